@@ -7,6 +7,11 @@
 
 #replaced code line is executed at the end
 
+#Every message ends with a trailer so the board can check what it received:
+#  [event code][payload ...][sequence][crc high][crc low]
+#The sequence counts messages mod 256. The crc is CRC-16/CCITT (polynomial 0x1021, seed 0xFFFF, msb
+#first) over everything before it, accumulated in r12 by the send subroutines while the message goes out
+
 #***************************************************************************
 #                   subroutine: writeStats
 #  description: writes stats to EXI port on each frame
@@ -79,6 +84,9 @@ bl startExiTransfer #indicate transfer start
 li r3, 0x37
 bl sendByteExi #send OnMatchStart event code
 
+li r3, 1
+bl sendByteExi #send the payload schema version, EVENT_SCHEMA_VERSION in eventschema.h. Boards drop games of another version, upgrade both together
+
 lis r31, 0x8045
 ori r31, r31, 0xAC4C
 
@@ -286,6 +294,35 @@ sth r10, 0x4010(r11) # disable MP3 memory protection
 li r10, 0xB0 #bit pattern to set clock to 8 MHz and enable CS for device 0
 stw r10, 0x6814(r11) #start transfer, write to parameter register
 
+li r12, 0
+ori r12, r12, 0xFFFF #seed the message crc
+
+blr
+
+#***************************************************************************
+#                    subroutine: crcUpdate
+#  description: adds bytes to the message crc in r12, most significant first
+#  inputs: r3 bytes to add, r9 number of bytes in r3 (1, 2 or 4)
+#  uses: r7-r10, ctr
+#***************************************************************************
+crcUpdate:
+slwi r7, r9, 3 #number of bits to add
+subfic r8, r7, 32
+slw r8, r3, r8 #left align the bytes so the next bit is always the top bit of r8
+mtctr r7
+
+CRC_BIT_LOOP:
+srwi r9, r8, 31 #next message bit
+rlwinm r10, r12, 17, 31, 31 #top bit of the crc
+xor r10, r10, r9
+rlwinm r12, r12, 1, 16, 30 #shift the crc left, keep 16 bits
+cmpwi r10, 0
+beq CRC_NO_POLY
+xori r12, r12, 0x1021
+CRC_NO_POLY:
+slwi r8, r8, 1
+bdnz CRC_BIT_LOOP
+
 blr
 
 #***************************************************************************
@@ -294,6 +331,11 @@ blr
 #  inputs: r3 byte to send
 #***************************************************************************
 sendByteExi:
+mflr r6
+li r9, 1
+bl crcUpdate
+mtlr r6
+
 lis r11, 0xCC00 #top bytes of address of EXI registers
 li r10, 0x5 #bit pattern to write to control register to write one byte
 
@@ -316,6 +358,11 @@ blr
 #  inputs: r3 bytes to send
 #***************************************************************************
 sendHalfExi:
+mflr r6
+li r9, 2
+bl crcUpdate
+mtlr r6
+
 lis r11, 0xCC00 #top bytes of address of EXI registers
 li r10, 0x15 #bit pattern to write to control register to write one byte
 
@@ -338,6 +385,11 @@ blr
 #  inputs: r3 word to send
 #***************************************************************************
 sendWordExi:
+mflr r6
+li r9, 4
+bl crcUpdate
+mtlr r6
+
 lis r11, 0xCC00 #top bytes of address of EXI registers
 li r10, 0x35 #bit pattern to write to control register to write four bytes
 
@@ -355,9 +407,25 @@ blr
 
 #***************************************************************************
 #                  subroutine: endExiTransfer
-#  description: stops port B writes
+#  description: sends the message trailer and stops port B writes
 #***************************************************************************
 endExiTransfer:
+mflr r5
+
+#the sequence number lives in the code itself so it survives between frames
+bl SEQUENCE_DATA_END
+.long 0
+SEQUENCE_DATA_END:
+mflr r4
+lbz r3, 0x0(r4)
+addi r10, r3, 1
+stb r10, 0x0(r4)
+bl sendByteExi #send sequence, it is covered by the crc
+
+mr r3, r12
+bl sendHalfExi #send crc, captured before sending it updates r12
+
+mtlr r5
 lis r11, 0xCC00 #top bytes of address of EXI registers
 
 li r10, 0
@@ -3,36 +3,40 @@
 #include <ArduinoJson.h>
 
 #include "enhmelee.h"
-
-//**********************************************************************
-//*                         ASM Event Codes
-//**********************************************************************
-#define EVENT_GAME_START 0x37
-#define EVENT_UPDATE 0x38
-#define EVENT_GAME_END 0x39
-
-int asmEvents[256];
-
-void asmEventsInitialize() {
-  asmEvents[EVENT_GAME_START] = 0xA;
-  asmEvents[EVENT_UPDATE] = 0x7A;
-  asmEvents[EVENT_GAME_END] = 0x1;
-}
+#include "eventschema.h"
+#include "msgcheck.h"
 
 //**********************************************************************
 //*               FPGA Read FIFO Communication Functions
 //**********************************************************************
-#define EMPTY_BIT_MASK 0x2000
-#define FULL_BIT_MASK 0x1000
-#define ACK_BIT_MASK 0x4000
 #define ACK_PIN 49
 #define EMPTY_PIN 50
 #define FULL_PIN 51
 #define READ_DATA_START_PIN 33
 #define READ_DATA_END_PIN 40
 
-word PortC;
+//The shipped FPGA image still puts an index byte in front of every data byte. Set to 1 only with an image
+//that sends framed messages (rfifo.h), the two formats cannot be told apart on the wire
+#define RFIFO_FRAMED 0
+
+//Set to 0 for a Gecko code older than the sequence and crc trailer (MatchDataExtraction.asm). The reader
+//has to know, the FIFO gives no message boundaries it could find the trailer by
+#define RFIFO_MSG_TRAILER 1
+#define RFIFO_TRAILER_SIZE (RFIFO_MSG_TRAILER ? MSG_TRAILER_SIZE : 0)
+
+//digitalWrite takes over a microsecond per call. Writing the set/clear registers directly keeps the ack
+//to a few cycles, the nops hold it high long enough for the FPGA to see it and give the FIFO time to
+//present the next word before the port is read again. DueFifoModel checks this margin on the host
+#define RFIFO_ACK_NOPS() __asm__ volatile ("nop\n\tnop\n\tnop\n\tnop\n\t")
+#define RFIFO_READ_PORT() (PIOC->PIO_PDSR)
+#define RFIFO_ACK() do { PIOC->PIO_SODR = ACK_BIT_MASK; RFIFO_ACK_NOPS(); PIOC->PIO_CODR = ACK_BIT_MASK; RFIFO_ACK_NOPS(); } while (0)
+
+#include "rfifo.h"
+
 RfifoMessage Msg; //Keep an RfifoMessage variable as a global variable to prevent memory leak? Does arduino do garbage collection?
+RfifoStats FifoStats = { };
+MsgCheckStats MsgChecks = { };
+uint8_t FifoFrame[MSG_BUFFER_SIZE + RFIFO_FRAME_OVERHEAD + MSG_TRAILER_SIZE];
 
 void rfifoInitialize() {
   //Set up fifo data pins as inputs
@@ -47,178 +51,85 @@ void rfifoInitialize() {
   digitalWrite(ACK_PIN, LOW);
 
   //Empty the FPGA buffer on startup
-  while((PIOC->PIO_PDSR & EMPTY_BIT_MASK) == 0) {
-    digitalWrite(ACK_PIN, HIGH);
-    digitalWrite(ACK_PIN, LOW);
-  }
+  rfifoFlush();
 }
 
-//Reads the pins corresponding with the FIFO communication
-void rfifoReadPins() {
-  PortC = PIOC->PIO_PDSR;
-}
-
-//Uses values read in previous read to determine if data is available
-bool rfifoDataAvailable() {
-  return (PortC & EMPTY_BIT_MASK) == 0;
-}
+void rfifoReadMessage() {
+  Msg = { false, 0, 0, 0, 0 };
 
-//Pops a byte off of the queue. This should only be called if data is available
-uint8_t rfifoPopByte() {
-  uint8_t read = (uint8_t)(PortC >> 1);
+  //Wait until data is available in the queue
+  while (!rfifoDataAvailable());
 
-  //Acknowledge the read
-  digitalWrite(ACK_PIN, HIGH);
-  digitalWrite(ACK_PIN, LOW);
+  int frameSize;
+#if RFIFO_FRAMED
+  int result = rfifoReadFramed(FifoFrame, frameSize, asmEvents, RFIFO_TRAILER_SIZE, FifoStats);
+#else
+  int result = rfifoReadIndexed(FifoFrame, frameSize, asmEvents, RFIFO_TRAILER_SIZE, FifoStats);
+#endif
 
-  return read;
-}
-
-void rfifoReadMessage() {
-  Msg = { false, 0, 0, 0, 0 };
-  uint8_t byteNum;
-  
-  do {
-    //Wait until data is available in the queue
-    do { rfifoReadPins(); } while(!rfifoDataAvailable());
-    byteNum = rfifoPopByte(); //First byte popped is the num
-  
-    //Wait until data is available in the queue
-    do { rfifoReadPins(); } while(!rfifoDataAvailable());
-    Msg.eventCode = rfifoPopByte(); //if byteNum is zero, this will be the event code
-  } while(byteNum != 0);
-  
-  //Get the expected message size for this event
+  Msg.eventCode = FifoFrame[1];
   Msg.messageSize = asmEvents[Msg.eventCode];
-  if (Msg.messageSize <= 0) return; //If message size for this event is zero, it is not a valid event, return a false success message
 
-  for (int i = 0; i < Msg.messageSize; i++) {
-    //Wait until data is available in the queue
-    do { rfifoReadPins(); } while(!rfifoDataAvailable());
-    uint8_t newByteNum = rfifoPopByte(); //Get byte index
-    
-    //Wait until data is available in the queue
-    do { rfifoReadPins(); } while(!rfifoDataAvailable());
-    uint8_t readValue = rfifoPopByte(); //Get byte value
-
-    //Given one of these conditions, something went wrong
-    if (newByteNum == 0 || newByteNum < byteNum || i != (newByteNum - 1)) return;
+  //Keep track of the number of bytes read (this is in case we miss reads we will know how many we did successfully read)
+  Msg.bytesRead = frameSize > 2 ? frameSize - 2 : 0;
+  if (Msg.bytesRead > Msg.messageSize) Msg.bytesRead = Msg.messageSize;
+  memcpy(Msg.data, FifoFrame + 2, Msg.bytesRead);
 
-    byteNum = newByteNum;
+  Msg.success = result == RFIFO_RESULT_OK;
 
-    //Load byte into buffer
-    Msg.data[i] = readValue;
-  
-    //Keep track of the number of bytes read (this is in case we miss reads we will know how many we did successfully read)
-    Msg.bytesRead = i + 1;
-  }
-  
-  Msg.success = true;
+#if RFIFO_MSG_TRAILER
+  //The indexed format has no checksum of its own, the trailer crc is all that catches a corrupt byte
+  int payloadSize;
+  int messageSize = 1 + Msg.messageSize + MSG_TRAILER_SIZE;
+  if (Msg.success) Msg.success = msgCheck(FifoFrame + 1, messageSize, asmEvents, payloadSize, MsgChecks) == MSG_CHECK_OK;
+#endif
 }
 
 //**********************************************************************
 //*                         Event Handlers
 //**********************************************************************
 Game CurrentGame = { };
+bool otherSchemaGame = false; //The game came from a Gecko code of another schema version, its messages are not used
 
-//The read operators will read a value and increment the index so the next read will read in the correct location
-uint8_t readByte(uint8_t* a, int& idx) {
-  return a[idx++];
-}
-
-uint16_t readHalf(uint8_t* a, int& idx) {
-  uint16_t value = a[idx] << 8 | a[idx + 1];
-  idx += 2;
-  return value;
-}
-
-uint32_t readWord(uint8_t* a, int& idx) {
-  uint32_t value = a[idx] << 24 | a[idx + 1] << 16 | a[idx + 2] << 8 | a[idx + 3];
-  idx += 4;
-  return value;
-}
-
-float readFloat(uint8_t* a, int& idx) {
-  uint32_t bytes = readWord(a, idx);
-  return *(float*)(&bytes);
-}
-
-void handleGameStart() {
-  uint8_t* data = Msg.data;
-  int idx = 0;
-  
+//Event codes, payload sizes and the field by field decode come from the schema in eventschema.h. The
+//Gecko code and this firmware have to be upgraded together, a game from another schema version is
+//dropped whole. Returns false for such a game
+bool handleGameStart() {
   //Reset CurrentGame variable
   CurrentGame = { };
   
-  //Load stage ID
-  CurrentGame.stage = readHalf(data, idx);
-
-  for (int i = 0; i < PLAYER_COUNT; i++) {
-    Player& p = CurrentGame.players[i];
-    
-    //Load player data
-    p.controllerPort = readByte(data, idx);
-    p.characterId = readByte(data, idx);
-    p.playerType = readByte(data, idx);
-    p.characterColor = readByte(data, idx);
+  schemaDecodeGameStart(CurrentGame, Msg.data);
+  otherSchemaGame = !schemaVersionMatches(CurrentGame);
+  if (otherSchemaGame) {
+    MsgChecks.otherSchemas++;
+    Serial.print("Game dropped: the Gecko code sends event schema ");
+    Serial.print(CurrentGame.schemaVersion);
+    Serial.print(", this firmware reads ");
+    Serial.print(EVENT_SCHEMA_VERSION);
+    Serial.println(". Upgrade both together");
   }
+  return !otherSchemaGame;
 }
 
 void handleUpdate() {
-  uint8_t* data = Msg.data;
-  int idx = 0;
-  
-  //Check frame count and see if any frames were skipped
-  uint32_t frameCount = readWord(data, idx);
-  int framesMissed = frameCount - CurrentGame.frameCounter - 1;
-  CurrentGame.framesMissed += framesMissed;
-  CurrentGame.frameCounter = frameCount;
-
-  CurrentGame.randomSeed = readWord(data, idx);
+  uint32_t lastFrame = CurrentGame.frameCounter;
 
+  //Change over previous frame data
   for (int i = 0; i < PLAYER_COUNT; i++) {
     Player& p = CurrentGame.players[i];
-
-    //Change over previous frame data
     p.previousFrameData = p.currentFrameData;
-
-    PlayerFrameData& pfd = p.currentFrameData;
-
-    //Load player data
-    pfd = { };
-    pfd.internalCharacterId = readByte(data, idx);
-    pfd.animation = readHalf(data, idx);
-    pfd.locationX = readFloat(data, idx);
-    pfd.locationY = readFloat(data, idx);
-
-    //Controller information
-    pfd.joystickX = readFloat(data, idx);
-    pfd.joystickY = readFloat(data, idx);
-    pfd.cstickX = readFloat(data, idx);
-    pfd.cstickY = readFloat(data, idx);
-    pfd.trigger = readFloat(data, idx);
-    pfd.buttons = readWord(data, idx);
-
-    //More data
-    pfd.percent = readFloat(data, idx);
-    pfd.shieldSize = readFloat(data, idx);
-    pfd.lastMoveHitId = readByte(data, idx);
-    pfd.comboCount = readByte(data, idx);
-    pfd.lastHitBy = readByte(data, idx);
-    pfd.stocks = readByte(data, idx);
-
-    //Raw controller information
-    pfd.physicalButtons = readHalf(data, idx);
-    pfd.lTrigger = readFloat(data, idx);
-    pfd.rTrigger = readFloat(data, idx);
+    p.currentFrameData = { };
   }
+
+  schemaDecodeUpdate(CurrentGame, Msg.data);
+  
+  //Check frame count and see if any frames were skipped
+  int framesMissed = CurrentGame.frameCounter - lastFrame - 1;
+  CurrentGame.framesMissed += framesMissed;
 }
 
 void handleGameEnd() {
-  uint8_t* data = Msg.data;
-  int idx = 0;
-  
-  CurrentGame.winCondition = readByte(data, idx);
+  schemaDecodeGameEnd(CurrentGame, Msg.data);
 }
 
 //**********************************************************************
@@ -669,23 +580,33 @@ void loop() {
     if (Msg.success) {
       switch (Msg.eventCode) {
         case EVENT_GAME_START:
-          handleGameStart();
+          if (!handleGameStart()) break;
           debugPrintMatchParams();
           postMatchParameters();
           break;
         case EVENT_UPDATE:
+          if (otherSchemaGame) break;
           handleUpdate();
           //debugPrintGameInfo();
           computeStatistics();
           break;
         case EVENT_GAME_END:
+          if (otherSchemaGame) break;
           handleGameEnd();
           postGameEndMessage();
           break;
       }
     } else {
       Serial.print("Failed to read message. Bytes read: ");
-      Serial.println(Msg.bytesRead);
+      Serial.print(Msg.bytesRead);
+      Serial.print(" | Bad checksums: ");
+      Serial.print(FifoStats.badChecksums);
+      Serial.print(" | Bad crcs: ");
+      Serial.print(MsgChecks.badCrcs);
+      Serial.print(" | Stalls: ");
+      Serial.print(FifoStats.stalls);
+      Serial.print(" | Missed messages: ");
+      Serial.println(FifoStats.sequenceGaps);
     }
   }
 }
@@ -141,8 +141,18 @@ typedef struct {
   PlayerStatistics stats;
 } Player;
 
+//Where eventschema.h decodes an update to and encodes one from
+PlayerFrameData& schemaUpdateTarget(Player& p) {
+  return p.currentFrameData;
+}
+
+const PlayerFrameData& schemaUpdateTarget(const Player& p) {
+  return p.currentFrameData;
+}
+
 typedef struct {
   Player players[PLAYER_COUNT]; //Contains all information relevant to individual players
+  uint8_t schemaVersion; //EVENT_SCHEMA_VERSION of the Gecko code that sent the game
   uint16_t stage; //Stage ID
 
   //Fromt Update event
@@ -0,0 +1,132 @@
+#ifndef _MSGCHECK_H_INCLUDED
+#define _MSGCHECK_H_INCLUDED
+
+#include <stdint.h>
+
+//Include after eventschema.h
+
+//**********************************************************************
+//*                       SPI Message Integrity
+//**********************************************************************
+//The Gecko code (MatchDataExtraction.asm) ends every message with a trailer:
+//
+//  [event code][payload ...][sequence][crc high][crc low]
+//
+//The sequence counts messages mod 256 so a lost message shows up as a gap even when it is not an
+//update. The crc is CRC-16/CCITT (polynomial 0x1021, seed 0xFFFF, msb first, no final xor) over
+//everything before it, which is one of the polynomials the TM4C1294 CRC module computes directly.
+//
+//Messages without a trailer from an older Gecko code are accepted but counted as unchecked, until the
+//first message with a good trailer. From then on every message is known to carry one, so a message of
+//the bare payload size is a truncated one and is rejected as a bad size. A game start from a Gecko code
+//older than the schema version byte (see eventschema.h) is rejected as another schema, not a bad size.
+//
+//Define MSG_CRC_HARDWARE before including this file to use the CRC module, host tools get the
+//software version which gives the same result.
+#define MSG_TRAILER_SIZE 3 //Sequence and crc
+
+#define MSG_CHECK_OK 0
+#define MSG_CHECK_UNCHECKED 1 //No trailer, the size matched the bare payload and no trailer was seen yet
+#define MSG_CHECK_BAD_SIZE 2 //Unknown event, a size that fits neither format or a bare message after a trailer
+#define MSG_CHECK_BAD_CRC 3
+#define MSG_CHECK_OTHER_SCHEMA 4 //Game start from a Gecko code older than the schema version byte
+#define MSG_CHECK_DUPLICATE 5 //Same sequence as the last good message
+
+typedef struct {
+  uint32_t messages; //Messages that passed the crc
+  uint32_t unchecked;
+  uint32_t badSizes;
+  uint32_t badCrcs;
+  uint32_t otherSchemas; //Game starts from another EVENT_SCHEMA_VERSION, the sketch counts the decoded ones
+  uint32_t sequenceGaps; //Messages missing between two good ones
+  uint32_t duplicates; //Repeats of the last good message, dropped
+  uint32_t resyncs; //Sequence stepped further back, the count restarted and nothing is counted as lost
+  bool hasSequence;
+  uint8_t nextSequence;
+} MsgCheckStats;
+
+#ifdef MSG_CRC_HARDWARE
+#include "inc/hw_memmap.h"
+#include "driverlib/crc.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+
+void msgCheckInitialize() {
+  ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_CCM0);
+  while (!ROM_SysCtlPeripheralReady(SYSCTL_PERIPH_CCM0));
+}
+
+uint16_t msgCrc16(const uint8_t* data, int length) {
+  //Writing the config seeds the module with all ones, in 8 bit mode it takes the buffer a byte at a time
+  ROM_CRCConfigSet(CCM0_BASE, CRC_CFG_INIT_1 | CRC_CFG_TYPE_P1021 | CRC_CFG_SIZE_8BIT);
+  return ROM_CRCDataProcess(CCM0_BASE, (uint32_t*)data, length, false) & 0xFFFF;
+}
+#else
+void msgCheckInitialize() {
+}
+
+uint16_t msgCrc16(const uint8_t* data, int length) {
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < length; i++) {
+    crc ^= data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+#endif
+
+//Checks a message as it came off the SPI bus, bytes starting with the event code. payloadSize is set
+//to the size of the payload without the trailer. Returns one of MSG_CHECK_*, the message should only
+//be used for OK and UNCHECKED
+int msgCheck(const uint8_t* bytes, int messageSize, const int* eventSizes, int& payloadSize, MsgCheckStats& stats) {
+  payloadSize = messageSize - 1;
+  int expected = eventSizes[bytes[0]];
+  if (expected <= 0) {
+    stats.badSizes++;
+    return MSG_CHECK_BAD_SIZE;
+  }
+
+  //The game start size from before the version byte, with or without the trailer
+  if (bytes[0] == EVENT_GAME_START &&
+    (payloadSize == EVENT_GAME_START_SIZE_V0 || payloadSize == EVENT_GAME_START_SIZE_V0 + MSG_TRAILER_SIZE)) {
+    stats.otherSchemas++;
+    return MSG_CHECK_OTHER_SCHEMA;
+  }
+
+  if (payloadSize == expected && !stats.hasSequence) {
+    stats.unchecked++;
+    return MSG_CHECK_UNCHECKED;
+  }
+
+  if (payloadSize != expected + MSG_TRAILER_SIZE) {
+    stats.badSizes++;
+    return MSG_CHECK_BAD_SIZE;
+  }
+
+  payloadSize = expected;
+  int checked = messageSize - 2;
+  uint16_t crc = bytes[checked] << 8 | bytes[checked + 1];
+  if (msgCrc16(bytes, checked) != crc) {
+    stats.badCrcs++;
+    return MSG_CHECK_BAD_CRC;
+  }
+
+  //Only a message that passed the crc is trusted to move the sequence along. A step back is not up to
+  //255 lost messages: the last sequence again is a duplicate, anything further back a restarted count
+  uint8_t sequence = bytes[checked - 1];
+  if (stats.hasSequence) {
+    int8_t step = (int8_t)(sequence - stats.nextSequence);
+    if (step == -1) {
+      stats.duplicates++;
+      return MSG_CHECK_DUPLICATE;
+    }
+    if (step < 0) stats.resyncs++;
+    else stats.sequenceGaps += step;
+  }
+  stats.nextSequence = sequence + 1;
+  stats.hasSequence = true;
+  stats.messages++;
+  return MSG_CHECK_OK;
+}
+
+#endif
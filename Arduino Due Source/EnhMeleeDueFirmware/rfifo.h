@@ -0,0 +1,177 @@
+#ifndef _RFIFO_H_INCLUDED
+#define _RFIFO_H_INCLUDED
+
+#include <stdint.h>
+
+//**********************************************************************
+//*                      FPGA Read FIFO Framing
+//**********************************************************************
+//The FPGA used to put an index byte in front of every data byte so a lost byte could be detected, which
+//doubles the pops per message (252 for an update with its trailer). Framed messages check once per message instead:
+//
+//  [sequence][event code][payload ...][checksum]
+//
+//The sequence counts messages mod 256 so a dropped message shows up as a gap. The checksum is the
+//negated 8 bit sum of every byte before it so a good frame sums to zero. The console sends each message
+//as one burst, so after a bad frame the reader drains the FIFO and the next byte starts a new frame.
+//
+//The Gecko code ends every message with its own sequence and crc trailer (msgcheck.h). The FPGA forwards
+//it like payload, so the readers take trailerSize more bytes after the payload and leave them in the
+//frame for msgCheck(). Reading only the payload would leave the trailer in the FIFO as the start of the
+//next message.
+//
+//Nothing here touches hardware directly. The includer defines how to reach the port so the board maps
+//these onto PIOC and the host FIFO model maps them onto a simulated FIFO:
+//  RFIFO_READ_PORT()  returns the port C pin state
+//  RFIFO_ACK()        pulses the ack line and waits for the FIFO to present the next word
+#define EMPTY_BIT_MASK 0x2000
+#define FULL_BIT_MASK 0x1000
+#define ACK_BIT_MASK 0x4000
+
+#define RFIFO_FRAME_OVERHEAD 3 //Sequence, event code and checksum
+#define RFIFO_STALL_POLLS 100000 //Empty polls in the middle of a message before giving up on it, a few ms
+
+#define RFIFO_RESULT_OK 0
+#define RFIFO_RESULT_STALLED 1 //The FIFO ran dry mid message
+#define RFIFO_RESULT_UNKNOWN_EVENT 2
+#define RFIFO_RESULT_BAD_CHECKSUM 3
+#define RFIFO_RESULT_BAD_INDEX 4 //Indexed format only
+#define RFIFO_RESULT_DUPLICATE 5 //Framed format only, same sequence as the last good frame
+
+typedef struct {
+  uint32_t messages;
+  uint32_t sequenceGaps; //Messages missing between two good ones
+  uint32_t duplicates; //Repeats of the last good frame, dropped
+  uint32_t resyncs; //Sequence stepped further back, the count restarted and nothing is counted as lost
+  uint32_t stalls;
+  uint32_t unknownEvents;
+  uint32_t badChecksums;
+  uint32_t badIndices;
+  uint32_t overflows; //Times the FIFO full flag was seen
+  bool hasSequence;
+  uint8_t nextSequence;
+} RfifoStats;
+
+uint8_t rfifoChecksum(const uint8_t* data, int length) {
+  uint8_t sum = 0;
+  for (int i = 0; i < length; i++) sum += data[i];
+  return (uint8_t)-sum;
+}
+
+//Pops bytes for as long as the FIFO stays non-empty, stops early once count bytes are read. Returns
+//the number of bytes popped
+int rfifoReadBurst(uint8_t* out, int count, RfifoStats& stats) {
+  int read = 0;
+  while (read < count) {
+    uint32_t port = RFIFO_READ_PORT();
+    if (port & EMPTY_BIT_MASK) break;
+    if (port & FULL_BIT_MASK) stats.overflows++;
+
+    out[read++] = (uint8_t)(port >> 1);
+    RFIFO_ACK();
+  }
+  return read;
+}
+
+//Reads exactly count bytes in bursts. Returns false if the FIFO stayed empty for too long
+bool rfifoReadExactly(uint8_t* out, int count, RfifoStats& stats) {
+  int read = 0;
+  int idle = 0;
+  while (read < count) {
+    int burst = rfifoReadBurst(out + read, count - read, stats);
+    if (burst > 0) {
+      read += burst;
+      idle = 0;
+    } else if (++idle >= RFIFO_STALL_POLLS) {
+      stats.stalls++;
+      return false;
+    }
+  }
+  return true;
+}
+
+//Empties the FIFO, used to get back to a frame boundary after a bad frame
+void rfifoFlush() {
+  while ((RFIFO_READ_PORT() & EMPTY_BIT_MASK) == 0) RFIFO_ACK();
+}
+
+bool rfifoDataAvailable() {
+  return (RFIFO_READ_PORT() & EMPTY_BIT_MASK) == 0;
+}
+
+//Reads one framed message into frame, eventSizes gives the payload size for each event code (0 means
+//unknown) and trailerSize the bytes that follow it. frameSize is set to the bytes read so far even on
+//failure. Returns one of RFIFO_RESULT_*
+int rfifoReadFramed(uint8_t* frame, int& frameSize, const int* eventSizes, int trailerSize, RfifoStats& stats) {
+  frameSize = 0;
+  if (!rfifoReadExactly(frame, 2, stats)) return RFIFO_RESULT_STALLED;
+  frameSize = 2;
+
+  int payloadSize = eventSizes[frame[1]];
+  if (payloadSize <= 0) {
+    stats.unknownEvents++;
+    rfifoFlush();
+    return RFIFO_RESULT_UNKNOWN_EVENT;
+  }
+
+  if (!rfifoReadExactly(frame + 2, payloadSize + trailerSize + 1, stats)) return RFIFO_RESULT_STALLED;
+  frameSize += payloadSize + trailerSize + 1;
+
+  if (rfifoChecksum(frame, frameSize) != 0) {
+    stats.badChecksums++;
+    rfifoFlush();
+    return RFIFO_RESULT_BAD_CHECKSUM;
+  }
+
+  //Only a good frame is trusted to move the sequence along, a step back is handled as in msgCheck()
+  uint8_t sequence = frame[0];
+  if (stats.hasSequence) {
+    int8_t step = (int8_t)(sequence - stats.nextSequence);
+    if (step == -1) {
+      stats.duplicates++;
+      return RFIFO_RESULT_DUPLICATE;
+    }
+    if (step < 0) stats.resyncs++;
+    else stats.sequenceGaps += step;
+  }
+  stats.nextSequence = sequence + 1;
+  stats.hasSequence = true;
+  stats.messages++;
+  return RFIFO_RESULT_OK;
+}
+
+//Reads one message in the older format where every byte is preceded by its index, index 0 carrying the
+//event code. Lays the result out like a frame so callers handle both formats the same way
+int rfifoReadIndexed(uint8_t* frame, int& frameSize, const int* eventSizes, int trailerSize, RfifoStats& stats) {
+  uint8_t pair[2];
+  frameSize = 0;
+
+  //Skip anything left over from a broken message until the start of the next one
+  do {
+    if (!rfifoReadExactly(pair, 2, stats)) return RFIFO_RESULT_STALLED;
+  } while (pair[0] != 0);
+
+  frame[0] = 0;
+  frame[1] = pair[1];
+  frameSize = 2;
+
+  int payloadSize = eventSizes[frame[1]];
+  if (payloadSize <= 0) {
+    stats.unknownEvents++;
+    return RFIFO_RESULT_UNKNOWN_EVENT;
+  }
+
+  for (int i = 0; i < payloadSize + trailerSize; i++) {
+    if (!rfifoReadExactly(pair, 2, stats)) return RFIFO_RESULT_STALLED;
+    if (pair[0] != (uint8_t)(i + 1)) {
+      stats.badIndices++;
+      return RFIFO_RESULT_BAD_INDEX;
+    }
+    frame[frameSize++] = pair[1];
+  }
+
+  stats.messages++;
+  return RFIFO_RESULT_OK;
+}
+
+#endif
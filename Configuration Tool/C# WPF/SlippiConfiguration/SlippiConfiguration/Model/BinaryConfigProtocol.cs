@@ -0,0 +1,130 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Net;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Fizzi.Applications.SlippiConfiguration.Model
+{
+    enum BinaryConfigTag : byte
+    {
+        Status = 0x01,
+        Mac = 0x02,
+        TargetIp = 0x03,
+        TargetPort = 0x04,
+        LogText = 0x05,
+        TelemetryTarget = 0x06,
+        TelemetryDecimation = 0x07,
+        TelemetryBudget = 0x08,
+        Frame = 0x10,
+        FramesMissed = 0x11,
+        Player = 0x12
+    }
+
+    enum BinaryConfigStatus : byte
+    {
+        Ok,
+        UnsupportedVersion,
+        Malformed,
+        UnknownType
+    }
+
+    class BinaryConfigPacket
+    {
+        public byte Version { get; set; }
+        public UdpMessageType Type { get; set; }
+        public UInt16 Sequence { get; set; }
+        public List<KeyValuePair<BinaryConfigTag, byte[]>> Values { get; private set; }
+
+        public BinaryConfigPacket()
+        {
+            Values = new List<KeyValuePair<BinaryConfigTag, byte[]>>();
+        }
+
+        public byte[] GetValue(BinaryConfigTag tag)
+        {
+            return Values.Where(kvp => kvp.Key == tag).Select(kvp => kvp.Value).FirstOrDefault();
+        }
+    }
+
+    /// <summary>
+    /// Builds and parses packets for the binary UDP configuration protocol described in udpprotocol.h
+    /// of EnhMelee1294Firmware. Packets share port 3637 with the JSON messages and are told apart by
+    /// their 'S','L' magic.
+    /// </summary>
+    static class BinaryConfigProtocol
+    {
+        public const byte Version = 1;
+        private const int HeaderSize = 6;
+
+        private static UInt16 nextSequence = 0;
+
+        public static bool IsBinaryPacket(byte[] packet)
+        {
+            return packet.Length >= HeaderSize && packet[0] == 'S' && packet[1] == 'L';
+        }
+
+        public static byte[] Build(UdpMessageType type, params KeyValuePair<BinaryConfigTag, byte[]>[] values)
+        {
+            var sequence = nextSequence++;
+
+            var packet = new List<byte>() { (byte)'S', (byte)'L', Version, (byte)type, (byte)(sequence >> 8), (byte)sequence };
+            foreach (var kvp in values)
+            {
+                packet.Add((byte)kvp.Key);
+                packet.Add((byte)kvp.Value.Length);
+                packet.AddRange(kvp.Value);
+            }
+
+            return packet.ToArray();
+        }
+
+        public static byte[] BuildDiscovery()
+        {
+            return Build(UdpMessageType.Discovery);
+        }
+
+        public static byte[] BuildFlashErase()
+        {
+            return Build(UdpMessageType.FlashErase);
+        }
+
+        public static byte[] BuildSetTarget(IPAddress address, int port)
+        {
+            return Build(UdpMessageType.SetTarget,
+                new KeyValuePair<BinaryConfigTag, byte[]>(BinaryConfigTag.TargetIp, address.GetAddressBytes()),
+                new KeyValuePair<BinaryConfigTag, byte[]>(BinaryConfigTag.TargetPort, new byte[] { (byte)(port >> 8), (byte)port }));
+        }
+
+        /// <summary>
+        /// Returns null if the packet is not a binary packet. Parsing stops at the first value that runs
+        /// past the end of the packet.
+        /// </summary>
+        public static BinaryConfigPacket Parse(byte[] packet)
+        {
+            if (!IsBinaryPacket(packet)) return null;
+
+            int index = 2;
+            var result = new BinaryConfigPacket();
+            result.Version = BitHelper.ReadByte(packet, ref index);
+            result.Type = (UdpMessageType)BitHelper.ReadByte(packet, ref index);
+            result.Sequence = BitHelper.ReadUInt16(packet, ref index);
+
+            while (index + 2 <= packet.Length)
+            {
+                var tag = (BinaryConfigTag)packet[index];
+                var length = packet[index + 1];
+                if (index + 2 + length > packet.Length) break;
+
+                var value = new byte[length];
+                Array.Copy(packet, index + 2, value, 0, length);
+                result.Values.Add(new KeyValuePair<BinaryConfigTag, byte[]>(tag, value));
+
+                index += 2 + length;
+            }
+
+            return result;
+        }
+    }
+}
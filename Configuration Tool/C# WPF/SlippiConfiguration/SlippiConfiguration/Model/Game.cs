@@ -11,6 +11,7 @@ namespace Fizzi.Applications.SlippiConfiguration.Model
     class Game
     {
         public Player[] Players { get; set; }
+        public byte SchemaVersion { get; set; }
         public Stage Stage { get; set; }
 
         public UInt32 FrameCounter { get; set; }
@@ -34,6 +35,9 @@ public static Game New(byte[] message)
 
             int index = 1;
 
+            //Payload schema version, see eventschema.h in the board firmware
+            game.SchemaVersion = BitHelper.ReadByte(message, ref index);
+
             //Get stage ID and increment counter
             game.Stage = (Stage)BitHelper.ReadUInt16(message, ref index);
             
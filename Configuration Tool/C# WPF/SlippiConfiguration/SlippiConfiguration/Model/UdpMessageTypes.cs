@@ -12,6 +12,8 @@ enum UdpMessageType
         Discovery,
         FlashErase,
         LogMessage,
-        SetTarget
+        SetTarget,
+        StatsQuery,
+        SetTelemetry
     }
 }
@@ -9,6 +9,7 @@
 using System.Windows;
 using System.Net.Sockets;
 using System.Net;
+using System.Net.NetworkInformation;
 using System.Reactive.Linq;
 using Newtonsoft.Json;
 using Newtonsoft.Json.Linq;
@@ -59,8 +60,12 @@ public MainViewModel(Window window)
 
                 UdpClient client = new UdpClient();
                 IPEndPoint ip = new IPEndPoint(IPAddress.Broadcast, 3637);
+                //Firmware without the binary protocol only answers JSON. The binary request goes last so a
+                //device that speaks both keeps sending its log in binary.
                 byte[] bytes = Encoding.ASCII.GetBytes(string.Format("{{\"type\":{0}}}", (int)UdpMessageType.Discovery));
                 client.Send(bytes, bytes.Length, ip);
+                byte[] packet = BinaryConfigProtocol.BuildDiscovery();
+                client.Send(packet, packet.Length, ip);
                 
                 //Log current time
                 LastScanTime = DateTime.UtcNow;
@@ -80,6 +85,26 @@ public MainViewModel(Window window)
                         //If response is too long, skip
                         if (response.Length > 100) continue;
 
+                        //Binary replies take precedence over the JSON reply from the same device
+                        if (BinaryConfigProtocol.IsBinaryPacket(response))
+                        {
+                            var reply = BinaryConfigProtocol.Parse(response);
+                            var mac = reply.GetValue(BinaryConfigTag.Mac);
+                            if (reply.Type != UdpMessageType.Discovery || mac == null || mac.Length != 6) continue;
+
+                            var binaryDevice = new SlippiDevice(new PhysicalAddress(mac), endpoint.Address, true);
+                            var targetIp = reply.GetValue(BinaryConfigTag.TargetIp);
+                            var targetPort = reply.GetValue(BinaryConfigTag.TargetPort);
+                            if (targetIp != null && targetIp.Length == 4) binaryDevice.TargetIp = new IPAddress(targetIp);
+                            if (targetPort != null && targetPort.Length == 2) binaryDevice.TargetPort = (targetPort[0] << 8) | targetPort[1];
+
+                            newDevices[endpoint.Address] = binaryDevice;
+                            continue;
+                        }
+
+                        SlippiDevice existing;
+                        if (newDevices.TryGetValue(endpoint.Address, out existing) && existing.IsBinary) continue;
+
                         //Parse JSON
                         var json = JObject.Parse(Encoding.ASCII.GetString(response));
                         var command = (UdpMessageType)json["type"].Value<int>();
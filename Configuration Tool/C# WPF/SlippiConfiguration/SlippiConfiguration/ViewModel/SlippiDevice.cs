@@ -37,13 +37,21 @@ class SlippiDevice : INotifyPropertyChanged
         private StringBuilder logBuilder = new StringBuilder(0, MAX_LOG_LENGTH);
         public string Log { get { return logBuilder.ToString(); } }
 
+        //True if the device answered the binary discovery packet, in which case commands are sent in binary
+        public bool IsBinary { get; private set; }
+
         public ICommand EraseFlashCommand { get; private set; }
         public ICommand SetTargetCommand { get; private set; }
 
-        public SlippiDevice(string mac, IPAddress address)
+        public SlippiDevice(string mac, IPAddress address) : this(PhysicalAddress.Parse(mac), address, false)
         {
-            Mac = PhysicalAddress.Parse(mac);
+        }
+
+        public SlippiDevice(PhysicalAddress mac, IPAddress address, bool isBinary)
+        {
+            Mac = mac;
             DeviceIp = address;
+            IsBinary = isBinary;
 
             EraseFlashCommand = Command.Create(() => true, EraseFlash);
             SetTargetCommand = Command.Create(() => true, () => ChangeTarget(PendingTargetIp, PendingTargetPort));
@@ -51,6 +59,15 @@ public SlippiDevice(string mac, IPAddress address)
 
         public void HandleUdpMessage(byte[] message)
         {
+            //Binary packets carry log text in a TLV instead of a JSON node
+            if (BinaryConfigProtocol.IsBinaryPacket(message))
+            {
+                var packet = BinaryConfigProtocol.Parse(message);
+                var text = packet.GetValue(BinaryConfigTag.LogText);
+                if (packet.Type == UdpMessageType.LogMessage && text != null) AppendLog(Encoding.UTF8.GetString(text));
+                return;
+            }
+
             //Parse JSON
             var json = JObject.Parse(Encoding.ASCII.GetString(message));
             int command = json["type"].Value<int>();
@@ -86,7 +103,8 @@ public void EraseFlash()
         {
             UdpClient client = new UdpClient();
             IPEndPoint ip = new IPEndPoint(DeviceIp, 3637);
-            byte[] bytes = Encoding.ASCII.GetBytes(string.Format("{{\"type\":{0}}}", (int)UdpMessageType.FlashErase));
+            byte[] bytes = IsBinary ? BinaryConfigProtocol.BuildFlashErase() :
+                Encoding.ASCII.GetBytes(string.Format("{{\"type\":{0}}}", (int)UdpMessageType.FlashErase));
             client.Send(bytes, bytes.Length, ip);
         }
 
@@ -94,6 +112,13 @@ public void ChangeTarget(IPAddress address, int port)
         {
             UdpClient client = new UdpClient();
             IPEndPoint ip = new IPEndPoint(DeviceIp, 3637);
+            if (IsBinary)
+            {
+                byte[] packet = BinaryConfigProtocol.BuildSetTarget(address, port);
+                client.Send(packet, packet.Length, ip);
+                return;
+            }
+
             var addressBytes = address.GetAddressBytes();
             var sendString = string.Format("{{\"type\":{0},\"ip1\":{1},\"ip2\":{2},\"ip3\":{3},\"ip4\":{4},\"port\":{5}}}",
                 (int)UdpMessageType.SetTarget, addressBytes[0], addressBytes[1], addressBytes[2], addressBytes[3], port);
@@ -0,0 +1,300 @@
+//BatchDecodeBenchmark - compares decoding a corpus of update payloads one frame at a time through the
+//schema decoder (what every analysis does today) with the batch decoder in batchdecode.h, which swaps and
+//transposes them into columns with SSSE3/AVX2 or its scalar fallback.
+//
+//The corpus is a set of synthetic games, plus the updates of any captures given with -i. Updates are
+//decoded packed back to back and, to cover the case of decoding in place, at their stride in a board
+//stream. Each variant reports the best time of all repetitions in ns per update and MB/s of payload.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing BatchDecodeBenchmark.cpp -o BatchDecodeBenchmark
+//Usage: BatchDecodeBenchmark [-i capture]... [-g games] [-f frames] [-r repetitions] [-c]
+//  -c checks every variant against the schema decoder and exits, the exit code is non-zero on failure
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/synthgame.h"
+#include "../Common/batchdecode.h"
+
+#define STREAM_UPDATE_STRIDE (STREAM_HEADER_SIZE + 1 + EVENT_UPDATE_SIZE)
+
+#define VARIANT_SCHEMA -2 //Not a batch variant, schemaDecodeUpdate per update
+
+static const int variants[] = { VARIANT_SCHEMA, BATCH_DECODE_SCALAR, BATCH_DECODE_SSSE3, BATCH_DECODE_AVX2 };
+static const char* variantNames[] = { "schema", "scalar", "ssse3", "avx2" };
+#define VARIANT_COUNT 4
+
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//**********************************************************************
+//*                               Corpus
+//**********************************************************************
+typedef struct {
+  std::vector<uint8_t> packed; //Update payloads back to back
+  std::vector<uint8_t> stream; //The same updates framed as a board sends them
+  int count;
+} Corpus;
+
+void appendUpdate(Corpus& c, const uint8_t* payload) {
+  c.packed.insert(c.packed.end(), payload, payload + EVENT_UPDATE_SIZE);
+
+  uint8_t framed[STREAM_UPDATE_STRIDE];
+  int length = frameMessage(framed, EVENT_UPDATE, payload, EVENT_UPDATE_SIZE);
+  c.stream.insert(c.stream.end(), framed, framed + length);
+  c.count++;
+}
+
+void appendSyntheticGames(Corpus& c, int games, int frames) {
+  uint8_t payload[MSG_BUFFER_SIZE];
+  for (int g = 0; g < games; g++) {
+    uint32_t rng = 0x9E3779B9 + g;
+    Game game;
+    synthesizeGameStart(game, rng);
+    for (int frame = 1; frame <= frames; frame++) {
+      synthesizeUpdate(game, rng, frame);
+      encodeUpdate(payload, game);
+      appendUpdate(c, payload);
+    }
+  }
+}
+
+//Takes the updates out of a raw board stream. Returns false if it is corrupt
+bool appendCapture(Corpus& c, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  StreamReader* r = new StreamReader();
+  r->length = 0;
+  bool ok = true;
+  while (ok) {
+    int space;
+    uint8_t* into = streamWritePointer(*r, space);
+    size_t read = fread(into, 1, space, f);
+    if (read == 0) break;
+    streamCommit(*r, read);
+
+    int offset = 0, messageSize, result;
+    uint8_t* message;
+    while ((result = streamNextMessage(*r, offset, message, messageSize)) == STREAM_MESSAGE) {
+      if (message[0] == EVENT_UPDATE && messageSize == EVENT_UPDATE_SIZE + 1) appendUpdate(c, message + 1);
+    }
+    if (result == STREAM_CORRUPT) ok = false;
+    streamConsume(*r, offset);
+  }
+
+  ok = ok && r->length == 0;
+  delete r;
+  fclose(f);
+  return ok;
+}
+
+//**********************************************************************
+//*                              Decoding
+//**********************************************************************
+//The field at a time path, a full decode per update with the columns filled in from the Game
+void schemaDecodeColumns(const uint8_t* records, int stride, int count, UpdateColumns& c) {
+  batchColumnsResize(c, count);
+  Game game = { };
+  for (int n = 0; n < count; n++) {
+    schemaDecodeUpdate(game, records + (size_t)n * stride);
+    c.frameCounter[n] = game.frameCounter;
+    c.randomSeed[n] = game.randomSeed;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      const PlayerFrameData& pfd = game.players[i].currentFrameData;
+      PlayerColumns& p = c.players[i];
+      p.locationX[n] = pfd.locationX;
+      p.locationY[n] = pfd.locationY;
+      p.joystickX[n] = pfd.joystickX;
+      p.joystickY[n] = pfd.joystickY;
+      p.cstickX[n] = pfd.cstickX;
+      p.cstickY[n] = pfd.cstickY;
+      p.trigger[n] = pfd.trigger;
+      p.buttons[n] = pfd.buttons;
+      p.percent[n] = pfd.percent;
+      p.shieldSize[n] = pfd.shieldSize;
+      p.animation[n] = pfd.animation;
+      p.stocks[n] = pfd.stocks;
+    }
+  }
+}
+
+void decodeColumns(int variant, const uint8_t* records, int stride, int count, UpdateColumns& c) {
+  if (variant == VARIANT_SCHEMA) schemaDecodeColumns(records, stride, count, c);
+  else batchDecodeUpdates(records, stride, count, c, variant);
+}
+
+template <typename T> bool sameColumn(const std::vector<T>& a, const std::vector<T>& b, int count) {
+  return memcmp(a.data(), b.data(), count * sizeof(T)) == 0;
+}
+
+//Bit for bit, so a NaN or -0 in a float column has to come through unchanged as well
+bool sameColumns(const UpdateColumns& a, const UpdateColumns& b) {
+  if (a.count != b.count) return false;
+  int n = a.count;
+  bool same = sameColumn(a.frameCounter, b.frameCounter, n) && sameColumn(a.randomSeed, b.randomSeed, n);
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerColumns& p = a.players[i];
+    const PlayerColumns& q = b.players[i];
+    same = same && sameColumn(p.locationX, q.locationX, n) && sameColumn(p.locationY, q.locationY, n) &&
+      sameColumn(p.joystickX, q.joystickX, n) && sameColumn(p.joystickY, q.joystickY, n) &&
+      sameColumn(p.cstickX, q.cstickX, n) && sameColumn(p.cstickY, q.cstickY, n) &&
+      sameColumn(p.trigger, q.trigger, n) && sameColumn(p.buttons, q.buttons, n) &&
+      sameColumn(p.percent, q.percent, n) && sameColumn(p.shieldSize, q.shieldSize, n) &&
+      sameColumn(p.animation, q.animation, n) && sameColumn(p.stocks, q.stocks, n);
+  }
+  return same;
+}
+
+//**********************************************************************
+//*                                Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int runCheck() {
+  bool ok = true;
+  printf("Checking batch decoder, best variant on this CPU is %s\n", variantNames[batchDecodeBestVariant() + 1]);
+
+  //Random bytes instead of encoded games so every bit pattern of every field is covered
+  Corpus random = { };
+  uint32_t rng = 0xD1CE;
+  uint8_t payload[EVENT_UPDATE_SIZE];
+  for (int n = 0; n < 1000; n++) {
+    for (int b = 0; b < EVENT_UPDATE_SIZE; b++) payload[b] = nextRandom(rng);
+    appendUpdate(random, payload);
+  }
+
+  UpdateColumns expected = { }, actual = { };
+  for (int v = 1; v < VARIANT_COUNT; v++) {
+    char what[96];
+    if (!batchDecodeSupported(variants[v])) {
+      printf("  %-58s skipped\n", variantNames[v]);
+      continue;
+    }
+
+    bool same = true;
+    for (int count = 0; count <= 19 && same; count++) {
+      schemaDecodeColumns(random.packed.data(), EVENT_UPDATE_SIZE, count, expected);
+      decodeColumns(variants[v], random.packed.data(), EVENT_UPDATE_SIZE, count, actual);
+      same = sameColumns(expected, actual);
+    }
+    snprintf(what, sizeof(what), "%s matches the schema decoder for 0-19 updates", variantNames[v]);
+    ok &= expect(same, what);
+
+    schemaDecodeColumns(random.packed.data(), EVENT_UPDATE_SIZE, random.count, expected);
+    decodeColumns(variants[v], random.packed.data(), EVENT_UPDATE_SIZE, random.count, actual);
+    snprintf(what, sizeof(what), "%s matches on %d random packed updates", variantNames[v], random.count);
+    ok &= expect(sameColumns(expected, actual), what);
+
+    decodeColumns(variants[v], random.stream.data() + STREAM_HEADER_SIZE + 1, STREAM_UPDATE_STRIDE, random.count, actual);
+    snprintf(what, sizeof(what), "%s matches on the same updates in a board stream", variantNames[v]);
+    ok &= expect(sameColumns(expected, actual), what);
+  }
+
+  //Round trip through the encoder, the columns have to hold exactly what was synthesized
+  Corpus synth = { };
+  appendSyntheticGames(synth, 1, 600);
+  batchDecodeUpdates(synth.packed.data(), EVENT_UPDATE_SIZE, synth.count, actual);
+  Game game;
+  rng = 0x9E3779B9;
+  synthesizeGameStart(game, rng);
+  bool roundTrip = true;
+  for (int frame = 1; frame <= 600; frame++) {
+    synthesizeUpdate(game, rng, frame);
+    int n = frame - 1;
+    roundTrip &= actual.frameCounter[n] == (uint32_t)frame;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      const PlayerFrameData& pfd = game.players[i].currentFrameData;
+      roundTrip &= actual.players[i].locationX[n] == pfd.locationX && actual.players[i].percent[n] == pfd.percent &&
+        actual.players[i].buttons[n] == pfd.buttons && actual.players[i].stocks[n] == pfd.stocks;
+    }
+  }
+  ok &= expect(roundTrip, "synthesized games come back out of the columns");
+
+  printf(ok ? "PASS\n" : "FAIL\n");
+  return ok ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  std::vector<const char*> captures;
+  int games = 32;
+  int frames = 3600;
+  int repetitions = 5;
+  bool check = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "i:g:f:r:c")) != -1) {
+    switch (opt) {
+      case 'i': captures.push_back(optarg); break;
+      case 'g': games = atoi(optarg); break;
+      case 'f': frames = atoi(optarg); break;
+      case 'r': repetitions = atoi(optarg); break;
+      case 'c': check = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-i capture]... [-g games] [-f frames] [-r repetitions] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  asmEventsInitialize();
+  if (check) return runCheck();
+  if (repetitions < 1) repetitions = 1;
+
+  Corpus corpus = { };
+  appendSyntheticGames(corpus, games, frames);
+  for (size_t i = 0; i < captures.size(); i++) {
+    if (!appendCapture(corpus, captures[i])) {
+      fprintf(stderr, "Failed to read capture %s, it is missing, corrupt or truncated\n", captures[i]);
+      return 1;
+    }
+  }
+  if (corpus.count == 0) {
+    fprintf(stderr, "No updates to decode\n");
+    return 1;
+  }
+
+  printf("%d updates, %.1f MB of payload, best variant on this CPU is %s\n", corpus.count,
+    corpus.count * (double)EVENT_UPDATE_SIZE / 1e6, variantNames[batchDecodeBestVariant() + 1]);
+
+  const char* layouts[] = { "packed", "stream" };
+  UpdateColumns columns = { };
+  for (int layout = 0; layout < 2; layout++) {
+    const uint8_t* records = layout == 0 ? corpus.packed.data() : corpus.stream.data() + STREAM_HEADER_SIZE + 1;
+    int stride = layout == 0 ? EVENT_UPDATE_SIZE : STREAM_UPDATE_STRIDE;
+
+    double schemaNs = 0;
+    for (int v = 0; v < VARIANT_COUNT; v++) {
+      if (variants[v] != VARIANT_SCHEMA && !batchDecodeSupported(variants[v])) continue;
+
+      uint64_t best = ~0ull;
+      for (int r = 0; r < repetitions; r++) {
+        uint64_t start = hostNs();
+        decodeColumns(variants[v], records, stride, corpus.count, columns);
+        uint64_t elapsed = hostNs() - start;
+        if (elapsed < best) best = elapsed;
+      }
+
+      double ns = (double)best / corpus.count;
+      if (variants[v] == VARIANT_SCHEMA) schemaNs = ns;
+      printf("  %-6s %-6s %7.2f ns/update %8.0f MB/s %5.2fx\n", layouts[layout], variantNames[v], ns,
+        EVENT_UPDATE_SIZE / ns * 1e3, schemaNs / ns);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,376 @@
+//BootSim - plays a board reset in the middle of a game against a console that keeps sending updates,
+//once with the old boot that held ingest back until DHCP answered and once with the fast boot of
+//netboot.h: ingest first, the network in the background and the stream held in the backlog until the
+//first connection, or until it gives up on the server. The boot state machine and the backlog are the board's code, the console, DHCP, the
+//server's TCP window and the server itself are simulated in 1ms steps.
+//
+//Prints when ingest, the network and the stream came up after reset, how many updates were lost where,
+//and checks that what reached the server is whole messages in order.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings BootSim.cpp -o BootSim
+//Usage: BootSim [-d dhcpMs] [-t connectMs] [-l lossAtMs] [-s seconds] [-k] | -c
+//  -d is when DHCP answers after reset, -1 never. -t is how long a connection to the server takes
+//  -l drops the connection once at that time, -k boots with a lease cached from an earlier boot
+//  -c checks the boot state machine, the backlog and a few boots and exits, non-zero on failure
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/netboot.h"
+
+#define FRAME_US 16683
+#define EVENT_UPDATE 0x38 //Code and payload size of an update, see eventschema.h
+#define EVENT_UPDATE_SIZE 0x7A
+#define SSI_RX_BUFFER_COUNT 5 //Like SSI3DMASlave.cpp
+#define LEGACY_DHCP_TIMEOUT_MS 60000 //Ethernet.begin(mac) gives up after this
+#define FAST_INGEST_US 3000 //Reset to the end of the stats engine init, what the board reports
+#define TCP_WINDOW_MAX 1460 //Most bytes one client.write() takes per millisecond
+
+typedef struct {
+  int dhcpMs; //-1 never answers
+  int connectMs;
+  int lossAtMs; //0 never
+  int seconds;
+  bool hasCachedLease;
+  bool fastBoot;
+} BootConfig;
+
+typedef struct {
+  uint32_t frames; //Updates the console sent
+  uint32_t lostBeforeIngest; //Sent while nothing read SSI, or written over in the ring
+  uint32_t ingested;
+  uint32_t backlogDropped;
+  uint32_t backlogAbandoned; //Still in the backlog when it was given up
+  uint32_t notConnected; //Dropped by writeMsg() without a connection
+  uint32_t received;
+  uint32_t badStreams; //Connections that did not parse as whole messages in order
+  uint32_t truncated; //Connections that ended in the middle of a message
+  uint32_t ingestUs;
+  int networkMs; //-1 never
+  int streamMs; //First update reached the server, -1 never
+  uint32_t backlogHighWater;
+  uint8_t source;
+} BootResult;
+
+//**********************************************************************
+//*                              Server
+//**********************************************************************
+//Each connection is parsed on its own, every one has to start on a message boundary. Only a lost one may
+//end in the middle of a message
+typedef struct {
+  std::vector<uint8_t> bytes;
+} Connection;
+
+typedef struct {
+  std::vector<Connection> connections;
+  int64_t lastFrame;
+} Server;
+
+void serverParse(Server& s, BootResult& r) {
+  s.lastFrame = -1;
+  for (size_t c = 0; c < s.connections.size(); c++) {
+    const std::vector<uint8_t>& b = s.connections[c].bytes;
+    size_t i = 0;
+    bool good = true;
+    while (good && i < b.size()) {
+      if (b.size() - i < 5) { r.truncated++; break; }
+      uint32_t size = (uint32_t)b[i] << 24 | b[i + 1] << 16 | b[i + 2] << 8 | b[i + 3];
+      if (size != EVENT_UPDATE_SIZE + 1 || b[i + 4] != EVENT_UPDATE) { good = false; break; }
+      if (b.size() - i - 4 < size) { r.truncated++; break; }
+
+      const uint8_t* data = &b[i + 5];
+      int64_t frame = (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+      if (frame <= s.lastFrame) good = false;
+      s.lastFrame = frame;
+      r.received++;
+      i += 4 + size;
+    }
+    if (!good) r.badStreams++;
+  }
+}
+
+//**********************************************************************
+//*                            Simulation
+//**********************************************************************
+NetBoot Boot;
+StreamBacklog Backlog;
+
+void encodeUpdate(uint8_t* data, uint32_t frame) {
+  memset(data, 0, EVENT_UPDATE_SIZE);
+  data[0] = frame >> 24;
+  data[1] = frame >> 16;
+  data[2] = frame >> 8;
+  data[3] = frame;
+}
+
+BootResult simulate(const BootConfig& config) {
+  BootResult r = { };
+  r.networkMs = -1;
+  r.streamMs = -1;
+  Server server = { };
+  uint32_t rng = 0x2545F491;
+  uint8_t mac[6] = { 0x00, 0x1A, 0xB6, 0x02, 0xF5, 0x8C };
+
+  memset(&Boot, 0, sizeof(Boot));
+  backlogReset(Backlog, config.fastBoot);
+  Boot.hasCachedLease = config.hasCachedLease;
+  if (Boot.hasCachedLease) netBootLinkLocal(Boot.cachedLease, mac);
+
+  //The old boot read SSI only once Ethernet.begin(mac) returned
+  int legacyUpMs = config.dhcpMs >= 0 && config.dhcpMs < LEGACY_DHCP_TIMEOUT_MS ? config.dhcpMs : LEGACY_DHCP_TIMEOUT_MS;
+  r.ingestUs = config.fastBoot ? FAST_INGEST_US : legacyUpMs * 1000 + FAST_INGEST_US;
+  Boot.dhcpStartMs = r.ingestUs / 1000;
+  if (!config.fastBoot && legacyUpMs == config.dhcpMs) r.networkMs = legacyUpMs;
+
+  int pending = 0;
+  uint32_t frame = 0;
+  bool connected = false;
+  int connectAtMs = -1;
+  bool lost = false;
+  uint8_t data[EVENT_UPDATE_SIZE];
+
+  for (int now = 0; now < config.seconds * 1000; now++) {
+    uint64_t nowUs = (uint64_t)now * 1000;
+    bool ingesting = nowUs >= r.ingestUs;
+
+    //Updates sent this millisecond land in the SSI ring, or nowhere before SSI3DMASlave.begin()
+    for (; (uint64_t)frame * FRAME_US < nowUs + 1000; frame++) {
+      r.frames++;
+      if (!ingesting || pending == SSI_RX_BUFFER_COUNT) r.lostBeforeIngest++;
+      else pending++;
+    }
+
+    //The network
+    if (config.fastBoot && ingesting && Boot.source == NETBOOT_WAITING) {
+      int step = netBootAdvance(Boot, now, config.dhcpMs >= 0 && now >= config.dhcpMs);
+      if (step != NETBOOT_KEEP_WAITING) r.networkMs = now;
+    }
+    if (r.networkMs >= 0 && now >= r.networkMs && connectAtMs < 0 && !connected) connectAtMs = now + config.connectMs;
+    if (!connected && connectAtMs >= 0 && now >= connectAtMs) {
+      connected = true;
+      connectAtMs = -1;
+      server.connections.push_back(Connection());
+    }
+    if (connected && config.lossAtMs > 0 && now >= config.lossAtMs && !lost) {
+      connected = false;
+      lost = true;
+    }
+
+    //loop(), then the boot task
+    for (uint32_t f = frame - pending; pending > 0; f++, pending--) {
+      r.ingested++;
+      encodeUpdate(data, f);
+      if (Backlog.active) {
+        if (!backlogAppend(Backlog, EVENT_UPDATE, data, EVENT_UPDATE_SIZE)) r.backlogDropped++;
+      }
+      else if (connected) {
+        uint8_t header[5] = { 0, 0, (EVENT_UPDATE_SIZE + 1) >> 8 & 0xFF, (EVENT_UPDATE_SIZE + 1) & 0xFF, EVENT_UPDATE };
+        std::vector<uint8_t>& out = server.connections.back().bytes;
+        out.insert(out.end(), header, header + 5);
+        out.insert(out.end(), data, data + EVENT_UPDATE_SIZE);
+        if (r.streamMs < 0) r.streamMs = now;
+      }
+      else r.notConnected++;
+    }
+
+    if (Backlog.active) {
+      if (!connected) {
+        if (Backlog.tail != 0 || backlogExpired(Boot, now)) r.backlogAbandoned += backlogAbandon(Backlog);
+      }
+      else {
+        const uint8_t* bytes;
+        int count = backlogPeek(Backlog, bytes);
+        rng = rng * 1103515245 + 12345;
+        int window = (rng >> 16) % (TCP_WINDOW_MAX + 1);
+        if (count > window) count = window;
+        server.connections.back().bytes.insert(server.connections.back().bytes.end(), bytes, bytes + count);
+        backlogConsume(Backlog, count);
+        if (count > 0 && r.streamMs < 0) r.streamMs = now;
+        if (backlogPending(Backlog) == 0) Backlog.active = false;
+      }
+    }
+  }
+
+  r.backlogHighWater = Backlog.highWater;
+  r.source = config.fastBoot ? Boot.source : (r.networkMs >= 0 ? NETBOOT_DHCP : NETBOOT_WAITING);
+  serverParse(server, r);
+  return r;
+}
+
+const char* sourceName(uint8_t source) {
+  switch (source) {
+    case NETBOOT_DHCP: return "DHCP";
+    case NETBOOT_CACHED: return "cached lease";
+    case NETBOOT_LINK_LOCAL: return "link local";
+    default: return "none";
+  }
+}
+
+void printResult(const char* title, const BootResult& r) {
+  printf("%s\n", title);
+  printf("  ingest after reset      %8.1fms\n", r.ingestUs / 1000.0);
+  if (r.networkMs >= 0) printf("  network after reset     %8dms (%s)\n", r.networkMs, sourceName(r.source));
+  else printf("  network after reset        never\n");
+  if (r.streamMs >= 0) printf("  stream after reset      %8dms\n", r.streamMs);
+  else printf("  stream after reset         never\n");
+  printf("  updates sent            %8u\n", r.frames);
+  printf("  lost before ingest      %8u\n", r.lostBeforeIngest);
+  printf("  dropped, backlog full   %8u\n", r.backlogDropped);
+  printf("  dropped, backlog gone   %8u\n", r.backlogAbandoned);
+  printf("  dropped, not connected  %8u\n", r.notConnected);
+  printf("  reached the server      %8u\n", r.received);
+  printf("  backlog high water      %8u bytes\n", r.backlogHighWater);
+  if (r.truncated) printf("  cut off by a lost link  %8u\n", r.truncated);
+  if (r.badStreams) printf("  BROKEN STREAMS          %8u\n", r.badStreams);
+}
+
+//**********************************************************************
+//*                           Self Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int runCheck() {
+  bool ok = true;
+  uint8_t mac[6] = { 0x00, 0x1A, 0xB6, 0x02, 0xF5, 0x8C };
+
+  NetBoot nb = { };
+  nb.dhcpStartMs = 0xFFFFF000; //millis() about to wrap
+  ok &= expect(netBootAdvance(nb, 0xFFFFF000 + NETBOOT_DHCP_WAIT_MS - 1, false) == NETBOOT_KEEP_WAITING,
+    "waits for DHCP across the millis() wrap");
+  ok &= expect(netBootAdvance(nb, 0xFFFFF000 + NETBOOT_DHCP_WAIT_MS, false) == NETBOOT_FALL_BACK &&
+    nb.source == NETBOOT_LINK_LOCAL, "falls back to link local without a cached lease");
+  ok &= expect(netBootAdvance(nb, 0, true) == NETBOOT_UP && nb.source == NETBOOT_LINK_LOCAL, "a fallback is kept until reset");
+
+  NetBoot cached = { };
+  netBootLinkLocal(cached.cachedLease, mac);
+  cached.cachedLease.ip[0] = 10;
+  cached.hasCachedLease = true;
+  ok &= expect(netBootAdvance(cached, NETBOOT_DHCP_WAIT_MS, false) == NETBOOT_FALL_BACK && cached.source == NETBOOT_CACHED &&
+    netBootFallbackLease(cached, mac).ip[0] == 10, "falls back to the cached lease");
+
+  NetBoot dhcp = { };
+  ok &= expect(netBootAdvance(dhcp, 2500, true) == NETBOOT_GOT_LEASE && dhcp.source == NETBOOT_DHCP && dhcp.upMs == 2500,
+    "takes the DHCP lease");
+
+  bool inRange = true;
+  for (int b = 0; b < 256; b++) {
+    uint8_t m[6] = { 0, 0, 0, 0, (uint8_t)b, (uint8_t)b };
+    NetLease l;
+    netBootLinkLocal(l, m);
+    inRange &= l.ip[0] == 169 && l.ip[1] == 254 && l.ip[2] >= 1 && l.ip[2] <= 254;
+  }
+  ok &= expect(inRange, "link local addresses stay out of the reserved blocks");
+
+  uint32_t words[NETBOOT_LEASE_WORDS];
+  NetLease lease, back;
+  for (int i = 0; i < 4; i++) { lease.ip[i] = 10 + i; lease.subnet[i] = 255; lease.gateway[i] = 20 + i; lease.dns[i] = 30 + i; }
+  netBootPackLease(lease, words);
+  ok &= expect(netBootUnpackLease(words, back) && memcmp(&lease, &back, sizeof(lease)) == 0, "a stored lease reads back");
+  memset(words, 0xFF, sizeof(words));
+  ok &= expect(!netBootUnpackLease(words, back), "blank EEPROM has no lease");
+
+  //The backlog keeps messages whole, across the end of the ring too
+  static StreamBacklog b;
+  backlogReset(b, true);
+  uint8_t data[EVENT_UPDATE_SIZE];
+  int appended = 0;
+  encodeUpdate(data, 0);
+  while (backlogAppend(b, EVENT_UPDATE, data, EVENT_UPDATE_SIZE)) appended++;
+  ok &= expect(b.dropped == 1 && appended == STREAM_BACKLOG_SIZE / (EVENT_UPDATE_SIZE + 5),
+    "a full backlog drops the whole message");
+  const uint8_t* bytes;
+  backlogConsume(b, backlogPeek(b, bytes));
+  ok &= expect(backlogAppend(b, EVENT_UPDATE, data, EVENT_UPDATE_SIZE) && b.head > STREAM_BACKLOG_SIZE,
+    "messages wrap around the ring");
+  uint32_t drained = STREAM_BACKLOG_CHUNK;
+  int count;
+  while ((count = backlogPeek(b, bytes)) > 0) {
+    backlogConsume(b, count);
+    drained += count;
+  }
+  ok &= expect(count == 0 && drained == b.head && b.messages == 0, "the backlog drains in chunks");
+
+  //A message part sent still counts as lost when the backlog is given up
+  backlogReset(b, true);
+  for (int i = 0; i < 3; i++) backlogAppend(b, EVENT_UPDATE, data, EVENT_UPDATE_SIZE);
+  backlogConsume(b, 4 + EVENT_UPDATE_SIZE + 1 + 10);
+  ok &= expect(b.messages == 2 && backlogAbandon(b) == 2 && !b.active, "giving up counts the messages not sent whole");
+  NetBoot up = { };
+  up.source = NETBOOT_DHCP;
+  up.upMs = 0xFFFFF000;
+  ok &= expect(!backlogExpired(up, 0xFFFFF000 + NETBOOT_CONNECT_WAIT_MS - 1) &&
+    backlogExpired(up, 0xFFFFF000 + NETBOOT_CONNECT_WAIT_MS), "the server gets its time across the millis() wrap");
+
+  //Whole boots
+  BootConfig config = { 3000, 200, 0, 20, false, false };
+  BootResult legacy = simulate(config);
+  config.fastBoot = true;
+  BootResult fast = simulate(config);
+  ok &= expect(legacy.lostBeforeIngest >= 3000000 / FRAME_US, "the old boot loses the updates DHCP takes");
+  ok &= expect(fast.ingestUs < 10000 && fast.lostBeforeIngest <= fast.ingestUs / FRAME_US + 1, "fast boot reads SSI within milliseconds");
+  ok &= expect(fast.received == fast.ingested && fast.badStreams == 0, "every update read reaches the server, in order");
+
+  config.dhcpMs = -1;
+  BootResult fallback = simulate(config);
+  ok &= expect(fallback.source == NETBOOT_LINK_LOCAL && fallback.networkMs == NETBOOT_DHCP_WAIT_MS + FAST_INGEST_US / 1000,
+    "no DHCP answer falls back on time");
+  ok &= expect(fallback.backlogDropped > 0 && fallback.received + fallback.backlogDropped == fallback.ingested &&
+    fallback.badStreams == 0, "a full backlog still gives whole messages in order");
+
+  //A server that is not there does not keep the stream held back, one that shows up late gets it from then on
+  config.dhcpMs = 1500;
+  config.connectMs = 60000;
+  BootResult absent = simulate(config);
+  ok &= expect(absent.backlogAbandoned > 0 && !Backlog.active && absent.received == 0 &&
+    absent.backlogAbandoned <= (uint32_t)(config.dhcpMs + NETBOOT_CONNECT_WAIT_MS) * 1000 / FRAME_US + 1 &&
+    absent.backlogAbandoned + absent.backlogDropped + absent.notConnected == absent.ingested,
+    "no connection gives the backlog up on time");
+  config.connectMs = NETBOOT_CONNECT_WAIT_MS + 3000;
+  BootResult late = simulate(config);
+  ok &= expect(late.backlogAbandoned > 0 && late.received > 0 && late.badStreams == 0 &&
+    late.received + late.backlogAbandoned + late.backlogDropped + late.notConnected == late.ingested,
+    "a late connection gets the live stream in order");
+  config.connectMs = 200;
+
+  config.dhcpMs = 1500;
+  config.lossAtMs = 1500 + 200 + 5; //A few milliseconds into the drain
+  BootResult loss = simulate(config);
+  ok &= expect(loss.truncated == 1 && loss.badStreams == 0 && loss.received > 0,
+    "a connection lost while draining leaves the next one framed");
+  ok &= expect(loss.received + loss.backlogAbandoned + loss.backlogDropped + loss.notConnected == loss.ingested,
+    "every update read is received or counted as dropped");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  BootConfig config = { 3000, 200, 0, 20, false, false };
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:t:l:s:kc")) != -1) {
+    switch (opt) {
+      case 'd': config.dhcpMs = atoi(optarg); break;
+      case 't': config.connectMs = atoi(optarg); break;
+      case 'l': config.lossAtMs = atoi(optarg); break;
+      case 's': config.seconds = atoi(optarg); break;
+      case 'k': config.hasCachedLease = true; break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s [-d dhcpMs] [-t connectMs] [-l lossAtMs] [-s seconds] [-k] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+
+  printResult("Blocking DHCP before ingest", simulate(config));
+  config.fastBoot = true;
+  printResult("Fast boot", simulate(config));
+  return 0;
+}
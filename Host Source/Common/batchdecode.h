@@ -0,0 +1,216 @@
+#ifndef _BATCHDECODE_H_INCLUDED
+#define _BATCHDECODE_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_DECODE_X86
+#endif
+
+#include "../../TM4C1294 Source/FullGameStatsWebPost/statsengine.h"
+
+//**********************************************************************
+//*                      Batch Update Decoding
+//**********************************************************************
+//Corpus scale analysis does not need a Game per frame, it needs each field of every frame side by side.
+//The batch decoder takes a run of update payloads and writes them out as columns, one array per field
+//and player, so the analysis loops that follow read memory sequentially and vectorize.
+//
+//The x86 versions swap and transpose 4 (SSSE3) or 8 (AVX2) updates at a time. They rely on the ten
+//32 bit fields from locationX to shieldSize being contiguous in each player block, which is checked
+//against the schema below and by BatchDecodeBenchmark -c. The narrow fields are read one at a time.
+#define BATCH_DECODE_SCALAR 0
+#define BATCH_DECODE_SSSE3 1
+#define BATCH_DECODE_AVX2 2
+#define BATCH_DECODE_BEST -1
+
+#define BATCH_PLAYER_SIZE SCHEMA_PLAYER_SIZE(UPDATE_PLAYER_FIELDS)
+#define BATCH_PLAYER_OFFSET(i) (SCHEMA_GAME_SIZE(UPDATE_GAME_FIELDS) + (i) * BATCH_PLAYER_SIZE)
+#define BATCH_ANIMATION_OFFSET 1 //In a player block
+#define BATCH_WORDS_OFFSET 3 //locationX, the first of the contiguous 32 bit fields
+#define BATCH_WORD_COUNT 10 //locationX through shieldSize
+#define BATCH_STOCKS_OFFSET 46
+
+static_assert(BATCH_PLAYER_SIZE == 57 && EVENT_UPDATE_SIZE == 0x7A, "Update schema changed, update the batch decoder offsets");
+
+typedef struct {
+  //Word columns, in payload order
+  std::vector<float> locationX, locationY;
+  std::vector<float> joystickX, joystickY, cstickX, cstickY, trigger;
+  std::vector<uint32_t> buttons;
+  std::vector<float> percent, shieldSize;
+
+  std::vector<uint16_t> animation;
+  std::vector<uint8_t> stocks;
+} PlayerColumns;
+
+typedef struct {
+  int count;
+  std::vector<uint32_t> frameCounter, randomSeed;
+  PlayerColumns players[PLAYER_COUNT];
+} UpdateColumns;
+
+//Sizes every column for count updates, only grows the storage
+void batchColumnsResize(UpdateColumns& c, int count) {
+  c.count = count;
+  c.frameCounter.resize(count);
+  c.randomSeed.resize(count);
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    PlayerColumns& p = c.players[i];
+    std::vector<float>* floats[] = { &p.locationX, &p.locationY, &p.joystickX, &p.joystickY, &p.cstickX, &p.cstickY,
+      &p.trigger, &p.percent, &p.shieldSize };
+    for (unsigned j = 0; j < sizeof(floats) / sizeof(floats[0]); j++) floats[j]->resize(count);
+    p.buttons.resize(count);
+    p.animation.resize(count);
+    p.stocks.resize(count);
+  }
+}
+
+//Word columns of a player in payload order, the SIMD versions store straight into these
+void batchWordColumns(PlayerColumns& p, uint32_t** columns) {
+  void* words[BATCH_WORD_COUNT] = { p.locationX.data(), p.locationY.data(), p.joystickX.data(), p.joystickY.data(),
+    p.cstickX.data(), p.cstickY.data(), p.trigger.data(), p.buttons.data(), p.percent.data(), p.shieldSize.data() };
+  for (int i = 0; i < BATCH_WORD_COUNT; i++) columns[i] = (uint32_t*)words[i];
+}
+
+//Fields that are not 32 bits wide, shared by every version
+void batchDecodeNarrow(const uint8_t* record, int n, UpdateColumns& c) {
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const uint8_t* block = record + BATCH_PLAYER_OFFSET(i);
+    c.players[i].animation[n] = schemaRead<uint16_t>(block + BATCH_ANIMATION_OFFSET);
+    c.players[i].stocks[n] = block[BATCH_STOCKS_OFFSET];
+  }
+}
+
+void batchDecodeRecord(const uint8_t* record, int n, UpdateColumns& c, uint32_t* const* words) {
+  c.frameCounter[n] = schemaRead<uint32_t>(record);
+  c.randomSeed[n] = schemaRead<uint32_t>(record + 4);
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const uint8_t* block = record + BATCH_PLAYER_OFFSET(i) + BATCH_WORDS_OFFSET;
+    for (int w = 0; w < BATCH_WORD_COUNT; w++) words[i * BATCH_WORD_COUNT + w][n] = schemaRead<uint32_t>(block + 4 * w);
+  }
+  batchDecodeNarrow(record, n, c);
+}
+
+//Decodes updates [first, count) one at a time, the fallback and the tail of the SIMD versions
+void batchDecodeScalar(const uint8_t* records, int stride, int first, int count, UpdateColumns& c, uint32_t* const* words) {
+  for (int n = first; n < count; n++) batchDecodeRecord(records + (size_t)n * stride, n, c, words);
+}
+
+#ifdef BATCH_DECODE_X86
+//Loads 16 bytes at the same offset of 4 updates, swaps every 32 bit word to little endian and transposes
+//them so row k holds word k of each update. The four rows are stored to columns[0..rows) at n
+__attribute__((target("ssse3")))
+inline void batchTranspose4(const uint8_t* const* record, int offset, uint32_t* const* columns, int rows, int n) {
+  const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(record[0] + offset)), swap);
+  __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(record[1] + offset)), swap);
+  __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(record[2] + offset)), swap);
+  __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(record[3] + offset)), swap);
+
+  __m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+  __m128i cd0 = _mm_unpacklo_epi32(c, d), cd1 = _mm_unpackhi_epi32(c, d);
+  __m128i row[4] = { _mm_unpacklo_epi64(ab0, cd0), _mm_unpackhi_epi64(ab0, cd0),
+    _mm_unpacklo_epi64(ab1, cd1), _mm_unpackhi_epi64(ab1, cd1) };
+  for (int k = 0; k < rows; k++) _mm_storeu_si128((__m128i*)(columns[k] + n), row[k]);
+}
+
+__attribute__((target("ssse3")))
+int batchDecodeSsse3(const uint8_t* records, int stride, int count, UpdateColumns& c, uint32_t* const* words) {
+  uint32_t* header[2] = { c.frameCounter.data(), c.randomSeed.data() };
+
+  int n = 0;
+  for (; n + 4 <= count; n += 4) {
+    const uint8_t* record[4];
+    for (int r = 0; r < 4; r++) record[r] = records + (size_t)(n + r) * stride;
+
+    batchTranspose4(record, 0, header, 2, n);
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      int offset = BATCH_PLAYER_OFFSET(i) + BATCH_WORDS_OFFSET;
+      uint32_t* const* columns = words + i * BATCH_WORD_COUNT;
+      batchTranspose4(record, offset, columns, 4, n);
+      batchTranspose4(record, offset + 16, columns + 4, 4, n);
+      batchTranspose4(record, offset + 32, columns + 8, 2, n);
+    }
+    for (int r = 0; r < 4; r++) batchDecodeNarrow(record[r], n + r, c);
+  }
+  return n;
+}
+
+//Same as batchTranspose4 for 8 updates, updates 0-3 go through the low lane and 4-7 through the high lane
+__attribute__((target("avx2")))
+inline void batchTranspose8(const uint8_t* const* record, int offset, uint32_t* const* columns, int rows, int n) {
+  const __m256i swap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+    12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m256i v[4];
+  for (int r = 0; r < 4; r++) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)(record[r] + offset));
+    __m128i hi = _mm_loadu_si128((const __m128i*)(record[r + 4] + offset));
+    v[r] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), swap);
+  }
+
+  __m256i ab0 = _mm256_unpacklo_epi32(v[0], v[1]), ab1 = _mm256_unpackhi_epi32(v[0], v[1]);
+  __m256i cd0 = _mm256_unpacklo_epi32(v[2], v[3]), cd1 = _mm256_unpackhi_epi32(v[2], v[3]);
+  __m256i row[4] = { _mm256_unpacklo_epi64(ab0, cd0), _mm256_unpackhi_epi64(ab0, cd0),
+    _mm256_unpacklo_epi64(ab1, cd1), _mm256_unpackhi_epi64(ab1, cd1) };
+  for (int k = 0; k < rows; k++) _mm256_storeu_si256((__m256i*)(columns[k] + n), row[k]);
+}
+
+__attribute__((target("avx2")))
+int batchDecodeAvx2(const uint8_t* records, int stride, int count, UpdateColumns& c, uint32_t* const* words) {
+  uint32_t* header[2] = { c.frameCounter.data(), c.randomSeed.data() };
+
+  int n = 0;
+  for (; n + 8 <= count; n += 8) {
+    const uint8_t* record[8];
+    for (int r = 0; r < 8; r++) record[r] = records + (size_t)(n + r) * stride;
+
+    batchTranspose8(record, 0, header, 2, n);
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      int offset = BATCH_PLAYER_OFFSET(i) + BATCH_WORDS_OFFSET;
+      uint32_t* const* columns = words + i * BATCH_WORD_COUNT;
+      batchTranspose8(record, offset, columns, 4, n);
+      batchTranspose8(record, offset + 16, columns + 4, 4, n);
+      batchTranspose8(record, offset + 32, columns + 8, 2, n);
+    }
+    for (int r = 0; r < 8; r++) batchDecodeNarrow(record[r], n + r, c);
+  }
+  return n;
+}
+#endif
+
+//Best version this CPU runs
+int batchDecodeBestVariant() {
+#ifdef BATCH_DECODE_X86
+  if (__builtin_cpu_supports("avx2")) return BATCH_DECODE_AVX2;
+  if (__builtin_cpu_supports("ssse3")) return BATCH_DECODE_SSSE3;
+#endif
+  return BATCH_DECODE_SCALAR;
+}
+
+bool batchDecodeSupported(int variant) {
+  return variant == BATCH_DECODE_SCALAR || variant == BATCH_DECODE_BEST || variant <= batchDecodeBestVariant();
+}
+
+//Decodes count update payloads (without event code) into columns. The payloads start stride bytes apart,
+//EVENT_UPDATE_SIZE when they are packed back to back. An unsupported variant falls back to scalar
+void batchDecodeUpdates(const uint8_t* records, int stride, int count, UpdateColumns& c, int variant = BATCH_DECODE_BEST) {
+  batchColumnsResize(c, count);
+  uint32_t* words[PLAYER_COUNT * BATCH_WORD_COUNT];
+  for (int i = 0; i < PLAYER_COUNT; i++) batchWordColumns(c.players[i], words + i * BATCH_WORD_COUNT);
+
+  if (variant == BATCH_DECODE_BEST) variant = batchDecodeBestVariant();
+  if (!batchDecodeSupported(variant)) variant = BATCH_DECODE_SCALAR;
+
+  int done = 0;
+#ifdef BATCH_DECODE_X86
+  if (variant == BATCH_DECODE_AVX2) done = batchDecodeAvx2(records, stride, count, c, words);
+  else if (variant == BATCH_DECODE_SSSE3) done = batchDecodeSsse3(records, stride, count, c, words);
+#endif
+  batchDecodeScalar(records, stride, done, count, c, words);
+}
+
+#endif
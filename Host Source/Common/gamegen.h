@@ -0,0 +1,535 @@
+#ifndef _GAMEGEN_H_INCLUDED
+#define _GAMEGEN_H_INCLUDED
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "slippistream.h"
+
+//**********************************************************************
+//*                          Game Generator
+//**********************************************************************
+//Produces the console side of a game one frame at a time: two players with simple physics and a
+//small decision loop that approach, attack, shield, dodge, grab, get launched, recover and lose stocks.
+//Animations, inputs, percents and stocks move together the way they do in Melee closely enough that
+//every branch of the stats engine sees realistic sequences. Messages come out byte exact through the
+//encoders in slippistream.h, framed like writeMsg(), optionally with faults injected.
+//
+//synthgame.h stays as it is, the benchmarks' golden outputs depend on its exact sequence.
+#define GEN_FRAMES_PER_SECOND 60.0988
+#define GEN_TIME_LIMIT_FRAMES 28800 //8 minutes
+
+#define GEN_WIN_TIME 1
+#define GEN_WIN_GAME 2
+
+#define GEN_BLAST_X 230.0f
+#define GEN_BLAST_TOP 200.0f
+#define GEN_BLAST_BOTTOM -110.0f
+#define GEN_GRAVITY 0.12f
+#define GEN_RESPAWN_Y 40.0f
+
+//Animation IDs the generator uses on top of the ranges in meleeids.h
+#define GEN_ANIM_REBIRTH 0xC
+#define GEN_ANIM_REBIRTH_WAIT 0xD
+#define GEN_ANIM_WALK 0xF
+#define GEN_ANIM_JUMP 0x19
+#define GEN_ANIM_FALL 0x1D
+#define GEN_ANIM_LANDING 0x2A
+#define GEN_ANIM_JAB 0x2C
+#define GEN_ANIM_FTILT 0x33
+#define GEN_ANIM_FSMASH 0x3C
+#define GEN_ANIM_NAIR 0x41
+#define GEN_ANIM_FAIR 0x42
+#define GEN_ANIM_GUARD 0xB3
+#define GEN_ANIM_GRAB 0xD4
+#define GEN_ANIM_UP_SPECIAL 0x162
+#define GEN_ANIM_DAMAGE_LIGHT 0x4B
+#define GEN_ANIM_DAMAGE_FLY 0x57
+
+//Physical button bits as the console reports them
+#define GEN_BUTTON_Z 0x0010
+#define GEN_BUTTON_R 0x0020
+#define GEN_BUTTON_A 0x0100
+#define GEN_BUTTON_B 0x0200
+#define GEN_BUTTON_X 0x0400
+
+#define GEN_STATE_GROUND 0
+#define GEN_STATE_AIR 1
+#define GEN_STATE_ATTACK 2
+#define GEN_STATE_SHIELD 3
+#define GEN_STATE_DODGE 4
+#define GEN_STATE_GRAB 5
+#define GEN_STATE_HELD 6
+#define GEN_STATE_HITSTUN 7
+#define GEN_STATE_DOWN 8 //Missed tech or tech in place
+#define GEN_STATE_DEAD 9
+#define GEN_STATE_REBIRTH 10
+
+typedef struct {
+  int state;
+  int timer; //Frames spent in the current state
+  int duration; //Frames the current state lasts, 0 if open ended
+  float vx;
+  float vy;
+  bool hasDoubleJump;
+  bool hasUpSpecial;
+  bool hitLanded; //The current attack already connected
+  float damage; //Of the current attack
+  uint8_t moveId;
+} GenPlayer;
+
+typedef struct {
+  Game game; //Only the console side fields are used, i.e. what the encoders write
+  GenPlayer players[PLAYER_COUNT];
+  uint32_t rng;
+  uint32_t faultRng; //Separate so injecting faults never changes the game itself
+  float stageEdge;
+  bool started;
+  bool ended;
+  bool endSent;
+  uint32_t frameLimit;
+} GameGenerator;
+
+//Faults are rates out of 1000 messages
+typedef struct {
+  int missedFramePerMille; //The update is never sent, the board sees a gap in frame numbers
+  int truncatePerMille; //An update is cut short, the length header matches what was actually sent
+  int badEventPerMille; //An extra message with an event code the board does not know
+} GenFaults;
+
+typedef struct {
+  uint32_t messages;
+  uint32_t missedFrames;
+  uint32_t truncated;
+  uint32_t badEvents;
+} GenCounters;
+
+uint32_t genXorshift(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+//xorshift32, a given seed always gives the same game
+uint32_t genRandom(GameGenerator& g) {
+  return genXorshift(g.rng);
+}
+
+//Uniform in [0, 1)
+float genUnit(GameGenerator& g) {
+  return (genRandom(g) >> 8) / 16777216.0f;
+}
+
+bool genChance(GameGenerator& g, int perMille) {
+  return (int)(genRandom(g) % 1000) < perMille;
+}
+
+bool genFaultChance(GameGenerator& g, int perMille) {
+  return (int)(genXorshift(g.faultRng) % 1000) < perMille;
+}
+
+//External character ID -> internal character ID
+static const uint8_t genInternalIds[26] = {
+  2, 3, 1, 24, 4, 5, 6, 17, 0, 18, 16, 8, 9, 12, 10, 15, 13, 14, 19, 7, 22, 20, 21, 26, 23, 25
+};
+
+typedef struct {
+  uint16_t id;
+  float edge; //Half width of the main platform
+} GenStage;
+
+static const GenStage genStages[6] = {
+  { STAGE_FOD, 63.35f }, { STAGE_POKEMON, 87.75f }, { STAGE_YOSHIS, 56.0f },
+  { STAGE_DREAM_LAND, 77.27f }, { STAGE_BATTLEFIELD, 68.4f }, { STAGE_FD, 85.5606f }
+};
+
+void generatorInit(GameGenerator& g, uint32_t seed, uint32_t frameLimit) {
+  g = { };
+  g.rng = seed ? seed : 1;
+  g.faultRng = g.rng ^ 0xA5A5A5A5;
+  g.frameLimit = frameLimit > 0 && frameLimit < GEN_TIME_LIMIT_FRAMES ? frameLimit : GEN_TIME_LIMIT_FRAMES;
+
+  const GenStage& stage = genStages[genRandom(g) % 6];
+  g.game.stage = stage.id;
+  g.stageEdge = stage.edge;
+  g.game.randomSeed = genRandom(g);
+
+  uint8_t firstPort = genRandom(g) % 4;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& p = g.game.players[i];
+    p.controllerPort = (firstPort + i * (1 + genRandom(g) % 3)) % 4;
+    p.characterId = genRandom(g) % 26;
+    p.characterColor = genRandom(g) % 4;
+    p.playerType = 0;
+
+    PlayerFrameData& pfd = p.currentFrameData;
+    pfd.internalCharacterId = genInternalIds[p.characterId];
+    pfd.stocks = STOCK_COUNT;
+    pfd.shieldSize = 60;
+    pfd.locationX = (i == 0 ? -1 : 1) * g.stageEdge * 0.6f;
+    pfd.animation = ACTION_WAIT;
+
+    g.players[i].state = GEN_STATE_GROUND;
+    g.players[i].hasDoubleJump = true;
+    g.players[i].hasUpSpecial = true;
+  }
+}
+
+void genSetState(GenPlayer& gp, PlayerFrameData& pfd, int state, uint16_t animation, int duration) {
+  gp.state = state;
+  gp.timer = 0;
+  gp.duration = duration;
+  pfd.animation = animation;
+}
+
+bool genIsIntangible(const GenPlayer& gp) {
+  return gp.state == GEN_STATE_DODGE || gp.state == GEN_STATE_DEAD || gp.state == GEN_STATE_REBIRTH ||
+    (gp.state == GEN_STATE_HITSTUN && gp.timer < 2);
+}
+
+//Sends the defender flying away from the attacker, harder the more percent they have
+void genLaunch(GameGenerator& g, int attacker, int defender, float damage, uint8_t moveId) {
+  PlayerFrameData& a = g.game.players[attacker].currentFrameData;
+  PlayerFrameData& d = g.game.players[defender].currentFrameData;
+  GenPlayer& gd = g.players[defender];
+
+  d.percent += damage;
+  d.lastHitBy = attacker;
+  a.lastMoveHitId = moveId;
+  a.comboCount++;
+
+  float knockback = 1.0f + damage * 0.12f + d.percent * damage * 0.0035f;
+  float direction = d.locationX >= a.locationX ? 1.0f : -1.0f;
+  float angle = 0.45f + genUnit(g) * 0.7f;
+  gd.vx = direction * knockback * cosf(angle);
+  gd.vy = knockback * sinf(angle);
+
+  int hitstun = (int)(knockback * 4);
+  genSetState(gd, d, GEN_STATE_HITSTUN, knockback > 4 ? GEN_ANIM_DAMAGE_FLY : GEN_ANIM_DAMAGE_LIGHT + genRandom(g) % 6,
+    hitstun < 8 ? 8 : hitstun);
+}
+
+//Picks what a player in control does next and sets the inputs that go with it
+void genDecide(GameGenerator& g, int i) {
+  GenPlayer& gp = g.players[i];
+  PlayerFrameData& pfd = g.game.players[i].currentFrameData;
+  const PlayerFrameData& opponent = g.game.players[!i].currentFrameData;
+  float toOpponent = opponent.locationX - pfd.locationX;
+  float distance = fabsf(toOpponent);
+  float facing = toOpponent >= 0 ? 1.0f : -1.0f;
+  bool airborne = gp.state == GEN_STATE_AIR;
+
+  if (distance < 18 && genChance(g, 180)) {
+    uint32_t choice = genRandom(g) % 100;
+    if (airborne || choice < 45) {
+      bool smash = !airborne && genChance(g, 250);
+      uint16_t animation = airborne ? (distance < 8 ? GEN_ANIM_NAIR : GEN_ANIM_FAIR) :
+        smash ? GEN_ANIM_FSMASH : genChance(g, 500) ? GEN_ANIM_JAB : GEN_ANIM_FTILT;
+      genSetState(gp, pfd, GEN_STATE_ATTACK, animation, smash ? 40 : 22);
+      gp.damage = smash ? 14 + genRandom(g) % 6 : 4 + genRandom(g) % 9;
+      gp.moveId = smash ? 10 : airborne ? 13 + genRandom(g) % 5 : 2 + genRandom(g) % 7;
+      gp.hitLanded = false;
+      pfd.physicalButtons |= GEN_BUTTON_A;
+      if (smash) pfd.cstickX = facing;
+      return;
+    }
+    if (choice < 65) {
+      genSetState(gp, pfd, GEN_STATE_SHIELD, GUARD_ON, 15 + genRandom(g) % 30);
+      return;
+    }
+    if (choice < 80) {
+      uint16_t dodge = genChance(g, 500) ? SPOT_DODGE : genChance(g, 500) ? ROLL_FORWARD : ROLL_BACKWARD;
+      genSetState(gp, pfd, GEN_STATE_DODGE, dodge, dodge == SPOT_DODGE ? 22 : 31);
+      gp.vx = dodge == ROLL_FORWARD ? facing * 1.6f : dodge == ROLL_BACKWARD ? -facing * 1.6f : 0;
+      pfd.rTrigger = 1;
+      pfd.physicalButtons |= GEN_BUTTON_R;
+      return;
+    }
+    if (choice < 90) {
+      genSetState(gp, pfd, GEN_STATE_GRAB, GEN_ANIM_GRAB, 30);
+      gp.hitLanded = false;
+      pfd.physicalButtons |= GEN_BUTTON_Z;
+      return;
+    }
+  }
+
+  if (!airborne && genChance(g, 15)) {
+    genSetState(gp, pfd, GEN_STATE_AIR, ACTION_KNEE_BEND, 0);
+    gp.vy = 2.8f + genUnit(g);
+    pfd.physicalButtons |= GEN_BUTTON_X;
+    return;
+  }
+
+  //Otherwise move towards the opponent, stopping short of the ledge
+  float target = opponent.locationX - facing * 10;
+  if (target > g.stageEdge - 5) target = g.stageEdge - 5;
+  if (target < -g.stageEdge + 5) target = -g.stageEdge + 5;
+  float delta = target - pfd.locationX;
+  pfd.joystickX = fabsf(delta) > 30 ? (delta > 0 ? 1 : -1) : fabsf(delta) > 3 ? (delta > 0 ? 0.5f : -0.5f) : 0;
+  if (!airborne) {
+    gp.vx = pfd.joystickX * 1.6f;
+    pfd.animation = pfd.joystickX == 0 ? ACTION_WAIT : fabsf(pfd.joystickX) > 0.7f ? ACTION_DASH : GEN_ANIM_WALK;
+  }
+}
+
+//Steers a player that is off stage back towards it with the double jump and up special
+void genRecover(GameGenerator& g, int i) {
+  GenPlayer& gp = g.players[i];
+  PlayerFrameData& pfd = g.game.players[i].currentFrameData;
+  float towards = pfd.locationX > 0 ? -1.0f : 1.0f;
+
+  pfd.joystickX = towards;
+  gp.vx += towards * 0.05f;
+  if (gp.vx * towards > 1.2f) gp.vx = towards * 1.2f;
+
+  if (gp.vy < 0 && gp.hasDoubleJump) {
+    gp.hasDoubleJump = false;
+    gp.vy = 2.5f;
+    pfd.animation = GEN_ANIM_JUMP;
+    pfd.physicalButtons |= GEN_BUTTON_X;
+  } else if (gp.vy < 0 && gp.hasUpSpecial && pfd.locationY < -20) {
+    //Some recoveries come up short, that is what makes failed recoveries show up in the stats
+    gp.hasUpSpecial = false;
+    gp.vy = 3.0f + genUnit(g) * 1.6f;
+    gp.vx = towards * (0.8f + genUnit(g));
+    pfd.animation = GEN_ANIM_UP_SPECIAL;
+    pfd.joystickY = 1;
+    pfd.physicalButtons |= GEN_BUTTON_B;
+  }
+}
+
+void genLoseStock(GameGenerator& g, int i) {
+  GenPlayer& gp = g.players[i];
+  PlayerFrameData& pfd = g.game.players[i].currentFrameData;
+
+  uint16_t animation = pfd.locationY > GEN_BLAST_TOP ? 3 : pfd.locationY < GEN_BLAST_BOTTOM ? 0 : pfd.locationX < 0 ? 1 : 2;
+  genSetState(gp, pfd, GEN_STATE_DEAD, animation, 60);
+  pfd.stocks--;
+  pfd.percent = 0;
+  pfd.comboCount = 0;
+  g.game.players[!i].currentFrameData.comboCount = 0;
+  gp.vx = 0;
+  gp.vy = 0;
+}
+
+void genStepPlayer(GameGenerator& g, int i) {
+  GenPlayer& gp = g.players[i];
+  PlayerFrameData& pfd = g.game.players[i].currentFrameData;
+  GenPlayer& go = g.players[!i];
+  PlayerFrameData& opponent = g.game.players[!i].currentFrameData;
+
+  //Inputs are held only for the frame they are pressed on unless a state keeps them down
+  pfd.physicalButtons = 0;
+  pfd.joystickX = 0;
+  pfd.joystickY = 0;
+  pfd.cstickX = 0;
+  pfd.cstickY = 0;
+  pfd.lTrigger = 0;
+  pfd.rTrigger = 0;
+  gp.timer++;
+
+  bool offStage = fabsf(pfd.locationX) > g.stageEdge || pfd.locationY < -5;
+  bool finished = gp.duration > 0 && gp.timer >= gp.duration;
+
+  switch (gp.state) {
+    case GEN_STATE_GROUND:
+      genDecide(g, i);
+      break;
+    case GEN_STATE_AIR:
+      if (pfd.animation == ACTION_KNEE_BEND && gp.timer > 4) pfd.animation = GEN_ANIM_JUMP;
+      if (gp.vy < 0 && pfd.animation == GEN_ANIM_JUMP) pfd.animation = GEN_ANIM_FALL;
+      if (offStage) genRecover(g, i);
+      else genDecide(g, i);
+      break;
+    case GEN_STATE_ATTACK:
+      //Active frames in the middle of the move
+      if (!gp.hitLanded && gp.timer >= 5 && gp.timer <= 10 && !genIsIntangible(go) &&
+        fabsf(opponent.locationX - pfd.locationX) < 16 && fabsf(opponent.locationY - pfd.locationY) < 14) {
+        gp.hitLanded = true;
+        if (go.state == GEN_STATE_SHIELD) {
+          opponent.shieldSize -= gp.damage;
+          if (opponent.shieldSize < 0) opponent.shieldSize = 0;
+        } else {
+          genLaunch(g, i, !i, gp.damage, gp.moveId);
+        }
+      }
+      if (gp.timer < 4) pfd.physicalButtons |= GEN_BUTTON_A;
+      if (finished) genSetState(gp, pfd, pfd.locationY > 0 ? GEN_STATE_AIR : GEN_STATE_GROUND,
+        pfd.locationY > 0 ? GEN_ANIM_FALL : ACTION_WAIT, 0);
+      break;
+    case GEN_STATE_SHIELD:
+      pfd.animation = gp.timer < 8 ? GUARD_ON : GEN_ANIM_GUARD;
+      pfd.rTrigger = 1;
+      pfd.physicalButtons |= GEN_BUTTON_R;
+      pfd.shieldSize -= 0.14f;
+      gp.vx = 0;
+      if (finished || pfd.shieldSize < 10) genSetState(gp, pfd, GEN_STATE_GROUND, ACTION_WAIT, 0);
+      break;
+    case GEN_STATE_DODGE:
+      if (gp.timer < 3) pfd.rTrigger = 1;
+      if (finished) {
+        gp.vx = 0;
+        genSetState(gp, pfd, GEN_STATE_GROUND, ACTION_WAIT, 0);
+      }
+      break;
+    case GEN_STATE_GRAB:
+      gp.vx = 0;
+      if (!gp.hitLanded && gp.timer == 7 && !genIsIntangible(go) && go.state != GEN_STATE_AIR &&
+        fabsf(opponent.locationX - pfd.locationX) < 14) {
+        gp.hitLanded = true;
+        genSetState(go, opponent, GEN_STATE_HELD, CAPTURE_START + genRandom(g) % 3, 25 + genRandom(g) % 20);
+        go.vx = 0;
+        go.vy = 0;
+      }
+      if (finished) genSetState(gp, pfd, GEN_STATE_GROUND, ACTION_WAIT, 0);
+      break;
+    case GEN_STATE_HELD:
+      //Pummels while held, then the throw
+      opponent.physicalButtons |= gp.timer % 12 == 0 ? GEN_BUTTON_A : 0;
+      if (gp.timer % 12 == 0) pfd.percent += 3;
+      if (finished) genLaunch(g, !i, i, 7 + genRandom(g) % 6, 52 + genRandom(g) % 4);
+      break;
+    case GEN_STATE_HITSTUN:
+      pfd.joystickX = genUnit(g) * 2 - 1; //Directional influence
+      gp.vx *= 0.97f;
+      if (finished) {
+        genSetState(gp, pfd, pfd.locationY > 0 || offStage ? GEN_STATE_AIR : GEN_STATE_GROUND,
+          pfd.locationY > 0 || offStage ? GEN_ANIM_FALL : ACTION_WAIT, 0);
+        opponent.comboCount = 0;
+      }
+      break;
+    case GEN_STATE_DOWN:
+      if (finished) genSetState(gp, pfd, GEN_STATE_GROUND, ACTION_WAIT, 0);
+      break;
+    case GEN_STATE_DEAD:
+      if (finished) {
+        if (pfd.stocks == 0) {
+          g.ended = true;
+          g.game.winCondition = GEN_WIN_GAME;
+          return;
+        }
+        pfd.locationX = 0;
+        pfd.locationY = GEN_RESPAWN_Y;
+        pfd.shieldSize = 60;
+        genSetState(gp, pfd, GEN_STATE_REBIRTH, GEN_ANIM_REBIRTH, 120);
+      }
+      return;
+    case GEN_STATE_REBIRTH:
+      if (gp.timer > 30) pfd.animation = GEN_ANIM_REBIRTH_WAIT;
+      if (finished || (gp.timer > 40 && genChance(g, 30))) {
+        gp.hasDoubleJump = true;
+        gp.hasUpSpecial = true;
+        genSetState(gp, pfd, GEN_STATE_AIR, GEN_ANIM_FALL, 0);
+      }
+      return;
+  }
+
+  //Zelda and Sheik transform now and then
+  if ((pfd.internalCharacterId == INTERNAL_ZELDA || pfd.internalCharacterId == INTERNAL_SHEIK) && genChance(g, 1)) {
+    pfd.internalCharacterId = pfd.internalCharacterId == INTERNAL_ZELDA ? INTERNAL_SHEIK : INTERNAL_ZELDA;
+  }
+
+  if (gp.state != GEN_STATE_SHIELD && pfd.shieldSize < 60) pfd.shieldSize += 0.07f;
+  pfd.trigger = pfd.lTrigger > pfd.rTrigger ? pfd.lTrigger : pfd.rTrigger;
+  pfd.buttons = pfd.physicalButtons;
+
+  //Physics
+  bool grounded = pfd.locationY <= 0 && fabsf(pfd.locationX) <= g.stageEdge;
+  if (gp.state == GEN_STATE_HELD) return;
+  if (!grounded || gp.vy > 0) gp.vy -= GEN_GRAVITY;
+  if (gp.vy < -2.8f) gp.vy = -2.8f;
+  pfd.locationX += gp.vx;
+  pfd.locationY += gp.vy;
+
+  if (pfd.locationY <= 0 && fabsf(pfd.locationX) <= g.stageEdge && gp.vy <= 0 && pfd.locationY > -6) {
+    pfd.locationY = 0;
+    gp.vy = 0;
+    gp.hasDoubleJump = true;
+    gp.hasUpSpecial = true;
+    if (gp.state == GEN_STATE_HITSTUN) {
+      //Tech in place, tech roll or miss it
+      uint32_t tech = genRandom(g) % 3;
+      genSetState(gp, pfd, GEN_STATE_DOWN, tech == 0 ? TECH_START : tech == 1 ? TECH_START + 1 : TECH_MISS_DOWN, tech == 2 ? 30 : 20);
+      gp.vx = 0;
+    } else if (gp.state == GEN_STATE_AIR) {
+      genSetState(gp, pfd, GEN_STATE_GROUND, GEN_ANIM_LANDING, 0);
+    }
+  }
+  if (gp.state == GEN_STATE_GROUND || gp.state == GEN_STATE_DOWN) gp.vx *= 0.8f;
+
+  if (fabsf(pfd.locationX) > GEN_BLAST_X || pfd.locationY > GEN_BLAST_TOP || pfd.locationY < GEN_BLAST_BOTTOM) {
+    genLoseStock(g, i);
+  }
+}
+
+//Advances the console by one frame. Returns false once the game is over
+bool generatorStep(GameGenerator& g) {
+  if (g.ended) return false;
+
+  g.game.frameCounter++;
+  g.game.randomSeed = g.game.randomSeed * 214013 + 2531011; //The game's own LCG
+  for (int i = 0; i < PLAYER_COUNT && !g.ended; i++) genStepPlayer(g, i);
+
+  if (!g.ended && g.game.frameCounter >= g.frameLimit) {
+    g.ended = true;
+    g.game.winCondition = GEN_WIN_TIME;
+  }
+  return true;
+}
+
+
+//Produces the next chunk of the stream: the game start, one update per call, then the game end. length
+//is set to the bytes written to out (room for 2 full messages needed), which is 0 when the update was
+//missed. frameSent is set when the call covered a frame of game time. Returns false once the game end
+//has been sent
+bool generatorNextMessages(GameGenerator& g, uint8_t* out, int& length, const GenFaults& faults, GenCounters& counters, bool& frameSent) {
+  uint8_t payload[MSG_BUFFER_SIZE];
+  length = 0;
+  frameSent = false;
+
+  if (!g.started) {
+    g.started = true;
+    counters.messages++;
+    length = frameMessage(out, EVENT_GAME_START, payload, encodeGameStart(payload, g.game));
+    return true;
+  }
+
+  if (g.ended) {
+    if (g.endSent) return false;
+    g.endSent = true;
+    counters.messages++;
+    length = frameMessage(out, EVENT_GAME_END, payload, encodeGameEnd(payload, g.game));
+    return true;
+  }
+
+  if (genFaultChance(g, faults.badEventPerMille)) {
+    //Anything outside the three known codes
+    uint8_t eventCode = EVENT_GAME_END + 1 + genXorshift(g.faultRng) % 0xC0;
+    int size = 1 + genXorshift(g.faultRng) % 32;
+    for (int i = 0; i < size; i++) payload[i] = genXorshift(g.faultRng);
+    length += frameMessage(out, eventCode, payload, size);
+    counters.messages++;
+    counters.badEvents++;
+  }
+
+  generatorStep(g);
+  frameSent = true;
+  if (genFaultChance(g, faults.missedFramePerMille)) {
+    counters.missedFrames++;
+    return true;
+  }
+
+  //Truncation shrinks the length header to match, like a board forwarding a short SPI transfer
+  int payloadSize = encodeUpdate(payload, g.game);
+  if (genFaultChance(g, faults.truncatePerMille)) {
+    payloadSize = 1 + genXorshift(g.faultRng) % (payloadSize - 1);
+    counters.truncated++;
+  }
+  counters.messages++;
+  length += frameMessage(out + length, EVENT_UPDATE, payload, payloadSize);
+  return true;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _GAMESUMMARY_H_INCLUDED
+#define _GAMESUMMARY_H_INCLUDED
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+
+#include "../../TM4C1294 Source/FullGameStatsWebPost/statsengine.h"
+
+//**********************************************************************
+//*                         Game Summary JSON
+//**********************************************************************
+//Host side equivalent of the game objects built by printGameSummaries() in FullGameStatsWebPost.
+//Field names and derived values match the board so both outputs can be fed to the same consumers.
+void appendf(std::string& out, const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  if (length > 0) out.append(buf, length < (int)sizeof(buf) ? length : sizeof(buf) - 1);
+}
+
+void printGameSummary(std::string& out, const Game& game) {
+  appendf(out, "{\"frames\":%u,\"framesMissed\":%u,\"winCondition\":%u,\"stage\":%u,\"players\":[",
+    game.frameCounter, game.framesMissed, game.winCondition, game.stage);
+
+  float totalActiveGameFrames = float(game.frameCounter);
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const Player& currentPlayer = game.players[i];
+    const PlayerStatistics& ps = currentPlayer.stats;
+
+    //Calculate played character
+    uint8_t playedCharacterId = currentPlayer.characterId;
+    if (playedCharacterId == EXTERNAL_ZELDA || playedCharacterId == EXTERNAL_SHEIK) {
+      uint32_t zeldaFrames = ps.internalCharUsage[INTERNAL_ZELDA];
+      uint32_t sheikFrames = ps.internalCharUsage[INTERNAL_SHEIK];
+
+      playedCharacterId = zeldaFrames > sheikFrames ? EXTERNAL_ZELDA : EXTERNAL_SHEIK;
+    }
+
+    if (i > 0) out += ',';
+    appendf(out, "{\"port\":%u,\"character\":%u,\"color\":%u,\"playerType\":%u,\"stocksRemaining\":%u,",
+      currentPlayer.controllerPort + 1, playedCharacterId, currentPlayer.characterColor, currentPlayer.playerType,
+      currentPlayer.currentFrameData.stocks);
+    appendf(out, "\"apm\":%.2f,\"averageDistanceFromCenter\":%.2f,\"percentTimeClosestCenter\":%.2f,",
+      3600 * (ps.actionCount / totalActiveGameFrames), ps.averageDistanceFromCenter,
+      100 * (ps.framesClosestCenter / totalActiveGameFrames));
+    appendf(out, "\"percentTimeAboveOthers\":%.2f,\"percentTimeInShield\":%.2f,\"framesWithoutDamage\":%u,",
+      100 * (ps.framesAboveOthers / totalActiveGameFrames), 100 * (ps.framesInShield / totalActiveGameFrames),
+      ps.mostFramesWithoutDamage);
+    appendf(out, "\"rollCount\":%u,\"spotDodgeCount\":%u,\"airDodgeCount\":%u,",
+      ps.rollCount, ps.spotDodgeCount, ps.airDodgeCount);
+
+    out += "\"stocks\":[";
+    bool first = true;
+    for (int j = 0; j < STOCK_COUNT; j++) {
+      const StockStatistics& ss = ps.stocks[j];
+
+      //Only log the stock if the player actually played that stock
+      if (ss.frameStart > 0 || j == 0) {
+        if (!first) out += ',';
+        first = false;
+        appendf(out, "{\"frameStart\":%u,\"frameEnd\":%u,\"percent\":%.2f,\"moveLastHitBy\":%u,\"lastAnimation\":%u,\"openingsAllowed\":%u}",
+          ss.frameStart, ss.frameEnd, ss.percent, ss.lastHitBy, ss.lastAnimation, ss.killedInOpenings);
+      }
+    }
+
+    EventCursor records;
+    const void* record;
+    out += "],\"comboStrings\":[";
+    eventCursorBegin(records, ps.comboStrings);
+    for (int j = 0; (record = eventCursorNext(records, sizeof(ComboString))) != NULL; j++) {
+      const ComboString& cs = *(const ComboString*)record;
+      if (j > 0) out += ',';
+      appendf(out, "{\"frameStart\":%u,\"frameEnd\":%u,\"percentStart\":%.2f,\"percentEnd\":%.2f,\"hitCount\":%u}",
+        cs.frameStart, cs.frameEnd, cs.percentStart, cs.percentEnd, cs.hitCount);
+    }
+
+    out += "],\"recoveries\":[";
+    eventCursorBegin(records, ps.recoveries);
+    for (int j = 0; (record = eventCursorNext(records, sizeof(Recovery))) != NULL; j++) {
+      const Recovery& r = *(const Recovery*)record;
+      if (j > 0) out += ',';
+      appendf(out, "{\"frameStart\":%u,\"frameEnd\":%u,\"percentStart\":%.2f,\"percentEnd\":%.2f,\"isSuccessful\":%s}",
+        r.frameStart, r.frameEnd, r.percentStart, r.percentEnd, r.isSuccessful ? "true" : "false");
+    }
+
+    out += "],\"punishes\":[";
+    eventCursorBegin(records, ps.punishes);
+    for (int j = 0; (record = eventCursorNext(records, sizeof(Punish))) != NULL; j++) {
+      const Punish& p = *(const Punish*)record;
+      if (j > 0) out += ',';
+      appendf(out, "{\"frameStart\":%u,\"frameEnd\":%u,\"percentStart\":%.2f,\"percentEnd\":%.2f,\"hitCount\":%u,\"isKill\":%s}",
+        p.frameStart, p.frameEnd, p.percentStart, p.percentEnd, p.hitCount, p.isKill ? "true" : "false");
+    }
+
+    out += "]}";
+  }
+
+  out += "]}";
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _SLIPPISTREAM_H_INCLUDED
+#define _SLIPPISTREAM_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../../TM4C1294 Source/FullGameStatsWebPost/statsengine.h"
+
+//**********************************************************************
+//*                       Device Stream Framing
+//**********************************************************************
+//Boards forward every message they receive from the console with writeMsg(). Each message on the
+//TCP stream is a 4 byte big endian length (event code + payload) followed by the event code and the
+//payload itself. The helpers in this file are shared by every host tool that reads or produces that stream.
+#define STREAM_HEADER_SIZE 4
+#define STREAM_MAX_MESSAGE_SIZE 1025 //Event code + MSG_BUFFER_SIZE bytes of payload
+
+typedef struct {
+  uint8_t buffer[16 * 1024];
+  int length;
+} StreamReader;
+
+//Return values of streamNextMessage
+#define STREAM_NEED_MORE 0
+#define STREAM_MESSAGE 1
+#define STREAM_CORRUPT -1
+
+//Returns the free space at the end of the reader buffer, new bytes should be received directly into it
+uint8_t* streamWritePointer(StreamReader& r, int& space) {
+  space = sizeof(r.buffer) - r.length;
+  return r.buffer + r.length;
+}
+
+void streamCommit(StreamReader& r, int bytesReceived) {
+  r.length += bytesReceived;
+}
+
+//Looks for a complete message starting at offset. On success message points at the event code and
+//messageSize is the event code + payload size. Call streamConsume with the returned offset once all
+//messages have been handled so that partial messages are moved to the front of the buffer
+int streamNextMessage(StreamReader& r, int& offset, uint8_t*& message, int& messageSize) {
+  int available = r.length - offset;
+  if (available < STREAM_HEADER_SIZE) return STREAM_NEED_MORE;
+
+  uint8_t* header = r.buffer + offset;
+  uint32_t size = (uint32_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+  if (size == 0 || size > STREAM_MAX_MESSAGE_SIZE) return STREAM_CORRUPT;
+  if (available < STREAM_HEADER_SIZE + (int)size) return STREAM_NEED_MORE;
+
+  message = header + STREAM_HEADER_SIZE;
+  messageSize = size;
+  offset += STREAM_HEADER_SIZE + size;
+  return STREAM_MESSAGE;
+}
+
+void streamConsume(StreamReader& r, int offset) {
+  if (offset == 0) return;
+
+  r.length -= offset;
+  memmove(r.buffer, r.buffer + offset, r.length);
+}
+
+//**********************************************************************
+//*                          Message Encoders
+//**********************************************************************
+//The write operators advance idx past the written value, they write big endian like the console
+void writeByte(uint8_t* a, int& idx, uint8_t value) {
+  a[idx++] = value;
+}
+
+void writeHalf(uint8_t* a, int& idx, uint16_t value) {
+  a[idx++] = value >> 8;
+  a[idx++] = value & 0xFF;
+}
+
+void writeWord(uint8_t* a, int& idx, uint32_t value) {
+  a[idx++] = value >> 24;
+  a[idx++] = value >> 16 & 0xFF;
+  a[idx++] = value >> 8 & 0xFF;
+  a[idx++] = value & 0xFF;
+}
+
+void writeFloat(uint8_t* a, int& idx, float value) {
+  uint32_t bytes;
+  memcpy(&bytes, &value, sizeof(bytes));
+  writeWord(a, idx, bytes);
+}
+
+//encodeGameStart, encodeUpdate and encodeGameEnd come from the schema in eventschema.h
+
+//Writes the stream header and event code in front of a payload. Returns the total amount of bytes
+//to send. out must have room for STREAM_HEADER_SIZE + 1 + payloadSize bytes
+int frameMessage(uint8_t* out, uint8_t eventCode, const uint8_t* payload, int payloadSize) {
+  int idx = 0;
+  writeWord(out, idx, payloadSize + 1);
+  writeByte(out, idx, eventCode);
+  memcpy(out + idx, payload, payloadSize);
+  return idx + payloadSize;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef _SYNTHGAME_H_INCLUDED
+#define _SYNTHGAME_H_INCLUDED
+
+#include <math.h>
+#include <stdint.h>
+
+#include "../../TM4C1294 Source/FullGameStatsWebPost/statsengine.h"
+
+//**********************************************************************
+//*                           Synthetic Games
+//**********************************************************************
+//Deterministic stand-in for a console, shared by the host tools that need a stream of plausible frames.
+//Seeding the generator the same way always produces the same game
+uint32_t nextRandom(uint32_t& state) {
+  //xorshift32, deterministic so runs are repeatable
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+void synthesizeGameStart(Game& game, uint32_t& rng) {
+  game = { };
+  game.stage = STAGE_BATTLEFIELD;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& p = game.players[i];
+    p.controllerPort = i;
+    p.characterId = nextRandom(rng) % 26;
+    p.characterColor = 0;
+    p.playerType = 0;
+    p.currentFrameData.stocks = STOCK_COUNT;
+  }
+}
+
+//Rough approximation of two players moving around the stage, trading hits and losing stocks. It only
+//needs to drive every branch of the stats engine, not to be realistic
+void synthesizeUpdate(Game& game, uint32_t& rng, uint32_t frame) {
+  game.frameCounter = frame;
+  game.randomSeed = nextRandom(rng);
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    PlayerFrameData& pfd = game.players[i].currentFrameData;
+    float phase = frame / 90.0f + i * 3.14f;
+
+    pfd.internalCharacterId = game.players[i].characterId;
+    pfd.locationX = 85 * sinf(phase);
+    pfd.locationY = fmaxf(0, 40 * sinf(phase * 2.3f)) - (fabsf(pfd.locationX) > 80 ? 30 : 0);
+    pfd.joystickX = sinf(phase * 7);
+    pfd.joystickY = cosf(phase * 5);
+    pfd.cstickX = (nextRandom(rng) % 30 == 0) ? 1 : 0;
+    pfd.cstickY = 0;
+    pfd.lTrigger = (nextRandom(rng) % 40 == 0) ? 1 : 0;
+    pfd.rTrigger = 0;
+    pfd.trigger = pfd.lTrigger;
+    pfd.physicalButtons = nextRandom(rng) & 0x0F1F;
+    pfd.buttons = pfd.physicalButtons;
+    pfd.shieldSize = 60;
+
+    if (nextRandom(rng) % 25 == 0) {
+      //Take a hit
+      pfd.percent += 4 + nextRandom(rng) % 12;
+      pfd.animation = DAMAGE_START + nextRandom(rng) % (DAMAGE_END - DAMAGE_START);
+      pfd.lastHitBy = !i;
+      game.players[!i].currentFrameData.lastMoveHitId = 1 + nextRandom(rng) % 60;
+    } else if (pfd.animation >= DAMAGE_START && pfd.animation <= DAMAGE_END && nextRandom(rng) % 8 != 0) {
+      //Stay in hitstun for a few frames
+    } else {
+      static const uint16_t actions[] = { ACTION_WAIT, ACTION_DASH, GUARD_ON, ROLL_FORWARD, SPOT_DODGE, AIR_DODGE };
+      pfd.animation = actions[nextRandom(rng) % 6];
+    }
+
+    if (pfd.percent > 120 + nextRandom(rng) % 60 && pfd.stocks > 1) {
+      pfd.stocks--;
+      pfd.percent = 0;
+      pfd.animation = DYING_START;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef _TELEMETRYRECEIVER_H_INCLUDED
+#define _TELEMETRYRECEIVER_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/telemetry.h"
+
+//**********************************************************************
+//*                        Telemetry Receiver
+//**********************************************************************
+//Keeps the newest telemetry snapshot sent by a board. Every datagram is a complete snapshot so nothing
+//is ever buffered or reordered: the socket is drained on each poll and only the newest sequence number
+//is kept. Calling telemetryPoll once per rendered frame therefore adds less than one frame of latency.
+//
+//Several overlays on one machine can listen at the same time, the socket is opened with SO_REUSEPORT.
+
+//A sequence number this far behind the newest one is taken as a board restart rather than a late packet
+#define TELEMETRY_RESYNC_WINDOW 256
+
+typedef struct {
+  int fd;
+
+  bool hasFrame;
+  TelemetryFrame latest;
+  timespec latestArrival;
+
+  uint64_t received;
+  uint64_t lost; //Gaps in the sequence numbers
+  uint64_t stale; //Duplicates and packets that arrived after a newer one
+  uint64_t malformed;
+} TelemetryReceiver;
+
+//multicastGroup can be NULL to only receive broadcast and unicast telemetry. Returns false on failure
+bool telemetryOpen(TelemetryReceiver& r, int port, const char* multicastGroup) {
+  memset(&r, 0, sizeof(r));
+
+  r.fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (r.fd < 0) return false;
+
+  int enable = 1;
+  setsockopt(r.fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  setsockopt(r.fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+
+  if (bind(r.fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(r.fd);
+    return false;
+  }
+
+  if (multicastGroup) {
+    ip_mreq group = { };
+    group.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (inet_pton(AF_INET, multicastGroup, &group.imr_multiaddr) != 1 ||
+      setsockopt(r.fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) < 0) {
+      close(r.fd);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void telemetryClose(TelemetryReceiver& r) {
+  if (r.fd >= 0) close(r.fd);
+  r.fd = -1;
+}
+
+//Applies one datagram. Returns true if it became the latest snapshot
+bool telemetryAccept(TelemetryReceiver& r, const uint8_t* packet, int size) {
+  TelemetryFrame frame;
+  if (!telemetryDecode(packet, size, frame)) {
+    r.malformed++;
+    return false;
+  }
+
+  r.received++;
+
+  if (r.hasFrame) {
+    int16_t diff = (int16_t)(frame.sequence - r.latest.sequence);
+    if (diff <= 0 && diff > -TELEMETRY_RESYNC_WINDOW) {
+      r.stale++;
+      return false;
+    }
+
+    if (diff > 1) r.lost += diff - 1;
+  }
+
+  r.latest = frame;
+  r.hasFrame = true;
+  clock_gettime(CLOCK_MONOTONIC, &r.latestArrival);
+  return true;
+}
+
+//Drains every datagram waiting on the socket without blocking. Returns the number of snapshots that
+//replaced the latest one, 0 means r.latest is unchanged
+int telemetryPoll(TelemetryReceiver& r) {
+  uint8_t packet[TELEMETRY_MAX_PACKET_SIZE + 1];
+  int updates = 0;
+
+  while (true) {
+    int size = recv(r.fd, packet, sizeof(packet), MSG_DONTWAIT);
+    if (size < 0) break;
+    if (telemetryAccept(r, packet, size)) updates++;
+  }
+
+  return updates;
+}
+
+//Blocks until at least one datagram arrives or timeoutMs passes, then drains the socket
+int telemetryWait(TelemetryReceiver& r, int timeoutMs) {
+  pollfd pfd = { r.fd, POLLIN, 0 };
+  if (poll(&pfd, 1, timeoutMs) <= 0) return 0;
+
+  return telemetryPoll(r);
+}
+
+#endif
@@ -0,0 +1,642 @@
+//CorpusRunner - recomputes the statistics of an archive of captures, e.g. after changing a threshold like
+//COMBO_STRING_TIMEOUT. Captures are the raw TCP stream of a board (see PipelineBenchmark), one or more
+//games each. They are spread over a pool of worker threads that steal work from each other, so a few
+//long captures at the end of the list do not leave the other cores idle.
+//
+//Every capture can be run with several parameter sets in one pass. Each message is decoded once and
+//the statistics are computed once per set (statsHandleMessageSets), so tuning a threshold costs a
+//fraction of rerunning the corpus per value. Summaries are written as one JSON object per line, in
+//capture order whatever the thread count, followed by totals per parameter set on stderr.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing -pthread CorpusRunner.cpp -o CorpusRunner
+//Usage: CorpusRunner [-j threads] [-p name=combo,recovery,punish]... [-l listFile] [-o resultsFile] [capture]...
+//       CorpusRunner -g dir -n captures        writes a synthetic corpus to try it on
+//       CorpusRunner -b [-n captures]          measures scaling with the thread count on a synthetic corpus
+//       CorpusRunner -c                        checks the runner and exits, the exit code is non-zero on failure
+//  The thresholds of a set are in frames, e.g. -p default=45,45,45 -p loose=60,45,90
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/gamesummary.h"
+#include "../Common/gamegen.h"
+
+#define MAX_PARAM_SETS 16
+
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//**********************************************************************
+//*                              Corpus
+//**********************************************************************
+typedef struct {
+  std::string name;
+  StatsParams params;
+} ParamSet;
+
+typedef struct {
+  std::string path;
+  std::vector<uint8_t> bytes; //Preloaded for synthetic corpora, otherwise read by the worker
+} Capture;
+
+typedef struct {
+  uint32_t games;
+  uint64_t frames;
+  uint32_t comboStrings;
+  uint32_t recoveries;
+  uint32_t failedRecoveries;
+  uint32_t punishes;
+  uint32_t kills;
+  uint32_t droppedRecords; //Lost to a full arena
+  uint32_t arenaHighWater; //Most arena bytes used by one game
+} SetTotals;
+
+typedef struct {
+  std::string lines; //Summaries of every game and set, in stream order
+  SetTotals totals[MAX_PARAM_SETS];
+  uint32_t rejected;
+  bool failed; //Unreadable or corrupt
+} CaptureResult;
+
+bool readCapture(const std::string& path, std::vector<uint8_t>& bytes) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+  fclose(f);
+  return true;
+}
+
+//A synthetic capture of one to four games of different lengths, so the work per capture is uneven
+void synthesizeCapture(Capture& c, uint32_t seed) {
+  uint32_t rng = seed;
+  int games = 1 + genXorshift(rng) % 4;
+  GenFaults faults = { 5, 0, 0 };
+  GenCounters counters = { };
+  uint8_t out[2 * (STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE)];
+
+  for (int i = 0; i < games; i++) {
+    GameGenerator* g = new GameGenerator();
+    generatorInit(*g, genXorshift(rng), 1800 + genXorshift(rng) % (GEN_TIME_LIMIT_FRAMES - 1800));
+    int length;
+    bool frameSent;
+    while (generatorNextMessages(*g, out, length, faults, counters, frameSent)) c.bytes.insert(c.bytes.end(), out, out + length);
+    delete g;
+  }
+}
+
+//The whole capture is in memory so messages are framed in place instead of going through a StreamReader.
+//Returns false at the end of the capture or at a corrupt header, offset then points at where it stopped
+bool nextMessage(const std::vector<uint8_t>& bytes, size_t& offset, const uint8_t*& message, int& messageSize) {
+  if (offset + STREAM_HEADER_SIZE > bytes.size()) return false;
+
+  const uint8_t* header = bytes.data() + offset;
+  uint32_t size = (uint32_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+  if (size == 0 || size > STREAM_MAX_MESSAGE_SIZE || offset + STREAM_HEADER_SIZE + size > bytes.size()) return false;
+
+  message = header + STREAM_HEADER_SIZE;
+  messageSize = size;
+  offset += STREAM_HEADER_SIZE + size;
+  return true;
+}
+
+void addTotals(SetTotals& t, const Game& game) {
+  t.games++;
+  t.frames += game.frameCounter;
+  t.droppedRecords += gameDroppedRecords(game);
+  if (arenaHeld(*game.arena) > t.arenaHighWater) t.arenaHighWater = arenaHeld(*game.arena);
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerStatistics& ps = game.players[i].stats;
+    EventCursor records;
+    const void* record;
+    t.comboStrings += ps.comboStrings.count;
+    eventCursorBegin(records, ps.recoveries);
+    while ((record = eventCursorNext(records, sizeof(Recovery))) != NULL) {
+      t.recoveries++;
+      if (!((const Recovery*)record)->isSuccessful) t.failedRecoveries++;
+    }
+    eventCursorBegin(records, ps.punishes);
+    while ((record = eventCursorNext(records, sizeof(Punish))) != NULL) {
+      t.punishes++;
+      if (((const Punish*)record)->isKill) t.kills++;
+    }
+  }
+}
+
+//Runs one capture through a context per parameter set
+void processCapture(const Capture& capture, const std::vector<ParamSet>& sets, CaptureResult& r) {
+  std::vector<uint8_t> loaded;
+  const std::vector<uint8_t>* bytes = &capture.bytes;
+  if (bytes->empty()) {
+    if (!readCapture(capture.path, loaded)) {
+      r.failed = true;
+      return;
+    }
+    bytes = &loaded;
+  }
+
+  int setCount = sets.size();
+  StatsContext* contexts = new StatsContext[setCount];
+  for (int k = 0; k < setCount; k++) statsContextInitialize(contexts[k], sets[k].params);
+
+  size_t offset = 0;
+  uint32_t game = 0;
+  const uint8_t* message;
+  int size;
+  while (nextMessage(*bytes, offset, message, size)) {
+    int result = statsHandleMessageSets(contexts, setCount, message, size);
+    if (result == STATS_REJECTED) r.rejected++;
+    if (result != STATS_GAME_ENDED) continue;
+
+    for (int k = 0; k < setCount; k++) {
+      appendf(r.lines, "{\"capture\":\"%s\",\"game\":%u,\"params\":\"%s\",\"summary\":", capture.path.c_str(), game,
+        sets[k].name.c_str());
+      printGameSummary(r.lines, contexts[k].game);
+      r.lines += "}\n";
+      addTotals(r.totals[k], contexts[k].game);
+    }
+    game++;
+  }
+
+  r.failed = offset != bytes->size();
+  delete[] contexts;
+}
+
+//**********************************************************************
+//*                         Work Stealing Pool
+//**********************************************************************
+//Every worker starts with an even share of the captures in its own queue. It takes from the back of its
+//own queue and, once that is empty, steals from the front of the others. Captures never create more work,
+//so a worker that finds every queue empty is done
+typedef struct {
+  std::mutex lock;
+  std::deque<int> tasks;
+} WorkQueue;
+
+typedef struct {
+  uint32_t captures;
+  uint32_t steals;
+} WorkerStats;
+
+bool takeTask(std::vector<WorkQueue>& queues, int self, int& task, bool& stolen) {
+  int count = queues.size();
+  for (int i = 0; i < count; i++) {
+    WorkQueue& q = queues[(self + i) % count];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tasks.empty()) continue;
+
+    if (i == 0) {
+      task = q.tasks.back();
+      q.tasks.pop_back();
+    } else {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+    }
+    stolen = i != 0;
+    return true;
+  }
+  return false;
+}
+
+void workerLoop(std::vector<WorkQueue>* queues, int self, const std::vector<Capture>* captures,
+  const std::vector<ParamSet>* sets, std::vector<CaptureResult>* results, WorkerStats* stats) {
+  int task;
+  bool stolen;
+  while (takeTask(*queues, self, task, stolen)) {
+    processCapture((*captures)[task], *sets, (*results)[task]);
+    stats->captures++;
+    if (stolen) stats->steals++;
+  }
+}
+
+//Results are indexed by capture so the output does not depend on which worker ran what
+void runCorpus(const std::vector<Capture>& captures, const std::vector<ParamSet>& sets, int threads,
+  std::vector<CaptureResult>& results, std::vector<WorkerStats>& stats) {
+  results.assign(captures.size(), CaptureResult());
+  stats.assign(threads, WorkerStats());
+
+  std::vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < captures.size(); i++) queues[i * threads / captures.size()].tasks.push_back(i);
+
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++) pool.push_back(std::thread(workerLoop, &queues, i, &captures, &sets, &results, &stats[i]));
+  workerLoop(&queues, 0, &captures, &sets, &results, &stats[0]);
+  for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+}
+
+void mergeTotals(const std::vector<CaptureResult>& results, int setCount, SetTotals* totals) {
+  for (int k = 0; k < setCount; k++) totals[k] = SetTotals();
+  for (size_t i = 0; i < results.size(); i++) {
+    for (int k = 0; k < setCount; k++) {
+      const SetTotals& t = results[i].totals[k];
+      totals[k].games += t.games;
+      totals[k].frames += t.frames;
+      totals[k].comboStrings += t.comboStrings;
+      totals[k].recoveries += t.recoveries;
+      totals[k].failedRecoveries += t.failedRecoveries;
+      totals[k].punishes += t.punishes;
+      totals[k].kills += t.kills;
+      totals[k].droppedRecords += t.droppedRecords;
+      if (t.arenaHighWater > totals[k].arenaHighWater) totals[k].arenaHighWater = t.arenaHighWater;
+    }
+  }
+}
+
+//**********************************************************************
+//*                          Check and Scaling
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-62s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+std::string joinLines(const std::vector<CaptureResult>& results) {
+  std::string all;
+  for (size_t i = 0; i < results.size(); i++) all += results[i].lines;
+  return all;
+}
+
+void buildSyntheticCorpus(std::vector<Capture>& captures, int count) {
+  captures.resize(count);
+  for (int i = 0; i < count; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "synth-%04d.bin", i);
+    captures[i].path = name;
+    synthesizeCapture(captures[i], 0x5EED0000 + i);
+  }
+}
+
+//Decodes and computes a Game by hand, the way the board does it, with an arena of arenaSize bytes
+std::string summarizeDirect(const std::vector<Capture>& captures, uint32_t arenaSize, uint32_t& dropped) {
+  std::string direct;
+  uint8_t* arenaMemory = new uint8_t[arenaSize];
+  GameArena arena;
+  arenaInit(arena, arenaMemory, arenaSize);
+  dropped = 0;
+
+  for (size_t i = 0; i < captures.size(); i++) {
+    Game* game = new Game();
+    game->arena = &arena;
+    uint32_t gameIndex = 0;
+    size_t offset = 0;
+    const uint8_t* message;
+    int size;
+    while (nextMessage(captures[i].bytes, offset, message, size)) {
+      if (size - 1 != asmEvents[message[0]]) continue;
+
+      if (message[0] == EVENT_GAME_START) {
+        arenaReset(arena);
+        decodeGameStart(*game, message + 1);
+      } else if (message[0] == EVENT_UPDATE) {
+        decodeUpdate(*game, message + 1);
+        computeGameStatistics(*game);
+      } else if (message[0] == EVENT_GAME_END) {
+        decodeGameEnd(*game, message + 1);
+        appendf(direct, "{\"capture\":\"%s\",\"game\":%u,\"params\":\"default\",\"summary\":", captures[i].path.c_str(), gameIndex++);
+        printGameSummary(direct, *game);
+        direct += "}\n";
+        dropped += gameDroppedRecords(*game);
+      }
+    }
+    delete game;
+  }
+
+  delete[] arenaMemory;
+  return direct;
+}
+
+//Like the board: completed games are kept in a ring of keep games whose lists share one arena, and the
+//oldest is released when the ring is full. Summaries are written as games are released, so they come
+//out in the same order as summarizeDirect
+std::string summarizeShared(const std::vector<Capture>& captures, uint32_t arenaSize, int keep, GameArena& arena) {
+  std::string shared;
+  uint8_t* arenaMemory = new uint8_t[arenaSize];
+  arenaInit(arena, arenaMemory, arenaSize);
+  std::vector<Game> ring(keep);
+  std::vector<std::string> labels(keep);
+  uint32_t completed = 0, released = 0;
+  Game* game = new Game();
+  gameAttachArena(*game, &arena);
+
+  for (size_t i = 0; i <= captures.size(); i++) {
+    size_t offset = 0;
+    uint32_t gameIndex = 0;
+    const uint8_t* message;
+    int size;
+    while (i < captures.size() && nextMessage(captures[i].bytes, offset, message, size)) {
+      if (size - 1 != asmEvents[message[0]]) continue;
+
+      if (message[0] == EVENT_GAME_START) decodeGameStart(*game, message + 1);
+      else if (message[0] == EVENT_UPDATE) {
+        decodeUpdate(*game, message + 1);
+        computeGameStatistics(*game);
+      } else if (message[0] == EVENT_GAME_END) {
+        decodeGameEnd(*game, message + 1);
+        if (completed - released == (uint32_t)keep) {
+          shared += labels[released % keep];
+          printGameSummary(shared, ring[released % keep]);
+          shared += "}\n";
+          released++;
+          arenaRelease(arena, ring[released % keep].arenaStart);
+        }
+        ring[completed % keep] = *game;
+        labels[completed % keep].clear();
+        appendf(labels[completed % keep], "{\"capture\":\"%s\",\"game\":%u,\"params\":\"default\",\"summary\":",
+          captures[i].path.c_str(), gameIndex++);
+        completed++;
+        gameAttachArena(*game, &arena);
+      }
+    }
+  }
+
+  //Whatever is still buffered at the end
+  while (released < completed) {
+    shared += labels[released % keep];
+    printGameSummary(shared, ring[released % keep]);
+    shared += "}\n";
+    released++;
+  }
+
+  delete game;
+  delete[] arenaMemory;
+  return shared;
+}
+
+int runCheck() {
+  bool ok = true;
+  printf("Checking corpus runner\n");
+
+  std::vector<Capture> captures;
+  buildSyntheticCorpus(captures, 24);
+
+  std::vector<ParamSet> defaults(1);
+  defaults[0].name = "default";
+  defaults[0].params = DefaultStatsParams;
+
+  std::vector<CaptureResult> serial, parallel;
+  std::vector<WorkerStats> stats;
+  runCorpus(captures, defaults, 1, serial, stats);
+  runCorpus(captures, defaults, 6, parallel, stats);
+  ok &= expect(joinLines(serial) == joinLines(parallel), "6 threads write the same summaries as 1 thread");
+
+  //The context path against decoding and computing by hand, the way the board does it
+  uint32_t dropped;
+  std::string direct = summarizeDirect(captures, GAME_ARENA_SIZE, dropped);
+  ok &= expect(direct == joinLines(serial), "contexts match decoding and computing a Game directly");
+
+  //Every event of the corpus fits in the arena. A small one drops the events that do not fit and counts
+  //them, the summaries keep every event that did
+  SetTotals all;
+  mergeTotals(serial, 1, &all);
+  ok &= expect(dropped == 0 && all.droppedRecords == 0 && all.arenaHighWater <= GAME_ARENA_SIZE, "the arena holds every event of the corpus");
+  std::string small = summarizeDirect(captures, 1024, dropped);
+  ok &= expect(dropped > 0 && small.size() < direct.size(), "a full arena drops events and counts them");
+  printf("  most arena used by a game: %u of %u bytes\n", all.arenaHighWater, (uint32_t)GAME_ARENA_SIZE);
+
+  //The board's ring of games in one arena, small enough here that it wraps many times over the corpus
+  GameArena shared;
+  std::string sharedLines = summarizeShared(captures, 12288, 3, shared);
+  ok &= expect(sharedLines == direct && shared.overflows == 0, "3 games held in one wrapping arena keep every event intact");
+  printf("  most held by the shared arena: %u of %u bytes\n", shared.highWater, shared.size);
+
+  //A game start from a Gecko code of another schema version drops that game, nothing of it is summarized
+  Capture other = captures[0];
+  size_t offset = 0;
+  const uint8_t* message;
+  int size;
+  uint32_t starts = 0;
+  while (nextMessage(other.bytes, offset, message, size)) {
+    if (message[0] != EVENT_GAME_START) continue;
+    other.bytes[message + 1 - other.bytes.data()] = EVENT_SCHEMA_VERSION + 1;
+    starts++;
+  }
+  CaptureResult otherResult = { };
+  processCapture(other, defaults, otherResult);
+  ok &= expect(starts > 0 && otherResult.lines.empty() && otherResult.rejected == starts,
+    "games from another schema version are rejected");
+
+  //Several sets in one pass against one pass per set
+  std::vector<ParamSet> sets(3);
+  sets[0] = defaults[0];
+  sets[1].name = "tight";
+  sets[1].params = { 20, 30, 20 };
+  sets[2].name = "loose";
+  sets[2].params = { 90, 90, 120 };
+
+  std::vector<CaptureResult> combined;
+  runCorpus(captures, sets, 4, combined, stats);
+
+  SetTotals totals[MAX_PARAM_SETS];
+  mergeTotals(combined, sets.size(), totals);
+  bool same = true;
+  for (size_t k = 0; k < sets.size(); k++) {
+    std::vector<ParamSet> one(1, sets[k]);
+    std::vector<CaptureResult> alone;
+    runCorpus(captures, one, 4, alone, stats);
+
+    //Pick this set's lines out of the combined output
+    std::string picked, tag = "\"params\":\"" + sets[k].name + "\"";
+    std::string all = joinLines(combined);
+    size_t start = 0;
+    while (start < all.size()) {
+      size_t end = all.find('\n', start) + 1;
+      std::string line = all.substr(start, end - start);
+      if (line.find(tag) != std::string::npos) picked += line;
+      start = end;
+    }
+    same &= picked == joinLines(alone);
+  }
+  ok &= expect(same, "3 sets in one pass match 3 separate passes");
+  ok &= expect(totals[1].comboStrings > totals[0].comboStrings && totals[0].comboStrings > totals[2].comboStrings,
+    "a shorter combo timeout splits strings, a longer one joins them");
+  ok &= expect(totals[0].games > 24 && totals[0].kills > 0 && totals[0].recoveries > 0, "the corpus has games, kills and recoveries");
+
+  printf(ok ? "PASS\n" : "FAIL\n");
+  return ok ? 0 : 1;
+}
+
+int runScaling(int count, const std::vector<ParamSet>& sets) {
+  std::vector<Capture> captures;
+  buildSyntheticCorpus(captures, count);
+
+  int cores = std::thread::hardware_concurrency();
+  if (cores < 1) cores = 1;
+  printf("%d captures, %d parameter sets, %d hardware threads\n", count, (int)sets.size(), cores);
+
+  double single = 0;
+  for (int threads = 1; threads <= 2 * cores; threads *= 2) {
+    std::vector<CaptureResult> results;
+    std::vector<WorkerStats> stats;
+    uint64_t start = hostNs();
+    runCorpus(captures, sets, threads, results, stats);
+    double seconds = (hostNs() - start) / 1e9;
+
+    SetTotals totals[MAX_PARAM_SETS];
+    mergeTotals(results, sets.size(), totals);
+    uint32_t steals = 0;
+    for (int i = 0; i < threads; i++) steals += stats[i].steals;
+
+    if (threads == 1) single = seconds;
+    printf("  %2d threads %8.3fs %10.0f frames/s  speedup %5.2fx  efficiency %3.0f%%  steals %u\n", threads, seconds,
+      totals[0].frames / seconds, single / seconds, 100 * single / seconds / (threads < cores ? threads : cores), steals);
+  }
+  return 0;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+bool parseParamSet(const char* spec, ParamSet& set) {
+  const char* equals = strchr(spec, '=');
+  int combo, recovery, punish;
+  if (!equals || sscanf(equals + 1, "%d,%d,%d", &combo, &recovery, &punish) != 3) return false;
+  if (combo < 0 || combo > 255 || recovery < 0 || recovery > 255 || punish < 0 || punish > 255) return false;
+
+  set.name.assign(spec, equals - spec);
+  set.params = { (uint8_t)combo, (uint8_t)recovery, (uint8_t)punish };
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int threads = std::thread::hardware_concurrency();
+  std::vector<ParamSet> sets;
+  const char* listPath = NULL;
+  const char* resultsPath = NULL;
+  const char* generateDir = NULL;
+  int count = 200;
+  bool scaling = false;
+  bool check = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "j:p:l:o:g:n:bc")) != -1) {
+    ParamSet set;
+    switch (opt) {
+      case 'j': threads = atoi(optarg); break;
+      case 'p':
+        if (!parseParamSet(optarg, set) || sets.size() == MAX_PARAM_SETS) {
+          fprintf(stderr, "Bad parameter set %s, expected name=combo,recovery,punish (at most %d sets)\n", optarg, MAX_PARAM_SETS);
+          return 1;
+        }
+        sets.push_back(set);
+        break;
+      case 'l': listPath = optarg; break;
+      case 'o': resultsPath = optarg; break;
+      case 'g': generateDir = optarg; break;
+      case 'n': count = atoi(optarg); break;
+      case 'b': scaling = true; break;
+      case 'c': check = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-j threads] [-p name=combo,recovery,punish]... [-l listFile] [-o resultsFile] [capture]...\n", argv[0]);
+        return 1;
+    }
+  }
+
+  asmEventsInitialize();
+  if (check) return runCheck();
+  if (threads < 1) threads = 1;
+  if (sets.empty()) {
+    ParamSet set;
+    set.name = "default";
+    set.params = DefaultStatsParams;
+    sets.push_back(set);
+  }
+  if (scaling) return runScaling(count, sets);
+
+  if (generateDir) {
+    for (int i = 0; i < count; i++) {
+      Capture c;
+      synthesizeCapture(c, 0x5EED0000 + i);
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/synth-%04d.bin", generateDir, i);
+      FILE* f = fopen(path, "wb");
+      if (!f || fwrite(c.bytes.data(), 1, c.bytes.size(), f) != c.bytes.size()) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        if (f) fclose(f);
+        return 1;
+      }
+      fclose(f);
+    }
+    printf("Wrote %d captures to %s\n", count, generateDir);
+    return 0;
+  }
+
+  std::vector<Capture> captures;
+  for (int i = optind; i < argc; i++) {
+    captures.push_back(Capture());
+    captures.back().path = argv[i];
+  }
+  if (listPath) {
+    FILE* f = fopen(listPath, "r");
+    if (!f) {
+      fprintf(stderr, "Failed to read %s\n", listPath);
+      return 1;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+      line[strcspn(line, "\r\n")] = 0;
+      if (!line[0]) continue;
+      captures.push_back(Capture());
+      captures.back().path = line;
+    }
+    fclose(f);
+  }
+  if (captures.empty()) {
+    fprintf(stderr, "No captures given\n");
+    return 1;
+  }
+
+  FILE* out = resultsPath ? fopen(resultsPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Failed to open %s\n", resultsPath);
+    return 1;
+  }
+
+  std::vector<CaptureResult> results;
+  std::vector<WorkerStats> stats;
+  uint64_t start = hostNs();
+  runCorpus(captures, sets, threads, results, stats);
+  double seconds = (hostNs() - start) / 1e9;
+
+  uint32_t failed = 0, rejected = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    fwrite(results[i].lines.data(), 1, results[i].lines.size(), out);
+    if (results[i].failed) {
+      failed++;
+      fprintf(stderr, "%s is missing, corrupt or truncated, games before the damage are kept\n", captures[i].path.c_str());
+    }
+    rejected += results[i].rejected;
+  }
+  if (out != stdout) fclose(out);
+
+  SetTotals totals[MAX_PARAM_SETS];
+  mergeTotals(results, sets.size(), totals);
+  fprintf(stderr, "%u captures (%u failed) on %d threads in %.2fs, %u messages rejected\n", (uint32_t)captures.size(), failed,
+    threads, seconds, rejected);
+  for (size_t k = 0; k < sets.size(); k++) {
+    const SetTotals& t = totals[k];
+    const StatsParams& p = sets[k].params;
+    fprintf(stderr, "  %-12s combo=%u recovery=%u punish=%u: games=%u frames=%llu comboStrings=%u recoveries=%u (failed %u) punishes=%u kills=%u\n",
+      sets[k].name.c_str(), p.comboStringTimeout, p.framesLandedRecovery, p.framesLandedPunish, t.games,
+      (unsigned long long)t.frames, t.comboStrings, t.recoveries, t.failedRecoveries, t.punishes, t.kills);
+    fprintf(stderr, "  %-12s arena: most used by a game %u of %u bytes, %u events dropped\n", "", t.arenaHighWater,
+      (uint32_t)GAME_ARENA_SIZE, t.droppedRecords);
+  }
+
+  return failed ? 1 : 0;
+}
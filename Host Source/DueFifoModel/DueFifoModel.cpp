@@ -0,0 +1,480 @@
+//DueFifoModel - runs the Due's FPGA FIFO reader (rfifo.h) against a cycle counted model of the FIFO.
+//The console writes messages into the model at a set byte rate, the reader pops them through the same
+//port macros the board uses, and every message is compared with what was sent. Each reader variant
+//reports pops and reader time per update so the indexed/digitalWrite reader can be compared with the
+//framed/PIO reader, and reading the port before the FIFO has presented the next word shows up as a
+//stale read. Messages end with the Gecko code's sequence and crc trailer like MatchDataExtraction.asm sends
+//them, the reader takes it with the payload and checks it with msgCheck() as the board does.
+//
+//All costs are in 84MHz cycles. The defaults are estimates, calibrate them against a scope trace or
+//ExiDataReaderParallelBenchmark before trusting absolute numbers.
+//
+//Build (Linux): g++ -O2 -std=c++11 DueFifoModel.cpp -o DueFifoModel
+//Usage: DueFifoModel [-f frames] [-p cyclesPerByte] [-r readCycles] [-a ackCycles] [-w digitalWriteCycles] [-l fifoLatency] [-d depth] [-n] [-c]
+//  -n sends messages without the trailer, as an older Gecko code does
+//  -c runs the fault injection check and exits, the exit code is non-zero on failure
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CYCLES_PER_US 84
+#define FRAME_CYCLES (16683 * CYCLES_PER_US)
+#define MAX_FIFO_DEPTH 4096
+#define MAX_PENDING 4096
+#define PIO_ACK_EDGE_CYCLES 2 //The set store is the first thing RFIFO_ACK does
+
+#include "../../TM4C1294 Source/FullGameStatsWebPost/enhmelee.h"
+#include "../../TM4C1294 Source/FullGameStatsWebPost/eventschema.h"
+
+//**********************************************************************
+//*                             FIFO Model
+//**********************************************************************
+//A first word fall through FIFO. Data and the empty flag only change latency cycles after a pop or after
+//a byte lands in an empty FIFO, until then the port still shows the previous word
+typedef struct {
+  uint8_t value;
+  uint64_t arrival;
+} PendingByte;
+
+typedef struct {
+  uint64_t now;
+  int depth;
+  uint64_t readCycles;
+  uint64_t ackCycles;
+  uint64_t ackEdgeCycles; //From the start of an ack to the edge the FIFO pops on
+  uint64_t latency;
+
+  uint8_t fifo[MAX_FIFO_DEPTH];
+  int head;
+  int count;
+  uint64_t visibleAt; //When the current head shows up on the port
+  uint32_t shownPort; //What the port showed before visibleAt
+
+  PendingByte pending[MAX_PENDING];
+  int pendingHead;
+  int pendingCount;
+
+  bool lastReadStale;
+  uint64_t pops;
+  uint64_t staleReads; //Acks of a word the reader never saw
+  uint64_t dropped; //Bytes written while the FIFO was full
+} FifoModel;
+
+FifoModel Model;
+
+uint32_t fifoModelReadPort(FifoModel& m);
+void fifoModelAck(FifoModel& m);
+
+#define RFIFO_READ_PORT() fifoModelReadPort(Model)
+#define RFIFO_ACK() fifoModelAck(Model)
+
+#include "../../Arduino Due Source/EnhMeleeDueFirmware/rfifo.h"
+#include "../../Arduino Due Source/EnhMeleeDueFirmware/msgcheck.h"
+
+void fifoModelReset(FifoModel& m) {
+  m.now = 0;
+  m.head = 0;
+  m.count = 0;
+  m.visibleAt = 0;
+  m.shownPort = EMPTY_BIT_MASK;
+  m.pendingHead = 0;
+  m.pendingCount = 0;
+  m.lastReadStale = false;
+  m.pops = 0;
+  m.staleReads = 0;
+  m.dropped = 0;
+}
+
+uint32_t fifoModelPort(FifoModel& m);
+
+//Moves bytes the console has sent by now into the FIFO
+void fifoModelAdvance(FifoModel& m) {
+  while (m.pendingCount > 0 && m.pending[m.pendingHead].arrival <= m.now) {
+    PendingByte& b = m.pending[m.pendingHead];
+    if (m.count >= m.depth) {
+      m.dropped++;
+    } else {
+      if (m.count == 0 && m.visibleAt <= b.arrival) {
+        m.shownPort = EMPTY_BIT_MASK;
+        m.visibleAt = b.arrival + m.latency;
+      }
+      m.fifo[(m.head + m.count) % MAX_FIFO_DEPTH] = b.value;
+      m.count++;
+    }
+    m.pendingHead = (m.pendingHead + 1) % MAX_PENDING;
+    m.pendingCount--;
+  }
+}
+
+//Port state once the outputs have settled
+uint32_t fifoModelPort(FifoModel& m) {
+  if (m.count == 0) return EMPTY_BIT_MASK;
+  uint32_t port = (uint32_t)m.fifo[m.head] << 1;
+  if (m.count >= m.depth) port |= FULL_BIT_MASK;
+  return port;
+}
+
+uint32_t fifoModelReadPort(FifoModel& m) {
+  m.now += m.readCycles;
+  fifoModelAdvance(m);
+  m.lastReadStale = m.now < m.visibleAt;
+  return m.lastReadStale ? m.shownPort : fifoModelPort(m);
+}
+
+//Whatever the ack does after the edge, holding the line or waiting, counts as settling time
+void fifoModelAck(FifoModel& m) {
+  uint64_t end = m.now + m.ackCycles;
+  m.now += m.ackEdgeCycles;
+  fifoModelAdvance(m);
+
+  if (m.count > 0) {
+    if (m.lastReadStale) m.staleReads++;
+    m.shownPort = m.now < m.visibleAt ? m.shownPort : fifoModelPort(m);
+    m.head = (m.head + 1) % MAX_FIFO_DEPTH;
+    m.count--;
+    m.pops++;
+    m.visibleAt = m.now + m.latency;
+  }
+
+  m.now = end;
+  fifoModelAdvance(m);
+}
+
+void fifoModelWrite(FifoModel& m, uint8_t value, uint64_t arrival) {
+  if (m.pendingCount >= MAX_PENDING) return;
+  PendingByte& b = m.pending[(m.pendingHead + m.pendingCount) % MAX_PENDING];
+  b.value = value;
+  b.arrival = arrival;
+  m.pendingCount++;
+}
+
+//The board spins on the empty flag between messages, skip straight to the next arrival instead
+void fifoModelWaitForData(FifoModel& m) {
+  if (m.count == 0 && m.pendingCount > 0 && m.pending[m.pendingHead].arrival > m.now) {
+    m.now = m.pending[m.pendingHead].arrival;
+  }
+}
+
+//**********************************************************************
+//*                              Producer
+//**********************************************************************
+#define FAULT_NONE 0
+#define FAULT_DROP_BYTE 1 //One payload byte never makes it into the FIFO
+#define FAULT_CORRUPT_BYTE 2 //One payload bit flips on the wire
+#define FAULT_DROP_MESSAGE 3 //The whole message is lost
+#define FAULT_REPEAT_MESSAGE 4 //The message arrives a second time with the same sequence
+#define FAULT_RESTART_SEQUENCE 5 //The sequence starts over from 0 at this message
+
+//Writes one message in the chosen format starting at the given cycle, with the Gecko code's trailer if
+//trailer is set. Returns the bytes written
+int produceMessage(FifoModel& m, bool framed, bool trailer, uint8_t sequence, uint8_t eventCode, const uint8_t* payload,
+  uint64_t start, int cyclesPerByte, int fault) {
+  if (fault == FAULT_DROP_MESSAGE) return 0;
+
+  //What the console sends: event code, payload and the trailer over both
+  uint8_t message[1 + 1024 + MSG_TRAILER_SIZE];
+  int size = asmEvents[eventCode];
+  message[0] = eventCode;
+  memcpy(message + 1, payload, size);
+  size++;
+  if (trailer) {
+    message[size++] = sequence;
+    uint16_t crc = msgCrc16(message, size);
+    message[size++] = crc >> 8;
+    message[size++] = crc & 0xFF;
+  }
+
+  uint8_t wire[2 * sizeof(message) + 2];
+  int length = 0;
+
+  if (framed) {
+    wire[length++] = sequence;
+    memcpy(wire + length, message, size);
+    length += size;
+    wire[length] = rfifoChecksum(wire, length);
+    length++;
+  } else {
+    //The FPGA inserts the index in front of every byte it forwards
+    for (int i = 0; i < size; i++) {
+      wire[length++] = i;
+      wire[length++] = message[i];
+    }
+  }
+
+  int faultAt = length / 2 | 1; //A data byte in either format
+  int written = 0;
+  for (int i = 0; i < length; i++) {
+    if (fault == FAULT_DROP_BYTE && i == faultAt) continue;
+    uint8_t value = fault == FAULT_CORRUPT_BYTE && i == faultAt ? wire[i] ^ 0x10 : wire[i];
+
+    //The index and its byte arrive together, the console only sends data bytes
+    int dataIndex = framed ? i : i / 2;
+    fifoModelWrite(m, value, start + (uint64_t)dataIndex * cyclesPerByte);
+    written++;
+  }
+  return written;
+}
+
+//**********************************************************************
+//*                              Simulation
+//**********************************************************************
+typedef struct {
+  const char* name;
+  bool framed;
+  bool digitalWriteAck;
+} ReaderVariant;
+
+typedef struct {
+  int readCycles;
+  int ackCycles;
+  int digitalWriteCycles;
+  int latency;
+  int depth;
+  int cyclesPerByte;
+  bool trailer; //Messages end with the sequence and crc trailer
+} ModelConfig;
+
+typedef struct {
+  uint64_t messages; //Reads, good or bad
+  uint64_t updates;
+  uint64_t updatePops;
+  uint64_t updateCycles;
+  uint64_t mismatches; //Reported good but the payload differs from what was sent
+  uint64_t failures; //Reported bad by the reader or the trailer check
+  RfifoStats stats;
+  MsgCheckStats checks;
+} RunResult;
+
+//Sends frames messages (game start, updates, game end) through the model and reads them back. A fault
+//can be injected into every faultEvery-th message
+RunResult run(const ReaderVariant& v, const ModelConfig& c, int frames, int fault, int faultEvery) {
+  FifoModel& m = Model;
+  m.depth = c.depth;
+  m.readCycles = c.readCycles;
+  m.ackCycles = v.digitalWriteAck ? 2 * c.digitalWriteCycles : c.ackCycles;
+  m.ackEdgeCycles = v.digitalWriteAck ? c.digitalWriteCycles : PIO_ACK_EDGE_CYCLES;
+  m.latency = c.latency;
+  fifoModelReset(m);
+
+  RunResult r;
+  memset(&r, 0, sizeof(r));
+
+  uint32_t rng = 0x2545F491;
+  uint8_t payload[1024];
+  uint8_t frame[1024 + RFIFO_FRAME_OVERHEAD + MSG_TRAILER_SIZE];
+  int trailerSize = c.trailer ? MSG_TRAILER_SIZE : 0;
+  uint64_t written = 0;
+  int sequenceStart = 0;
+
+  for (int i = 0; i < frames + 2; i++) {
+    uint8_t eventCode = i == 0 ? EVENT_GAME_START : i == frames + 1 ? EVENT_GAME_END : EVENT_UPDATE;
+    int size = asmEvents[eventCode];
+    for (int j = 0; j < size; j++) {
+      rng = rng * 1664525 + 1013904223;
+      payload[j] = rng >> 24;
+    }
+
+    int messageFault = faultEvery > 0 && i % faultEvery == faultEvery - 1 ? fault : FAULT_NONE;
+    if (messageFault == FAULT_RESTART_SEQUENCE) sequenceStart = i;
+
+    //A repeated message is sent again once the first copy has been read
+    int copies = messageFault == FAULT_REPEAT_MESSAGE ? 2 : 1;
+    for (int copy = 0; copy < copies; copy++) {
+      uint64_t start = (uint64_t)i * FRAME_CYCLES;
+      if (m.now > start) start = m.now; //The reader fell more than a frame behind
+      written += produceMessage(m, v.framed, c.trailer, (uint8_t)(i - sequenceStart), eventCode, payload, start,
+        c.cyclesPerByte, messageFault);
+
+      //Keep reading until everything sent so far is popped or dropped, a broken message can take more than one read
+      //to get through. Only a read that ends exactly at the end of this message can be this message
+      while (m.pops + m.dropped < written) {
+        fifoModelWaitForData(m);
+        uint64_t pops = m.pops;
+        uint64_t begin = m.now;
+
+        int frameSize;
+        int result = v.framed ? rfifoReadFramed(frame, frameSize, asmEvents, trailerSize, r.stats) :
+          rfifoReadIndexed(frame, frameSize, asmEvents, trailerSize, r.stats);
+
+        //The same trailer check rfifoReadMessage() does
+        int payloadSize;
+        if (result == RFIFO_RESULT_OK && c.trailer &&
+          msgCheck(frame + 1, 1 + asmEvents[frame[1]] + MSG_TRAILER_SIZE, asmEvents, payloadSize, r.checks) != MSG_CHECK_OK) {
+          result = RFIFO_RESULT_BAD_CHECKSUM;
+        }
+
+        r.messages++;
+        if (result != RFIFO_RESULT_OK) {
+          r.failures++;
+          continue;
+        }
+
+        if (m.pops + m.dropped != written || frame[1] != eventCode || memcmp(frame + 2, payload, size) != 0) r.mismatches++;
+        if (eventCode == EVENT_UPDATE) {
+          r.updates++;
+          r.updatePops += m.pops - pops;
+          r.updateCycles += m.now - begin;
+        }
+      }
+    }
+  }
+
+  return r;
+}
+
+void printResult(const ReaderVariant& v, const RunResult& r, const FifoModel& m) {
+  double updates = r.updates > 0 ? (double)r.updates : 1;
+  printf("%-22s pops/update=%5.1f reader=%7.1fus/update good=%llu failed=%llu mismatched=%llu stale=%llu dropped=%llu gaps=%lu\n",
+    v.name, r.updatePops / updates, r.updateCycles / updates / CYCLES_PER_US,
+    (unsigned long long)(r.messages - r.failures), (unsigned long long)r.failures,
+    (unsigned long long)r.mismatches, (unsigned long long)m.staleReads, (unsigned long long)m.dropped,
+    (unsigned long)r.stats.sequenceGaps);
+}
+
+static const ReaderVariant Variants[] = {
+  { "indexed/digitalWrite", false, true },
+  { "indexed/pio", false, false },
+  { "framed/pio", true, false },
+};
+#define VARIANT_COUNT 3
+
+//**********************************************************************
+//*                           Fault Injection
+//**********************************************************************
+//Every message the fault did not touch has to come through intact and nothing bad may be accepted
+int expectDelivered(const char* name, const RunResult& r, uint64_t delivered, uint64_t gaps) {
+  uint64_t good = r.messages - r.failures;
+  bool ok = good == delivered && r.mismatches == 0 && r.stats.sequenceGaps == gaps;
+  printf("%-28s good=%llu (expected %llu) failed=%llu gaps=%lu (expected %llu) mismatched=%llu %s\n", name,
+    (unsigned long long)good, (unsigned long long)delivered, (unsigned long long)r.failures,
+    (unsigned long)r.stats.sequenceGaps, (unsigned long long)gaps, (unsigned long long)r.mismatches, ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+int runCheck(const ModelConfig& c) {
+  const int frames = 600;
+  const int every = 50;
+  const ReaderVariant& framed = Variants[2];
+  const ReaderVariant& indexed = Variants[1];
+  int failures = 0;
+
+  //Every injected fault costs exactly its own message and the reader is back in sync for the next one.
+  //A rejected frame also shows up as a sequence gap once the next good frame arrives
+  int total = frames + 2;
+  int faults = total / every;
+  failures += expectDelivered("framed clean", run(framed, c, frames, FAULT_NONE, 0), total, 0);
+  failures += expectDelivered("framed dropped byte", run(framed, c, frames, FAULT_DROP_BYTE, every), total - faults, faults);
+  failures += expectDelivered("framed corrupted byte", run(framed, c, frames, FAULT_CORRUPT_BYTE, every), total - faults, faults);
+  failures += expectDelivered("framed dropped message", run(framed, c, frames, FAULT_DROP_MESSAGE, every), total - faults, faults);
+
+  //A step back in the sequence is not a run of lost messages. The same sequence again is dropped as a
+  //duplicate, by the frame check in the framed format and by the trailer check in the index format, and
+  //a sequence that starts over is picked up from there
+  RunResult repeated = run(framed, c, frames, FAULT_REPEAT_MESSAGE, every);
+  failures += expectDelivered("framed repeated message", repeated, total, 0);
+  RunResult indexedRepeated = run(indexed, c, frames, FAULT_REPEAT_MESSAGE, every);
+  failures += expectDelivered("indexed repeated message", indexedRepeated, total, 0);
+  RunResult restarted = run(framed, c, frames, FAULT_RESTART_SEQUENCE, every);
+  failures += expectDelivered("framed restarted sequence", restarted, total, 0);
+  if (repeated.stats.duplicates != (uint32_t)faults || indexedRepeated.checks.duplicates != (uint32_t)faults ||
+    restarted.stats.resyncs != (uint32_t)faults || restarted.checks.sequenceGaps != 0) {
+    printf("Duplicates %u and %u, resyncs %u of %d\n", repeated.stats.duplicates, indexedRepeated.checks.duplicates,
+      restarted.stats.resyncs, faults);
+    failures++;
+  }
+
+  //The index format can only find the next message by waiting out the rest of the broken one, so it
+  //reports more failures per fault but must still deliver the same messages
+  failures += expectDelivered("indexed dropped byte", run(indexed, c, frames, FAULT_DROP_BYTE, every), total - faults, 0);
+
+  //The index format has no checksum, only the Gecko code's crc keeps a flipped bit out of the stats
+  RunResult corrupted = run(indexed, c, frames, FAULT_CORRUPT_BYTE, every);
+  failures += expectDelivered("indexed corrupted byte", corrupted, total - faults, 0);
+  if (corrupted.checks.badCrcs != (uint32_t)faults) {
+    printf("Trailer crc caught %u of %d corrupted bytes\n", corrupted.checks.badCrcs, faults);
+    failures++;
+  }
+
+  //A Gecko code without the trailer still reads in both formats when the reader is told
+  ModelConfig bare = c;
+  bare.trailer = false;
+  failures += expectDelivered("framed without trailer", run(framed, bare, frames, FAULT_NONE, 0), total, 0);
+  failures += expectDelivered("indexed without trailer", run(indexed, bare, frames, FAULT_NONE, 0), total, 0);
+
+  //With the configured timing nothing may be read before the FIFO presents it
+  if (Model.staleReads != 0) {
+    printf("Stale reads at the configured timing\n");
+    failures++;
+  }
+
+  //Acking faster than the FIFO can present the next word has to be caught by the checksum, not slip
+  //through. Whole messages arrive at once here, with gaps between bytes a frame can pick up several bad
+  //bytes and an 8 bit checksum lets one in 256 of those through
+  ModelConfig fast = c;
+  fast.cyclesPerByte = 0;
+  fast.ackCycles = PIO_ACK_EDGE_CYCLES;
+  fast.readCycles = 1;
+  fast.latency = c.ackCycles + c.readCycles + 4;
+  RunResult r = run(framed, fast, frames, FAULT_NONE, 0);
+  bool caught = Model.staleReads > 0 && r.mismatches == 0 && r.failures > 0;
+  printf("%-28s stale=%llu failed=%llu mismatched=%llu %s\n", "framed ack faster than fifo",
+    (unsigned long long)Model.staleReads, (unsigned long long)r.failures, (unsigned long long)r.mismatches,
+    caught ? "ok" : "FAIL");
+  if (!caught) failures++;
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  int frames = 3600;
+  bool check = false;
+
+  ModelConfig c;
+  c.readCycles = 4; //PDSR load over the peripheral bridge
+  c.ackCycles = 14; //Set and clear stores plus the nops after each in RFIFO_ACK
+  c.digitalWriteCycles = 100; //Pin lookup and bounds checks in the core's digitalWrite
+  c.latency = 6; //A couple of FPGA clocks for the fall through register
+  c.depth = 512;
+  c.cyclesPerByte = 0; //0 has the whole message waiting, which measures the reader alone
+  c.trailer = true;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:p:r:a:w:l:d:nc")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'p': c.cyclesPerByte = atoi(optarg); break;
+      case 'r': c.readCycles = atoi(optarg); break;
+      case 'a': c.ackCycles = atoi(optarg); break;
+      case 'w': c.digitalWriteCycles = atoi(optarg); break;
+      case 'l': c.latency = atoi(optarg); break;
+      case 'd': c.depth = atoi(optarg); break;
+      case 'n': c.trailer = false; break;
+      case 'c': check = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-p cyclesPerByte] [-r readCycles] [-a ackCycles] [-w digitalWriteCycles] [-l fifoLatency] [-d depth] [-n] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (c.depth < 1) c.depth = 1;
+  if (c.ackCycles < PIO_ACK_EDGE_CYCLES) c.ackCycles = PIO_ACK_EDGE_CYCLES;
+  if (c.depth > MAX_FIFO_DEPTH) c.depth = MAX_FIFO_DEPTH;
+
+  asmEventsInitialize();
+
+  if (check) return runCheck(c);
+
+  for (int i = 0; i < VARIANT_COUNT; i++) {
+    RunResult r = run(Variants[i], c, frames, FAULT_NONE, 0);
+    printResult(Variants[i], r, Model);
+  }
+
+  return 0;
+}
@@ -0,0 +1,529 @@
+//FleetSim - impersonates a fleet of boards. Every simulated board opens a TCP connection to the stats
+//server and streams games the way EnhMelee1294 does: each console message is forwarded with writeMsg()
+//framing (4 byte big endian length, event code, payload), at console speed or faster. The games come
+//from gamegen.h, so the motion, hits, stock losses and inputs are plausible enough to exercise every
+//branch of the stats engine, and faults (missed frames, truncated updates, unknown event codes) can be
+//mixed in at a given rate. A recorded capture can be replayed instead of generated games.
+//
+//-c runs the generator through the same decode and size check StatsDaemon uses without any network and
+//verifies that the stream round trips byte exact, that the injected faults are exactly the ones the
+//receiver sees, that the games produce kills, combos, punishes and recoveries and that missed updates
+//do not skew the frame based stats of an otherwise identical game.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing FleetSim.cpp -o FleetSim
+//Usage: FleetSim [-a address] [-p port] [-s boards] [-x speed] [-g gamesPerBoard] [-f maxFrames] [-r seed]
+//                [-M missedPerMille] [-T truncatedPerMille] [-E badEventPerMille] [-i capture] [-o captureOut] [-m] [-c]
+//  -x 1 plays at console speed, 4 at four times that and 0 unthrottled. -i replays a capture (e.g. the
+//  output of nc -l 3636 > capture.bin) on every board instead of generating games, -g times over. -o writes the stream
+//  of the first board to a file. -m sends postConnectedMessage()'s {"mac":[...]} line first
+
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/gamegen.h"
+
+#define MAX_CHUNK_SIZE (2 * (STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE))
+
+//**********************************************************************
+//*                            Boards
+//**********************************************************************
+typedef struct {
+  int fd;
+  uint8_t mac[6];
+  GameGenerator gen;
+  GenCounters counters;
+  uint32_t seed;
+  int gamesLeft;
+  size_t replayOffset;
+  bool done;
+
+  uint64_t bytesSent;
+  uint32_t gamesSent;
+} Board;
+
+typedef struct {
+  const char* address;
+  int port;
+  int boards;
+  double speed;
+  int games;
+  uint32_t maxFrames;
+  uint32_t seed;
+  GenFaults faults;
+  const char* capturePath;
+  const char* captureOutPath;
+  bool connectedMessage;
+} Options;
+
+std::vector<uint8_t> Capture;
+FILE* CaptureOut = NULL;
+
+double nowMs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+void sleepUntilMs(double deadline) {
+  double remaining = deadline - nowMs();
+  if (remaining <= 0) return;
+
+  timespec t;
+  t.tv_sec = (time_t)(remaining / 1000);
+  t.tv_nsec = (long)(fmod(remaining, 1000) * 1e6);
+  nanosleep(&t, NULL);
+}
+
+bool sendAll(int fd, const uint8_t* data, int length) {
+  while (length > 0) {
+    int sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent <= 0) return false;
+    data += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+bool boardSend(Board& b, int index, const uint8_t* data, int length) {
+  if (index == 0 && CaptureOut) fwrite(data, 1, length, CaptureOut);
+  if (b.fd < 0) return true;
+
+  b.bytesSent += length;
+  if (sendAll(b.fd, data, length)) return true;
+
+  fprintf(stderr, "Board %d lost its connection: %s\n", index, strerror(errno));
+  close(b.fd);
+  b.fd = -1;
+  b.done = true;
+  return false;
+}
+
+int connectBoard(const Options& o) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+
+  //writeMsg() pushes every message out on its own, so should we
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(o.port);
+  inet_pton(AF_INET, o.address, &addr.sin_addr);
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+//Same text postConnectedMessage() prints, ArduinoJson writes the bytes as decimal numbers
+void sendConnectedMessage(Board& b, int index) {
+  char line[64];
+  int length = snprintf(line, sizeof(line), "{\"mac\":[%d,%d,%d,%d,%d,%d]}\r\n",
+    b.mac[0], b.mac[1], b.mac[2], b.mac[3], b.mac[4], b.mac[5]);
+  boardSend(b, index, (const uint8_t*)line, length);
+}
+
+void startGame(Board& b, const Options& o) {
+  generatorInit(b.gen, b.seed, o.maxFrames);
+  b.seed = b.seed * 1103515245 + 12345;
+  b.gamesLeft--;
+}
+
+//Sends everything up to and including the next frame of game time. Returns false once the board has
+//nothing left to send
+bool stepBoard(Board& b, int index, const Options& o) {
+  uint8_t out[MAX_CHUNK_SIZE];
+
+  if (!Capture.empty()) {
+    //Replay paces on update messages, anything in between goes out with the next one
+    size_t start = b.replayOffset;
+    while (b.replayOffset + STREAM_HEADER_SIZE < Capture.size()) {
+      const uint8_t* header = &Capture[b.replayOffset];
+      uint32_t length = (uint32_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+      if (length == 0 || length > STREAM_MAX_MESSAGE_SIZE || b.replayOffset + STREAM_HEADER_SIZE + length > Capture.size()) {
+        fprintf(stderr, "Capture is corrupt at offset %lu, stopping the replay there\n", (unsigned long)b.replayOffset);
+        b.replayOffset = Capture.size();
+        break;
+      }
+
+      b.replayOffset += STREAM_HEADER_SIZE + length;
+      b.counters.messages++;
+      if (header[STREAM_HEADER_SIZE] == EVENT_GAME_END) b.gamesSent++;
+      if (header[STREAM_HEADER_SIZE] == EVENT_UPDATE) break;
+    }
+
+    if (b.replayOffset > start) boardSend(b, index, &Capture[start], (int)(b.replayOffset - start));
+    if (b.replayOffset + STREAM_HEADER_SIZE >= Capture.size()) {
+      if (--b.gamesLeft <= 0) return false;
+      b.replayOffset = 0;
+    }
+    return !b.done;
+  }
+
+  while (!b.done) {
+    bool frameSent;
+    int length;
+    if (!generatorNextMessages(b.gen, out, length, o.faults, b.counters, frameSent)) {
+      b.gamesSent++;
+      if (b.gamesLeft <= 0) return false;
+      startGame(b, o);
+      continue;
+    }
+
+    if (length > 0) boardSend(b, index, out, length);
+    if (frameSent) break;
+  }
+  return !b.done;
+}
+
+//**********************************************************************
+//*                             Fleet
+//**********************************************************************
+int runFleet(const Options& o) {
+  std::vector<Board> boards(o.boards);
+  for (int i = 0; i < o.boards; i++) {
+    Board& b = boards[i];
+    b = { };
+
+    //Locally administered MACs keep the fleet from colliding with real boards
+    uint8_t mac[6] = { 0x02, 0x1A, 0xB6, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i };
+    memcpy(b.mac, mac, sizeof(mac));
+    b.seed = o.seed + i * 7919;
+    b.gamesLeft = o.games;
+
+    b.fd = connectBoard(o);
+    if (b.fd < 0) {
+      fprintf(stderr, "Board %d could not connect to %s:%d: %s\n", i, o.address, o.port, strerror(errno));
+      return 1;
+    }
+    if (o.connectedMessage) sendConnectedMessage(b, i);
+    if (Capture.empty()) startGame(b, o);
+  }
+
+  printf("%d boards connected to %s:%d, %s\n", o.boards, o.address, o.port,
+    Capture.empty() ? "generating games" : "replaying capture");
+
+  //Frames go out on an absolute schedule so a late frame does not push the rest back
+  double periodMs = o.speed > 0 ? 1000.0 / (GEN_FRAMES_PER_SECOND * o.speed) : 0;
+  double startMs = nowMs();
+  double worstLateMs = 0;
+  uint64_t ticks = 0;
+  int active = o.boards;
+
+  while (active > 0) {
+    double deadline = startMs + ticks * periodMs;
+    if (periodMs > 0) {
+      sleepUntilMs(deadline);
+      double late = nowMs() - deadline;
+      if (late > worstLateMs) worstLateMs = late;
+    }
+
+    active = 0;
+    for (int i = 0; i < o.boards; i++) {
+      if (boards[i].done) continue;
+      if (stepBoard(boards[i], i, o)) active++;
+      else boards[i].done = true;
+    }
+    ticks++;
+  }
+
+  double elapsedMs = nowMs() - startMs;
+  uint64_t bytes = 0;
+  GenCounters total = { };
+  uint32_t games = 0;
+  for (int i = 0; i < o.boards; i++) {
+    Board& b = boards[i];
+    bytes += b.bytesSent;
+    games += b.gamesSent;
+    total.messages += b.counters.messages;
+    total.missedFrames += b.counters.missedFrames;
+    total.truncated += b.counters.truncated;
+    total.badEvents += b.counters.badEvents;
+    if (b.fd >= 0) close(b.fd);
+  }
+
+  printf("Sent %u games, %u messages, %llu bytes in %.1f s\n", games, total.messages, (unsigned long long)bytes, elapsedMs / 1000);
+  printf("Faults injected: %u missed frames, %u truncated updates, %u unknown events\n",
+    total.missedFrames, total.truncated, total.badEvents);
+  printf("Frame rate: %.2f fps per board (target %.2f), worst lateness %.2f ms\n", ticks * 1000.0 / elapsedMs,
+    periodMs > 0 ? GEN_FRAMES_PER_SECOND * o.speed : 0.0, worstLateMs);
+  return 0;
+}
+
+//**********************************************************************
+//*                          Self Check
+//**********************************************************************
+//What a receiver saw, collected the same way StatsDaemon handles messages
+typedef struct {
+  uint32_t rejected;
+  uint32_t framesMissed;
+  uint32_t roundTripErrors;
+  uint32_t stocksLost;
+  uint32_t kills;
+  uint32_t punishes;
+  uint32_t combos;
+  uint32_t recoveries;
+  uint32_t failedRecoveries;
+  uint32_t droppedRecords; //Combos, punishes and recoveries that did not fit in the game arena
+  uint32_t rolls;
+  uint32_t shieldFrames;
+  uint32_t closestCenterFrames;
+  uint32_t aboveOthersFrames;
+  float distanceFromCenter; //Sum of the per player averages
+  uint32_t stockWins;
+} Received;
+
+void receiveGame(GameGenerator& gen, const GenFaults& faults, GenCounters& counters, Received& r) {
+  static Game game; //Too large for the stack
+  static StreamReader reader;
+  static uint8_t arenaMemory[GAME_ARENA_SIZE];
+  static GameArena arena;
+  arenaInit(arena, arenaMemory, sizeof(arenaMemory));
+  game.arena = &arena;
+  uint8_t out[MAX_CHUNK_SIZE];
+  uint8_t payload[MSG_BUFFER_SIZE];
+  uint32_t lastFrame = 0;
+  reader.length = 0;
+
+  bool frameSent;
+  int length;
+  while (generatorNextMessages(gen, out, length, faults, counters, frameSent)) {
+    int space;
+    uint8_t* dest = streamWritePointer(reader, space);
+    memcpy(dest, out, length);
+    streamCommit(reader, length);
+
+    int offset = 0;
+    uint8_t* message;
+    int messageSize;
+    while (streamNextMessage(reader, offset, message, messageSize) == STREAM_MESSAGE) {
+      uint8_t eventCode = message[0];
+      uint8_t* data = message + 1;
+      if (messageSize - 1 != asmEvents[eventCode]) {
+        r.rejected++;
+        continue;
+      }
+
+      switch (eventCode) {
+        case EVENT_GAME_START:
+          decodeGameStart(game, data);
+          if (encodeGameStart(payload, game) != messageSize - 1 || memcmp(payload, data, messageSize - 1)) r.roundTripErrors++;
+          break;
+        case EVENT_UPDATE:
+          decodeUpdate(game, data);
+          if (encodeUpdate(payload, game) != messageSize - 1 || memcmp(payload, data, messageSize - 1)) r.roundTripErrors++;
+          computeGameStatistics(game);
+          lastFrame = game.frameCounter;
+          break;
+        case EVENT_GAME_END:
+          decodeGameEnd(game, data);
+          if (game.winCondition != gen.game.winCondition) r.roundTripErrors++;
+          break;
+      }
+    }
+    streamConsume(reader, offset);
+  }
+
+  //Updates dropped after the last one decoded never show up as a gap
+  r.framesMissed += game.framesMissed + (gen.game.frameCounter - lastFrame);
+  if (game.winCondition == GEN_WIN_GAME) r.stockWins++;
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const Player& p = game.players[i];
+    const PlayerStatistics& s = p.stats;
+    r.stocksLost += STOCK_COUNT - p.currentFrameData.stocks;
+    EventCursor records;
+    const void* record;
+    r.combos += s.comboStrings.count;
+    r.punishes += s.punishes.count;
+    eventCursorBegin(records, s.punishes);
+    while ((record = eventCursorNext(records, sizeof(Punish))) != NULL) r.kills += ((const Punish*)record)->isKill;
+    r.recoveries += s.recoveries.count;
+    eventCursorBegin(records, s.recoveries);
+    while ((record = eventCursorNext(records, sizeof(Recovery))) != NULL) r.failedRecoveries += !((const Recovery*)record)->isSuccessful;
+    r.droppedRecords += s.comboStrings.dropped + s.punishes.dropped + s.recoveries.dropped;
+    r.rolls += s.rollCount + s.spotDodgeCount;
+    r.shieldFrames += s.framesInShield;
+    r.closestCenterFrames += s.framesClosestCenter;
+    r.aboveOthersFrames += s.framesAboveOthers;
+    r.distanceFromCenter += s.averageDistanceFromCenter;
+  }
+}
+
+bool within(double value, double reference, double fraction) {
+  return fabs(value - reference) <= reference * fraction;
+}
+
+bool expect(bool condition, const char* what) {
+  printf("  %-58s %s\n", what, condition ? "ok" : "FAILED");
+  return condition;
+}
+
+int runCheck(const Options& o) {
+  static GameGenerator gen;
+  bool pass = true;
+  int games = o.games > 1 ? o.games : 20;
+
+  //Clean games must decode into exactly what was generated and look like Melee
+  Received clean = { };
+  GenCounters cleanCounters = { };
+  GenFaults none = { };
+  for (int i = 0; i < games; i++) {
+    generatorInit(gen, o.seed + i, o.maxFrames);
+    receiveGame(gen, none, cleanCounters, clean);
+  }
+
+  printf("%d clean games: %u stocks lost, %u kills, %u punishes, %u combos, %u recoveries (%u failed), %u rolls and dodges, %u shield frames\n",
+    games, clean.stocksLost, clean.kills, clean.punishes, clean.combos, clean.recoveries, clean.failedRecoveries,
+    clean.rolls, clean.shieldFrames);
+  pass &= expect(clean.roundTripErrors == 0, "every message decodes and re-encodes byte exact");
+  pass &= expect(clean.rejected == 0 && clean.framesMissed == 0, "no rejects or missed frames without faults");
+  pass &= expect(clean.kills > 0 && clean.stocksLost > 0 && clean.stockWins > 0, "stocks are lost and games end on stocks");
+  pass &= expect(clean.punishes > clean.kills && clean.combos > 0, "punishes and combos are recorded");
+  pass &= expect(clean.droppedRecords == 0, "every combo, punish and recovery fits in the game arena");
+  pass &= expect(clean.recoveries > clean.failedRecoveries && clean.failedRecoveries > 0, "recoveries both succeed and fail");
+  pass &= expect(clean.rolls > 0 && clean.shieldFrames > 0, "rolls, dodges and shielding show up");
+
+  //With faults, the receiver has to see exactly what was injected
+  GenFaults faults = { 20, 10, 5 };
+  if (o.faults.missedFramePerMille || o.faults.truncatePerMille || o.faults.badEventPerMille) faults = o.faults;
+  Received faulty = { };
+  GenCounters injected = { };
+  for (int i = 0; i < games; i++) {
+    generatorInit(gen, o.seed + i, o.maxFrames);
+    receiveGame(gen, faults, injected, faulty);
+  }
+
+  printf("%d games with faults: %u missed frames, %u truncated updates, %u unknown events injected\n",
+    games, injected.missedFrames, injected.truncated, injected.badEvents);
+  pass &= expect(faulty.roundTripErrors == 0, "messages that get through still decode byte exact");
+  pass &= expect(faulty.rejected == injected.truncated + injected.badEvents, "rejects match truncated updates plus unknown events");
+  pass &= expect(faulty.framesMissed == injected.missedFrames + injected.truncated, "missed frames match dropped plus truncated updates");
+
+  //Missed frames alone do not change the game itself, only what the receiver sees of it. Durations have
+  //to stay close to the clean run instead of shrinking with every gap
+  GenFaults missesOnly = { 100, 0, 0 };
+  Received gaps = { };
+  GenCounters gapCounters = { };
+  for (int i = 0; i < games; i++) {
+    generatorInit(gen, o.seed + i, o.maxFrames);
+    receiveGame(gen, missesOnly, gapCounters, gaps);
+  }
+
+  printf("Same games with 10%% of updates missed: %u shield frames, %u closest to center, %u above, %.1f distance (clean %u, %u, %u, %.1f)\n",
+    gaps.shieldFrames, gaps.closestCenterFrames, gaps.aboveOthersFrames, gaps.distanceFromCenter,
+    clean.shieldFrames, clean.closestCenterFrames, clean.aboveOthersFrames, clean.distanceFromCenter);
+  pass &= expect(gaps.stocksLost == clean.stocksLost && gaps.kills == clean.kills, "gaps do not change stock losses or kills");
+  pass &= expect(within(gaps.shieldFrames, clean.shieldFrames, 0.05) && within(gaps.closestCenterFrames, clean.closestCenterFrames, 0.02) &&
+    within(gaps.aboveOthersFrames, clean.aboveOthersFrames, 0.02), "frame counts stay within a few percent across gaps");
+  pass &= expect(within(gaps.distanceFromCenter, clean.distanceFromCenter, 0.02), "average distance from center stays within 2%");
+
+  //A seed always gives the same stream
+  uint8_t first[MAX_CHUNK_SIZE];
+  uint8_t second[MAX_CHUNK_SIZE];
+  GenCounters scratch = { };
+  static GameGenerator other;
+  generatorInit(gen, o.seed, o.maxFrames);
+  generatorInit(other, o.seed, o.maxFrames);
+  bool same = true;
+  bool frameSent;
+  int length;
+  int otherLength;
+  while (same && generatorNextMessages(gen, first, length, faults, scratch, frameSent)) {
+    same = generatorNextMessages(other, second, otherLength, faults, scratch, frameSent) && otherLength == length &&
+      memcmp(first, second, length) == 0;
+  }
+  pass &= expect(same, "generation is deterministic for a seed");
+
+  printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+bool loadCapture(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  uint8_t chunk[64 * 1024];
+  size_t read;
+  while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0) Capture.insert(Capture.end(), chunk, chunk + read);
+  fclose(f);
+  return !Capture.empty();
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  o.address = "127.0.0.1";
+  o.port = 3636;
+  o.boards = 1;
+  o.speed = 1;
+  o.games = 1;
+  o.maxFrames = 0;
+  o.seed = 0x5EED;
+  o.faults.missedFramePerMille = 0;
+  o.faults.truncatePerMille = 0;
+  o.faults.badEventPerMille = 0;
+  o.capturePath = NULL;
+  o.captureOutPath = NULL;
+  o.connectedMessage = false;
+  bool check = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "a:p:s:x:g:f:r:M:T:E:i:o:mc")) != -1) {
+    switch (opt) {
+      case 'a': o.address = optarg; break;
+      case 'p': o.port = atoi(optarg); break;
+      case 's': o.boards = atoi(optarg); break;
+      case 'x': o.speed = atof(optarg); break;
+      case 'g': o.games = atoi(optarg); break;
+      case 'f': o.maxFrames = strtoul(optarg, NULL, 10); break;
+      case 'r': o.seed = strtoul(optarg, NULL, 0); break;
+      case 'M': o.faults.missedFramePerMille = atoi(optarg); break;
+      case 'T': o.faults.truncatePerMille = atoi(optarg); break;
+      case 'E': o.faults.badEventPerMille = atoi(optarg); break;
+      case 'i': o.capturePath = optarg; break;
+      case 'o': o.captureOutPath = optarg; break;
+      case 'm': o.connectedMessage = true; break;
+      case 'c': check = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-a address] [-p port] [-s boards] [-x speed] [-g gamesPerBoard] [-f maxFrames] [-r seed] "
+          "[-M missedPerMille] [-T truncatedPerMille] [-E badEventPerMille] [-i capture] [-o captureOut] [-m] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  asmEventsInitialize();
+  if (check) return runCheck(o);
+
+  if (o.boards < 1 || o.games < 1) {
+    fprintf(stderr, "Need at least one board and one game\n");
+    return 1;
+  }
+  if (o.capturePath && !loadCapture(o.capturePath)) {
+    fprintf(stderr, "Could not read capture %s\n", o.capturePath);
+    return 1;
+  }
+  if (o.captureOutPath && !(CaptureOut = fopen(o.captureOutPath, "wb"))) {
+    fprintf(stderr, "Could not create %s\n", o.captureOutPath);
+    return 1;
+  }
+
+  int result = runFleet(o);
+  if (CaptureOut) fclose(CaptureOut);
+  return result;
+}
@@ -0,0 +1,269 @@
+//FrameHistoryBenchmark - measures what the per player frame history ring in EnhMelee1294Firmware's
+//enhmelee.h costs per frame at depths 2, 8 and 32, against the copy forward handleUpdate() used to do.
+//
+//The depth is a compile time setting, so the firmware headers are built once per depth, each in its own
+//namespace. Every variant decodes the same update payloads. "advance" is the history step plus the decode
+//handleUpdate() does, "lookback" adds a scan of every entry of both players, the most any detection could
+//read. Each reports the best time of all repetitions in ns per frame.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings FrameHistoryBenchmark.cpp -o FrameHistoryBenchmark
+//Usage: FrameHistoryBenchmark [-f frames] [-r repetitions] [-c]
+//  -c checks the ring against the copy forward history and exits, the exit code is non-zero on failure
+
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#undef FRAME_HISTORY_DEPTH
+#define FRAME_HISTORY_DEPTH 2
+namespace depth2 {
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/eventschema.h"
+}
+#undef _EVENTSCHEMA_H_INCLUDED
+#undef FRAME_HISTORY_DEPTH
+#undef FRAME_HISTORY_MASK
+
+#define FRAME_HISTORY_DEPTH 8
+namespace depth8 {
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/eventschema.h"
+}
+#undef _EVENTSCHEMA_H_INCLUDED
+#undef FRAME_HISTORY_DEPTH
+#undef FRAME_HISTORY_MASK
+
+#define FRAME_HISTORY_DEPTH 32
+namespace depth32 {
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/eventschema.h"
+}
+
+#define DEFAULT_FRAMES 28800
+#define DEFAULT_REPETITIONS 20
+
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//Updates encoded from a random walk, so the values change from frame to frame like a game's do
+std::vector<uint8_t> makeUpdates(int frames) {
+  std::vector<uint8_t> updates((size_t)frames * EVENT_UPDATE_SIZE);
+  depth2::Game game = { };
+  uint32_t rng = 0x9E3779B9;
+  for (int n = 0; n < frames; n++) {
+    game.frameCounter = n + 1;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      depth2::PlayerFrameData& pfd = depth2::currentFrame(game.players[i]);
+      rng = rng * 1103515245 + 12345;
+      pfd.animation = (rng >> 16) % 0x160;
+      pfd.locationX += ((rng >> 8) & 0xFF) / 64.0f - 2;
+      pfd.locationY += ((rng >> 4) & 0xFF) / 64.0f - 2;
+      pfd.percent += (rng & 0x7) == 0 ? 3 : 0;
+      pfd.stocks = 4;
+      pfd.physicalButtons = rng >> 20;
+      pfd.lTrigger = (rng & 0xF) / 15.0f;
+    }
+    depth2::encodeUpdate(updates.data() + (size_t)n * EVENT_UPDATE_SIZE, game);
+  }
+  return updates;
+}
+
+//**********************************************************************
+//*                              Variants
+//**********************************************************************
+//What handleUpdate() did before the ring: a current and previous frame, copied forward every frame
+typedef struct {
+  depth2::PlayerFrameData currentFrameData;
+  depth2::PlayerFrameData previousFrameData;
+} CopyPlayer;
+
+uint32_t runCopy(const uint8_t* updates, int frames, bool lookback) {
+  static depth2::Game game;
+  static CopyPlayer players[PLAYER_COUNT];
+  game = depth2::Game();
+  memset(players, 0, sizeof(players));
+
+  uint32_t sum = 0;
+  for (int n = 0; n < frames; n++) {
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      players[i].previousFrameData = players[i].currentFrameData;
+      players[i].currentFrameData = { };
+    }
+
+    //The schema decodes into the Game, the copy stands in for what the old Player held
+    depth2::schemaDecodeUpdate(game, updates + (size_t)n * EVENT_UPDATE_SIZE);
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      players[i].currentFrameData = depth2::currentFrame(game.players[i]);
+      if (lookback) sum += players[i].currentFrameData.animation != players[i].previousFrameData.animation;
+    }
+  }
+  return sum;
+}
+
+#define FRAME_HISTORY_DEPTH_OF(ns) (int)(sizeof(((ns::FrameHistory*)0)->frames) / sizeof(ns::PlayerFrameData))
+
+//Counts animation changes over the whole history of both players, which touches every entry
+#define RING_VARIANT(ns) \
+uint32_t run_##ns(const uint8_t* updates, int frames, bool lookback) { \
+  static ns::Game game; \
+  game = ns::Game(); \
+  uint32_t sum = 0; \
+  for (int n = 0; n < frames; n++) { \
+    for (int i = 0; i < PLAYER_COUNT; i++) ns::frameHistoryAdvance(game.players[i]); \
+    ns::schemaDecodeUpdate(game, updates + (size_t)n * EVENT_UPDATE_SIZE); \
+    if (!lookback) continue; \
+    for (int i = 0; i < PLAYER_COUNT; i++) { \
+      for (int k = 1; k < FRAME_HISTORY_DEPTH_OF(ns); k++) { \
+        sum += ns::frameAgo(game.players[i], k - 1).animation != ns::frameAgo(game.players[i], k).animation; \
+      } \
+    } \
+  } \
+  return sum; \
+}
+
+RING_VARIANT(depth2)
+RING_VARIANT(depth8)
+RING_VARIANT(depth32)
+
+typedef uint32_t (*VariantFunction)(const uint8_t* updates, int frames, bool lookback);
+
+typedef struct {
+  const char* name;
+  VariantFunction run;
+  int depth;
+} Variant;
+
+static const Variant variants[] = {
+  { "copy", runCopy, 2 },
+  { "ring", run_depth2, 2 },
+  { "ring", run_depth8, 8 },
+  { "ring", run_depth32, 32 },
+};
+#define VARIANT_COUNT 4
+
+//**********************************************************************
+//*                                Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+//Keeps every decoded frame so each entry of the ring can be compared with the frame it should hold
+template <typename G, typename F> bool checkRing(G& game, const uint8_t* updates, int frames, int depth, F decode) {
+  std::vector<depth2::PlayerFrameData> decoded((size_t)frames * PLAYER_COUNT);
+  depth2::Game reference = { };
+  for (int n = 0; n < frames; n++) {
+    depth2::schemaDecodeUpdate(reference, updates + (size_t)n * EVENT_UPDATE_SIZE);
+    for (int i = 0; i < PLAYER_COUNT; i++) decoded[(size_t)n * PLAYER_COUNT + i] = depth2::currentFrame(reference.players[i]);
+  }
+
+  game = G();
+  for (int n = 0; n < frames; n++) {
+    decode(game, updates + (size_t)n * EVENT_UPDATE_SIZE);
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      for (int k = 0; k < depth; k++) {
+        //Before the first frames of the game the entries are still cleared, like previousFrameData was
+        depth2::PlayerFrameData expected = { };
+        if (n - k >= 0) expected = decoded[(size_t)(n - k) * PLAYER_COUNT + i];
+        if (memcmp(&expected, &frameAgo(game.players[i], k), sizeof(expected)) != 0) return false;
+      }
+      if (&currentFrame(game.players[i]) != &frameAgo(game.players[i], 0) ||
+        &previousFrame(game.players[i]) != &frameAgo(game.players[i], 1)) return false;
+    }
+  }
+  return true;
+}
+
+#define CHECK_DECODE(ns) [](ns::Game& g, const uint8_t* u) { \
+  for (int i = 0; i < PLAYER_COUNT; i++) ns::frameHistoryAdvance(g.players[i]); \
+  ns::schemaDecodeUpdate(g, u); \
+}
+
+int runCheck() {
+  bool ok = true;
+  printf("Checking frame history ring\n");
+
+  std::vector<uint8_t> updates = makeUpdates(300);
+  static depth2::Game g2;
+  static depth8::Game g8;
+  static depth32::Game g32;
+  ok &= expect(checkRing(g2, updates.data(), 300, 2, CHECK_DECODE(depth2)), "depth 2 holds the last 2 frames");
+  ok &= expect(checkRing(g8, updates.data(), 300, 8, CHECK_DECODE(depth8)), "depth 8 holds the last 8 frames");
+  ok &= expect(checkRing(g32, updates.data(), 300, 32, CHECK_DECODE(depth32)), "depth 32 holds the last 32 frames");
+
+  //Depth 2 has to see exactly what the copy forward history saw
+  uint32_t copy = runCopy(updates.data(), 300, true);
+  uint32_t ring = run_depth2(updates.data(), 300, true);
+  ok &= expect(copy == ring, "depth 2 lookback matches the copy forward history");
+
+  //A stale field from DEPTH frames ago must not survive into a new frame the update leaves alone
+  depth8::Player p = { };
+  for (int k = 0; k < 8; k++) {
+    depth8::frameHistoryAdvance(p);
+    depth8::currentFrame(p).comboCount = 7;
+  }
+  depth8::frameHistoryAdvance(p);
+  ok &= expect(depth8::currentFrame(p).comboCount == 0 && depth8::previousFrame(p).comboCount == 7,
+    "a reused entry starts cleared");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  int frames = DEFAULT_FRAMES;
+  int repetitions = DEFAULT_REPETITIONS;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:r:c")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'r': repetitions = atoi(optarg); break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-r repetitions] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (frames <= 0 || repetitions <= 0) {
+    fprintf(stderr, "Frames and repetitions must be positive\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> updates = makeUpdates(frames);
+  printf("%d frames, best of %d repetitions, player frame data is %d bytes\n", frames, repetitions,
+    (int)sizeof(depth2::PlayerFrameData));
+  printf("%-6s %5s %10s %12s %13s\n", "", "depth", "bytes", "advance ns", "lookback ns");
+
+  volatile uint32_t sink = 0;
+  for (int v = 0; v < VARIANT_COUNT; v++) {
+    const Variant& variant = variants[v];
+    uint64_t best[2] = { UINT64_MAX, UINT64_MAX };
+    for (int r = 0; r < repetitions; r++) {
+      for (int lookback = 0; lookback < 2; lookback++) {
+        uint64_t start = hostNs();
+        sink += variant.run(updates.data(), frames, lookback != 0);
+        uint64_t elapsed = hostNs() - start;
+        if (elapsed < best[lookback]) best[lookback] = elapsed;
+      }
+    }
+
+    int bytes = variant.run == runCopy ? (int)sizeof(CopyPlayer) : variant.depth * (int)sizeof(depth2::PlayerFrameData) + 1;
+    printf("%-6s %5d %10d %12.1f %13.1f\n", variant.name, variant.depth, bytes * PLAYER_COUNT, (double)best[0] / frames,
+      (double)best[1] / frames);
+  }
+
+  return 0;
+}
@@ -0,0 +1,488 @@
+//HeatmapDecoder - reads the stage heatmaps and the spacing histogram of the game in progress, or of the last
+//one, from EnhMelee1294Firmware and turns them back into frame counts. Each grid is paged over UDP, see
+//heatmap.h. It prints each player's grid as shaded text with the top blast zone first, or every cell as CSV.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings HeatmapDecoder.cpp -o HeatmapDecoder
+//Usage: HeatmapDecoder -d deviceIp [-s] | -c
+//  -s prints CSV: player (0 for the spacing histogram), row, column (the bin), frames
+//  -c checks accumulation, encoding and paging against the firmware headers and exits, non-zero on failure
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/heatmap.h"
+
+#define CONFIG_PORT 3637
+#define FETCH_ATTEMPTS 3 //Times a grid is read again if the board encodes it afresh while it is paged
+
+//**********************************************************************
+//*                              Decode
+//**********************************************************************
+typedef struct {
+  uint32_t frame; //Frame counter when the spacing histogram was encoded
+  int columns;
+  int rows;
+  StageBounds bounds;
+  int spacingBinWidth;
+  int playerCount;
+  uint16_t cells[PLAYER_COUNT][HEATMAP_CELLS];
+  uint16_t spacing[SPACING_BINS];
+} DecodedHeatmaps;
+
+//One response, bytes points into the packet
+typedef struct {
+  uint8_t status;
+  bool hasInfo;
+  int columns;
+  int rows;
+  StageBounds bounds;
+  int spacingBins;
+  int spacingBinWidth;
+  bool hasData;
+  uint8_t grid;
+  uint32_t frame;
+  int size;
+  int offset;
+  int count;
+  const uint8_t* bytes;
+} DecodedPage;
+
+uint32_t readBig(const uint8_t* value, int& idx, int bytes) {
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) result = (result << 8) | value[idx++];
+  return result;
+}
+
+float readFloat(const uint8_t* value, int& idx) {
+  uint32_t bits = readBig(value, idx, 4);
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+bool decodePage(const uint8_t* packet, int size, uint16_t sequence, DecodedPage& d) {
+  memset(&d, 0, sizeof(d));
+  d.status = 0xFF;
+
+  TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!tlvOpen(r, packet, size) || r.type != MSG_TYPE_HEATMAP || r.sequence != sequence) return false;
+
+  while (tlvNext(r, tag, value, length)) {
+    int idx = 0;
+    if (tag == TLV_STATUS && length == 1) {
+      d.status = value[0];
+    } else if (tag == TLV_HEATMAP_INFO && length == 20) {
+      d.hasInfo = true;
+      d.columns = value[idx++];
+      d.rows = value[idx++];
+      d.bounds.left = readFloat(value, idx);
+      d.bounds.right = readFloat(value, idx);
+      d.bounds.bottom = readFloat(value, idx);
+      d.bounds.top = readFloat(value, idx);
+      d.spacingBins = value[idx++];
+      d.spacingBinWidth = value[idx++];
+    } else if (tag == TLV_HEATMAP_DATA && length >= 9) {
+      d.hasData = true;
+      d.grid = value[idx++];
+      d.frame = readBig(value, idx, 4);
+      d.size = readBig(value, idx, 2);
+      d.offset = readBig(value, idx, 2);
+      d.count = length - idx;
+      d.bytes = value + idx;
+    }
+  }
+  return true;
+}
+
+//**********************************************************************
+//*                              Fetch
+//**********************************************************************
+//Where requests go: the board over UDP, or for the check a board simulated in this process
+struct SimBoard;
+typedef struct {
+  int fd;
+  sockaddr_in addr;
+  SimBoard* sim;
+} Link;
+
+int simReply(SimBoard& sim, const uint8_t* request, int size, uint8_t* reply, int capacity);
+
+//Sends a request and returns the size of the reply to it, 0 if none came
+int exchange(Link& link, const uint8_t* request, int size, uint8_t* reply, int capacity) {
+  if (link.sim != NULL) return simReply(*link.sim, request, size, reply, capacity);
+
+  uint16_t sequence = request[4] << 8 | request[5];
+  for (int attempt = 0; attempt < FETCH_ATTEMPTS; attempt++) {
+    sendto(link.fd, request, size, 0, (sockaddr*)&link.addr, sizeof(link.addr));
+
+    pollfd pfd = { link.fd, POLLIN, 0 };
+    while (poll(&pfd, 1, 1000) > 0) {
+      int received = recv(link.fd, reply, capacity, 0);
+      if (received >= UDP_BINARY_HEADER_SIZE && (reply[4] << 8 | reply[5]) == sequence) return received;
+    }
+  }
+  return 0;
+}
+
+//Pages one grid in from its start. If the board encodes it afresh in between, for another host or a grid
+//read during a game, the pages no longer line up and it is read again
+bool fetchGrid(Link& link, uint16_t& sequence, uint8_t grid, uint16_t* cells, int cellCount, DecodedHeatmaps& d,
+  uint32_t& frame) {
+  static uint8_t encoded[HEATMAP_ENCODED_MAX(HEATMAP_CELLS)];
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  uint8_t reply[UDP_BINARY_MAX_PACKET_SIZE];
+
+  for (int attempt = 0; attempt < FETCH_ATTEMPTS; attempt++) {
+    int received = 0;
+    int size = -1;
+    bool lined = true;
+    while (lined && (size < 0 || received < size)) {
+      TlvWriter w;
+      tlvBegin(w, packet, sizeof(packet), MSG_TYPE_HEATMAP, sequence);
+      uint8_t select[3] = { grid, (uint8_t)(received >> 8), (uint8_t)received };
+      tlvAppend(w, TLV_HEATMAP_SELECT, select, sizeof(select));
+
+      DecodedPage page;
+      int replySize = exchange(link, packet, w.size, reply, sizeof(reply));
+      if (replySize <= 0 || !decodePage(reply, replySize, sequence++, page)) {
+        fprintf(stderr, "No reply to the request for grid %u\n", grid);
+        return false;
+      }
+      if (page.status != STATUS_OK || !page.hasInfo || !page.hasData || page.grid != grid) {
+        fprintf(stderr, "Request for grid %u refused with status %u\n", grid, page.status);
+        return false;
+      }
+      if (page.columns != HEATMAP_COLUMNS || page.rows != HEATMAP_ROWS || page.spacingBins != SPACING_BINS) {
+        fprintf(stderr, "Heatmaps are %dx%d, this decoder was built for %dx%d\n", page.columns, page.rows,
+          HEATMAP_COLUMNS, HEATMAP_ROWS);
+        return false;
+      }
+
+      if (size < 0) {
+        size = page.size;
+        frame = page.frame;
+        if (size > (int)sizeof(encoded)) return false;
+      }
+      lined = page.size == size && page.frame == frame && page.offset == received;
+      if (!lined) continue;
+      if (page.count == 0 && received < size) return false;
+
+      memcpy(encoded + received, page.bytes, page.count);
+      received += page.count;
+      d.bounds = page.bounds;
+      d.columns = page.columns;
+      d.rows = page.rows;
+      d.spacingBinWidth = page.spacingBinWidth;
+    }
+    if (lined) return heatmapDecode(encoded, size, cells, cellCount);
+  }
+
+  fprintf(stderr, "Grid %u kept changing while it was read\n", grid);
+  return false;
+}
+
+bool fetchHeatmaps(Link& link, DecodedHeatmaps& d) {
+  static uint16_t sequence = 1;
+  uint32_t frame;
+  if (!fetchGrid(link, sequence, HEATMAP_GRID_SPACING, d.spacing, SPACING_BINS, d, d.frame)) return false;
+  for (d.playerCount = 0; d.playerCount < PLAYER_COUNT; d.playerCount++) {
+    if (!fetchGrid(link, sequence, d.playerCount + 1, d.cells[d.playerCount], HEATMAP_CELLS, d, frame)) return false;
+  }
+  return true;
+}
+
+//**********************************************************************
+//*                              Output
+//**********************************************************************
+//Shades by the share of the busiest cell on a square root scale, so the little visited cells still show
+void printGrid(const uint16_t* cells, int columns, int rows) {
+  static const char shades[] = " .:-=+*#%@";
+  uint16_t most = 1;
+  for (int i = 0; i < columns * rows; i++) if (cells[i] > most) most = cells[i];
+
+  printf("+%.*s+\n", columns, "----------------------------------------------------------------");
+  for (int row = rows - 1; row >= 0; row--) {
+    putchar('|');
+    for (int column = 0; column < columns; column++) {
+      uint16_t value = cells[row * columns + column];
+      int shade = value == 0 ? 0 : 1 + (int)(sqrt((double)value / most) * (sizeof(shades) - 3) + 0.5);
+      putchar(shades[shade]);
+    }
+    printf("|\n");
+  }
+  printf("+%.*s+\n", columns, "----------------------------------------------------------------");
+}
+
+void printHeatmaps(const DecodedHeatmaps& d, bool csv) {
+  if (csv) {
+    for (int i = 0; i < SPACING_BINS; i++) printf("0,0,%d,%u\n", i, d.spacing[i]);
+    for (int p = 0; p < d.playerCount; p++) {
+      for (int i = 0; i < HEATMAP_CELLS; i++) {
+        printf("%d,%d,%d,%u\n", p + 1, i / HEATMAP_COLUMNS, i % HEATMAP_COLUMNS, d.cells[p][i]);
+      }
+    }
+    return;
+  }
+
+  printf("Frame %u, x %.1f to %.1f, y %.1f to %.1f\n", d.frame, d.bounds.left, d.bounds.right, d.bounds.bottom,
+    d.bounds.top);
+  for (int p = 0; p < d.playerCount; p++) {
+    uint32_t frames = 0;
+    for (int i = 0; i < HEATMAP_CELLS; i++) frames += d.cells[p][i];
+    printf("Player %d, %u frames\n", p + 1, frames);
+    printGrid(d.cells[p], HEATMAP_COLUMNS, HEATMAP_ROWS);
+  }
+
+  uint32_t frames = 0;
+  uint16_t most = 1;
+  for (int i = 0; i < SPACING_BINS; i++) {
+    frames += d.spacing[i];
+    if (d.spacing[i] > most) most = d.spacing[i];
+  }
+  printf("Horizontal spacing\n");
+  for (int i = 0; i < SPACING_BINS; i++) {
+    if (d.spacing[i] == 0) continue;
+    int width = d.spacing[i] * 50 / most;
+    printf("  %3d%s %5.1f%% %.*s\n", i * d.spacingBinWidth, i == SPACING_BINS - 1 ? "+" : " ",
+      100.0 * d.spacing[i] / frames, width, "##################################################");
+  }
+}
+
+//**********************************************************************
+//*                                Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+//Answers MSG_TYPE_HEATMAP the way handleBinaryPacket() does. Before the interleaveAt-th request, and every
+//interleaveEvery-th, a query for another grid from some other host comes in first
+struct SimBoard {
+  StageHeatmaps* heatmaps;
+  HeatmapPages pages;
+  uint32_t frame;
+  int requests;
+  int interleaveAt;
+  int interleaveEvery;
+  int largest;
+};
+
+void simAnswer(SimBoard& sim, const uint8_t* request, int size, TlvWriter& w) {
+  TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!tlvOpen(r, request, size)) return;
+  tlvBegin(w, w.buffer, w.capacity, r.type, r.sequence);
+
+  uint8_t grid = HEATMAP_GRID_SPACING;
+  uint16_t offset = 0;
+  while (tlvNext(r, tag, value, length)) {
+    if (tag == TLV_HEATMAP_SELECT && length == 3) {
+      grid = value[0];
+      offset = tlvHalf(value + 1);
+    }
+  }
+  if (grid > PLAYER_COUNT) {
+    tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
+    return;
+  }
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  heatmapAppend(w, *sim.heatmaps, sim.pages, grid, offset, sim.frame);
+}
+
+int simReply(SimBoard& sim, const uint8_t* request, int size, uint8_t* reply, int capacity) {
+  TlvWriter w = { reply, capacity, 0 };
+  sim.requests++;
+  if (sim.requests == sim.interleaveAt || (sim.interleaveEvery > 0 && sim.requests % sim.interleaveEvery == 0)) {
+    uint8_t other[16];
+    TlvWriter o;
+    tlvBegin(o, other, sizeof(other), MSG_TYPE_HEATMAP, 0);
+    uint8_t select[3] = { (uint8_t)(request[8] == HEATMAP_GRID_SPACING ? 1 : HEATMAP_GRID_SPACING), 0, 0 };
+    tlvAppend(o, TLV_HEATMAP_SELECT, select, sizeof(select));
+    sim.frame++;
+    simAnswer(sim, other, o.size, w);
+  }
+
+  simAnswer(sim, request, size, w);
+  if (w.size > sim.largest) sim.largest = w.size;
+  return w.size;
+}
+
+//Players walk around the stage and jump now and then, with missed updates every so often
+int playGame(StageHeatmaps& h, uint16_t stage, int frames, uint32_t seed) {
+  static Player players[PLAYER_COUNT];
+  heatmapReset(h, stage);
+  float x[PLAYER_COUNT] = { -40, 40 };
+  float y[PLAYER_COUNT] = { 0, 0 };
+  uint32_t rng = seed;
+  int counted = 0;
+  for (int i = 0; i < PLAYER_COUNT; i++) players[i] = Player();
+
+  for (int n = 0; n < frames; ) {
+    rng = rng * 1103515245 + 12345;
+    uint32_t frameDelta = (rng & 0xFF) == 0 ? 2 : 1;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      rng = rng * 1103515245 + 12345;
+      x[i] += ((rng >> 8) & 0xFF) / 64.0f - 2;
+      y[i] = (rng >> 20) % 7 == 0 ? y[i] + 3 : y[i] > 0 ? y[i] - 1 : 0;
+      if (x[i] < -150 || x[i] > 150) x[i] *= 0.5f;
+      frameHistoryAdvance(players[i]);
+      currentFrame(players[i]).locationX = x[i];
+      currentFrame(players[i]).locationY = y[i];
+    }
+    heatmapAdd(h, players, frameDelta);
+    n += frameDelta;
+    counted += frameDelta;
+  }
+  return counted;
+}
+
+int runCheck() {
+  bool ok = true;
+  printf("Checking stage heatmaps\n");
+
+  static StageHeatmaps h;
+  int frames = playGame(h, STAGE_BATTLEFIELD, 28800, 0xBEEF);
+  uint32_t sums[PLAYER_COUNT + 1] = { };
+  for (int i = 0; i < PLAYER_COUNT; i++) for (int c = 0; c < HEATMAP_CELLS; c++) sums[i] += h.cells[i][c];
+  for (int b = 0; b < SPACING_BINS; b++) sums[PLAYER_COUNT] += h.spacing[b];
+  ok &= expect(sums[0] == (uint32_t)frames && sums[1] == (uint32_t)frames && sums[2] == (uint32_t)frames,
+    "every grid counts every frame, missed ones included");
+
+  //Read back through the same requests and responses a board answers
+  static SimBoard sim = { &h };
+  sim.frame = frames;
+  Link link = { -1, { }, &sim };
+  static DecodedHeatmaps d;
+  bool fetched = fetchHeatmaps(link, d);
+  ok &= expect(fetched && d.playerCount == PLAYER_COUNT && d.frame == (uint32_t)frames, "every grid is read back");
+  ok &= expect(fetched && memcmp(d.cells, h.cells, sizeof(h.cells)) == 0 && memcmp(d.spacing, h.spacing,
+    sizeof(h.spacing)) == 0, "decoded counts match the board's");
+  ok &= expect(fetched && d.bounds.left == h.bounds.left && d.bounds.top == h.bounds.top &&
+    d.spacingBinWidth == SPACING_BIN_WIDTH, "bounds and bin width survive");
+  printf("  %d responses, largest %d of %d bytes, %d raw, %d as per frame positions\n", sim.requests, sim.largest,
+    UDP_BINARY_MAX_PACKET_SIZE, (int)(sizeof(h.cells) + sizeof(h.spacing)), frames * PLAYER_COUNT * 8);
+
+  uint8_t request[16], reply[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  tlvBegin(w, request, sizeof(request), MSG_TYPE_HEATMAP, 3);
+  uint8_t select[3] = { PLAYER_COUNT + 1, 0, 0 };
+  tlvAppend(w, TLV_HEATMAP_SELECT, select, sizeof(select));
+  DecodedPage page;
+  int size = exchange(link, request, w.size, reply, sizeof(reply));
+  ok &= expect(decodePage(reply, size, 3, page) && page.status == STATUS_MALFORMED && !page.hasData,
+    "a grid past the players is refused");
+
+  //Positions on the blast zones, past them and not numbers at all land in the edge cells
+  Player edge[PLAYER_COUNT] = { };
+  heatmapReset(h, STAGE_FD);
+  currentFrame(edge[0]).locationX = -1000;
+  currentFrame(edge[0]).locationY = 1000;
+  currentFrame(edge[1]).locationX = NAN;
+  currentFrame(edge[1]).locationY = -246;
+  heatmapAdd(h, edge, 1);
+  ok &= expect(h.cells[0][(HEATMAP_ROWS - 1) * HEATMAP_COLUMNS] == 1 && h.cells[1][0] == 1 && h.spacing[0] == 1,
+    "out of bounds positions clamp to the edge cells");
+
+  currentFrame(edge[1]).locationX = 1000;
+  for (int i = 0; i < 40000; i++) heatmapAdd(h, edge, 2);
+  ok &= expect(h.cells[0][(HEATMAP_ROWS - 1) * HEATMAP_COLUMNS] == 0xFFFF && h.spacing[SPACING_BINS - 1] == 0xFFFF,
+    "cells saturate");
+
+  //The worst case is every cell needing a 3 byte varint
+  static uint16_t worst[HEATMAP_CELLS], back[HEATMAP_CELLS];
+  static uint8_t encoded[HEATMAP_ENCODED_MAX(HEATMAP_CELLS)];
+  for (int i = 0; i < HEATMAP_CELLS; i++) worst[i] = 0xC000 + i;
+  size = heatmapEncode(worst, HEATMAP_CELLS, encoded, sizeof(encoded));
+  ok &= expect(size == (int)sizeof(encoded) && heatmapDecode(encoded, size, back, HEATMAP_CELLS) &&
+    memcmp(worst, back, sizeof(worst)) == 0, "the worst case fits HEATMAP_ENCODED_MAX");
+  memcpy(h.cells[1], worst, sizeof(worst));
+  sim.requests = 0;
+  fetched = fetchHeatmaps(link, d);
+  ok &= expect(fetched && memcmp(d.cells[1], worst, sizeof(worst)) == 0 && size < 0x10000,
+    "the worst case pages through");
+  printf("  the worst case takes %d responses\n", sim.requests);
+
+  //Another host reading another grid in between makes the board encode it afresh
+  sim.requests = 0;
+  sim.interleaveAt = 10;
+  memset(&d, 0, sizeof(d));
+  fetched = fetchHeatmaps(link, d);
+  ok &= expect(fetched && memcmp(d.cells, h.cells, sizeof(h.cells)) == 0 && memcmp(d.spacing, h.spacing,
+    sizeof(h.spacing)) == 0, "a grid encoded again mid read is read again");
+  sim.requests = 0;
+  sim.interleaveAt = 0;
+  sim.interleaveEvery = 5;
+  ok &= expect(!fetchHeatmaps(link, d), "a grid that never holds still is given up on");
+  sim.interleaveEvery = 0;
+  for (int i = 0; i < HEATMAP_CELLS; i++) worst[i] = i % 3 == 0 ? 0 : i;
+  size = heatmapEncode(worst, HEATMAP_CELLS, encoded, sizeof(encoded));
+  ok &= expect(size > 0 && heatmapDecode(encoded, size, back, HEATMAP_CELLS) && memcmp(worst, back, sizeof(worst)) == 0,
+    "alternating empty and counted cells round trip");
+  ok &= expect(heatmapEncode(worst, HEATMAP_CELLS, encoded, size - 1) == -1, "a short buffer is refused");
+
+  ok &= expect(!heatmapDecode(encoded, size - 1, back, HEATMAP_CELLS), "a truncated grid is rejected");
+  uint8_t overrun[] = { 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F,
+    0x7F, 0x7F };
+  ok &= expect(!heatmapDecode(overrun, sizeof(overrun), back, HEATMAP_CELLS), "too many cells are rejected");
+  uint8_t wide[] = { 0x80, 0xFF, 0xFF, 0x7F };
+  ok &= expect(!heatmapDecode(wide, sizeof(wide), back, 1), "a count over 16 bits is rejected");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  const char* deviceIp = NULL;
+  bool csv = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:sc")) != -1) {
+    switch (opt) {
+      case 'd': deviceIp = optarg; break;
+      case 's': csv = true; break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s -d deviceIp [-s] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!deviceIp) {
+    fprintf(stderr, "Usage: %s -d deviceIp [-s] | -c\n", argv[0]);
+    return 1;
+  }
+
+  Link link = { socket(AF_INET, SOCK_DGRAM, 0), { }, NULL };
+  link.addr.sin_family = AF_INET;
+  link.addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &link.addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(link.fd);
+    return 1;
+  }
+
+  static DecodedHeatmaps d;
+  bool fetched = fetchHeatmaps(link, d);
+  close(link.fd);
+  if (!fetched) return 1;
+  printHeatmaps(d, csv);
+  return 0;
+}
@@ -0,0 +1,194 @@
+//LatencySim - runs the board's frame latency accounting (latency.h) on the host. Frames from a
+//synthetic console arrive on a simulated 120MHz cycle counter with configurable jitter and slowdowns,
+//the decode, stats and telemetry stages are the real code timed on the host, and the report is the
+//same text the board prints at the end of a game. Stamps can be written out and replayed so a trace
+//captured from a board gives the same numbers on the host.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing LatencySim.cpp -o LatencySim
+//Usage: LatencySim [-f frames] [-j jitterUs] [-s slowdownEvery] [-n decimation] [-o traceOut] [-i traceIn]
+//  Trace lines are "arrival decoded computed emitted" in cycles, or "G" at the start of a game
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/synthgame.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/telemetry.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/latency.h"
+
+#define CYCLES_PER_US 120 //TM4C1294 at F_CPU
+#define TRACE_GAME_START "G"
+
+//**********************************************************************
+//*                          Simulated Clock
+//**********************************************************************
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//Converts host time spent in a stage to cycles on the simulated counter
+uint32_t cyclesSince(uint64_t startNs) {
+  return (uint32_t)((hostNs() - startNs) * CYCLES_PER_US / 1000);
+}
+
+void writeStamp(FILE* trace, const FrameTiming& t) {
+  if (trace) fprintf(trace, "%u %u %u %u\n", t.arrival, t.decoded, t.computed, t.emitted);
+}
+
+//**********************************************************************
+//*                             Simulation
+//**********************************************************************
+void simulate(LatencyStats& ls, int frames, int jitterUs, int slowdownEvery, int decimation, FILE* trace) {
+  uint32_t rng = 0x1234567;
+  static Game console, board;
+  static uint8_t arenaMemory[GAME_ARENA_SIZE];
+  static GameArena arena;
+  arenaInit(arena, arenaMemory, sizeof(arenaMemory));
+  board.arena = &arena;
+  synthesizeGameStart(console, rng);
+
+  uint8_t payload[MSG_BUFFER_SIZE];
+  encodeGameStart(payload, console);
+  decodeGameStart(board, payload);
+  latencyGameStart(ls);
+  if (trace) fprintf(trace, TRACE_GAME_START "\n");
+
+  //Telemetry goes to a loopback port nobody listens on, the send still goes through the whole stack
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(TELEMETRY_PORT + 100);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  uint8_t datagram[TELEMETRY_MAX_PACKET_SIZE];
+
+  //Start a few seconds before the 32 bit counter wraps so the wrap is always exercised
+  uint64_t consoleUs = 0;
+  uint32_t base = 0xFFFFFFFFu - 5u * 1000000u * CYCLES_PER_US;
+
+  for (int frame = 1; frame <= frames; frame++) {
+    consoleUs += LATENCY_NOMINAL_FRAME_US;
+    if (slowdownEvery > 0 && frame % slowdownEvery == 0) consoleUs += LATENCY_NOMINAL_FRAME_US;
+
+    int jitter = jitterUs > 0 ? (int)(nextRandom(rng) % (2 * jitterUs + 1)) - jitterUs : 0;
+
+    synthesizeUpdate(console, rng, frame);
+    encodeUpdate(payload, console);
+
+    FrameTiming t = { };
+    t.arrival = base + (uint32_t)((consoleUs + jitter) * CYCLES_PER_US);
+
+    uint64_t start = hostNs();
+    decodeUpdate(board, payload);
+    t.decoded = t.arrival + cyclesSince(start);
+
+    start = hostNs();
+    computeGameStatistics(board);
+    t.computed = t.decoded + cyclesSince(start);
+
+    if (frame % decimation == 0) {
+      start = hostNs();
+      TelemetryFrame tf = { };
+      tf.sequence = frame;
+      tf.frame = board.frameCounter;
+      tf.playerCount = PLAYER_COUNT;
+      for (int i = 0; i < PLAYER_COUNT; i++) {
+        tf.players[i].locationX = board.players[i].currentFrameData.locationX;
+        tf.players[i].percent = board.players[i].currentFrameData.percent;
+      }
+      int size = telemetryEncode(datagram, sizeof(datagram), tf);
+      sendto(fd, datagram, size, 0, (sockaddr*)&addr, sizeof(addr));
+      t.emitted = t.computed + cyclesSince(start);
+      if (t.emitted == 0) t.emitted = 1; //0 means not sent
+    }
+
+    latencyRecord(ls, t);
+    writeStamp(trace, t);
+  }
+
+  close(fd);
+}
+
+//Returns false if the trace could not be read
+bool replay(LatencyStats& ls, const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    if (strncmp(line, TRACE_GAME_START, 1) == 0) {
+      latencyGameStart(ls);
+      continue;
+    }
+
+    FrameTiming t;
+    if (sscanf(line, "%u %u %u %u", &t.arrival, &t.decoded, &t.computed, &t.emitted) == 4) latencyRecord(ls, t);
+  }
+
+  fclose(f);
+  return true;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  int frames = 3600;
+  int jitterUs = 200;
+  int slowdownEvery = 0;
+  int decimation = 1;
+  const char* tracePath = NULL;
+  const char* replayPath = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:j:s:n:o:i:")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'j': jitterUs = atoi(optarg); break;
+      case 's': slowdownEvery = atoi(optarg); break;
+      case 'n': decimation = atoi(optarg); break;
+      case 'o': tracePath = optarg; break;
+      case 'i': replayPath = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-j jitterUs] [-s slowdownEvery] [-n decimation] [-o traceOut] [-i traceIn]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (decimation < 1) decimation = 1;
+
+  asmEventsInitialize();
+
+  LatencyStats* ls = new LatencyStats();
+  latencyReset(*ls, CYCLES_PER_US);
+
+  if (replayPath) {
+    if (!replay(*ls, replayPath)) {
+      fprintf(stderr, "Failed to read trace %s\n", replayPath);
+      return 1;
+    }
+  } else {
+    FILE* trace = NULL;
+    if (tracePath && !(trace = fopen(tracePath, "w"))) {
+      fprintf(stderr, "Failed to open trace %s\n", tracePath);
+      return 1;
+    }
+
+    simulate(*ls, frames, jitterUs, slowdownEvery, decimation, trace);
+    if (trace) fclose(trace);
+  }
+
+  char report[512];
+  latencyFormatReport(report, sizeof(report), *ls);
+  fputs(report, stdout);
+
+  delete ls;
+  return 0;
+}
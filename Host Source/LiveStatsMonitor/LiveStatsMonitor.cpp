@@ -0,0 +1,369 @@
+//LiveStatsMonitor - reads the live stats snapshots EnhMelee1294Firmware publishes during a game. It either
+//queries the latest snapshot every second or asks the board to push every snapshot as it is published.
+//Each snapshot comes in two datagrams, the players and stocks and the techniques, see livestats.h.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings LiveStatsMonitor.cpp -o LiveStatsMonitor
+//Usage: LiveStatsMonitor -d deviceIp [-i interval] [-s] | -c
+//  -i sets the frames between snapshots on the board, 0 stops them
+//  -s asks the board to push snapshots instead of polling for them
+//  -c checks publishing and encoding against the firmware headers and exits, non-zero on failure
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/livestats.h"
+
+#define CONFIG_PORT 3637
+
+//**********************************************************************
+//*                          Snapshot Decode
+//**********************************************************************
+typedef struct {
+  uint8_t port;
+  uint8_t stocks;
+  float percent;
+  uint16_t actions;
+  uint16_t openings;
+  uint16_t recoveryAttempts;
+  uint16_t successfulRecoveries;
+  uint32_t framesInShield;
+  float averageDamagePerString;
+  float mostDamageString;
+} DecodedPlayer;
+
+typedef struct {
+  uint8_t port;
+  uint16_t techMisses;
+  uint16_t techsLeft;
+  uint16_t techsRight;
+  uint16_t techsInPlace;
+  uint16_t wavedashes;
+  uint16_t lCancels;
+  uint16_t lCancelMisses;
+  uint16_t ledgedashes;
+  uint16_t shieldDrops;
+} DecodedTechs;
+
+typedef struct {
+  bool valid;
+  uint16_t interval;
+  uint32_t sequence;
+  uint32_t frame;
+  uint32_t framesMissed;
+  uint8_t part;
+  int playerCount;
+  DecodedPlayer players[PLAYER_COUNT];
+  int stockCount;
+  int techCount;
+  DecodedTechs techs[PLAYER_COUNT];
+} DecodedSnapshot;
+
+uint32_t readBig(const uint8_t* value, int& idx, int bytes) {
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) result = (result << 8) | value[idx++];
+  return result;
+}
+
+float readFloat(const uint8_t* value, int& idx) {
+  uint32_t bits = readBig(value, idx, 4);
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+bool decodeSnapshot(const uint8_t* packet, int size, DecodedSnapshot& s) {
+  memset(&s, 0, sizeof(s));
+
+  TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!tlvOpen(r, packet, size) || r.type != MSG_TYPE_LIVE_STATS) return false;
+
+  while (tlvNext(r, tag, value, length)) {
+    int idx = 0;
+    if (tag == TLV_LIVE_INTERVAL && length == 2) {
+      s.interval = tlvHalf(value);
+    } else if (tag == TLV_LIVE_SNAPSHOT && length == 12) {
+      s.valid = true;
+      s.sequence = readBig(value, idx, 4);
+      s.frame = readBig(value, idx, 4);
+      s.framesMissed = readBig(value, idx, 4);
+    } else if (tag == TLV_LIVE_PART && length == 1) {
+      s.part = value[0];
+    } else if (tag == TLV_LIVE_TECHS && length == 19 && s.techCount < PLAYER_COUNT) {
+      DecodedTechs& t = s.techs[s.techCount++];
+      t.port = value[idx++];
+      t.techMisses = readBig(value, idx, 2);
+      t.techsLeft = readBig(value, idx, 2);
+      t.techsRight = readBig(value, idx, 2);
+      t.techsInPlace = readBig(value, idx, 2);
+      t.wavedashes = readBig(value, idx, 2);
+      t.lCancels = readBig(value, idx, 2);
+      t.lCancelMisses = readBig(value, idx, 2);
+      t.ledgedashes = readBig(value, idx, 2);
+      t.shieldDrops = readBig(value, idx, 2);
+    } else if (tag == TLV_LIVE_PLAYER && length == 32 && s.playerCount < PLAYER_COUNT) {
+      DecodedPlayer& p = s.players[s.playerCount++];
+      p.port = value[idx++];
+      p.stocks = value[idx++];
+      p.percent = readFloat(value, idx);
+      p.actions = readBig(value, idx, 2);
+      p.openings = readBig(value, idx, 2);
+      p.recoveryAttempts = readBig(value, idx, 2);
+      p.successfulRecoveries = readBig(value, idx, 2);
+      p.framesInShield = readBig(value, idx, 4);
+      idx += 6; //Rolls, spot dodges and air dodges
+      p.averageDamagePerString = readFloat(value, idx);
+      p.mostDamageString = readFloat(value, idx);
+    } else if (tag == TLV_LIVE_STOCK) {
+      s.stockCount++;
+    }
+  }
+
+  return true;
+}
+
+void printSnapshot(const DecodedSnapshot& s) {
+  if (!s.valid) {
+    printf("No snapshot yet (interval %u frames)\n", s.interval);
+    return;
+  }
+
+  printf("seq %5u frame %6u missed %3u", s.sequence, s.frame, s.framesMissed);
+  if (s.part == LIVE_PART_TECHNIQUES) {
+    for (int i = 0; i < s.techCount; i++) {
+      const DecodedTechs& t = s.techs[i];
+      printf(" | P%u techs %u/%u/%u missed %u wavedashes %u L-cancels %u/%u ledgedashes %u shield drops %u", t.port,
+        t.techsLeft, t.techsRight, t.techsInPlace, t.techMisses, t.wavedashes, t.lCancels, t.lCancels + t.lCancelMisses,
+        t.ledgedashes, t.shieldDrops);
+    }
+    printf("\n");
+    return;
+  }
+
+  for (int i = 0; i < s.playerCount; i++) {
+    const DecodedPlayer& p = s.players[i];
+    float minutes = s.frame / 3600.0f;
+    printf(" | P%u %u stocks %5.1f%% apm %5.1f openings %3u recovered %u/%u", p.port, p.stocks, p.percent,
+      minutes > 0 ? p.actions / minutes : 0, p.openings, p.successfulRecoveries, p.recoveryAttempts);
+  }
+  printf("\n");
+}
+
+//**********************************************************************
+//*                             Self Check
+//**********************************************************************
+void fillGame(Game& game, uint32_t frame) {
+  game.frameCounter = frame;
+  game.framesMissed = frame / 1000;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& p = game.players[i];
+    p.controllerPort = i * 2;
+    currentFrame(p).stocks = 4 - frame / 2000;
+    currentFrame(p).percent = (frame % 700) * 0.25f + i;
+    p.stats.actionCount = frame / 10 + i;
+    p.stats.numberOfOpenings = frame / 300;
+    p.stats.recoveryAttempts = frame / 900;
+    p.stats.successfulRecoveries = frame / 1800;
+    p.stats.framesInShield = frame / 7;
+    p.stats.averageDamagePerString = 18.5f + i;
+    p.stats.mostDamageString = 60 + i;
+    p.stats.techMissCount = frame / 1100;
+    p.stats.techLeftCount = frame / 1300 + i;
+    p.stats.techRightCount = frame / 1500;
+    p.stats.techPlaceCount = frame / 1700;
+    p.stats.wavedashCount = frame / 120;
+    p.stats.lCancelCount = frame / 25 + i; //Past 255 by the end of the check
+    p.stats.lCancelMissCount = frame / 200;
+    p.stats.ledgedashCount = frame / 2500;
+    p.stats.shieldDropCount = frame / 400;
+    for (int j = 0; j < STOCK_COUNT; j++) p.stats.stocks[j].isStockUsed = j <= (int)(frame / 2000);
+  }
+}
+
+int runCheck() {
+  static LiveStats ls;
+  Game game = { };
+  int failures = 0;
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  DecodedSnapshot s;
+
+  liveStatsInitialize(ls);
+
+  //Nothing to read before the first snapshot
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_LIVE_STATS, 0);
+  if (liveStatsAppend(w, ls, LIVE_PART_PLAYERS) || w.size != UDP_BINARY_HEADER_SIZE) {
+    fprintf(stderr, "A snapshot was read before one was published\n");
+    failures++;
+  }
+
+  //Only every interval frames is published
+  int published = 0;
+  for (uint32_t frame = 1; frame <= 6000; frame++) {
+    fillGame(game, frame);
+    if (liveStatsPublish(ls, game, false)) published++;
+  }
+  if (published != 6000 / LIVE_STATS_DEFAULT_INTERVAL || ls.sequence != (uint32_t)published) {
+    fprintf(stderr, "Published %d snapshots, expected %d\n", published, 6000 / LIVE_STATS_DEFAULT_INTERVAL);
+    failures++;
+  }
+
+  //The latest snapshot round trips. Every stock has been played by frame 6000, so this is also the
+  //largest a response gets
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_LIVE_STATS, 0);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppendHalf(w, TLV_LIVE_INTERVAL, ls.interval);
+  if (!liveStatsAppend(w, ls, LIVE_PART_PLAYERS) || !decodeSnapshot(packet, w.size, s) || !s.valid) {
+    fprintf(stderr, "Latest snapshot did not fit in a response\n");
+    failures++;
+  } else {
+    if (s.sequence != ls.sequence || s.frame != 6000 || s.framesMissed != 6 || s.playerCount != PLAYER_COUNT ||
+      s.stockCount != PLAYER_COUNT * STOCK_COUNT) {
+      fprintf(stderr, "Snapshot header or counts do not round trip\n");
+      failures++;
+    }
+    for (int i = 0; i < s.playerCount; i++) {
+      const Player& p = game.players[i];
+      const DecodedPlayer& d = s.players[i];
+      if (d.port != p.controllerPort + 1 || d.stocks != currentFrame(p).stocks ||
+        d.percent != currentFrame(p).percent || d.actions != p.stats.actionCount ||
+        d.framesInShield != p.stats.framesInShield || d.mostDamageString != p.stats.mostDamageString) {
+        fprintf(stderr, "Player %d does not round trip\n", i + 1);
+        failures++;
+      }
+    }
+  }
+  printf("Largest players response: %d of %d bytes\n", w.size, UDP_BINARY_MAX_PACKET_SIZE);
+
+  //The techniques part of the same snapshot carries its sequence and every player's counts
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_LIVE_STATS, 0);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppendHalf(w, TLV_LIVE_INTERVAL, ls.interval);
+  if (!liveStatsAppend(w, ls, LIVE_PART_TECHNIQUES) || !decodeSnapshot(packet, w.size, s) || !s.valid) {
+    fprintf(stderr, "Techniques part did not fit in a response\n");
+    failures++;
+  } else {
+    if (s.sequence != ls.sequence || s.part != LIVE_PART_TECHNIQUES || s.techCount != PLAYER_COUNT || s.playerCount != 0) {
+      fprintf(stderr, "Techniques part header or counts do not round trip\n");
+      failures++;
+    }
+    for (int i = 0; i < s.techCount; i++) {
+      const Player& p = game.players[i];
+      const DecodedTechs& t = s.techs[i];
+      const PlayerStatistics& ps = p.stats;
+      if (t.port != p.controllerPort + 1 || t.techMisses != ps.techMissCount || t.techsLeft != ps.techLeftCount ||
+        t.techsRight != ps.techRightCount || t.techsInPlace != ps.techPlaceCount || t.wavedashes != ps.wavedashCount ||
+        t.lCancels != ps.lCancelCount || t.lCancelMisses != ps.lCancelMissCount || t.ledgedashes != ps.ledgedashCount ||
+        t.shieldDrops != ps.shieldDropCount) {
+        fprintf(stderr, "Techniques of player %d do not round trip\n", i + 1);
+        failures++;
+      }
+    }
+  }
+  printf("Techniques response: %d of %d bytes\n", w.size, UDP_BINARY_MAX_PACKET_SIZE);
+
+  //A publish never writes the buffer a reader may be in. Publishing the next snapshot leaves the
+  //latest one untouched, only the one after that reuses it, and by then the sequence has moved twice
+  uint32_t sequence = ls.sequence;
+  LiveStatsSnapshot reading = ls.buffers[sequence & 1];
+  fillGame(game, 6001);
+  liveStatsPublish(ls, game, true);
+  if (memcmp(&reading, &ls.buffers[sequence & 1], sizeof(reading)) != 0) {
+    fprintf(stderr, "Publishing wrote into the buffer being read\n");
+    failures++;
+  }
+  if (ls.buffers[ls.sequence & 1].frame != 6001) {
+    fprintf(stderr, "Forced publish did not become the latest snapshot\n");
+    failures++;
+  }
+
+  //Interval 0 stops publishing but force still goes through, as at the end of a game
+  ls.interval = 0;
+  sequence = ls.sequence;
+  fillGame(game, 6060);
+  if (liveStatsPublish(ls, game, false) || ls.sequence != sequence || !liveStatsPublish(ls, game, true)) {
+    fprintf(stderr, "Interval 0 or force was not respected\n");
+    failures++;
+  }
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  const char* deviceIp = NULL;
+  int interval = -1;
+  bool push = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:i:sc")) != -1) {
+    switch (opt) {
+      case 'd': deviceIp = optarg; break;
+      case 'i': interval = atoi(optarg); break;
+      case 's': push = true; break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s -d deviceIp [-i interval] [-s] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!deviceIp) {
+    fprintf(stderr, "Usage: %s -d deviceIp [-i interval] [-s] | -c\n", argv[0]);
+    return 1;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(fd);
+    return 1;
+  }
+
+  uint16_t sequence = 1;
+  bool requestSent = false;
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  while (true) {
+    //The settings go out with the first query, after that a push only needs to be listened for. A poll
+    //asks for every part of the snapshot
+    if (!push || !requestSent) {
+      for (int part = 0; part < (push ? 1 : LIVE_PART_COUNT); part++) {
+        TlvWriter w;
+        tlvBegin(w, packet, sizeof(packet), MSG_TYPE_LIVE_STATS, sequence++);
+        if (!requestSent && interval >= 0) tlvAppendHalf(w, TLV_LIVE_INTERVAL, interval);
+        if (!requestSent && push) tlvAppendByte(w, TLV_LIVE_PUSH, 1);
+        tlvAppendByte(w, TLV_LIVE_PART, part);
+        sendto(fd, w.buffer, w.size, 0, (sockaddr*)&addr, sizeof(addr));
+        requestSent = true;
+      }
+    }
+
+    pollfd pfd = { fd, POLLIN, 0 };
+    int replies = 0;
+    while (poll(&pfd, 1, replies == 0 ? 1000 : 50) > 0) {
+      int size = recv(fd, packet, sizeof(packet), 0);
+      DecodedSnapshot s;
+      if (size > 0 && decodeSnapshot(packet, size, s)) printSnapshot(s);
+      replies++;
+    }
+    if (replies == 0 && !push) fprintf(stderr, "No reply from %s\n", deviceIp);
+
+    if (!push) sleep(1);
+  }
+}
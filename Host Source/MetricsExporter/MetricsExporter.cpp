@@ -0,0 +1,453 @@
+//MetricsExporter - scrapes the health metrics (metrics.h) of every EnhMelee1294Firmware board on the subnet
+//and serves them in the Prometheus text format, for fleet wide dashboards during events. Every interval
+//one MSG_TYPE_METRICS request is broadcast, each board answers with its MAC and all of its counters and
+//gauges, and boards whose reply did not fit in one datagram are asked again for the rest.
+//
+//Every series is labelled with the board's MAC and its current address. enh_up is 0 for a board that
+//missed the last scrape, boards silent for STALE_SCRAPES scrapes are dropped. Metric IDs newer than this
+//exporter are served as gauges named by their ID.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings -pthread MetricsExporter.cpp -o MetricsExporter
+//Usage: MetricsExporter [-b broadcastIp] [-l listenPort] [-i intervalSeconds] | -c
+//  -b is 255.255.255.255 by default, a subnet's broadcast address also works
+//  -l is the HTTP port Prometheus scrapes /metrics from, 9637 by default
+//  -c checks the registry, the dump and the exposition format over loopback and exits, non-zero on failure
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/metrics.h"
+
+#define CONFIG_PORT 3637
+#define DEFAULT_LISTEN_PORT 9637
+#define DEFAULT_INTERVAL_S 5
+#define STALE_SCRAPES 12
+#define MAX_METRIC_ID 256
+#define METRIC_PREFIX "enh_"
+
+typedef struct {
+  std::string ip;
+  uint32_t values[MAX_METRIC_ID];
+  bool present[MAX_METRIC_ID];
+  int count; //Metrics the board has, newer firmware can have more than metricDefs
+  time_t lastSeen;
+} Board;
+
+typedef std::map<std::string, Board> Fleet; //By MAC
+
+//**********************************************************************
+//*                              Scraping
+//**********************************************************************
+uint64_t hostMs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000ull + t.tv_nsec / 1000000;
+}
+
+int buildRequest(uint8_t* packet, int capacity, uint16_t sequence, int first) {
+  TlvWriter w;
+  tlvBegin(w, packet, capacity, MSG_TYPE_METRICS, sequence);
+  if (first > 0) tlvAppendByte(w, TLV_METRICS_FROM, first);
+  return w.size;
+}
+
+//Stores the values of a reply. Returns the ID to ask again from if the reply stopped short, 0 if the
+//board has been read to the end and -1 if the packet is not a metrics reply
+int handleReply(Fleet& fleet, const uint8_t* packet, int size, const char* ip, time_t now) {
+  TlvReader r;
+  if (!tlvOpen(r, packet, size) || r.version != UDP_BINARY_VERSION || r.type != MSG_TYPE_METRICS) return -1;
+
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  bool ok = false;
+  char mac[18] = "";
+  int first = -1, count = 0, values = 0;
+  const uint8_t* data = NULL;
+
+  while (tlvNext(r, tag, value, length)) {
+    if (tag == TLV_STATUS && length == 1) ok = value[0] == STATUS_OK;
+    else if (tag == TLV_MAC && length == 6) {
+      snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", value[0], value[1], value[2], value[3], value[4], value[5]);
+    } else if (tag == TLV_METRICS && length >= 2) {
+      first = value[0];
+      count = value[1];
+      data = value + 2;
+      values = (length - 2) / 4;
+    }
+  }
+  if (!ok || mac[0] == 0 || first < 0) return -1;
+
+  Board& b = fleet[mac];
+  if (b.ip != ip) b = Board();
+  b.ip = ip;
+  b.count = count;
+  b.lastSeen = now;
+  for (int i = 0; i < values && first + i < MAX_METRIC_ID; i++) {
+    const uint8_t* v = data + 4 * i;
+    b.values[first + i] = (uint32_t)v[0] << 24 | (uint32_t)v[1] << 16 | (uint32_t)v[2] << 8 | v[3];
+    b.present[first + i] = true;
+  }
+
+  int next = first + values;
+  return values > 0 && next < count ? next : 0;
+}
+
+//Broadcasts a request and collects the replies for waitMs, asking again where replies stopped short
+void scrape(int fd, const sockaddr_in& target, Fleet& fleet, uint16_t& sequence, int waitMs) {
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  int size = buildRequest(packet, sizeof(packet), sequence++, 0);
+  sendto(fd, packet, size, 0, (const sockaddr*)&target, sizeof(target));
+
+  uint64_t end = hostMs() + waitMs;
+  pollfd pfd = { fd, POLLIN, 0 };
+  for (uint64_t now = hostMs(); now < end && poll(&pfd, 1, end - now) > 0; now = hostMs()) {
+    sockaddr_in from;
+    socklen_t fromLength = sizeof(from);
+    size = recvfrom(fd, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLength);
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+
+    int next = size > 0 ? handleReply(fleet, packet, size, ip, time(NULL)) : -1;
+    if (next > 0) {
+      size = buildRequest(packet, sizeof(packet), sequence++, next);
+      sendto(fd, packet, size, 0, (const sockaddr*)&from, sizeof(from));
+    }
+  }
+}
+
+//**********************************************************************
+//*                             Exposition
+//**********************************************************************
+//Text format 0.0.4, every metric once with its HELP and TYPE and one sample per board
+std::string renderMetrics(const Fleet& fleet, time_t now, time_t lastScrape) {
+  std::string text;
+  char line[256];
+
+  text += "# HELP " METRIC_PREFIX "up 1 if the board answered the last scrape\n";
+  text += "# TYPE " METRIC_PREFIX "up gauge\n";
+  for (Fleet::const_iterator b = fleet.begin(); b != fleet.end(); ++b) {
+    snprintf(line, sizeof(line), METRIC_PREFIX "up{board=\"%s\",ip=\"%s\"} %d\n", b->first.c_str(),
+      b->second.ip.c_str(), b->second.lastSeen >= lastScrape ? 1 : 0);
+    text += line;
+  }
+  text += "# HELP " METRIC_PREFIX "scrape_age_seconds Seconds since the board last answered\n";
+  text += "# TYPE " METRIC_PREFIX "scrape_age_seconds gauge\n";
+  for (Fleet::const_iterator b = fleet.begin(); b != fleet.end(); ++b) {
+    snprintf(line, sizeof(line), METRIC_PREFIX "scrape_age_seconds{board=\"%s\",ip=\"%s\"} %ld\n", b->first.c_str(),
+      b->second.ip.c_str(), (long)(now - b->second.lastSeen));
+    text += line;
+  }
+
+  for (int id = 0; id < MAX_METRIC_ID; id++) {
+    bool any = false;
+    for (Fleet::const_iterator b = fleet.begin(); b != fleet.end(); ++b) any |= b->second.present[id];
+    if (!any) continue;
+
+    char name[64];
+    if (id < METRIC_COUNT) {
+      snprintf(name, sizeof(name), METRIC_PREFIX "%s", metricDefs[id].name);
+      snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, metricDefs[id].help, name,
+        metricDefs[id].kind == METRIC_COUNTER ? "counter" : "gauge");
+    } else {
+      snprintf(name, sizeof(name), METRIC_PREFIX "metric_%d", id);
+      snprintf(line, sizeof(line), "# HELP %s Metric %d, newer than this exporter\n# TYPE %s gauge\n", name, id, name);
+    }
+    text += line;
+
+    for (Fleet::const_iterator b = fleet.begin(); b != fleet.end(); ++b) {
+      if (!b->second.present[id]) continue;
+      snprintf(line, sizeof(line), "%s{board=\"%s\",ip=\"%s\"} %lu\n", name, b->first.c_str(), b->second.ip.c_str(),
+        (unsigned long)b->second.values[id]);
+      text += line;
+    }
+  }
+  return text;
+}
+
+int openListener(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+//Answers one HTTP request. Anything but GET /metrics is a 404
+void serveHttp(int listenFd, const std::string& body) {
+  int fd = accept(listenFd, NULL, NULL);
+  if (fd < 0) return;
+
+  //Requests are a single line and a few headers, read until the blank line or 1 second
+  std::string request;
+  char buffer[1024];
+  pollfd pfd = { fd, POLLIN, 0 };
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192 && poll(&pfd, 1, 1000) > 0) {
+    int size = recv(fd, buffer, sizeof(buffer), 0);
+    if (size <= 0) break;
+    request.append(buffer, size);
+  }
+
+  std::string response;
+  if (request.compare(0, 13, "GET /metrics ") == 0) {
+    char header[160];
+    snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+    response = header + body;
+  } else {
+    response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  }
+
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += n;
+  }
+  close(fd);
+}
+
+//**********************************************************************
+//*                               Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+//Answers one request the way handleBinaryPacket() does
+void answerLikeBoard(int fd, const MetricsRegistry& m, const uint8_t* mac, int capacity) {
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  sockaddr_in from;
+  socklen_t fromLength = sizeof(from);
+  int size = recvfrom(fd, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLength);
+
+  TlvReader r;
+  if (size <= 0 || !tlvOpen(r, packet, size) || r.type != MSG_TYPE_METRICS) return;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  int first = 0;
+  while (tlvNext(r, tag, value, length)) {
+    if (tag == TLV_METRICS_FROM && length == 1) first = value[0];
+  }
+
+  uint8_t response[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  tlvBegin(w, response, capacity, r.type, r.sequence);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppend(w, TLV_MAC, mac, 6);
+  if (first < METRIC_COUNT) metricsAppend(w, m, first);
+  sendto(fd, w.buffer, w.size, 0, (sockaddr*)&from, fromLength);
+}
+
+int bindLoopback(int type, int& port) {
+  int fd = socket(AF_INET, type, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (sockaddr*)&addr, sizeof(addr));
+  socklen_t length = sizeof(addr);
+  getsockname(fd, (sockaddr*)&addr, &length);
+  port = ntohs(addr.sin_port);
+  return fd;
+}
+
+int runCheck() {
+  bool ok = true;
+  static MetricsRegistry m;
+  metricsReset(m);
+
+  //Interrupt handlers and loop() add into the same slots, threads stand in for them here
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([]() {
+      for (int i = 0; i < 100000; i++) metricAdd(m, METRIC_SSI_MESSAGES, 1);
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+  ok &= expect(m.values[METRIC_SSI_MESSAGES] == 400000, "concurrent adds are not lost");
+
+  for (int id = 0; id < METRIC_COUNT; id++) metricSet(m, id, 0x01000000u * id + 1000 + id);
+
+  //A full datagram carries every metric in one TLV
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_METRICS, 1);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  uint8_t mac[6] = { 0x00, 0x1A, 0xB6, 0x02, 0xF5, 0x8C };
+  tlvAppend(w, TLV_MAC, mac, 6);
+  ok &= expect(metricsAppend(w, m, 0) == METRIC_COUNT, "every metric fits in one datagram");
+
+  Fleet fleet;
+  bool same = handleReply(fleet, packet, w.size, "10.0.0.20", 100) == 0 && fleet.size() == 1;
+  const Board& b = fleet["00:1a:b6:02:f5:8c"];
+  for (int id = 0; id < METRIC_COUNT; id++) same &= b.present[id] && b.values[id] == m.values[id];
+  ok &= expect(same, "the dump decodes to the registry");
+
+  //A board with more metrics than fit is read in pages
+  Fleet paged;
+  int next = 0, requests = 0;
+  do {
+    tlvBegin(w, packet, 48, MSG_TYPE_METRICS, 2);
+    tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+    tlvAppend(w, TLV_MAC, mac, 6);
+    metricsAppend(w, m, next);
+    next = handleReply(paged, packet, w.size, "10.0.0.20", 100);
+    requests++;
+  } while (next > 0 && requests < 100);
+  same = next == 0 && requests > 1;
+  for (int id = 0; id < METRIC_COUNT; id++) same &= paged["00:1a:b6:02:f5:8c"].present[id] && paged["00:1a:b6:02:f5:8c"].values[id] == m.values[id];
+  ok &= expect(same, "short replies are asked again and read to the end");
+
+  //Firmware newer than the exporter
+  uint8_t newer[2 + 4 * 2] = { METRIC_COUNT, METRIC_COUNT + 2, 0, 0, 0, 7, 0, 0, 0, 9 };
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_METRICS, 3);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppend(w, TLV_MAC, mac, 6);
+  tlvAppend(w, TLV_METRICS, newer, sizeof(newer));
+  handleReply(fleet, packet, w.size, "10.0.0.20", 100);
+  std::string text = renderMetrics(fleet, 105, 100);
+  char expected[128];
+  snprintf(expected, sizeof(expected), METRIC_PREFIX "metric_%d{board=\"00:1a:b6:02:f5:8c\",ip=\"10.0.0.20\"} 9\n", METRIC_COUNT + 1);
+  ok &= expect(text.find(expected) != std::string::npos, "unknown IDs are served under their number");
+
+  snprintf(expected, sizeof(expected), "# TYPE " METRIC_PREFIX "ssi_messages_total counter\n" METRIC_PREFIX
+    "ssi_messages_total{board=\"00:1a:b6:02:f5:8c\",ip=\"10.0.0.20\"} %lu\n", (unsigned long)m.values[METRIC_SSI_MESSAGES]);
+  bool formatted = text.find(expected) != std::string::npos && text.find(METRIC_PREFIX "up{board=\"00:1a:b6:02:f5:8c\",ip=\"10.0.0.20\"} 1\n") != std::string::npos;
+  int types = 0;
+  for (size_t at = text.find("# TYPE"); at != std::string::npos; at = text.find("# TYPE", at + 1)) types++;
+  ok &= expect(formatted && types == METRIC_COUNT + 2 + 2, "every metric has one TYPE and one sample per board");
+  ok &= expect(renderMetrics(fleet, 200, 150).find(METRIC_PREFIX "up{board=\"00:1a:b6:02:f5:8c\",ip=\"10.0.0.20\"} 0\n") !=
+    std::string::npos, "a board that missed the scrape is down");
+
+  //Over loopback: a board that answers in short datagrams, then Prometheus asking for the page
+  int boardPort, exporterPort;
+  int boardFd = bindLoopback(SOCK_DGRAM, boardPort);
+  int exporterFd = bindLoopback(SOCK_DGRAM, exporterPort);
+  metricSet(m, METRIC_SSI_MESSAGES, 1234);
+  std::thread board([&]() {
+    pollfd pfd = { boardFd, POLLIN, 0 };
+    while (poll(&pfd, 1, 500) > 0) answerLikeBoard(boardFd, m, mac, 64);
+  });
+  sockaddr_in target = { };
+  target.sin_family = AF_INET;
+  target.sin_port = htons(boardPort);
+  target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  Fleet live;
+  uint16_t sequence = 1;
+  scrape(exporterFd, target, live, sequence, 300);
+  board.join();
+  close(boardFd);
+  close(exporterFd);
+
+  same = live.size() == 1 && live.begin()->second.ip == "127.0.0.1";
+  for (int id = 0; id < METRIC_COUNT && same; id++) same &= live.begin()->second.present[id] && live.begin()->second.values[id] == m.values[id];
+  ok &= expect(same, "a scrape over loopback reads the whole board");
+
+  int httpPort;
+  int listenFd = bindLoopback(SOCK_STREAM, httpPort);
+  listen(listenFd, 4);
+  std::string body = renderMetrics(live, time(NULL), 0);
+  std::string reply;
+  std::thread client([&]() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(httpPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+      const char* request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+      send(fd, request, strlen(request), 0);
+      char buffer[4096];
+      int size;
+      while ((size = recv(fd, buffer, sizeof(buffer), 0)) > 0) reply.append(buffer, size);
+    }
+    close(fd);
+  });
+  serveHttp(listenFd, body);
+  client.join();
+  close(listenFd);
+  ok &= expect(reply.compare(0, 15, "HTTP/1.1 200 OK") == 0 && reply.find(METRIC_PREFIX "ssi_messages_total{board=\"00:1a:b6:02:f5:8c\",ip=\"127.0.0.1\"} 1234\n") !=
+    std::string::npos, "GET /metrics serves the scraped values");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  const char* broadcastIp = "255.255.255.255";
+  int listenPort = DEFAULT_LISTEN_PORT;
+  int interval = DEFAULT_INTERVAL_S;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:l:i:c")) != -1) {
+    switch (opt) {
+      case 'b': broadcastIp = optarg; break;
+      case 'l': listenPort = atoi(optarg); break;
+      case 'i': interval = atoi(optarg); break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s [-b broadcastIp] [-l listenPort] [-i intervalSeconds] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+  if (interval < 1) interval = 1;
+
+  sockaddr_in target = { };
+  target.sin_family = AF_INET;
+  target.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, broadcastIp, &target.sin_addr) != 1) {
+    fprintf(stderr, "Invalid broadcast address %s\n", broadcastIp);
+    return 1;
+  }
+
+  int udpFd = socket(AF_INET, SOCK_DGRAM, 0);
+  int one = 1;
+  setsockopt(udpFd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+  int listenFd = openListener(listenPort);
+  if (listenFd < 0) {
+    fprintf(stderr, "Can't listen on port %d\n", listenPort);
+    return 1;
+  }
+  printf("Serving http://0.0.0.0:%d/metrics, scraping %s every %ds\n", listenPort, broadcastIp, interval);
+
+  Fleet fleet;
+  uint16_t sequence = 1;
+  time_t lastScrape = 0;
+  while (true) {
+    time_t now = time(NULL);
+    if (now - lastScrape >= interval) {
+      lastScrape = now;
+      scrape(udpFd, target, fleet, sequence, 500);
+      for (Fleet::iterator b = fleet.begin(); b != fleet.end();) {
+        if (now - b->second.lastSeen > STALE_SCRAPES * interval) fleet.erase(b++);
+        else ++b;
+      }
+    }
+
+    pollfd pfd = { listenFd, POLLIN, 0 };
+    if (poll(&pfd, 1, 200) > 0) serveHttp(listenFd, renderMetrics(fleet, time(NULL), lastScrape));
+  }
+}
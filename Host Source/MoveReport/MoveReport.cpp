@@ -0,0 +1,588 @@
+//MoveReport - replays captures through EnhMelee1294Firmware's per move histograms (movestats.h) and prints
+//what each move of each player did: hits, damage, openings, kills and how often it started or ended a
+//combo. Captures are the raw TCP stream of a board (see PipelineBenchmark), one or more games each. With
+//-d it reads the histograms of the game in progress, or of the last one, from the board over UDP instead.
+//
+//The board only ever sees one frame at a time. The check keeps every frame of a game instead and works
+//the histograms out again afterwards, string by string, from the whole game, then compares the two on
+//generated games with missed and truncated frames (gamegen.h), like the captures CorpusRunner -g writes.
+//The histograms it compares are read back through the same requests and responses a board answers.
+//
+//The firmware headers are built in their own namespace, the generator uses the FullGameStatsWebPost ones.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings MoveReport.cpp -o MoveReport
+//Usage: MoveReport [capture]... | -d deviceIp
+//       MoveReport -c [-n games]   checks the histograms against the reference and exits, non-zero on failure
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../Common/gamegen.h"
+
+#undef _EVENTSCHEMA_H_INCLUDED
+namespace enh {
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/eventschema.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/movestats.h"
+}
+
+#define DEFAULT_CHECK_GAMES 20
+#define CONFIG_PORT 3637
+#define FETCH_ATTEMPTS 3
+
+typedef struct {
+  uint32_t frameDelta;
+  enh::PlayerFrameData players[PLAYER_COUNT];
+} FrameRecord;
+
+//One game as the board saw it, with every frame kept for the reference
+typedef struct {
+  enh::Game game;
+  enh::MoveStats moves[PLAYER_COUNT];
+  std::vector<FrameRecord> frames;
+  bool ended;
+} Replay;
+
+typedef struct {
+  uint32_t hits;
+  uint32_t damage;
+  uint32_t openings;
+  uint32_t kills;
+  uint32_t comboStarters;
+  uint32_t comboEnders;
+} MoveCounts;
+
+typedef std::map<int, MoveCounts> MoveTable;
+
+//**********************************************************************
+//*                              Replay
+//**********************************************************************
+bool readCapture(const char* path, std::vector<uint8_t>& bytes) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+  fclose(f);
+  return true;
+}
+
+//Returns false at the end of the capture or at a corrupt header
+bool nextMessage(const std::vector<uint8_t>& bytes, size_t& offset, const uint8_t*& message, int& messageSize) {
+  if (offset + STREAM_HEADER_SIZE > bytes.size()) return false;
+
+  const uint8_t* header = bytes.data() + offset;
+  uint32_t size = (uint32_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+  if (size == 0 || size > STREAM_MAX_MESSAGE_SIZE || offset + STREAM_HEADER_SIZE + size > bytes.size()) return false;
+
+  message = header + STREAM_HEADER_SIZE;
+  messageSize = size;
+  offset += STREAM_HEADER_SIZE + size;
+  return true;
+}
+
+//What handleGameStart(), handleUpdate() and the moveStatsAdd() call in computeStatistics() do. Messages
+//of the wrong size are dropped like msgcheck.h drops them. Returns true when a game has ended
+bool replayMessage(Replay& r, const uint8_t* message, int size) {
+  const uint8_t* payload = message + 1;
+  switch (message[0]) {
+    case EVENT_GAME_START:
+      if (size != 1 + EVENT_GAME_START_SIZE) return false;
+      r.game = { };
+      enh::schemaDecodeGameStart(r.game, payload);
+      for (int i = 0; i < PLAYER_COUNT; i++) enh::moveStatsReset(r.moves[i]);
+      r.frames.clear();
+      r.ended = false;
+      return false;
+    case EVENT_UPDATE: {
+      if (size != 1 + EVENT_UPDATE_SIZE) return false;
+      uint32_t lastFrame = r.game.frameCounter;
+      for (int i = 0; i < PLAYER_COUNT; i++) enh::frameHistoryAdvance(r.game.players[i]);
+      enh::schemaDecodeUpdate(r.game, payload);
+      int framesMissed = r.game.frameCounter - lastFrame - 1;
+      r.game.framesMissed += framesMissed;
+      r.game.frameDelta = lastFrame != 0 && framesMissed > 0 ? framesMissed + 1 : 1;
+
+      FrameRecord record;
+      record.frameDelta = r.game.frameDelta;
+      for (int i = 0; i < PLAYER_COUNT; i++) {
+        enh::moveStatsAdd(r.moves[i], r.game.players[i], r.game.players[!i], r.game.frameDelta);
+        record.players[i] = enh::currentFrame(r.game.players[i]);
+      }
+      r.frames.push_back(record);
+      return false;
+    }
+    case EVENT_GAME_END:
+      if (size != 1 + EVENT_GAME_END_SIZE) return false;
+      enh::schemaDecodeGameEnd(r.game, payload);
+      r.ended = true;
+      return true;
+    default:
+      return false;
+  }
+}
+
+MoveTable histogramTable(const enh::MoveStats& ms) {
+  MoveTable table;
+  for (int m = 0; m < MOVE_ID_COUNT; m++) {
+    MoveCounts c = { ms.hits[m], ms.damage[m], ms.openings[m], ms.kills[m], ms.comboStarters[m], ms.comboEnders[m] };
+    if (c.hits || c.damage || c.openings || c.kills || c.comboStarters || c.comboEnders) table[m] = c;
+  }
+  return table;
+}
+
+//**********************************************************************
+//*                             Reference
+//**********************************************************************
+//The histograms of one player worked out from the whole game: first where the strings are, then what
+//each frame adds to which move
+bool isDamaged(const enh::PlayerFrameData& pfd) {
+  return pfd.animation >= DAMAGE_START && pfd.animation <= DAMAGE_END;
+}
+
+bool isGrabbed(const enh::PlayerFrameData& pfd) {
+  return pfd.animation >= CAPTURE_START && pfd.animation <= CAPTURE_END;
+}
+
+bool isTeching(const enh::PlayerFrameData& pfd) {
+  return (pfd.animation >= TECH_START && pfd.animation <= TECH_END) ||
+    pfd.animation == TECH_MISS_UP || pfd.animation == TECH_MISS_DOWN;
+}
+
+MoveTable referenceTable(const std::vector<FrameRecord>& frames, int player) {
+  MoveTable table;
+  int count = frames.size();
+  enh::PlayerFrameData none = { };
+  std::vector<bool> hit(count), lost(count);
+  std::vector<bool> opLost(count);
+  std::vector<int> move(count);
+
+  for (int f = 0; f < count; f++) {
+    const enh::PlayerFrameData& cp = frames[f].players[player];
+    const enh::PlayerFrameData& op = frames[f].players[!player];
+    const enh::PlayerFrameData& cpBefore = f > 0 ? frames[f - 1].players[player] : none;
+    const enh::PlayerFrameData& opBefore = f > 0 ? frames[f - 1].players[!player] : none;
+
+    move[f] = cp.lastMoveHitId < MOVE_ID_COUNT ? cp.lastMoveHitId : MOVE_ID_COUNT - 1;
+    hit[f] = op.percent > opBefore.percent && (isDamaged(op) || isGrabbed(op));
+    lost[f] = cpBefore.stocks > cp.stocks;
+    opLost[f] = opBefore.stocks > op.stocks;
+
+    long dealt = lroundf(op.percent * 10) - lroundf(opBefore.percent * 10);
+    if (dealt > 0) table[move[f]].damage += dealt;
+    if (hit[f]) table[move[f]].hits++;
+    if (opLost[f]) table[move[f]].kills++;
+  }
+
+  //A string runs from a hit to the first frame a stock is lost or the opponent has been out of hitstun,
+  //grabs and techs for more than COMBO_STRING_TIMEOUT frames. One still going when the game ends is an
+  //opening but never a combo
+  int f = 0;
+  while (f < count) {
+    if (!hit[f]) {
+      f++;
+      continue;
+    }
+
+    int first = f, last = f, hits = 0;
+    uint32_t idle = 0;
+    for (; f < count; f++) {
+      const enh::PlayerFrameData& op = frames[f].players[!player];
+      if (hit[f]) {
+        hits++;
+        last = f;
+      }
+      if (isDamaged(op) || isGrabbed(op) || isTeching(op)) idle = 0;
+      else idle += frames[f].frameDelta;
+      if (lost[f] || opLost[f] || idle > COMBO_STRING_TIMEOUT) break;
+    }
+
+    table[move[first]].openings++;
+    if (hits >= 2 && f < count) {
+      table[move[first]].comboStarters++;
+      table[move[last]].comboEnders++;
+    }
+    f++;
+  }
+  return table;
+}
+
+bool sameTables(const MoveTable& a, const MoveTable& b) {
+  if (a.size() != b.size()) return false;
+  for (MoveTable::const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+    if (i->first != j->first || memcmp(&i->second, &j->second, sizeof(MoveCounts)) != 0) return false;
+  }
+  return true;
+}
+
+//**********************************************************************
+//*                               Fetch
+//**********************************************************************
+//One response of MSG_TYPE_MOVES
+typedef struct {
+  uint8_t status;
+  bool hasPage;
+  uint8_t player;
+  uint8_t port;
+  uint8_t first;
+  uint8_t next;
+  MoveTable moves;
+} DecodedMoves;
+
+uint32_t readBig(const uint8_t* value, int& idx, int bytes) {
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) result = (result << 8) | value[idx++];
+  return result;
+}
+
+bool decodeMoves(const uint8_t* packet, int size, uint16_t sequence, DecodedMoves& d) {
+  d = DecodedMoves();
+  d.status = 0xFF;
+
+  enh::TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!enh::tlvOpen(r, packet, size) || r.type != MSG_TYPE_MOVES || r.sequence != sequence) return false;
+
+  while (enh::tlvNext(r, tag, value, length)) {
+    int idx = 0;
+    if (tag == TLV_STATUS && length == 1) {
+      d.status = value[0];
+    } else if (tag == TLV_MOVES_PAGE && length == 4) {
+      d.hasPage = true;
+      d.player = value[idx++];
+      d.port = value[idx++];
+      d.first = value[idx++];
+      d.next = value[idx++];
+    } else if (tag == TLV_MOVE && length == 15) {
+      int id = value[idx++];
+      MoveCounts& c = d.moves[id];
+      c.hits = readBig(value, idx, 2);
+      c.damage = readBig(value, idx, 4);
+      c.openings = readBig(value, idx, 2);
+      c.kills = readBig(value, idx, 2);
+      c.comboStarters = readBig(value, idx, 2);
+      c.comboEnders = readBig(value, idx, 2);
+    }
+  }
+  return true;
+}
+
+//Where requests go: the board over UDP, or for the check a board simulated in this process
+struct SimBoard;
+typedef struct {
+  int fd;
+  sockaddr_in addr;
+  SimBoard* sim;
+} Link;
+
+int simReply(SimBoard& sim, const uint8_t* request, int size, uint8_t* reply, int capacity);
+
+//Sends a request and returns the size of the reply to it, 0 if none came
+int exchange(Link& link, const uint8_t* request, int size, uint8_t* reply, int capacity) {
+  if (link.sim != NULL) return simReply(*link.sim, request, size, reply, capacity);
+
+  uint16_t sequence = request[4] << 8 | request[5];
+  for (int attempt = 0; attempt < FETCH_ATTEMPTS; attempt++) {
+    sendto(link.fd, request, size, 0, (sockaddr*)&link.addr, sizeof(link.addr));
+
+    pollfd pfd = { link.fd, POLLIN, 0 };
+    while (poll(&pfd, 1, 1000) > 0) {
+      int received = recv(link.fd, reply, capacity, 0);
+      if (received >= UDP_BINARY_HEADER_SIZE && (reply[4] << 8 | reply[5]) == sequence) return received;
+    }
+  }
+  return 0;
+}
+
+//Asks for one player's moves page by page until the board says there are no more. During a game each
+//page is as of its own response
+bool fetchMoves(Link& link, uint16_t& sequence, uint8_t player, uint8_t& port, MoveTable& table, int& pages) {
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  uint8_t reply[UDP_BINARY_MAX_PACKET_SIZE];
+  table.clear();
+  pages = 0;
+
+  for (int from = 0; from < MOVE_ID_COUNT; ) {
+    enh::TlvWriter w;
+    enh::tlvBegin(w, packet, sizeof(packet), MSG_TYPE_MOVES, sequence);
+    uint8_t select[2] = { player, (uint8_t)from };
+    enh::tlvAppend(w, TLV_MOVES_SELECT, select, sizeof(select));
+
+    DecodedMoves d;
+    int replySize = exchange(link, packet, w.size, reply, sizeof(reply));
+    if (replySize <= 0 || !decodeMoves(reply, replySize, sequence++, d)) {
+      fprintf(stderr, "No reply to the request for player %u\n", player + 1);
+      return false;
+    }
+    if (d.status != STATUS_OK || !d.hasPage || d.player != player || d.first != from || d.next <= from) {
+      fprintf(stderr, "Request for player %u refused with status %u\n", player + 1, d.status);
+      return false;
+    }
+
+    port = d.port;
+    table.insert(d.moves.begin(), d.moves.end());
+    from = d.next;
+    pages++;
+  }
+  return true;
+}
+
+//**********************************************************************
+//*                              Report
+//**********************************************************************
+void printMoves(int port, const MoveTable& table) {
+  printf("  Port %d\n", port);
+  printf("    %4s %6s %8s %9s %6s %9s %7s\n", "move", "hits", "damage", "openings", "kills", "starters", "enders");
+  for (MoveTable::const_iterator m = table.begin(); m != table.end(); ++m) {
+    const MoveCounts& c = m->second;
+    printf("    %4d %6u %8.1f %9u %6u %9u %7u\n", m->first, c.hits, c.damage / 10.0, c.openings, c.kills,
+      c.comboStarters, c.comboEnders);
+  }
+}
+
+void printGame(const Replay& r, int number) {
+  printf("Game %d: stage %d, %u frames, %u missed\n", number, r.game.stage, r.game.frameCounter, r.game.framesMissed);
+  for (int i = 0; i < PLAYER_COUNT; i++) printMoves(r.game.players[i].controllerPort + 1, histogramTable(r.moves[i]));
+}
+
+//**********************************************************************
+//*                               Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+//Answers MSG_TYPE_MOVES the way handleBinaryPacket() does
+struct SimBoard {
+  const enh::MoveStats* moves;
+  uint8_t ports[PLAYER_COUNT];
+  int largest;
+};
+
+int simReply(SimBoard& sim, const uint8_t* request, int size, uint8_t* reply, int capacity) {
+  enh::TlvReader r;
+  enh::TlvWriter w;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!enh::tlvOpen(r, request, size)) return 0;
+  enh::tlvBegin(w, reply, capacity, r.type, r.sequence);
+
+  uint8_t player = 0, from = 0;
+  while (enh::tlvNext(r, tag, value, length)) {
+    if (tag == TLV_MOVES_SELECT && length == 2) {
+      player = value[0];
+      from = value[1];
+    }
+  }
+  if (player >= PLAYER_COUNT) {
+    enh::tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
+  } else {
+    enh::tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+    enh::moveStatsAppend(w, sim.moves[player], player, sim.ports[player], from);
+  }
+  if (w.size > sim.largest) sim.largest = w.size;
+  return w.size;
+}
+
+int runCheck(int games) {
+  bool ok = true;
+  GenFaults faults = { 5, 2, 1 };
+  GenCounters counters = { };
+  uint8_t out[2 * (STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE)];
+  uint16_t sequence = 1;
+  int largest = 0, mostPages = 0;
+
+  int matched = 0, ended = 0, wireMatched = 0;
+  uint32_t hits = 0, openings = 0, combos = 0, kills = 0, stocksLost = 0;
+  bool openingsWithinHits = true;
+  for (int n = 0; n < games; n++) {
+    //Each game is captured first, then replayed from the capture like a recorded one
+    GameGenerator* g = new GameGenerator();
+    generatorInit(*g, 0x4D0E5 + 7919 * n, 3600 + (n * 2749) % (GEN_TIME_LIMIT_FRAMES - 3600));
+    std::vector<uint8_t> capture;
+    int length;
+    bool frameSent;
+    while (generatorNextMessages(*g, out, length, faults, counters, frameSent)) capture.insert(capture.end(), out, out + length);
+    delete g;
+
+    Replay* r = new Replay();
+    size_t offset = 0;
+    const uint8_t* message;
+    int size;
+    while (nextMessage(capture, offset, message, size)) replayMessage(*r, message, size);
+    if (r->ended) ended++;
+
+    SimBoard sim = { r->moves, { }, 0 };
+    Link link = { -1, { }, &sim };
+    bool same = true, sameWire = true;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      MoveTable board = histogramTable(r->moves[i]);
+      same &= sameTables(board, referenceTable(r->frames, i));
+
+      MoveTable fetched;
+      uint8_t port;
+      int pages;
+      sim.ports[i] = r->game.players[i].controllerPort + 1;
+      sameWire &= fetchMoves(link, sequence, i, port, fetched, pages) && port == sim.ports[i] &&
+        sameTables(board, fetched);
+      if (pages > mostPages) mostPages = pages;
+
+      uint32_t playerHits = 0, playerOpenings = 0;
+      for (MoveTable::iterator m = board.begin(); m != board.end(); ++m) {
+        playerHits += m->second.hits;
+        playerOpenings += m->second.openings;
+        combos += m->second.comboStarters;
+        kills += m->second.kills;
+      }
+      openingsWithinHits &= playerOpenings <= playerHits;
+      hits += playerHits;
+      openings += playerOpenings;
+      if (!r->frames.empty()) stocksLost += STOCK_COUNT - r->frames.back().players[i].stocks;
+    }
+    if (same) matched++;
+    if (sameWire) wireMatched++;
+    if (sim.largest > largest) largest = sim.largest;
+    delete r;
+  }
+
+  printf("%d games, %u hits, %u openings, %u combos, %u kills, %u missed and %u truncated frames\n", games, hits,
+    openings, combos, kills, counters.missedFrames, counters.truncated);
+  ok &= expect(ended == games, "every capture replays to a game end");
+  ok &= expect(hits > 0 && combos > 0 && kills > 0, "the games land hits, combos and kills");
+  ok &= expect(matched == games, "histograms match the whole game reference");
+  ok &= expect(wireMatched == games, "histograms read over UDP match the board's");
+  ok &= expect(openingsWithinHits, "every opening is a hit");
+  ok &= expect(kills == stocksLost, "every stock lost is a kill of some move");
+
+  //IDs past the table share the last bin
+  enh::Game* game = new enh::Game();
+  enh::MoveStats* ms = new enh::MoveStats();
+  enh::moveStatsReset(*ms);
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    enh::frameHistoryAdvance(game->players[i]);
+    enh::currentFrame(game->players[i]).stocks = STOCK_COUNT;
+  }
+  enh::currentFrame(game->players[0]).lastMoveHitId = 200;
+  enh::currentFrame(game->players[1]).percent = 12;
+  enh::currentFrame(game->players[1]).animation = DAMAGE_START;
+  enh::moveStatsAdd(*ms, game->players[0], game->players[1], 1);
+  ok &= expect(ms->hits[MOVE_ID_COUNT - 1] == 1 && ms->damage[MOVE_ID_COUNT - 1] == 120, "move IDs past the table land in the last bin");
+
+  //With every move used a player takes several responses, each asking on from where the last one stopped
+  for (int m = 0; m < MOVE_ID_COUNT; m++) {
+    ms->hits[m] = 1000 + m;
+    ms->damage[m] = 70000 + m;
+    ms->kills[m] = m;
+  }
+  enh::MoveStats both[PLAYER_COUNT];
+  for (int i = 0; i < PLAYER_COUNT; i++) both[i] = *ms;
+  SimBoard sim = { both, { 1, 4 }, 0 };
+  Link link = { -1, { }, &sim };
+  MoveTable fetched;
+  uint8_t port;
+  int pages;
+  ok &= expect(fetchMoves(link, sequence, 1, port, fetched, pages) && port == 4 && pages > 1 &&
+    sameTables(fetched, histogramTable(*ms)), "a full table pages through");
+  if (sim.largest > largest) largest = sim.largest;
+  printf("  largest response is %d of %d bytes, a full table takes %d, a game at most %d\n", largest,
+    UDP_BINARY_MAX_PACKET_SIZE, pages, mostPages);
+  ok &= expect(!fetchMoves(link, sequence, PLAYER_COUNT, port, fetched, pages), "a player past the last is refused");
+  delete ms;
+  delete game;
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+//Prints the histograms the board has now
+int reportBoard(const char* deviceIp) {
+  Link link = { socket(AF_INET, SOCK_DGRAM, 0), { }, NULL };
+  link.addr.sin_family = AF_INET;
+  link.addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &link.addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(link.fd);
+    return 1;
+  }
+
+  uint16_t sequence = 1;
+  printf("%s\n", deviceIp);
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    MoveTable table;
+    uint8_t port;
+    int pages;
+    if (!fetchMoves(link, sequence, i, port, table, pages)) {
+      close(link.fd);
+      return 1;
+    }
+    printMoves(port, table);
+  }
+  close(link.fd);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int games = DEFAULT_CHECK_GAMES;
+  bool check = false;
+  const char* deviceIp = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "cn:d:")) != -1) {
+    switch (opt) {
+      case 'c': check = true; break;
+      case 'n': games = atoi(optarg); break;
+      case 'd': deviceIp = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [capture]... | -d deviceIp | -c [-n games]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (check) return runCheck(games > 0 ? games : DEFAULT_CHECK_GAMES);
+  if (deviceIp) return reportBoard(deviceIp);
+
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [capture]... | -d deviceIp | -c [-n games]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  int number = 0;
+  Replay* r = new Replay();
+  for (int a = optind; a < argc; a++) {
+    std::vector<uint8_t> bytes;
+    if (!readCapture(argv[a], bytes)) {
+      fprintf(stderr, "Can't read %s\n", argv[a]);
+      failed++;
+      continue;
+    }
+
+    printf("%s\n", argv[a]);
+    size_t offset = 0;
+    const uint8_t* message;
+    int size;
+    while (nextMessage(bytes, offset, message, size)) {
+      if (replayMessage(*r, message, size)) printGame(*r, ++number);
+    }
+    if (offset != bytes.size()) fprintf(stderr, "%s: corrupt after byte %zu\n", argv[a], offset);
+  }
+  delete r;
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,622 @@
+//PipelineBenchmark - runs the board's message pipeline on the host with the hardware stubbed out and
+//compares the result against stored numbers. Every message of a corpus goes through the same stages
+//as on the board: popping it off the SSI receive ring into Msg (spiReadMessage), decoding it
+//(handleGameStart/handleUpdate/handleGameEnd), computing statistics, framing it for the TCP stream
+//(writeMsg) and, at the end of each game, serializing the summary (printGameSummaries).
+//
+//Each stage reports per call latency percentiles and heap allocations, and the whole pipeline reports
+//throughput. The numbers are checked against baseline.txt and the game summaries against the files in
+//golden/, so a change that makes a stage slower, starts allocating, or alters a single stat fails the
+//run. Timings depend on the machine, rewrite the baseline with -w on the machine that runs the check.
+//
+//Corpora are the built in synthetic games plus any captures given with -i. A capture is the raw TCP
+//stream of a board (e.g. nc -l 3636 > capture.bin), -o writes one of the synthetic games as a capture.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing PipelineBenchmark.cpp -o PipelineBenchmark
+//Usage: PipelineBenchmark [-i capture]... [-r repetitions] [-t tolerancePercent] [-b baseline] [-g goldenDir] [-o captureOut] [-w]
+//  Run from this directory so baseline.txt and golden/ are found. -w rewrites them from this run
+
+#include <algorithm>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/synthgame.h"
+#include "../Common/gamesummary.h"
+
+#define SSI_BUFFER_SIZE 1024
+#define SSI_RX_BUFFER_COUNT 5
+
+#define STAGE_POP 0
+#define STAGE_DECODE 1
+#define STAGE_STATS 2
+#define STAGE_FRAME 3
+#define STAGE_SUMMARY 4
+#define STAGE_COUNT 5
+
+static const char* stageNames[STAGE_COUNT] = { "pop", "decode", "stats", "frame", "summary" };
+
+//**********************************************************************
+//*                         Allocation Counting
+//**********************************************************************
+//Nothing on the board may touch the heap per frame, every operator new on the host is counted
+uint64_t allocationCount = 0;
+
+void* operator new(size_t size) {
+  allocationCount++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+//GCC sees the replaced operator new inlined as malloc and flags the matching free, the pair is consistent
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//**********************************************************************
+//*                               Corpora
+//**********************************************************************
+typedef struct {
+  uint32_t offset; //Event code of the message in stream
+  uint32_t size; //Event code + payload
+} CorpusMessage;
+
+typedef struct {
+  std::string name;
+  std::vector<uint8_t> stream; //writeMsg() framing, exactly as a board sends it
+  std::vector<CorpusMessage> messages;
+} Corpus;
+
+void appendMessage(Corpus& c, uint8_t eventCode, const uint8_t* payload, int payloadSize) {
+  uint8_t out[STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE];
+  int length = frameMessage(out, eventCode, payload, payloadSize);
+  c.stream.insert(c.stream.end(), out, out + length);
+}
+
+//A synthetic game, every missEvery-th frame is never sent so framesMissed gets exercised
+void appendSyntheticGame(Corpus& c, uint32_t seed, int frames, int missEvery) {
+  uint32_t rng = seed;
+  Game game;
+  uint8_t payload[MSG_BUFFER_SIZE];
+
+  synthesizeGameStart(game, rng);
+  appendMessage(c, EVENT_GAME_START, payload, encodeGameStart(payload, game));
+
+  for (int frame = 1; frame <= frames; frame++) {
+    synthesizeUpdate(game, rng, frame);
+    if (missEvery > 0 && frame % missEvery == 0) continue;
+    appendMessage(c, EVENT_UPDATE, payload, encodeUpdate(payload, game));
+  }
+
+  game.winCondition = 2;
+  appendMessage(c, EVENT_GAME_END, payload, encodeGameEnd(payload, game));
+}
+
+//Splits the stream into messages with the same reader StatsDaemon uses. Returns false if it is corrupt
+bool indexCorpus(Corpus& c) {
+  c.messages.clear();
+  StreamReader* r = new StreamReader();
+  r->length = 0;
+
+  size_t fed = 0;
+  uint32_t consumed = 0;
+  bool ok = true;
+  while (ok) {
+    int space;
+    uint8_t* dest = streamWritePointer(*r, space);
+    int chunk = (int)std::min((size_t)space, c.stream.size() - fed);
+    memcpy(dest, c.stream.data() + fed, chunk);
+    streamCommit(*r, chunk);
+    fed += chunk;
+
+    int offset = 0;
+    uint8_t* message;
+    int messageSize;
+    int result;
+    while ((result = streamNextMessage(*r, offset, message, messageSize)) == STREAM_MESSAGE) {
+      CorpusMessage m = { consumed + (uint32_t)(message - r->buffer), (uint32_t)messageSize };
+      c.messages.push_back(m);
+    }
+    if (result == STREAM_CORRUPT) ok = false;
+
+    consumed += offset;
+    streamConsume(*r, offset);
+    if (fed == c.stream.size()) break;
+  }
+
+  if (r->length != 0) ok = false; //Truncated at the end
+  delete r;
+  return ok;
+}
+
+bool loadCapture(Corpus& c, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) c.stream.insert(c.stream.end(), buffer, buffer + read);
+  fclose(f);
+
+  const char* slash = strrchr(path, '/');
+  c.name = slash ? slash + 1 : path;
+  return indexCorpus(c);
+}
+
+void buildSyntheticCorpora(std::vector<Corpus>& corpora) {
+  Corpus a;
+  a.name = "synth-1game";
+  appendSyntheticGame(a, 0x1234567, 3600, 0);
+  indexCorpus(a);
+  corpora.push_back(a);
+
+  //Several games back to back, some with dropped frames, so state carried between games is covered too
+  Corpus b;
+  b.name = "synth-4games";
+  appendSyntheticGame(b, 0xBADC0DE, 10800, 0);
+  appendSyntheticGame(b, 0x51ABB1, 2400, 97);
+  appendSyntheticGame(b, 0xC0FFEE, 600, 7);
+  appendSyntheticGame(b, 0x7E57, 28800, 0);
+  indexCorpus(b);
+  corpora.push_back(b);
+}
+
+//**********************************************************************
+//*                          Stubbed Hardware
+//**********************************************************************
+//The receive ring of SSI3DMASlave. The DMA filling it is not part of the board's processing time so
+//ingest is not timed, popping the message out of it is
+typedef struct {
+  uint8_t buffers[SSI_RX_BUFFER_COUNT][SSI_BUFFER_SIZE];
+  uint32_t sizes[SSI_RX_BUFFER_COUNT];
+  uint8_t writeIndex;
+  uint8_t readIndex;
+  uint32_t writeCount;
+  uint32_t readCount;
+} RxRing;
+
+void ringIngest(RxRing& ring, const uint8_t* message, uint32_t size) {
+  memcpy(ring.buffers[ring.writeIndex], message, size);
+  ring.sizes[ring.writeIndex] = size;
+  ring.writeIndex = (ring.writeIndex + 1) % SSI_RX_BUFFER_COUNT;
+  ring.writeCount++;
+}
+
+//Same steps as spiReadMessage() on top of popMessage()
+void ringReadMessage(RxRing& ring, RfifoMessage& msg) {
+  msg = { false, 0, 0, 0, 0 };
+  if (ring.writeCount <= ring.readCount) return;
+
+  uint32_t messageSize = ring.sizes[ring.readIndex];
+  uint8_t* bytes = ring.buffers[ring.readIndex];
+  ring.readIndex++;
+  if (ring.readIndex >= SSI_RX_BUFFER_COUNT) ring.readIndex = 0;
+  ring.readCount++;
+
+  msg.eventCode = bytes[0];
+  for (uint32_t i = 1; i < messageSize; i++) msg.data[i - 1] = bytes[i];
+  msg.messageSize = messageSize - 1;
+
+  if (msg.messageSize != asmEvents[msg.eventCode]) return;
+  msg.success = true;
+}
+
+//The EthernetClient writeMsg() writes to, one call per byte of the header like the board
+typedef struct {
+  uint8_t buffer[STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE];
+  int length;
+} ClientStub;
+
+void clientWrite(ClientStub& client, uint8_t value) {
+  client.buffer[client.length++] = value;
+}
+
+void clientWrite(ClientStub& client, const uint8_t* data, int length) {
+  memcpy(client.buffer + client.length, data, length);
+  client.length += length;
+}
+
+void writeMsg(ClientStub& client, const RfifoMessage& msg) {
+  int realMsgSize = msg.messageSize + 1;
+
+  clientWrite(client, realMsgSize >> 24 & 0xFF);
+  clientWrite(client, realMsgSize >> 16 & 0xFF);
+  clientWrite(client, realMsgSize >> 8 & 0xFF);
+  clientWrite(client, realMsgSize & 0xFF);
+  clientWrite(client, msg.eventCode);
+  clientWrite(client, msg.data, msg.messageSize);
+}
+
+//**********************************************************************
+//*                              Pipeline
+//**********************************************************************
+typedef struct {
+  std::vector<uint32_t> ns[STAGE_COUNT];
+  std::vector<size_t> repetitionStarts[STAGE_COUNT]; //Index into ns where each repetition starts
+  uint64_t allocations[STAGE_COUNT];
+  uint64_t frames;
+  uint64_t elapsedNs;
+  uint64_t bestElapsedNs;
+  std::string summaries; //One line per game, from the first repetition
+  bool reframedMatches; //writeMsg output reproduced the corpus stream byte for byte
+  uint64_t rejected;
+} CorpusResult;
+
+void recordStage(CorpusResult& r, int stage, uint64_t& t, uint64_t& allocations) {
+  uint64_t now = hostNs();
+  r.ns[stage].push_back((uint32_t)(now - t));
+  r.allocations[stage] += allocationCount - allocations;
+  allocations = allocationCount;
+  t = now;
+}
+
+void runCorpus(const Corpus& c, int repetitions, CorpusResult& r) {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    r.ns[i].clear();
+    r.ns[i].reserve(c.messages.size() * repetitions);
+    r.repetitionStarts[i].clear();
+    r.allocations[i] = 0;
+  }
+  r.frames = 0;
+  r.elapsedNs = 0;
+  r.bestElapsedNs = 0;
+  r.summaries.clear();
+  r.reframedMatches = true;
+  r.rejected = 0;
+
+  //Everything the loop touches is allocated up front so only the stages show up in the counts
+  RxRing* ring = new RxRing();
+  RfifoMessage* msg = new RfifoMessage();
+  ClientStub* client = new ClientStub();
+  Game* game = new Game();
+  uint8_t* arenaMemory = new uint8_t[GAME_ARENA_SIZE];
+  GameArena arena;
+  arenaInit(arena, arenaMemory, GAME_ARENA_SIZE);
+  game->arena = &arena;
+  std::string summary;
+  summary.reserve(1024 * 1024);
+
+  for (int rep = 0; rep < repetitions; rep++) {
+    bool gameInProgress = false;
+    for (int i = 0; i < STAGE_COUNT; i++) r.repetitionStarts[i].push_back(r.ns[i].size());
+    uint64_t start = hostNs();
+
+    for (size_t i = 0; i < c.messages.size(); i++) {
+      const CorpusMessage& m = c.messages[i];
+      ringIngest(*ring, c.stream.data() + m.offset, m.size);
+
+      uint64_t allocations = allocationCount;
+      uint64_t t = hostNs();
+
+      ringReadMessage(*ring, *msg);
+      recordStage(r, STAGE_POP, t, allocations);
+      if (!msg->success) {
+        r.rejected++;
+        continue;
+      }
+
+      switch (msg->eventCode) {
+        case EVENT_GAME_START:
+          arenaReset(arena);
+          decodeGameStart(*game, msg->data);
+          gameInProgress = true;
+          recordStage(r, STAGE_DECODE, t, allocations);
+          break;
+        case EVENT_UPDATE:
+          decodeUpdate(*game, msg->data);
+          recordStage(r, STAGE_DECODE, t, allocations);
+          computeGameStatistics(*game);
+          recordStage(r, STAGE_STATS, t, allocations);
+          r.frames++;
+          break;
+        case EVENT_GAME_END:
+          decodeGameEnd(*game, msg->data);
+          recordStage(r, STAGE_DECODE, t, allocations);
+          break;
+      }
+
+      client->length = 0;
+      writeMsg(*client, *msg);
+      recordStage(r, STAGE_FRAME, t, allocations);
+
+      if (rep == 0) {
+        const uint8_t* original = c.stream.data() + m.offset - STREAM_HEADER_SIZE;
+        if (client->length != (int)(STREAM_HEADER_SIZE + m.size) || memcmp(client->buffer, original, client->length) != 0) {
+          r.reframedMatches = false;
+        }
+      }
+
+      if (msg->eventCode == EVENT_GAME_END && gameInProgress) {
+        summary.clear();
+        printGameSummary(summary, *game);
+        recordStage(r, STAGE_SUMMARY, t, allocations);
+        if (rep == 0) r.summaries += summary + "\n";
+        gameInProgress = false;
+      }
+    }
+
+    uint64_t elapsed = hostNs() - start;
+    r.elapsedNs += elapsed;
+    if (r.bestElapsedNs == 0 || elapsed < r.bestElapsedNs) r.bestElapsedNs = elapsed;
+  }
+
+  r.frames /= repetitions;
+  delete ring;
+  delete msg;
+  delete client;
+  delete game;
+  delete[] arenaMemory;
+}
+
+uint32_t percentile(std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end, double p) {
+  if (begin == end) return 0;
+  size_t idx = (size_t)(p * (end - begin - 1) + 0.5);
+  std::nth_element(begin, begin + idx, end);
+  return begin[idx];
+}
+
+//The median of the fastest repetition. Other processes only ever make a repetition slower, so this is
+//the number that moves least between runs on a busy machine
+uint32_t bestMedian(CorpusResult& r, int stage) {
+  std::vector<uint32_t>& ns = r.ns[stage];
+  const std::vector<size_t>& starts = r.repetitionStarts[stage];
+
+  uint32_t best = 0;
+  for (size_t i = 0; i < starts.size(); i++) {
+    size_t end = i + 1 < starts.size() ? starts[i + 1] : ns.size();
+    if (end == starts[i]) continue;
+    uint32_t median = percentile(ns.begin() + starts[i], ns.begin() + end, 0.5);
+    if (best == 0 || median < best) best = median;
+  }
+  return best;
+}
+
+//**********************************************************************
+//*                         Baseline and Golden
+//**********************************************************************
+//baseline.txt holds one "corpus metric value" per line. The best repetition's median, allocations and
+//best throughput are compared. Percentiles over every call are only reported, one scheduler hiccup
+//moves the p99
+typedef std::map<std::string, double> Metrics;
+
+void collectMetrics(Metrics& metrics, const std::string& corpus, CorpusResult& r) {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    std::string key = corpus + " " + stageNames[i];
+    size_t calls = r.ns[i].size();
+    metrics[key + ".best"] = bestMedian(r, i);
+    metrics[key + ".p50"] = percentile(r.ns[i].begin(), r.ns[i].end(), 0.5);
+    metrics[key + ".p99"] = percentile(r.ns[i].begin(), r.ns[i].end(), 0.99);
+    metrics[key + ".allocs"] = calls > 0 ? (double)r.allocations[i] / calls : 0;
+  }
+  metrics[corpus + " throughput"] = r.bestElapsedNs > 0 ? r.frames / (r.bestElapsedNs / 1e9) : 0;
+}
+
+bool loadMetrics(Metrics& metrics, const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[256], corpus[128], metric[64];
+  double value;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%127s %63s %lf", corpus, metric, &value) == 3) metrics[std::string(corpus) + " " + metric] = value;
+  }
+
+  fclose(f);
+  return true;
+}
+
+bool saveMetrics(const Metrics& metrics, const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+
+  fprintf(f, "#PipelineBenchmark baseline, rewrite with -w. Times in ns per call, allocs per call, throughput in frames/s\n");
+  for (Metrics::const_iterator it = metrics.begin(); it != metrics.end(); ++it) {
+    fprintf(f, "%s %.2f\n", it->first.c_str(), it->second);
+  }
+
+  fclose(f);
+  return true;
+}
+
+//Returns the number of regressions
+int compareMetrics(const Metrics& current, const Metrics& baseline, double tolerance) {
+  int regressions = 0;
+  for (Metrics::const_iterator it = current.begin(); it != current.end(); ++it) {
+    Metrics::const_iterator base = baseline.find(it->first);
+    if (base == baseline.end()) continue;
+
+    const std::string& key = it->first;
+    bool regressed = false;
+    if (key.size() > 5 && key.compare(key.size() - 5, 5, ".best") == 0) regressed = it->second > base->second * (1 + tolerance) + 50;
+    else if (key.size() > 7 && key.compare(key.size() - 7, 7, ".allocs") == 0) regressed = it->second > base->second + 0.001;
+    else if (key.size() > 10 && key.compare(key.size() - 10, 10, "throughput") == 0) regressed = it->second < base->second / (1 + tolerance);
+
+    if (regressed) {
+      printf("REGRESSION %s: %.2f (baseline %.2f)\n", key.c_str(), it->second, base->second);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+bool readFile(const std::string& path, std::string& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+
+  char buffer[4096];
+  size_t read;
+  out.clear();
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) out.append(buffer, read);
+  fclose(f);
+  return true;
+}
+
+bool writeFile(const std::string& path, const std::string& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  return true;
+}
+
+//Returns false if the summaries differ from the golden file
+bool checkGolden(const std::string& path, const std::string& summaries) {
+  std::string golden;
+  if (!readFile(path, golden)) {
+    printf("GOLDEN %s: missing, run with -w to create it\n", path.c_str());
+    return false;
+  }
+  if (golden == summaries) return true;
+
+  size_t at = 0;
+  while (at < golden.size() && at < summaries.size() && golden[at] == summaries[at]) at++;
+  size_t from = at > 40 ? at - 40 : 0;
+  printf("GOLDEN %s: differs at byte %lu\n  expected ...%s\n  actual   ...%s\n", path.c_str(), (unsigned long)at,
+    golden.substr(from, 80).c_str(), summaries.substr(from, 80).c_str());
+  return false;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  std::vector<const char*> captures;
+  int repetitions = 10;
+  double tolerance = 1.0; //Shared build machines easily swing 50% between runs
+  const char* baselinePath = "baseline.txt";
+  std::string goldenDir = "golden";
+  const char* captureOut = NULL;
+  bool write = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "i:r:t:b:g:o:w")) != -1) {
+    switch (opt) {
+      case 'i': captures.push_back(optarg); break;
+      case 'r': repetitions = atoi(optarg); break;
+      case 't': tolerance = atof(optarg) / 100; break;
+      case 'b': baselinePath = optarg; break;
+      case 'g': goldenDir = optarg; break;
+      case 'o': captureOut = optarg; break;
+      case 'w': write = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-i capture]... [-r repetitions] [-t tolerancePercent] [-b baseline] [-g goldenDir] [-o captureOut] [-w]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (repetitions < 1) repetitions = 1;
+  asmEventsInitialize();
+
+  std::vector<Corpus> corpora;
+  buildSyntheticCorpora(corpora);
+
+  if (captureOut && !writeFile(captureOut, std::string(corpora[0].stream.begin(), corpora[0].stream.end()))) {
+    fprintf(stderr, "Failed to write %s\n", captureOut);
+    return 1;
+  }
+
+  for (size_t i = 0; i < captures.size(); i++) {
+    Corpus c;
+    if (!loadCapture(c, captures[i])) {
+      fprintf(stderr, "Failed to read capture %s, it is missing, corrupt or truncated\n", captures[i]);
+      return 1;
+    }
+    corpora.push_back(c);
+  }
+
+  Metrics baseline;
+  bool hasBaseline = !write && loadMetrics(baseline, baselinePath);
+  if (!write && !hasBaseline) printf("No baseline at %s, run with -w to create it\n", baselinePath);
+
+  Metrics metrics;
+  int failures = 0;
+  CorpusResult* r = new CorpusResult();
+
+  for (size_t i = 0; i < corpora.size(); i++) {
+    const Corpus& c = corpora[i];
+    runCorpus(c, repetitions, *r);
+    collectMetrics(metrics, c.name, *r);
+
+    printf("%s: %lu messages, %llu frames, %.0f frames/s\n", c.name.c_str(), (unsigned long)c.messages.size(),
+      (unsigned long long)r->frames, metrics[c.name + " throughput"]);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+      std::string key = c.name + " " + stageNames[s];
+      printf("  %-8s calls=%-8lu best=%6.0fns p50=%6.0fns p99=%6.0fns allocs/call=%.2f\n", stageNames[s],
+        (unsigned long)r->ns[s].size(), metrics[key + ".best"], metrics[key + ".p50"], metrics[key + ".p99"],
+        metrics[key + ".allocs"]);
+    }
+
+    if (r->rejected > 0) {
+      printf("  %llu messages were rejected by the pop stage\n", (unsigned long long)r->rejected);
+      failures++;
+    }
+    if (!r->reframedMatches) {
+      printf("  writeMsg did not reproduce the corpus stream\n");
+      failures++;
+    }
+
+    std::string goldenPath = goldenDir + "/" + c.name + ".json";
+    if (write) {
+      if (!writeFile(goldenPath, r->summaries)) {
+        fprintf(stderr, "Failed to write %s\n", goldenPath.c_str());
+        failures++;
+      }
+    } else if (!checkGolden(goldenPath, r->summaries)) {
+      failures++;
+    }
+  }
+
+  delete r;
+
+  if (write) {
+    if (!saveMetrics(metrics, baselinePath)) {
+      fprintf(stderr, "Failed to write %s\n", baselinePath);
+      return 1;
+    }
+    printf("Wrote %s and %s/\n", baselinePath, goldenDir.c_str());
+  } else if (hasBaseline) {
+    failures += compareMetrics(metrics, baseline, tolerance);
+  }
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
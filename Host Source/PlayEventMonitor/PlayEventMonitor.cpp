@@ -0,0 +1,549 @@
+//PlayEventMonitor - follows the play events EnhMelee1294Firmware pushes during a game and rebuilds the end
+//of game summary from them, printing each event as it arrives and the summary when the game ends.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings PlayEventMonitor.cpp -o PlayEventMonitor
+//Usage: PlayEventMonitor -d deviceIp [-q] | -c
+//  -q prints only the summaries, not every event
+//  -c checks queueing, encoding and the rebuilt summary against the firmware headers and exits, non-zero on failure
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/playevents.h"
+
+#define CONFIG_PORT 3637
+#define MAX_PORTS 4
+#define REQUEST_INTERVAL_S 5 //The push request is repeated so a board that restarted picks the host up again
+
+//**********************************************************************
+//*                          Summary Rebuild
+//**********************************************************************
+//The same numbers postGameEndMessage() sends, added up from the events
+typedef struct {
+  bool seen;
+  uint16_t rollCount;
+  uint16_t spotDodgeCount;
+  uint16_t airDodgeCount;
+  uint16_t recoveryAttempts;
+  uint16_t successfulRecoveries;
+  uint16_t edgeguardChances;
+  uint16_t edgeguardConversions;
+  uint16_t numberOfOpenings;
+
+  uint16_t combos;
+  float damageSum;
+  uint32_t framesSum;
+  uint32_t hitsSum;
+  float mostDamageString;
+  uint32_t mostTimeString;
+  uint16_t mostHitsString;
+
+  uint8_t stocksLost;
+  StockStatistics stocks[STOCK_COUNT]; //Lost stocks only
+} RebuiltPlayer;
+
+typedef struct {
+  bool started;
+  bool ended;
+  uint16_t stage;
+  uint32_t endFrame;
+  uint8_t winCondition;
+  uint64_t startServerTime; //0 if the board had not synced with the time server, or predates the stamp
+  uint64_t endServerTime;
+  RebuiltPlayer players[MAX_PORTS]; //By port - 1
+
+  //Stream health
+  uint32_t events;
+  uint32_t nextSequence;
+  uint32_t lostEvents; //Gaps in the sequence, datagrams that never arrived
+  uint32_t dropped; //Events the board could not queue, as last reported
+} RebuiltGame;
+
+typedef struct {
+  uint8_t kind;
+  uint8_t port;
+  uint32_t frame;
+  const uint8_t* payload;
+  int payloadSize;
+} PlayEvent;
+
+uint32_t readBig(const uint8_t* value, int& idx, int bytes) {
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) result = (result << 8) | value[idx++];
+  return result;
+}
+
+uint64_t readLong(const uint8_t* value, int& idx) {
+  uint64_t high = readBig(value, idx, 4);
+  return high << 32 | readBig(value, idx, 4);
+}
+
+float readFloat(const uint8_t* value, int& idx) {
+  uint32_t bits = readBig(value, idx, 4);
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void rebuildReset(RebuiltGame& g) {
+  uint32_t nextSequence = g.nextSequence;
+  uint32_t lostEvents = g.lostEvents;
+  uint32_t dropped = g.dropped;
+  memset(&g, 0, sizeof(g));
+  g.nextSequence = nextSequence;
+  g.lostEvents = lostEvents;
+  g.dropped = dropped;
+}
+
+float averagePerCombo(const RebuiltPlayer& p, float sum) {
+  return p.combos > 0 ? sum / p.combos : 0;
+}
+
+//Returns false for an event that is too short for its kind or from a port that cannot exist
+bool rebuildApply(RebuiltGame& g, const PlayEvent& e) {
+  static const int payloadSizes[] = { -1, 2, 1, 4, 10, 0, 2, 0, 10, 0, 0, 0 };
+  if (e.kind == 0 || e.kind > PLAY_EVENT_AIR_DODGE || e.payloadSize < payloadSizes[e.kind]) return false;
+  //The server time stamps were added after the events, boards without them send the shorter payloads
+  int idx = 0;
+  if (e.kind == PLAY_EVENT_GAME_START) {
+    rebuildReset(g);
+    g.started = true;
+    g.stage = readBig(e.payload, idx, 2);
+    if (e.payloadSize >= 10) g.startServerTime = readLong(e.payload, idx);
+    return true;
+  }
+
+  g.events++;
+  if (e.kind == PLAY_EVENT_GAME_END) {
+    g.ended = true;
+    g.endFrame = e.frame;
+    g.winCondition = e.payload[idx++];
+    if (e.payloadSize >= 9) g.endServerTime = readLong(e.payload, idx);
+    return true;
+  }
+
+  if (e.port == 0 || e.port > MAX_PORTS) return false;
+  RebuiltPlayer& p = g.players[e.port - 1];
+  p.seen = true;
+
+  switch (e.kind) {
+    case PLAY_EVENT_OPENING: p.numberOfOpenings++; break;
+    case PLAY_EVENT_COMBO_END: {
+      uint16_t hits = readBig(e.payload, idx, 2);
+      float damage = readFloat(e.payload, idx);
+      uint32_t frames = readBig(e.payload, idx, 4);
+      p.combos++;
+      p.hitsSum += hits;
+      p.damageSum += damage;
+      p.framesSum += frames;
+      if (damage > p.mostDamageString) p.mostDamageString = damage;
+      if (frames > p.mostTimeString) p.mostTimeString = frames;
+      if (hits > p.mostHitsString) p.mostHitsString = hits;
+      break;
+    }
+    case PLAY_EVENT_RECOVERY_END: {
+      p.recoveryAttempts++;
+      if (e.payload[0]) p.successfulRecoveries++;
+
+      uint8_t opponent = e.payload[1];
+      if (opponent == 0 || opponent > MAX_PORTS) return false;
+      g.players[opponent - 1].seen = true;
+      g.players[opponent - 1].edgeguardChances++;
+      break;
+    }
+    case PLAY_EVENT_EDGEGUARD: p.edgeguardConversions++; break;
+    case PLAY_EVENT_STOCK_LOST: {
+      uint8_t stock = e.payload[idx++];
+      if (stock >= STOCK_COUNT) return false;
+      StockStatistics& ss = p.stocks[stock];
+      ss.isStockUsed = true;
+      ss.isStockLost = true;
+      ss.frame = e.frame;
+      ss.percent = readFloat(e.payload, idx);
+      ss.lastHitBy = e.payload[idx++];
+      ss.lastAnimation = readBig(e.payload, idx, 2);
+      ss.killedInOpenings = readBig(e.payload, idx, 2);
+      p.stocksLost++;
+      break;
+    }
+    case PLAY_EVENT_ROLL: p.rollCount++; break;
+    case PLAY_EVENT_SPOT_DODGE: p.spotDodgeCount++; break;
+    case PLAY_EVENT_AIR_DODGE: p.airDodgeCount++; break;
+  }
+
+  return true;
+}
+
+void printEvent(const PlayEvent& e) {
+  static const char* names[] = { "?", "game start", "game end", "opening", "combo end", "recovery start", "recovery end",
+    "edgeguard", "stock lost", "roll", "spot dodge", "air dodge" };
+  const char* name = e.kind <= PLAY_EVENT_AIR_DODGE ? names[e.kind] : names[0];
+
+  int idx = 0;
+  printf("frame %6u P%u %s", e.frame, e.port, name);
+  if (e.kind == PLAY_EVENT_COMBO_END && e.payloadSize >= 10) {
+    uint16_t hits = readBig(e.payload, idx, 2);
+    float damage = readFloat(e.payload, idx);
+    printf(" %u hits %.1f%% %u frames", hits, damage, readBig(e.payload, idx, 4));
+  } else if (e.kind == PLAY_EVENT_RECOVERY_END && e.payloadSize >= 1) {
+    printf(" %s", e.payload[0] ? "recovered" : "died");
+  } else if (e.kind == PLAY_EVENT_STOCK_LOST && e.payloadSize >= 5) {
+    uint8_t stock = e.payload[idx++];
+    printf(" %u at %.1f%%", stock + 1, readFloat(e.payload, idx));
+  }
+  printf("\n");
+}
+
+void printSummary(const RebuiltGame& g) {
+  printf("Game over at frame %u on stage %u (win condition %u), %u events, %u lost, %u dropped by the board\n",
+    g.endFrame, g.stage, g.winCondition, g.events, g.lostEvents, g.dropped);
+  if (g.startServerTime != 0 && g.endServerTime > g.startServerTime) {
+    printf("  Server time %llu to %llu, %.3f s\n", (unsigned long long)g.startServerTime, (unsigned long long)g.endServerTime,
+      (g.endServerTime - g.startServerTime) / 1e6);
+  }
+  for (int i = 0; i < MAX_PORTS; i++) {
+    const RebuiltPlayer& p = g.players[i];
+    if (!p.seen) continue;
+
+    printf("  P%d openings %u avg %.1f%% %.1f hits %.0f frames, most %.1f%% %u hits %u frames | recovered %u/%u edgeguards %u/%u"
+      " | rolls %u spot %u air %u | stocks lost %u\n", i + 1, p.numberOfOpenings, averagePerCombo(p, p.damageSum),
+      averagePerCombo(p, p.hitsSum), averagePerCombo(p, p.framesSum), p.mostDamageString, p.mostHitsString, p.mostTimeString,
+      p.successfulRecoveries, p.recoveryAttempts, p.edgeguardConversions, p.edgeguardChances, p.rollCount, p.spotDodgeCount,
+      p.airDodgeCount, p.stocksLost);
+  }
+}
+
+//Applies every event of a datagram. Returns false if it is not a play events datagram
+bool decodeDatagram(const uint8_t* packet, int size, RebuiltGame& g, bool printEvents, bool printSummaries) {
+  TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!tlvOpen(r, packet, size) || r.type != MSG_TYPE_PLAY_EVENTS) return false;
+
+  uint32_t sequence = g.nextSequence;
+  while (tlvNext(r, tag, value, length)) {
+    int idx = 0;
+    if (tag == TLV_EVENT_STREAM && length == 8) {
+      sequence = readBig(value, idx, 4);
+      g.dropped = readBig(value, idx, 4);
+
+      //Behind the expected sequence means the board started the stream over
+      if (sequence > g.nextSequence) g.lostEvents += sequence - g.nextSequence;
+    } else if (tag == TLV_PLAY_EVENT && length >= PLAY_EVENT_HEADER_SIZE) {
+      PlayEvent e;
+      e.kind = value[idx++];
+      e.port = value[idx++];
+      e.frame = readBig(value, idx, 4);
+      e.payload = value + idx;
+      e.payloadSize = length - idx;
+      if (printEvents) printEvent(e);
+      if (rebuildApply(g, e) && e.kind == PLAY_EVENT_GAME_END && printSummaries) printSummary(g);
+      sequence++;
+    }
+  }
+
+  g.nextSequence = sequence;
+  return true;
+}
+
+//**********************************************************************
+//*                             Self Check
+//**********************************************************************
+//Plays a game against the queue the way computeStatistics() does, keeping the statistics it would and
+//queueing the same events. Datagrams are drained every drainFrames frames, and dropDatagram of them
+//(1 based, 0 for none) never arrives
+#define CHECK_START_SERVER_TIME 1760000000000000ULL //Microseconds since the Unix epoch, more than 32 bits
+
+typedef struct {
+  uint32_t frames;
+  uint32_t drainFrames;
+  int dropDatagram;
+  bool enabled;
+} CheckGame;
+
+uint32_t checkRandom = 1;
+
+uint32_t nextRandom(uint32_t range) {
+  checkRandom = checkRandom * 1103515245 + 12345;
+  return (checkRandom >> 16) % range;
+}
+
+typedef struct {
+  PlayerStatistics stats[PLAYER_COUNT];
+  uint8_t ports[PLAYER_COUNT];
+  int datagrams;
+  int bytes;
+  int largestDatagram;
+  uint32_t largestBatch;
+} CheckResult;
+
+//Sends everything queued, as many datagrams as it takes
+void drainCheckQueue(PlayEventQueue& q, RebuiltGame& g, const CheckGame& c, CheckResult& result) {
+  static uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  if (playEventsPending(q) > result.largestBatch) result.largestBatch = playEventsPending(q);
+
+  TlvWriter w;
+  while (true) {
+    tlvBegin(w, packet, sizeof(packet), MSG_TYPE_PLAY_EVENTS, 0);
+    if (playEventsAppend(w, q) == 0) break;
+    result.datagrams++;
+    result.bytes += w.size;
+    if (w.size > result.largestDatagram) result.largestDatagram = w.size;
+    if (result.datagrams != c.dropDatagram) decodeDatagram(packet, w.size, g, false, false);
+  }
+}
+
+void playCheckGame(PlayEventQueue& q, RebuiltGame& g, const CheckGame& c, CheckResult& result) {
+  Player players[PLAYER_COUNT] = { };
+  memset(&result, 0, sizeof(result));
+  checkRandom = 1;
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    players[i].controllerPort = i * 2;
+    currentFrame(players[i]).stocks = STOCK_COUNT;
+    result.ports[i] = i * 2 + 1;
+  }
+
+  playEventsReset(q, c.enabled);
+  playEventGameStart(q, 0, 31, CHECK_START_SERVER_TIME);
+
+  for (uint32_t frame = 1; frame <= c.frames; frame++) {
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      Player& cp = players[i];
+      Player& op = players[!i];
+      uint8_t port = cp.controllerPort + 1;
+
+      switch (nextRandom(500)) {
+        case 0: cp.stats.rollCount++; playEventQueue(q, PLAY_EVENT_ROLL, port, frame); break;
+        case 1: cp.stats.spotDodgeCount++; playEventQueue(q, PLAY_EVENT_SPOT_DODGE, port, frame); break;
+        case 2: cp.stats.airDodgeCount++; playEventQueue(q, PLAY_EVENT_AIR_DODGE, port, frame); break;
+        case 3: case 4: {
+          //An opening and the string it started, with the running averages computeStatistics() keeps
+          float startPercent = currentFrame(op).percent;
+          cp.stats.numberOfOpenings++;
+          playEventOpening(q, port, frame, startPercent);
+
+          uint16_t hits = 1 + nextRandom(6);
+          float percent = hits * (4 + nextRandom(80) / 8.0f);
+          uint32_t frames = 10 + nextRandom(200);
+          currentFrame(op).percent += percent;
+          PlayerStatistics& s = cp.stats;
+          s.averageDamagePerString = ((s.numberOfOpenings - 1)*s.averageDamagePerString + percent) / s.numberOfOpenings;
+          s.averageTimePerString = ((s.numberOfOpenings - 1)*s.averageTimePerString + frames) / s.numberOfOpenings;
+          s.averageHitsPerString = ((s.numberOfOpenings - 1)*s.averageHitsPerString + hits) / s.numberOfOpenings;
+          if (percent > s.mostDamageString) s.mostDamageString = percent;
+          if (frames > s.mostTimeString) s.mostTimeString = frames;
+          if (hits > s.mostHitsString) s.mostHitsString = hits;
+          playEventComboEnd(q, port, frame, hits, percent, frames);
+          break;
+        }
+        case 5: {
+          playEventQueue(q, PLAY_EVENT_RECOVERY_START, port, frame);
+          bool recovered = nextRandom(3) != 0 || currentFrame(cp).stocks == 1;
+          cp.stats.recoveryAttempts++;
+          op.stats.edgeguardChances++;
+          if (recovered) cp.stats.successfulRecoveries++;
+          else op.stats.edgeguardConversions++;
+          playEventRecoveryEnd(q, port, frame, recovered, op.controllerPort + 1);
+          if (recovered) break;
+
+          playEventQueue(q, PLAY_EVENT_EDGEGUARD, op.controllerPort + 1, frame);
+          int stock = STOCK_COUNT - currentFrame(cp).stocks;
+          StockStatistics& ss = cp.stats.stocks[stock];
+          ss.isStockUsed = true;
+          ss.isStockLost = true;
+          ss.frame = frame;
+          ss.percent = currentFrame(cp).percent;
+          ss.lastHitBy = nextRandom(60);
+          ss.lastAnimation = nextRandom(400);
+          ss.killedInOpenings = op.stats.numberOfOpenings;
+          for (int j = 0; j < stock; j++) ss.killedInOpenings -= cp.stats.stocks[j].killedInOpenings;
+          playEventStockLost(q, port, frame, stock, ss);
+          currentFrame(cp).stocks--;
+          currentFrame(cp).percent = 0;
+          break;
+        }
+      }
+    }
+
+    if (frame % c.drainFrames == 0) drainCheckQueue(q, g, c, result);
+  }
+
+  drainCheckQueue(q, g, c, result);
+  playEventGameEnd(q, c.frames, 2, CHECK_START_SERVER_TIME + c.frames * 16667ULL);
+  drainCheckQueue(q, g, c, result);
+
+  for (int i = 0; i < PLAYER_COUNT; i++) result.stats[i] = players[i].stats;
+}
+
+bool closeEnough(float a, float b) {
+  return fabsf(a - b) <= 0.001f * (fabsf(a) > 1 ? fabsf(a) : 1);
+}
+
+int compareRebuilt(const RebuiltGame& g, const CheckResult& result) {
+  int failures = 0;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerStatistics& s = result.stats[i];
+    const RebuiltPlayer& p = g.players[result.ports[i] - 1];
+
+    bool counts = p.rollCount == s.rollCount && p.spotDodgeCount == s.spotDodgeCount && p.airDodgeCount == s.airDodgeCount &&
+      p.recoveryAttempts == s.recoveryAttempts && p.successfulRecoveries == s.successfulRecoveries &&
+      p.edgeguardChances == s.edgeguardChances && p.edgeguardConversions == s.edgeguardConversions &&
+      p.numberOfOpenings == s.numberOfOpenings;
+    bool strings = closeEnough(averagePerCombo(p, p.damageSum), s.averageDamagePerString) &&
+      closeEnough(averagePerCombo(p, p.framesSum), s.averageTimePerString) &&
+      closeEnough(averagePerCombo(p, p.hitsSum), s.averageHitsPerString) && p.mostDamageString == s.mostDamageString &&
+      p.mostTimeString == s.mostTimeString && p.mostHitsString == s.mostHitsString;
+    bool stocks = true;
+    for (int j = 0; j < STOCK_COUNT; j++) {
+      const StockStatistics& a = p.stocks[j];
+      const StockStatistics& b = s.stocks[j];
+      if (a.isStockLost != b.isStockLost || a.frame != b.frame || a.percent != b.percent || a.lastHitBy != b.lastHitBy ||
+        a.lastAnimation != b.lastAnimation || a.killedInOpenings != b.killedInOpenings) stocks = false;
+    }
+
+    if (!counts || !strings || !stocks) {
+      fprintf(stderr, "Rebuilt P%u does not match:%s%s%s\n", result.ports[i], counts ? "" : " counts", strings ? "" : " strings",
+        stocks ? "" : " stocks");
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int runCheck() {
+  static PlayEventQueue q;
+  static RebuiltGame g;
+  CheckResult result;
+  int failures = 0;
+
+  //A full length game drained once a frame, as the background task does, rebuilds exactly
+  CheckGame c = { 28800, 1, 0, true };
+  memset(&g, 0, sizeof(g));
+  playCheckGame(q, g, c, result);
+  failures += compareRebuilt(g, result);
+  if (!g.started || !g.ended || g.endFrame != c.frames || g.lostEvents != 0 || g.dropped != 0 || q.dropped != 0) {
+    fprintf(stderr, "Stream was not complete: start %d end %d lost %u dropped %u\n", g.started, g.ended, g.lostEvents, g.dropped);
+    failures++;
+  }
+  if (g.startServerTime != CHECK_START_SERVER_TIME || g.endServerTime != CHECK_START_SERVER_TIME + c.frames * 16667ULL) {
+    fprintf(stderr, "Server time stamps did not survive: %llu to %llu\n", (unsigned long long)g.startServerTime,
+      (unsigned long long)g.endServerTime);
+    failures++;
+  }
+  printf("Game of %u frames: %u events in %d datagrams, largest %d of %d bytes, %.1f bytes per event\n", c.frames, g.events + 1,
+    result.datagrams, result.largestDatagram, UDP_BINARY_MAX_PACKET_SIZE, float(result.bytes) / (g.events + 1));
+
+  //Draining only every 10 seconds batches several datagrams at once and still rebuilds exactly
+  c.drainFrames = 600;
+  memset(&g, 0, sizeof(g));
+  playCheckGame(q, g, c, result);
+  failures += compareRebuilt(g, result);
+  if (g.lostEvents != 0 || q.dropped != 0 || result.largestBatch > PLAY_EVENT_QUEUE_SIZE) {
+    fprintf(stderr, "Batched drain lost %u events, dropped %u\n", g.lostEvents, q.dropped);
+    failures++;
+  }
+  printf("Drained every %u frames: up to %u events pending, %d datagrams\n", c.drainFrames, result.largestBatch, result.datagrams);
+
+  //Not draining for a minute fills the ring. What did not fit is dropped and reported, never overwritten
+  c.drainFrames = 3600;
+  memset(&g, 0, sizeof(g));
+  playCheckGame(q, g, c, result);
+  if (q.dropped == 0 || g.dropped != q.dropped || g.lostEvents != 0 || !g.ended) {
+    fprintf(stderr, "Full ring dropped %u events, host saw %u\n", q.dropped, g.dropped);
+    failures++;
+  }
+  printf("Drained every %u frames: %u events dropped by the board\n", c.drainFrames, g.dropped);
+
+  //A datagram lost on the way shows up as a gap of exactly the events it carried
+  c.drainFrames = 1;
+  c.dropDatagram = 5;
+  memset(&g, 0, sizeof(g));
+  playCheckGame(q, g, c, result);
+  uint32_t queued = q.head;
+  if (g.lostEvents == 0 || g.events + 1 + g.lostEvents != queued) {
+    fprintf(stderr, "Lost datagram not seen: %u received, %u lost, %u queued\n", g.events + 1, g.lostEvents, queued);
+    failures++;
+  }
+
+  //Nothing is queued while no host listens
+  c.dropDatagram = 0;
+  c.enabled = false;
+  memset(&g, 0, sizeof(g));
+  playCheckGame(q, g, c, result);
+  if (q.head != 0 || q.dropped != 0 || result.datagrams != 0) {
+    fprintf(stderr, "Events were queued with the stream disabled\n");
+    failures++;
+  }
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  const char* deviceIp = NULL;
+  bool quiet = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:qc")) != -1) {
+    switch (opt) {
+      case 'd': deviceIp = optarg; break;
+      case 'q': quiet = true; break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s -d deviceIp [-q] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!deviceIp) {
+    fprintf(stderr, "Usage: %s -d deviceIp [-q] | -c\n", argv[0]);
+    return 1;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(fd);
+    return 1;
+  }
+
+  static RebuiltGame g;
+  uint16_t sequence = 1;
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  time_t lastRequest = 0;
+  while (true) {
+    //Repeated while nothing arrives, in case the board restarted and forgot this host
+    if (time(NULL) - lastRequest >= REQUEST_INTERVAL_S) {
+      TlvWriter w;
+      tlvBegin(w, packet, sizeof(packet), MSG_TYPE_PLAY_EVENTS, sequence++);
+      tlvAppendByte(w, TLV_EVENT_PUSH, 1);
+      sendto(fd, w.buffer, w.size, 0, (sockaddr*)&addr, sizeof(addr));
+      lastRequest = time(NULL);
+    }
+
+    pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 1000) > 0) {
+      int size = recv(fd, packet, sizeof(packet), 0);
+      if (size > 0 && decodeDatagram(packet, size, g, !quiet, true)) lastRequest = time(NULL);
+    }
+  }
+}
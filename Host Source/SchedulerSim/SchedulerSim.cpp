@@ -0,0 +1,342 @@
+//SchedulerSim - runs the board's cooperative scheduler (scheduler.h) on a simulated 120MHz cycle counter
+//to find the worst case wait between a frame arriving and the main loop starting on it. The background
+//tasks are models with the board's periods and budgets that cost simulated time, and can stall now and
+//then like a slow network. The same run can be made with the old main loop, which did all of the network
+//work on every pass, for comparison, or with the core sleeping between frames (idle.h).
+//
+//Build (Linux): g++ -O2 -std=c++11 SchedulerSim.cpp -o SchedulerSim
+//Usage: SchedulerSim [-f frames] [-j jitterUs] [-e stallEvery] [-s stallUs] [-n] [-z] [-c]
+//  -e and -s make one run in every stallEvery of the udp task take stallUs longer than its budget
+//  -n simulates the old main loop instead of the scheduler
+//  -z sleeps the core when there is nothing to run, like the board with idle sleep enabled
+//  -c runs the checks and exits, the exit code is non-zero on failure
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/latency.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/scheduler.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/idle.h"
+
+#define CYCLES_PER_US 120 //TM4C1294 at F_CPU
+#define FRAME_PROCESSING_US 250 //Decode, stats and telemetry of one frame
+#define IDLE_PASS_US 2 //A loop() pass with nothing to do
+#define WAKE_US 3 //Interrupt entry, the handler and getting back to loop() after WFI
+
+//**********************************************************************
+//*                          Simulated Board
+//**********************************************************************
+typedef struct {
+  const char* name;
+  uint32_t periodUs;
+  uint32_t budgetUs;
+  uint32_t deadlineUs;
+  uint32_t costUs; //What a normal run takes
+  uint32_t stallEvery; //Every Nth run takes stallUs longer, 0 never
+  uint32_t stallUs;
+  uint32_t calls;
+  uint64_t lastRun;
+} TaskModel;
+
+//The tasks ethernetTasksInitialize() adds on the board
+#define TASK_COUNT 7
+TaskModel Models[TASK_COUNT];
+
+void resetModels() {
+  TaskModel models[TASK_COUNT] = {
+    { "udp", 1000, 500, 5000, 40, 0, 0, 0, 0 },
+    { "livestats", 1000, 300, 16683, 5, 0, 0, 0, 0 },
+    { "events", 1000, 300, 16683, 5, 0, 0, 0, 0 },
+    { "timesync", 50000, 300, 50000, 120, 0, 0, 0, 0 },
+    { "client", 100000, 2000, 500000, 30, 0, 0, 0, 0 },
+    { "dhcp", 1000000, 2000, 5000000, 200, 0, 0, 0, 0 },
+    { "boot", 1000, 500, 16683, 5, 0, 0, 0, 0 },
+  };
+  memcpy(Models, models, sizeof(Models));
+}
+
+uint64_t SimCycles = 0;
+
+uint32_t simClock() {
+  return (uint32_t)SimCycles;
+}
+
+//Like the functions on the board a task checks its own interval, the old main loop called them all on
+//every pass and most of those calls returned right away
+template <int I> void simTask() {
+  TaskModel& m = Models[I];
+  if (m.lastRun != 0 && SimCycles - m.lastRun < (uint64_t)m.periodUs * CYCLES_PER_US) {
+    SimCycles += CYCLES_PER_US;
+    return;
+  }
+  m.lastRun = SimCycles;
+  m.calls++;
+  uint32_t us = m.costUs;
+  if (m.stallEvery > 0 && m.calls % m.stallEvery == 0) us += m.budgetUs + m.stallUs;
+  SimCycles += (uint64_t)us * CYCLES_PER_US;
+}
+
+SchedTaskFunction TaskFunctions[TASK_COUNT] = { simTask<0>, simTask<1>, simTask<2>, simTask<3>, simTask<4>, simTask<5>, simTask<6> };
+
+uint32_t simRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+//**********************************************************************
+//*                             Simulation
+//**********************************************************************
+typedef struct {
+  int frames;
+  int jitterUs;
+  uint32_t pauseAtFrame; //The console stops sending after this frame for pauseUs, 0 never
+  uint32_t pauseUs;
+  uint32_t stallEvery; //Every Nth udp run stalls for stallUs past its budget, 0 never
+  uint32_t stallUs;
+  bool naive; //The old main loop: every task on every pass
+  bool sleep; //Sleep when the scheduler has nothing to run instead of polling again
+} SimConfig;
+
+typedef struct {
+  LatencyHistogram wait; //Frame arrival to the loop starting on it
+  uint32_t pauseRuns; //Background task runs while the console was paused
+  uint32_t afterGameRuns; //Background task runs in the second after the game ended
+  IdleStats idle; //Sleeps and wake latency over the game, only with sleep
+} SimResult;
+
+//idleSleep() from the board: the wake timer is set for the next task and the core wakes at that or the
+//next frame, whichever comes first
+void simIdle(const SimConfig& config, Scheduler& s, SimResult& r, uint64_t nextArrival) {
+  uint32_t sleepUs = config.sleep ? schedulerSleepUs(s, simClock()) : 0;
+  if (sleepUs < IDLE_MIN_SLEEP_US) {
+    SimCycles += IDLE_PASS_US * CYCLES_PER_US;
+    return;
+  }
+  if (sleepUs > IDLE_MAX_SLEEP_US) sleepUs = IDLE_MAX_SLEEP_US;
+
+  uint64_t start = SimCycles;
+  uint64_t wake = start + (uint64_t)sleepUs * CYCLES_PER_US;
+  bool woken = nextArrival < wake;
+  if (woken) wake = nextArrival > start ? nextArrival : start;
+  SimCycles = wake + WAKE_US * CYCLES_PER_US;
+  idleRecordSleep(r.idle, (uint32_t)start, simClock(), woken ? (uint32_t)nextArrival : 0);
+}
+
+void simulate(const SimConfig& config, Scheduler& s, SimResult& r) {
+  resetModels();
+  Models[0].stallEvery = config.stallEvery;
+  Models[0].stallUs = config.stallUs;
+  latencyHistogramReset(r.wait, LATENCY_STAGE_BUCKET_US);
+  r.pauseRuns = 0;
+  r.afterGameRuns = 0;
+  r.idle.enabled = config.sleep;
+
+  //Start a few seconds before the 32 bit counter wraps so the wrap is always exercised
+  SimCycles = 0xFFFFFFFFu - 5u * 1000000u * CYCLES_PER_US;
+  schedulerInit(s, simClock, CYCLES_PER_US);
+  for (int i = 0; i < TASK_COUNT; i++) {
+    const TaskModel& m = Models[i];
+    schedulerAddTask(s, m.name, TaskFunctions[i], m.periodUs, m.budgetUs, m.deadlineUs);
+  }
+  idleReset(r.idle, CYCLES_PER_US, simClock());
+
+  uint32_t rng = 0x2545F491;
+  uint64_t consoleCycles = SimCycles + (uint64_t)LATENCY_NOMINAL_FRAME_US * CYCLES_PER_US;
+  uint64_t nextArrival = consoleCycles;
+  int frame = 1;
+  uint64_t pauseStart = 0, pauseEnd = 0;
+
+  while (frame <= config.frames) {
+    //Frames first, everything that has arrived is handled before any background work
+    while (frame <= config.frames && nextArrival <= SimCycles) {
+      latencyHistogramAdd(r.wait, (uint32_t)((SimCycles - nextArrival) / CYCLES_PER_US));
+      uint32_t arrival = (uint32_t)nextArrival;
+      SimCycles += FRAME_PROCESSING_US * CYCLES_PER_US;
+      schedulerFrame(s, arrival);
+
+      //The console keeps its own pace, jitter moves a single arrival without drifting the rest
+      consoleCycles += (uint64_t)LATENCY_NOMINAL_FRAME_US * CYCLES_PER_US;
+      if (config.pauseAtFrame > 0 && (uint32_t)frame == config.pauseAtFrame) {
+        pauseStart = SimCycles;
+        consoleCycles += (uint64_t)config.pauseUs * CYCLES_PER_US;
+        pauseEnd = consoleCycles;
+      }
+      int jitter = config.jitterUs > 0 ? (int)(simRandom(rng) % (2 * config.jitterUs + 1)) - config.jitterUs : 0;
+      nextArrival = consoleCycles + (int64_t)jitter * CYCLES_PER_US;
+      frame++;
+    }
+
+    if (config.naive) {
+      for (int i = 0; i < TASK_COUNT; i++) TaskFunctions[i]();
+    } else if (schedulerRunNext(s) >= 0) {
+      if (SimCycles > pauseStart && SimCycles < pauseEnd) r.pauseRuns++;
+    } else {
+      simIdle(config, s, r, frame <= config.frames ? nextArrival : ~0ull);
+    }
+  }
+  idleAdvance(r.idle, simClock());
+
+  //Game end, then a second with no frames
+  schedulerGameEnd(s);
+  uint64_t end = SimCycles + 1000000ull * CYCLES_PER_US;
+  while (SimCycles < end) {
+    if (schedulerRunNext(s) >= 0) r.afterGameRuns++;
+    else simIdle(config, s, r, ~0ull);
+  }
+}
+
+void printResult(const Scheduler& s, const SimResult& r, const SimConfig& config) {
+  printf("frame wait n=%lu p50=%luus p99=%luus max=%luus (%s)\n", (unsigned long)r.wait.count,
+    (unsigned long)latencyPercentile(r.wait, 50), (unsigned long)latencyPercentile(r.wait, 99),
+    (unsigned long)r.wait.maxUs, config.naive ? "old main loop" : config.sleep ? "scheduler, sleeping" : "scheduler");
+
+  if (!config.naive) {
+    char report[1024];
+    int length = schedulerFormatReport(report, sizeof(report), s);
+    if (config.sleep) idleFormatReport(report + length, sizeof(report) - length, r.idle);
+    printf("%s", report);
+  }
+}
+
+//**********************************************************************
+//*                               Checks
+//**********************************************************************
+int runChecks() {
+  static Scheduler s;
+  SimResult r;
+  int failures = 0;
+
+  //Tasks within their budgets and arrivals within the guard: a frame never waits on a background task,
+  //only on the frame before it, over a run that crosses the counter wrap
+  SimConfig config = { 7200, 400, 0, 0, 0, 0, false, false };
+  simulate(config, s, r);
+  printResult(s, r, config);
+  if (r.wait.maxUs > IDLE_PASS_US + 1) {
+    fprintf(stderr, "A well behaved task delayed a frame by %luus\n", (unsigned long)r.wait.maxUs);
+    failures++;
+  }
+  for (int i = 0; i < s.taskCount; i++) {
+    const SchedTask& t = s.tasks[i];
+    if (t.runs == 0 || t.overruns != 0 || t.deadlineMisses != 0) {
+      fprintf(stderr, "Task %s: %lu runs, %lu overruns, %lu missed deadlines\n", t.name, (unsigned long)t.runs,
+        (unsigned long)t.overruns, (unsigned long)t.deadlineMisses);
+      failures++;
+    }
+  }
+
+  //The same tasks on the old main loop are the baseline the scheduler has to beat
+  SimResult naive;
+  config.naive = true;
+  simulate(config, s, naive);
+  printResult(s, naive, config);
+  if (naive.wait.maxUs <= r.wait.maxUs) {
+    fprintf(stderr, "The scheduler did not improve on the old main loop\n");
+    failures++;
+  }
+
+  //A stalling task cannot be stopped, but every stall is counted as an overrun and delays a frame by no
+  //more than the one run it was stuck in
+  config = (SimConfig){ 7200, 400, 0, 0, 500, 3000, false, false };
+  simulate(config, s, r);
+  printResult(s, r, config);
+  const SchedTask& udp = s.tasks[0];
+  uint32_t stallWorstUs = Models[0].costUs + Models[0].budgetUs + config.stallUs;
+  if (udp.overruns != Models[0].calls / config.stallEvery || r.wait.maxUs > stallWorstUs) {
+    fprintf(stderr, "Stalls: %lu overruns for %lu stalled runs, worst wait %luus (bound %luus)\n",
+      (unsigned long)udp.overruns, (unsigned long)(Models[0].calls / config.stallEvery), (unsigned long)r.wait.maxUs,
+      (unsigned long)stallWorstUs);
+    failures++;
+  }
+
+  //Frames that stop mid-game, as in a pause, must not starve the network
+  config = (SimConfig){ 600, 400, 300, 2000000, 0, 0, false, false };
+  simulate(config, s, r);
+  if (r.pauseRuns < 1000) {
+    fprintf(stderr, "Only %lu background runs during a 2s pause\n", (unsigned long)r.pauseRuns);
+    failures++;
+  }
+
+  //After the game everything runs freely again
+  if (r.afterGameRuns < 1000) {
+    fprintf(stderr, "Only %lu background runs after the game\n", (unsigned long)r.afterGameRuns);
+    failures++;
+  }
+
+  //A game that stops without a game end has to count as over. Otherwise once the 32 bit cycle counter
+  //wraps back around to the last frame, about every 36s, tasks are deferred for a frame that never comes
+  resetModels();
+  schedulerInit(s, simClock, CYCLES_PER_US);
+  schedulerAddTask(s, Models[0].name, TaskFunctions[0], Models[0].periodUs, Models[0].budgetUs, Models[0].deadlineUs);
+  schedulerFrame(s, simClock());
+  uint64_t lastFrame = SimCycles;
+  uint32_t deferralsWhenStopped = 0;
+  while (SimCycles < lastFrame + (1ull << 32) + 100000ull * CYCLES_PER_US) {
+    if (schedulerRunNext(s) < 0) SimCycles += IDLE_PASS_US * CYCLES_PER_US;
+    if (SimCycles < lastFrame + 100000ull * CYCLES_PER_US) deferralsWhenStopped = s.tasks[0].deferrals;
+  }
+  if (s.tasks[0].deferrals != deferralsWhenStopped) {
+    fprintf(stderr, "Deferred %lu times after frames stopped without a game end\n",
+      (unsigned long)(s.tasks[0].deferrals - deferralsWhenStopped));
+    failures++;
+  }
+
+  //Sleeping between frames may only add the wake up to a frame, every task still runs on time, and the
+  //core is awake for little more than the frame processing and the tasks themselves
+  config = (SimConfig){ 7200, 400, 0, 0, 0, 0, false, true };
+  simulate(config, s, r);
+  printResult(s, r, config);
+  if (r.wait.maxUs > WAKE_US + 1 || r.idle.wake.count < (uint32_t)config.frames * 9 / 10) {
+    fprintf(stderr, "Sleeping: worst frame wait %luus, %lu of %d frames woke the core\n", (unsigned long)r.wait.maxUs,
+      (unsigned long)r.idle.wake.count, config.frames);
+    failures++;
+  }
+  for (int i = 0; i < s.taskCount; i++) {
+    const SchedTask& t = s.tasks[i];
+    if (t.runs == 0 || t.deadlineMisses != 0) {
+      fprintf(stderr, "Sleeping, task %s: %lu runs, %lu missed deadlines\n", t.name, (unsigned long)t.runs,
+        (unsigned long)t.deadlineMisses);
+      failures++;
+    }
+  }
+  if (idleDutyCycle(r.idle) > 2500) {
+    fprintf(stderr, "Sleeping: awake %lu.%02lu%% of the time\n", (unsigned long)(idleDutyCycle(r.idle) / 100),
+      (unsigned long)(idleDutyCycle(r.idle) % 100));
+    failures++;
+  }
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  SimConfig config = { 36000, 200, 0, 0, 0, 0, false, false };
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:j:e:s:nzc")) != -1) {
+    switch (opt) {
+      case 'f': config.frames = atoi(optarg); break;
+      case 'j': config.jitterUs = atoi(optarg); break;
+      case 'e': config.stallEvery = atoi(optarg); break;
+      case 's': config.stallUs = atoi(optarg); break;
+      case 'n': config.naive = true; break;
+      case 'z': config.sleep = true; break;
+      case 'c': return runChecks();
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-j jitterUs] [-e stallEvery] [-s stallUs] [-n] [-z] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  static Scheduler s;
+  SimResult r;
+  simulate(config, s, r);
+  printResult(s, r, config);
+  return 0;
+}
@@ -0,0 +1,339 @@
+//SeriesMonitor - follows one bucketed counter of one player from EnhMelee1294Firmware's stat series, the
+//data behind momentum graphs like APM over time or damage per 10 seconds. Every second it asks for the
+//buckets it has not printed yet and prints each one once it is complete, with the rate per minute.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings SeriesMonitor.cpp -o SeriesMonitor
+//Usage: SeriesMonitor -d deviceIp [-p port] [-n channel] [-b bucketFrames] | -c
+//  -p is the controller port, 1 to 4, 1 by default
+//  -n is the channel name, actions by default. An unknown name lists the channels
+//  -b sets the bucket length from the next game on, 60 to 3600 frames
+//  -c checks bucketing and encoding against the firmware headers and exits, non-zero on failure
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/statseries.h"
+
+#define CONFIG_PORT 3637
+
+//In SERIES_* order
+static const char* channelNames[SERIES_CHANNELS] = {
+  "framesAboveOthers", "framesClosestCenter", "framesInShield", "damageDealt", "actions", "openings", "rolls",
+  "spotDodges", "airDodges", "techMisses", "techLeft", "techRight", "techPlace", "wavedashes", "lCancels",
+  "lCancelMisses", "ledgedashes", "shieldDrops", "recoveryAttempts", "successfulRecoveries", "edgeguardChances",
+  "edgeguardConversions",
+};
+
+//**********************************************************************
+//*                               Decode
+//**********************************************************************
+typedef struct {
+  uint8_t status;
+  uint16_t nextBucketFrames;
+  bool hasInfo;
+  uint16_t bucketFrames;
+  uint32_t latest;
+  uint32_t first;
+  bool hasData;
+  uint8_t port;
+  uint8_t channel;
+  uint32_t from;
+  std::vector<uint16_t> counts;
+} DecodedSeries;
+
+uint32_t readBig(const uint8_t* value, int& idx, int bytes) {
+  uint32_t result = 0;
+  for (int i = 0; i < bytes; i++) result = (result << 8) | value[idx++];
+  return result;
+}
+
+bool decodeSeries(const uint8_t* packet, int size, DecodedSeries& s) {
+  s = DecodedSeries();
+  s.status = 0xFF;
+
+  TlvReader r;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  if (!tlvOpen(r, packet, size) || r.type != MSG_TYPE_STAT_SERIES) return false;
+
+  while (tlvNext(r, tag, value, length)) {
+    int idx = 0;
+    if (tag == TLV_STATUS && length == 1) {
+      s.status = value[0];
+    } else if (tag == TLV_SERIES_BUCKET_FRAMES && length == 2) {
+      s.nextBucketFrames = tlvHalf(value);
+    } else if (tag == TLV_SERIES_INFO && length == 10) {
+      s.hasInfo = true;
+      s.bucketFrames = readBig(value, idx, 2);
+      s.latest = readBig(value, idx, 4);
+      s.first = readBig(value, idx, 4);
+    } else if (tag == TLV_SERIES_DATA && length >= 6 && length % 2 == 0) {
+      s.hasData = true;
+      s.port = value[idx++];
+      s.channel = value[idx++];
+      s.from = readBig(value, idx, 4);
+      while (idx < length) s.counts.push_back(readBig(value, idx, 2));
+    }
+  }
+  return true;
+}
+
+//**********************************************************************
+//*                             Self Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+uint32_t channelTotal(const PlayerStatistics& ps, int channel) {
+  const uint8_t* stats = (const uint8_t*)&ps;
+  if (channel < SERIES_WORD_CHANNELS) return *(const uint32_t*)(stats + seriesWordOffsets[channel]);
+  return *(const uint16_t*)(stats + seriesHalfOffsets[channel - SERIES_WORD_CHANNELS]);
+}
+
+void bumpChannel(PlayerStatistics& ps, int channel, uint32_t amount) {
+  uint8_t* stats = (uint8_t*)&ps;
+  if (channel < SERIES_WORD_CHANNELS) *(uint32_t*)(stats + seriesWordOffsets[channel]) += amount;
+  else *(uint16_t*)(stats + seriesHalfOffsets[channel - SERIES_WORD_CHANNELS]) += amount;
+}
+
+//Counters move the way computeStatistics() moves them: frame counters by the frame delta, damage in bursts,
+//the rest now and then, and a few updates go missing. Records the totals as of the last frame of every
+//bucket so each bucket can be checked on its own
+uint32_t playGame(StatSeries& s, Player* players, int frames, uint32_t seed, std::vector<PlayerStatistics>* ends) {
+  uint32_t rng = seed;
+  for (int i = 0; i < PLAYER_COUNT; i++) players[i] = Player();
+  seriesReset(s);
+  for (int i = 0; i < PLAYER_COUNT; i++) ends[i].clear();
+
+  uint32_t frame = 0;
+  while (frame < (uint32_t)frames) {
+    rng = rng * 1103515245 + 12345;
+    uint32_t frameDelta = (rng >> 24) < 4 ? 2 + (rng >> 22) % 3 : 1;
+    if (frame + frameDelta > (uint32_t)frames) frameDelta = frames - frame;
+    frame += frameDelta;
+
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      PlayerStatistics& ps = players[i].stats;
+      for (int c = 0; c < SERIES_CHANNELS; c++) {
+        rng = rng * 1103515245 + 12345;
+        uint32_t roll = rng >> 16;
+        if (c <= SERIES_FRAMES_IN_SHIELD) bumpChannel(ps, c, roll % 3 == 0 ? frameDelta : 0);
+        else if (c == SERIES_DAMAGE_DEALT) bumpChannel(ps, c, roll % 40 == 0 ? 10 + roll % 200 : 0);
+        else if (c == SERIES_ACTIONS) bumpChannel(ps, c, roll % 4 == 0 ? 1 + roll % 3 : 0);
+        else bumpChannel(ps, c, roll % 500 == 0 ? 1 : 0);
+      }
+    }
+
+    seriesAdd(s, players, frame);
+    uint32_t bucket = (frame - 1) / s.bucketFrames;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      ends[i].resize(bucket + 1, ends[i].empty() ? PlayerStatistics() : ends[i].back());
+      ends[i][bucket] = players[i].stats;
+    }
+  }
+  return frame;
+}
+
+//Every bucket kept has to be exactly what the counters moved by during it, and with nothing dropped the
+//buckets sum to the totals
+bool checkBuckets(const StatSeries& s, const Player* players, const std::vector<PlayerStatistics>* ends, bool& sums) {
+  sums = true;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    for (int c = 0; c < SERIES_CHANNELS; c++) {
+      uint32_t sum = 0;
+      for (uint32_t b = seriesFirstBucket(s); b <= s.bucket; b++) {
+        uint32_t before = b > 0 ? channelTotal(ends[i][b - 1], c) : 0;
+        uint16_t cell = s.buckets[i][b & (SERIES_BUCKETS - 1)][c];
+        if (cell != channelTotal(ends[i][b], c) - before) return false;
+        sum += cell;
+      }
+      if (sum != channelTotal(players[i].stats, c)) sums = false;
+    }
+  }
+  return true;
+}
+
+int runCheck() {
+  bool ok = true;
+  static StatSeries s;
+  static Player players[PLAYER_COUNT];
+  std::vector<PlayerStatistics> ends[PLAYER_COUNT];
+  printf("Checking stat series, %d bytes\n", (int)sizeof(s));
+
+  seriesInitialize(s);
+  playGame(s, players, 28800, 0x5EED, ends);
+  bool sums;
+  bool buckets = checkBuckets(s, players, ends, sums);
+  ok &= expect(s.bucket + 1 == 28800 / SERIES_DEFAULT_BUCKET_FRAMES, "an 8 minute game fills 10 second buckets");
+  ok &= expect(buckets, "each bucket holds what its frames counted");
+  ok &= expect(sums, "buckets sum exactly to the totals");
+
+  //The shortest buckets wrap the ring, what is kept is still exact
+  ok &= expect(seriesSetBucketFrames(s, SERIES_MIN_BUCKET_FRAMES), "shortest bucket length accepted");
+  ok &= expect(s.bucketFrames == SERIES_DEFAULT_BUCKET_FRAMES, "a new length waits for the next game");
+  playGame(s, players, 28800, 0xF00D, ends);
+  buckets = checkBuckets(s, players, ends, sums);
+  ok &= expect(s.bucketFrames == SERIES_MIN_BUCKET_FRAMES && seriesFirstBucket(s) == s.bucket - SERIES_BUCKETS + 1,
+    "a wrapped ring keeps the latest buckets");
+  ok &= expect(buckets, "reused buckets start cleared");
+
+  //Missed frames that skip whole buckets leave them empty, not holding what the ring held a lap earlier
+  uint32_t skippedFrom = s.bucket + 1;
+  players[0].stats.actionCount += 3;
+  seriesAdd(s, players, (skippedFrom + 4) * s.bucketFrames + 1);
+  bool cleared = s.bucket == skippedFrom + 4 && s.buckets[0][s.bucket & (SERIES_BUCKETS - 1)][SERIES_ACTIONS] == 3;
+  for (uint32_t b = skippedFrom; b < s.bucket; b++) {
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      for (int c = 0; c < SERIES_CHANNELS; c++) cleared &= s.buckets[i][b & (SERIES_BUCKETS - 1)][c] == 0;
+    }
+  }
+  ok &= expect(cleared, "buckets skipped by missed frames read empty");
+
+  seriesAdd(s, players, (s.bucket + 2 * SERIES_BUCKETS) * s.bucketFrames + 1);
+  cleared = true;
+  for (size_t k = 0; k < sizeof(s.buckets) / sizeof(uint16_t); k++) cleared &= (&s.buckets[0][0][0])[k] == 0;
+  ok &= expect(cleared, "a gap longer than the ring clears all of it");
+
+  seriesSetBucketFrames(s, SERIES_MAX_BUCKET_FRAMES);
+  playGame(s, players, 28800, 0xACE, ends);
+  buckets = checkBuckets(s, players, ends, sums);
+  ok &= expect(buckets && sums, "minute buckets sum exactly to the totals");
+  ok &= expect(!seriesSetBucketFrames(s, SERIES_MIN_BUCKET_FRAMES - 1) &&
+    !seriesSetBucketFrames(s, SERIES_MAX_BUCKET_FRAMES + 1), "lengths out of range are refused");
+
+  //A whole channel fits one response, and asking from a later bucket returns only the rest
+  seriesSetBucketFrames(s, SERIES_DEFAULT_BUCKET_FRAMES);
+  playGame(s, players, 38400, 0xBEAD, ends);
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  DecodedSeries d;
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_STAT_SERIES, 7);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppendHalf(w, TLV_SERIES_BUCKET_FRAMES, s.nextBucketFrames);
+  bool appended = seriesAppend(w, s, 1, 2, SERIES_DAMAGE_DEALT, 0);
+  bool same = appended && decodeSeries(packet, w.size, d) && d.hasInfo && d.hasData &&
+    d.counts.size() == SERIES_BUCKETS && d.port == 2 && d.channel == SERIES_DAMAGE_DEALT && d.from == 0;
+  for (size_t b = 0; same && b < d.counts.size(); b++) same = d.counts[b] == s.buckets[1][b][SERIES_DAMAGE_DEALT];
+  ok &= expect(same, "a full ring round trips in one response");
+  printf("  largest response is %d of %d bytes\n", w.size, UDP_BINARY_MAX_PACKET_SIZE);
+
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_STAT_SERIES, 8);
+  seriesAppend(w, s, 0, 1, SERIES_ACTIONS, 60);
+  ok &= expect(decodeSeries(packet, w.size, d) && d.from == 60 && d.counts.size() == 4 &&
+    d.counts[3] == s.buckets[0][63][SERIES_ACTIONS], "a later start returns only the newer buckets");
+
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_STAT_SERIES, 9);
+  seriesAppend(w, s, 0, 1, SERIES_ACTIONS, 1000);
+  ok &= expect(decodeSeries(packet, w.size, d) && d.hasData && d.counts.empty() && d.latest == 63,
+    "a start past the latest bucket returns no counts");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  const char* deviceIp = NULL;
+  const char* channelName = "actions";
+  int port = 1;
+  int bucketFrames = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:p:n:b:c")) != -1) {
+    switch (opt) {
+      case 'd': deviceIp = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 'n': channelName = optarg; break;
+      case 'b': bucketFrames = atoi(optarg); break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s -d deviceIp [-p port] [-n channel] [-b bucketFrames] | -c\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!deviceIp || port < 1 || port > 4) {
+    fprintf(stderr, "Usage: %s -d deviceIp [-p port] [-n channel] [-b bucketFrames] | -c\n", argv[0]);
+    return 1;
+  }
+
+  int channel = -1;
+  for (int c = 0; c < SERIES_CHANNELS; c++) if (strcmp(channelNames[c], channelName) == 0) channel = c;
+  if (channel < 0) {
+    fprintf(stderr, "Unknown channel %s, the channels are:\n", channelName);
+    for (int c = 0; c < SERIES_CHANNELS; c++) fprintf(stderr, "  %s\n", channelNames[c]);
+    return 1;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(fd);
+    return 1;
+  }
+
+  uint16_t sequence = 1;
+  uint32_t next = 0; //First bucket not printed yet
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  while (true) {
+    TlvWriter w;
+    tlvBegin(w, packet, sizeof(packet), MSG_TYPE_STAT_SERIES, sequence++);
+    if (bucketFrames >= 0) tlvAppendHalf(w, TLV_SERIES_BUCKET_FRAMES, bucketFrames);
+    uint8_t select[6] = { (uint8_t)port, (uint8_t)channel, (uint8_t)(next >> 24), (uint8_t)(next >> 16),
+      (uint8_t)(next >> 8), (uint8_t)next };
+    tlvAppend(w, TLV_SERIES_SELECT, select, sizeof(select));
+    sendto(fd, w.buffer, w.size, 0, (sockaddr*)&addr, sizeof(addr));
+
+    pollfd pfd = { fd, POLLIN, 0 };
+    DecodedSeries d;
+    if (poll(&pfd, 1, 1000) <= 0) {
+      fprintf(stderr, "No reply from %s\n", deviceIp);
+    } else {
+      int size = recv(fd, packet, sizeof(packet), 0);
+      if (size > 0 && decodeSeries(packet, size, d)) {
+        if (d.status != STATUS_OK) {
+          fprintf(stderr, "Request refused with status %u\n", d.status);
+          return 1;
+        }
+        bucketFrames = -1;
+
+        //A new game starts the buckets over
+        if (d.hasInfo && d.latest + 1 < next) {
+          printf("New game, %u frames per bucket\n", d.bucketFrames);
+          next = 0;
+        }
+
+        //The latest bucket is still filling, it is printed on a later poll
+        for (size_t i = 0; d.hasData && i < d.counts.size(); i++) {
+          uint32_t bucket = d.from + i;
+          if (bucket >= d.latest || bucket < next) continue;
+          uint32_t seconds = bucket * d.bucketFrames / 60;
+          float scale = channel == SERIES_DAMAGE_DEALT ? 0.1f : 1;
+          printf("P%u %s %3u:%02u %8.1f  %8.1f per minute\n", d.port, channelNames[channel], seconds / 60, seconds % 60,
+            d.counts[i] * scale, d.counts[i] * scale * 3600 / d.bucketFrames);
+          next = bucket + 1;
+        }
+      }
+    }
+
+    sleep(1);
+  }
+}
@@ -0,0 +1,324 @@
+//StatsDaemon - accepts raw device streams (writeMsg() framing) from many boards and runs the board's
+//stats engine for every connection on a pool of worker threads. Completed games are published as one
+//JSON object per line in the same shape as the board's printGameSummaries() output.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing -pthread StatsDaemon.cpp -o StatsDaemon
+//Usage: StatsDaemon [-p port] [-t workerThreads] [-o resultsFile] [-v]
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/gamesummary.h"
+
+#define DEFAULT_PORT 3636
+#define MAX_EPOLL_EVENTS 64
+#define STATUS_INTERVAL_S 5
+
+//**********************************************************************
+//*                          Global Variables
+//**********************************************************************
+std::atomic<bool> running(true);
+bool verbose = false;
+
+FILE* resultsFile = stdout;
+std::mutex resultsLock;
+
+//**********************************************************************
+//*                            Connections
+//**********************************************************************
+//A connection is only ever touched by the worker that owns it, so the stats engine state needs no locking
+typedef struct {
+  int fd;
+  char name[32];
+  StreamReader reader;
+
+  StatsContext stats;
+  uint32_t gamesPublished;
+} Connection;
+
+typedef struct {
+  int epollFd;
+  std::thread thread;
+
+  std::atomic<uint64_t> framesProcessed;
+  std::atomic<uint64_t> messagesRejected;
+  std::atomic<uint32_t> gamesPublished;
+  std::atomic<uint32_t> connections;
+} Worker;
+
+std::vector<Worker*> workers;
+
+void closeConnection(Worker& w, Connection* c) {
+  if (verbose) fprintf(stderr, "Connection closed. %s\n", c->name);
+
+  epoll_ctl(w.epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  w.connections--;
+  delete c;
+}
+
+//**********************************************************************
+//*                             Publishing
+//**********************************************************************
+void publishGame(Worker& w, Connection& c) {
+  std::string line;
+  line.reserve(16 * 1024);
+
+  appendf(line, "{\"device\":\"%s\",\"game\":%u,\"summary\":", c.name, c.gamesPublished);
+  printGameSummary(line, c.stats.game);
+  line += "}\n";
+
+  //Only the write itself is serialized, the summary is built on the worker thread
+  {
+    std::lock_guard<std::mutex> guard(resultsLock);
+    fwrite(line.data(), 1, line.size(), resultsFile);
+    fflush(resultsFile);
+  }
+
+  c.gamesPublished++;
+  w.gamesPublished++;
+}
+
+//**********************************************************************
+//*                           Event Handling
+//**********************************************************************
+void handleMessage(Worker& w, Connection& c, uint8_t* message, int messageSize) {
+  switch (statsHandleMessage(c.stats, message, messageSize)) {
+    case STATS_REJECTED: w.messagesRejected++; break;
+    case STATS_FRAME: w.framesProcessed++; break;
+    case STATS_GAME_ENDED: publishGame(w, c); break;
+  }
+}
+
+//Returns false if the connection should be closed
+bool readConnection(Worker& w, Connection& c) {
+  while (true) {
+    int space;
+    uint8_t* dest = streamWritePointer(c.reader, space);
+
+    int received = recv(c.fd, dest, space, 0);
+    if (received == 0) return false;
+    if (received < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+
+    streamCommit(c.reader, received);
+
+    int offset = 0;
+    uint8_t* message;
+    int messageSize;
+    int result;
+    while ((result = streamNextMessage(c.reader, offset, message, messageSize)) == STREAM_MESSAGE) {
+      handleMessage(w, c, message, messageSize);
+    }
+
+    //A bad length means we lost framing, there is no way to resynchronize so drop the device
+    if (result == STREAM_CORRUPT) {
+      fprintf(stderr, "Invalid message length received from %s. Dropping connection.\n", c.name);
+      return false;
+    }
+
+    streamConsume(c.reader, offset);
+  }
+}
+
+void workerMain(Worker* w) {
+  epoll_event events[MAX_EPOLL_EVENTS];
+
+  while (running) {
+    int count = epoll_wait(w->epollFd, events, MAX_EPOLL_EVENTS, 200);
+
+    for (int i = 0; i < count; i++) {
+      Connection* c = (Connection*)events[i].data.ptr;
+      bool keep = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+      if (keep) keep = readConnection(*w, *c);
+      if (!keep) closeConnection(*w, c);
+    }
+  }
+}
+
+//**********************************************************************
+//*                              Listener
+//**********************************************************************
+int listenOn(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+
+  int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 256) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//Hands a new device to the least loaded worker
+void acceptConnection(int listenFd) {
+  sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  int fd = accept(listenFd, (sockaddr*)&addr, &addrLength);
+  if (fd < 0) return;
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  Connection* c = new Connection();
+  c->fd = fd;
+  c->reader.length = 0;
+  statsContextInitialize(c->stats);
+  c->gamesPublished = 0;
+
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+  snprintf(c->name, sizeof(c->name), "%s:%d", ip, ntohs(addr.sin_port));
+
+  Worker* target = workers[0];
+  for (size_t i = 1; i < workers.size(); i++) {
+    if (workers[i]->connections < target->connections) target = workers[i];
+  }
+
+  target->connections++;
+
+  epoll_event ev = { };
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = c;
+  if (epoll_ctl(target->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    target->connections--;
+    close(fd);
+    delete c;
+    return;
+  }
+
+  if (verbose) fprintf(stderr, "Connection accepted. %s\n", c->name);
+}
+
+void printStatus(double elapsedSeconds, uint64_t& lastFrames) {
+  uint64_t frames = 0, rejected = 0;
+  uint32_t games = 0, connections = 0;
+  for (size_t i = 0; i < workers.size(); i++) {
+    frames += workers[i]->framesProcessed;
+    rejected += workers[i]->messagesRejected;
+    games += workers[i]->gamesPublished;
+    connections += workers[i]->connections;
+  }
+
+  fprintf(stderr, "Devices: %u | Frames/s: %.0f | Games: %u | Rejected messages: %llu\n", connections,
+    (frames - lastFrames) / elapsedSeconds, games, (unsigned long long)rejected);
+  lastFrames = frames;
+}
+
+void handleSignal(int) {
+  running = false;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  int port = DEFAULT_PORT;
+  int threadCount = std::thread::hardware_concurrency();
+  const char* resultsPath = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:o:v")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 't': threadCount = atoi(optarg); break;
+      case 'o': resultsPath = optarg; break;
+      case 'v': verbose = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port] [-t workerThreads] [-o resultsFile] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (threadCount < 1) threadCount = 1;
+
+  if (resultsPath) {
+    resultsFile = fopen(resultsPath, "a");
+    if (!resultsFile) {
+      fprintf(stderr, "Failed to open results file %s\n", resultsPath);
+      return 1;
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+
+  asmEventsInitialize();
+
+  int listenFd = listenOn(port);
+  if (listenFd < 0) {
+    fprintf(stderr, "Failed to listen on port %d: %s\n", port, strerror(errno));
+    return 1;
+  }
+
+  for (int i = 0; i < threadCount; i++) {
+    Worker* w = new Worker();
+    w->epollFd = epoll_create1(0);
+    w->framesProcessed = 0;
+    w->messagesRejected = 0;
+    w->gamesPublished = 0;
+    w->connections = 0;
+    w->thread = std::thread(workerMain, w);
+    workers.push_back(w);
+  }
+
+  fprintf(stderr, "Stats daemon listening on port %d with %d worker threads.\n", port, threadCount);
+
+  //Accept connections on the main thread, everything else happens on the workers
+  int acceptEpoll = epoll_create1(0);
+  epoll_event ev = { };
+  ev.events = EPOLLIN;
+  ev.data.fd = listenFd;
+  epoll_ctl(acceptEpoll, EPOLL_CTL_ADD, listenFd, &ev);
+
+  timespec lastStatus;
+  clock_gettime(CLOCK_MONOTONIC, &lastStatus);
+  uint64_t lastFrames = 0;
+
+  while (running) {
+    epoll_event event;
+    if (epoll_wait(acceptEpoll, &event, 1, 200) > 0) acceptConnection(listenFd);
+
+    if (verbose) {
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      double elapsed = (now.tv_sec - lastStatus.tv_sec) + (now.tv_nsec - lastStatus.tv_nsec) / 1e9;
+      if (elapsed >= STATUS_INTERVAL_S) {
+        printStatus(elapsed, lastFrames);
+        lastStatus = now;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < workers.size(); i++) workers[i]->thread.join();
+  close(listenFd);
+  if (resultsFile != stdout) fclose(resultsFile);
+
+  return 0;
+}
@@ -0,0 +1,298 @@
+//StatsDaemonBenchmark - load test for StatsDaemon. Starts the daemon, connects a number of simulated
+//setups over loopback and streams synthetic games to it at console speed (or unthrottled). Reports the
+//frame rate the daemon sustained and how long it took for each game summary to be published after
+//the game end message was sent.
+//
+//Build (Linux): g++ -O2 -std=c++11 -fno-strict-aliasing -pthread StatsDaemonBenchmark.cpp -o StatsDaemonBenchmark
+//Usage: StatsDaemonBenchmark [-x daemonPath] [-p port] [-s setups] [-r fps] [-f framesPerGame] [-g games] [-t daemonThreads]
+//  -r 0 streams unthrottled to measure peak throughput
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../Common/slippistream.h"
+#include "../Common/synthgame.h"
+
+#define FRAME_BUDGET_MS (1000.0 / 60)
+
+//**********************************************************************
+//*                           Synthetic Setups
+//**********************************************************************
+typedef struct {
+  int fd;
+  int localPort;
+  uint32_t rng;
+  Game game;
+
+  double gameEndSentMs;
+} Setup;
+
+double nowMs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+bool sendAll(int fd, const uint8_t* data, int length) {
+  while (length > 0) {
+    int sent = send(fd, data, length, 0);
+    if (sent <= 0) return false;
+    data += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+bool sendEvent(Setup& s, uint8_t eventCode) {
+  uint8_t payload[MSG_BUFFER_SIZE];
+  uint8_t out[STREAM_HEADER_SIZE + 1 + MSG_BUFFER_SIZE];
+
+  int payloadSize = 0;
+  switch (eventCode) {
+    case EVENT_GAME_START: payloadSize = encodeGameStart(payload, s.game); break;
+    case EVENT_UPDATE: payloadSize = encodeUpdate(payload, s.game); break;
+    case EVENT_GAME_END: payloadSize = encodeGameEnd(payload, s.game); break;
+  }
+
+  int length = frameMessage(out, eventCode, payload, payloadSize);
+  return sendAll(s.fd, out, length);
+}
+
+//**********************************************************************
+//*                          Daemon Management
+//**********************************************************************
+pid_t daemonPid = -1;
+
+//Starts the daemon with its results written to the returned pipe
+int startDaemon(const char* path, int port, int threads) {
+  int fds[2];
+  if (pipe(fds) < 0) return -1;
+
+  daemonPid = fork();
+  if (daemonPid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    char portArg[16], threadArg[16];
+    snprintf(portArg, sizeof(portArg), "%d", port);
+    snprintf(threadArg, sizeof(threadArg), "%d", threads);
+    if (threads > 0) execl(path, path, "-p", portArg, "-t", threadArg, (char*)NULL);
+    else execl(path, path, "-p", portArg, (char*)NULL);
+
+    fprintf(stderr, "Failed to start %s: %s\n", path, strerror(errno));
+    _exit(1);
+  }
+
+  close(fds[1]);
+  return fds[0];
+}
+
+int connectToDaemon(int port) {
+  //Keep trying while the daemon starts up
+  for (int attempt = 0; attempt < 100; attempt++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+      int enable = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+      return fd;
+    }
+
+    close(fd);
+    usleep(50000);
+  }
+
+  return -1;
+}
+
+//**********************************************************************
+//*                          Result Collection
+//**********************************************************************
+std::mutex resultLock;
+std::map<int, std::vector<double> > resultTimes; //Keyed by the setup's local port
+std::atomic<int> resultCount(0);
+
+void collectResults(int fd) {
+  FILE* in = fdopen(fd, "r");
+  std::vector<char> line(1 << 20);
+
+  while (fgets(line.data(), line.size(), in)) {
+    double arrival = nowMs();
+
+    const char* device = strstr(line.data(), "\"device\":\"");
+    const char* colon = device ? strchr(device + 10, ':') : NULL;
+    if (!colon) continue;
+
+    int port = atoi(colon + 1);
+    {
+      std::lock_guard<std::mutex> guard(resultLock);
+      resultTimes[port].push_back(arrival);
+    }
+    resultCount++;
+  }
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t idx = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[idx];
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  const char* daemonPath = "./StatsDaemon";
+  int port = 3656;
+  int setupCount = 100;
+  double fps = 60;
+  int framesPerGame = 3600;
+  int games = 1;
+  int daemonThreads = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "x:p:s:r:f:g:t:")) != -1) {
+    switch (opt) {
+      case 'x': daemonPath = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 's': setupCount = atoi(optarg); break;
+      case 'r': fps = atof(optarg); break;
+      case 'f': framesPerGame = atoi(optarg); break;
+      case 'g': games = atoi(optarg); break;
+      case 't': daemonThreads = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-x daemonPath] [-p port] [-s setups] [-r fps] [-f framesPerGame] [-g games] [-t daemonThreads]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  int resultsFd = startDaemon(daemonPath, port, daemonThreads);
+  if (resultsFd < 0) return 1;
+  std::thread collector(collectResults, resultsFd);
+
+  std::vector<Setup*> setups;
+  std::map<int, Setup*> setupsByPort;
+  for (int i = 0; i < setupCount; i++) {
+    Setup* s = new Setup();
+    s->rng = 0x9E3779B9 ^ (i * 7919 + 1);
+    s->fd = connectToDaemon(port);
+    if (s->fd < 0) {
+      fprintf(stderr, "Failed to connect setup %d to the daemon.\n", i);
+      kill(daemonPid, SIGTERM);
+      return 1;
+    }
+
+    sockaddr_in local;
+    socklen_t localLength = sizeof(local);
+    getsockname(s->fd, (sockaddr*)&local, &localLength);
+    s->localPort = ntohs(local.sin_port);
+
+    setups.push_back(s);
+    setupsByPort[s->localPort] = s;
+  }
+
+  printf("Streaming %d game(s) of %d frames from %d setups at %s.\n", games, framesPerGame, setupCount,
+    fps > 0 ? "console speed" : "unthrottled speed");
+
+  double start = nowMs();
+  double worstLatenessMs = 0;
+  std::vector<double> publishLatencies;
+
+  for (int g = 0; g < games; g++) {
+    for (size_t i = 0; i < setups.size(); i++) {
+      synthesizeGameStart(setups[i]->game, setups[i]->rng);
+      sendEvent(*setups[i], EVENT_GAME_START);
+    }
+
+    double gameStart = nowMs();
+    for (int frame = 1; frame <= framesPerGame; frame++) {
+      for (size_t i = 0; i < setups.size(); i++) {
+        synthesizeUpdate(setups[i]->game, setups[i]->rng, frame);
+        if (!sendEvent(*setups[i], EVENT_UPDATE)) {
+          fprintf(stderr, "Daemon closed the connection of setup %d.\n", (int)i);
+          kill(daemonPid, SIGTERM);
+          return 1;
+        }
+      }
+
+      if (fps > 0) {
+        //Keep an absolute schedule so that a slow frame is caught up instead of shifting every later frame
+        double due = gameStart + frame * 1000.0 / fps;
+        double lateness = nowMs() - due;
+        if (lateness > worstLatenessMs) worstLatenessMs = lateness;
+        if (lateness < 0) usleep((useconds_t)(-lateness * 1000));
+      }
+    }
+
+    for (size_t i = 0; i < setups.size(); i++) {
+      setups[i]->game.winCondition = 2;
+      setups[i]->gameEndSentMs = nowMs();
+      sendEvent(*setups[i], EVENT_GAME_END);
+    }
+
+    //Wait for every setup to get its summary published
+    int expected = setupCount * (g + 1);
+    double waitStart = nowMs();
+    while (resultCount < expected && nowMs() - waitStart < 30000) usleep(1000);
+
+    std::lock_guard<std::mutex> guard(resultLock);
+    for (size_t i = 0; i < setups.size(); i++) {
+      std::vector<double>& times = resultTimes[setups[i]->localPort];
+      if ((int)times.size() > g) publishLatencies.push_back(times[g] - setups[i]->gameEndSentMs);
+    }
+  }
+
+  double elapsedMs = nowMs() - start;
+  uint64_t totalFrames = (uint64_t)setupCount * framesPerGame * games;
+
+  kill(daemonPid, SIGTERM);
+  waitpid(daemonPid, NULL, 0);
+  for (size_t i = 0; i < setups.size(); i++) close(setups[i]->fd);
+  collector.join();
+
+  int published = resultCount;
+  double p50 = percentile(publishLatencies, 0.5);
+  double p99 = percentile(publishLatencies, 0.99);
+  double pMax = percentile(publishLatencies, 1.0);
+
+  printf("Games published: %d / %d\n", published, setupCount * games);
+  printf("Frames processed: %llu in %.1f s (%.0f frames/s)\n", (unsigned long long)totalFrames, elapsedMs / 1000,
+    totalFrames / (elapsedMs / 1000));
+  printf("Summary publish latency (ms): p50 %.2f | p99 %.2f | max %.2f\n", p50, p99, pMax);
+  if (fps > 0) printf("Worst send schedule lateness: %.2f ms\n", worstLatenessMs);
+
+  //At console speed the daemon has kept up if every summary came back within a frame and the sender
+  //never fell a frame behind because of back pressure
+  bool passed = published == setupCount * games;
+  if (fps > 0) passed = passed && p99 < FRAME_BUDGET_MS && worstLatenessMs < FRAME_BUDGET_MS;
+  printf("%s\n", passed ? "PASS" : "FAIL");
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,410 @@
+//TechniqueBenchmark - times the technique machines of EnhMelee1294Firmware's techniques.h with every
+//detector on, per player per frame, and checks them on recorded frame sequences.
+//
+//The sequences are the animations, buttons, triggers and positions of the frames around each technique
+//as a game reports them, written as spans of identical frames. The timing runs a synthetic game where
+//players move between the animations the machines care about and through the recorded sequences, once
+//through the compiled tables and once interpreting the rows directly, which is what a branch per
+//technique would cost. Each reports the best time of all repetitions in ns per frame for both players.
+//
+//Build (Linux): g++ -O2 -std=c++11 -Wno-write-strings TechniqueBenchmark.cpp -o TechniqueBenchmark
+//Usage: TechniqueBenchmark [-f frames] [-r repetitions] [-c]
+//  -c checks the machines on the recorded sequences and the tables against the rows, non-zero on failure
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/enhmelee.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/techniques.h"
+
+#define DEFAULT_FRAMES 28800
+#define DEFAULT_REPETITIONS 20
+
+#define BUTTON_Z 0x10
+#define BUTTON_R 0x20
+#define BUTTON_L 0x40
+
+uint64_t hostNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//**********************************************************************
+//*                          Row Interpreter
+//**********************************************************************
+//The same machines run straight from the rows, the reference the compiled tables are checked against
+void techAdvanceRows(TechTracker& tr, const Player& p, PlayerStatistics& stats, uint32_t frameDelta, const TechTables& t) {
+  const PlayerFrameData& current = currentFrame(p);
+  uint8_t category = current.animation < TECH_ANIMATION_COUNT ? t.categories[current.animation] : TECH_CAT_OTHER;
+  bool pressed = techShieldPressed(current, previousFrame(p));
+
+  for (int m = 0; m < TECH_MACHINE_COUNT; m++) {
+    const TechMachine& machine = techMachines[m];
+    uint8_t state = tr.state[m];
+    uint32_t frames = tr.frames[m] + frameDelta;
+    if (machine.windows[state] != 0 && frames > machine.windows[state]) {
+      state = machine.timeouts[state];
+      frames = 0;
+    }
+
+    const TechRow* row = techMatch(machine, state, category, pressed);
+    if (row == NULL && state != 0) row = techMatch(machine, 0, category, pressed);
+    uint8_t next = row != NULL ? row->next : 0;
+    uint8_t flags = row != NULL ? row->flags : 0;
+    if (next != state || (flags & TECH_ROW_RESTART)) frames = 0;
+    if (flags & TECH_ROW_ANCHOR) tr.anchorX[m] = current.locationX;
+    if (row != NULL && row->counter != TECH_COUNT_NONE) {
+      int counter = row->counter;
+      if ((flags & TECH_ROW_DIRECTIONAL) && current.locationX > tr.anchorX[m]) counter++;
+      (*(uint16_t*)((uint8_t*)&stats + techCounterOffsets[counter]))++;
+    }
+
+    tr.state[m] = next;
+    tr.frames[m] = frames > 0xFFFF ? 0xFFFF : frames;
+  }
+}
+
+//**********************************************************************
+//*                         Recorded Sequences
+//**********************************************************************
+typedef struct {
+  uint8_t frames;
+  uint16_t animation;
+  uint16_t buttons; //physicalButtons, held for the whole span
+  float lTrigger;
+  float moveX; //Per frame
+  uint8_t frameDelta; //Of the first frame of the span, 0 is 1
+} Span;
+
+#define WAIT 0x0E
+#define SQUAT_WAIT 0x28
+#define JUMP_F 0x19
+#define JUMP_AERIAL_F 0x1B
+#define FALL 0x1D
+#define LANDING 0x2A
+#define ATTACK_AIR_N 0x41
+#define ATTACK_AIR_F 0x42
+#define LANDING_AIR_N 0x46
+#define LANDING_AIR_F 0x47
+#define GUARD 0xB3
+#define DOWN_WAIT_U 0xB8
+#define CLIFF_CATCH 0xFC
+#define CLIFF_WAIT 0xFD
+
+typedef struct {
+  const char* name;
+  const Span* spans;
+  int spanCount;
+  uint16_t expected[sizeof(techCounterOffsets) / sizeof(techCounterOffsets[0])]; //By TECH_COUNT_*
+} Sequence;
+
+//                                 none miss left right place wavedash lcancel lmiss ledgedash shielddrop
+#define EXPECT(...) { __VA_ARGS__ }
+#define SPANS(spans) spans, (int)(sizeof(spans) / sizeof(spans[0]))
+
+static const Span wavedash[] = {
+  { 5, WAIT, 0, 0, 0, 0 }, { 3, ACTION_KNEE_BEND, 0, 0, 0, 0 }, { 1, JUMP_F, 0, 0, 0.5f, 0 },
+  { 2, AIR_DODGE, BUTTON_R, 0, 1.5f, 0 }, { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 }, { 5, WAIT, 0, 0, 0, 0 },
+};
+static const Span wavedashFromJumpsquat[] = {
+  { 3, WAIT, 0, 0, 0, 0 }, { 3, ACTION_KNEE_BEND, 0, 0, 0, 0 }, { 1, AIR_DODGE, BUTTON_L, 1, 1.5f, 0 },
+  { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+static const Span wavedashMissedUpdate[] = {
+  { 3, WAIT, 0, 0, 0, 0 }, { 2, ACTION_KNEE_BEND, 0, 0, 0, 0 }, { 1, JUMP_F, 0, 0, 0, 2 },
+  { 2, AIR_DODGE, BUTTON_R, 0, 1.5f, 0 }, { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+static const Span waveland[] = {
+  { 10, FALL, 0, 0, 0, 0 }, { 3, AIR_DODGE, BUTTON_R, 0, 1, 0 }, { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+static const Span lateAirDodge[] = {
+  { 3, ACTION_KNEE_BEND, 0, 0, 0, 0 }, { 8, JUMP_F, 0, 0, 0, 0 }, { 3, AIR_DODGE, BUTTON_R, 0, 1, 0 },
+  { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+static const Span lCancel[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 12, ATTACK_AIR_N, 0, 0, 0, 0 }, { 1, ATTACK_AIR_N, BUTTON_L, 0, 0, 0 },
+  { 3, ATTACK_AIR_N, BUTTON_L, 0, 0, 0 }, { 8, LANDING_AIR_N, 0, 0, 0, 0 }, { 5, WAIT, 0, 0, 0, 0 },
+};
+static const Span lCancelAnalog[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 10, ATTACK_AIR_F, 0, 0.1f, 0, 0 }, { 2, ATTACK_AIR_F, 0, 0.45f, 0, 0 },
+  { 9, LANDING_AIR_F, 0, 0.45f, 0, 0 },
+};
+static const Span lCancelZ[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 10, ATTACK_AIR_N, 0, 0, 0, 0 }, { 6, ATTACK_AIR_N, BUTTON_Z, 0, 0, 0 },
+  { 8, LANDING_AIR_N, 0, 0, 0, 0 },
+};
+static const Span lCancelEarly[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 4, ATTACK_AIR_N, 0, 0, 0, 0 }, { 1, ATTACK_AIR_N, BUTTON_R, 0, 0, 0 },
+  { 9, ATTACK_AIR_N, 0, 0, 0, 0 }, { 16, LANDING_AIR_N, 0, 0, 0, 0 },
+};
+static const Span lCancelMissed[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 14, ATTACK_AIR_F, 0, 0, 0, 0 }, { 18, LANDING_AIR_F, 0, 0, 0, 0 },
+};
+static const Span aerialEndsInAir[] = {
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 20, ATTACK_AIR_N, 0, 0, 0, 0 }, { 2, FALL, BUTTON_L, 0, 0, 0 }, { 4, LANDING, 0, 0, 0, 0 },
+};
+static const Span ledgedash[] = {
+  { 7, CLIFF_CATCH, 0, 0, 0, 0 }, { 20, CLIFF_WAIT, 0, 0, 0, 0 }, { 4, FALL, 0, 0, 0, 0 }, { 3, JUMP_AERIAL_F, 0, 0, 1, 0 },
+  { 2, AIR_DODGE, BUTTON_R, 0, 2, 0 }, { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+static const Span ledgeDrop[] = {
+  { 20, CLIFF_WAIT, 0, 0, 0, 0 }, { 20, FALL, 0, 0, 0, 0 }, { 4, LANDING, 0, 0, 0, 0 },
+};
+static const Span shieldDrop[] = {
+  { 10, GUARD, BUTTON_R, 0, 0, 0 }, { 5, ACTION_PLATFORM_DROP, 0, 0, 0, 0 }, { 10, FALL, 0, 0, 0, 0 },
+};
+static const Span platformDrop[] = {
+  { 3, SQUAT_WAIT, 0, 0, 0, 0 }, { 5, ACTION_PLATFORM_DROP, 0, 0, 0, 0 }, { 10, FALL, 0, 0, 0, 0 },
+};
+static const Span techInPlace[] = {
+  { 26, TECH_IN_PLACE, BUTTON_L, 0, 0, 0 }, { 5, WAIT, 0, 0, 0, 0 },
+};
+static const Span techRollRight[] = {
+  { 40, TECH_ROLL_FORWARD, BUTTON_R, 0, 0.8f, 0 }, { 5, WAIT, 0, 0, 0, 0 },
+};
+static const Span techRollLeft[] = {
+  { 40, TECH_ROLL_BACKWARD, BUTTON_R, 0, -0.8f, 0 }, { 5, WAIT, 0, 0, 0, 0 },
+};
+static const Span missedTech[] = {
+  { 26, TECH_MISS_UP, 0, 0, 0, 0 }, { 20, DOWN_WAIT_U, 0, 0, 0, 0 },
+};
+static const Span everything[] = {
+  { 3, WAIT, 0, 0, 0, 0 }, { 3, ACTION_KNEE_BEND, 0, 0, 0, 0 }, { 1, AIR_DODGE, BUTTON_L, 0, 1.5f, 0 },
+  { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 }, { 10, GUARD, BUTTON_R, 0, 0, 0 }, { 5, ACTION_PLATFORM_DROP, 0, 0, 0, 0 },
+  { 6, ATTACK_AIR_N, 0, 0, 0, 0 }, { 2, ATTACK_AIR_N, BUTTON_Z, 0, 0, 0 }, { 8, LANDING_AIR_N, 0, 0, 0, 0 },
+  { 26, TECH_MISS_DOWN, 0, 0, 0, 0 }, { 30, TECH_ROLL_FORWARD, 0, 0, -1, 0 }, { 26, TECH_IN_PLACE, 0, 0, 0, 0 },
+  { 5, JUMP_F, 0, 0, 0, 0 }, { 14, ATTACK_AIR_F, 0, 0, 0, 0 }, { 18, LANDING_AIR_F, 0, 0, 0, 0 },
+  { 10, CLIFF_WAIT, 0, 0, 0, 0 }, { 2, FALL, 0, 0, 0, 0 }, { 2, AIR_DODGE, BUTTON_R, 0, 2, 0 },
+  { 10, ACTION_LANDING_FALL_SPECIAL, 0, 0, 1, 0 },
+};
+
+static const Sequence sequences[] = {
+  { "wavedash", SPANS(wavedash), EXPECT(0, 0, 0, 0, 0, 1, 0, 0, 0, 0) },
+  { "wavedash out of jumpsquat", SPANS(wavedashFromJumpsquat), EXPECT(0, 0, 0, 0, 0, 1, 0, 0, 0, 0) },
+  { "wavedash across a missed update", SPANS(wavedashMissedUpdate), EXPECT(0, 0, 0, 0, 0, 1, 0, 0, 0, 0) },
+  { "waveland is not a wavedash", SPANS(waveland), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "late air dodge is not a wavedash", SPANS(lateAirDodge), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "L-cancel", SPANS(lCancel), EXPECT(0, 0, 0, 0, 0, 0, 1, 0, 0, 0) },
+  { "L-cancel with analog L", SPANS(lCancelAnalog), EXPECT(0, 0, 0, 0, 0, 0, 1, 0, 0, 0) },
+  { "L-cancel with Z", SPANS(lCancelZ), EXPECT(0, 0, 0, 0, 0, 0, 1, 0, 0, 0) },
+  { "L-cancel pressed too early", SPANS(lCancelEarly), EXPECT(0, 0, 0, 0, 0, 0, 0, 1, 0, 0) },
+  { "L-cancel not pressed", SPANS(lCancelMissed), EXPECT(0, 0, 0, 0, 0, 0, 0, 1, 0, 0) },
+  { "aerial over before landing", SPANS(aerialEndsInAir), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "ledgedash", SPANS(ledgedash), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 1, 0) },
+  { "ledge drop", SPANS(ledgeDrop), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "shield drop", SPANS(shieldDrop), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 1) },
+  { "platform drop from crouch", SPANS(platformDrop), EXPECT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "tech in place", SPANS(techInPlace), EXPECT(0, 0, 0, 0, 1, 0, 0, 0, 0, 0) },
+  { "tech roll right", SPANS(techRollRight), EXPECT(0, 0, 0, 1, 0, 0, 0, 0, 0, 0) },
+  { "tech roll left", SPANS(techRollLeft), EXPECT(0, 0, 1, 0, 0, 0, 0, 0, 0, 0) },
+  { "missed tech", SPANS(missedTech), EXPECT(0, 1, 0, 0, 0, 0, 0, 0, 0, 0) },
+  { "everything back to back", SPANS(everything), EXPECT(0, 1, 1, 0, 1, 1, 1, 1, 1, 1) },
+};
+#define SEQUENCE_COUNT (int)(sizeof(sequences) / sizeof(sequences[0]))
+
+void playSequence(const TechTables& t, const Sequence& s, PlayerStatistics& stats, bool rows) {
+  static Player p;
+  p = Player();
+  TechTracker tr;
+  techResetTracker(tr);
+  memset(&stats, 0, sizeof(stats));
+
+  float x = 0;
+  for (int i = 0; i < s.spanCount; i++) {
+    const Span& span = s.spans[i];
+    for (int f = 0; f < span.frames; f++) {
+      frameHistoryAdvance(p);
+      PlayerFrameData& pfd = currentFrame(p);
+      x += span.moveX;
+      pfd.animation = span.animation;
+      pfd.physicalButtons = span.buttons;
+      pfd.lTrigger = span.lTrigger;
+      pfd.locationX = x;
+
+      uint32_t frameDelta = f == 0 && span.frameDelta != 0 ? span.frameDelta : 1;
+      if (rows) techAdvanceRows(tr, p, stats, frameDelta, t);
+      else techAdvance(t, tr, p, stats, frameDelta);
+    }
+  }
+}
+
+uint16_t counted(const PlayerStatistics& stats, int counter) {
+  return *(const uint16_t*)((const uint8_t*)&stats + techCounterOffsets[counter]);
+}
+
+//**********************************************************************
+//*                           Synthetic Game
+//**********************************************************************
+//Runs of a few frames of the animations the machines look at, with shield presses now and then, and
+//every so often one of the recorded sequences so each technique turns up
+typedef struct {
+  uint16_t animation;
+  uint16_t buttons;
+  float lTrigger;
+  float locationX;
+} SynthFrame;
+
+std::vector<SynthFrame> makeFrames(int frames, uint32_t seed) {
+  static const uint16_t animations[] = { WAIT, ACTION_DASH, ACTION_KNEE_BEND, JUMP_F, FALL, AIR_DODGE,
+    ACTION_LANDING_FALL_SPECIAL, ATTACK_AIR_N, LANDING_AIR_N, GUARD, ACTION_PLATFORM_DROP, CLIFF_WAIT, TECH_IN_PLACE,
+    TECH_ROLL_FORWARD, TECH_MISS_UP, DAMAGE_START, 0x160, 0x200 };
+  std::vector<SynthFrame> result;
+  result.reserve(frames);
+  uint32_t rng = seed;
+  SynthFrame current = { WAIT, 0, 0, 0 };
+  while ((int)result.size() < frames) {
+    rng = rng * 1103515245 + 12345;
+    if ((rng >> 28) < 4) {
+      const Sequence& s = sequences[(rng >> 8) % SEQUENCE_COUNT];
+      for (int i = 0; i < s.spanCount; i++) {
+        const Span& span = s.spans[i];
+        for (int f = 0; f < span.frames; f++) {
+          current.animation = span.animation;
+          current.buttons = span.buttons;
+          current.lTrigger = span.lTrigger;
+          current.locationX += span.moveX;
+          result.push_back(current);
+        }
+      }
+      continue;
+    }
+
+    current.animation = animations[(rng >> 16) % (sizeof(animations) / sizeof(animations[0]))];
+    current.lTrigger = 0;
+    int run = 1 + (rng >> 8) % 12;
+    for (int f = 0; f < run; f++) {
+      rng = rng * 1103515245 + 12345;
+      current.buttons = (rng & 0x1F) == 0 ? BUTTON_L : 0;
+      current.locationX += ((rng >> 4) & 0xF) / 8.0f - 1;
+      result.push_back(current);
+    }
+  }
+  result.resize(frames);
+  return result;
+}
+
+uint32_t runGame(const TechTables& t, const std::vector<SynthFrame>* frames, int frameCount, bool rows,
+  PlayerStatistics* stats) {
+  static Player players[PLAYER_COUNT];
+  TechTracker trackers[PLAYER_COUNT];
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    players[i] = Player();
+    techResetTracker(trackers[i]);
+    memset(&stats[i], 0, sizeof(stats[i]));
+  }
+
+  for (int n = 0; n < frameCount; n++) {
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      Player& p = players[i];
+      frameHistoryAdvance(p);
+      const SynthFrame& f = frames[i][n];
+      currentFrame(p).animation = f.animation;
+      currentFrame(p).physicalButtons = f.buttons;
+      currentFrame(p).lTrigger = f.lTrigger;
+      currentFrame(p).locationX = f.locationX;
+      if (rows) techAdvanceRows(trackers[i], p, stats[i], 1, t);
+      else techAdvance(t, trackers[i], p, stats[i], 1);
+    }
+  }
+
+  uint32_t sum = 0;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    for (int c = 1; c < (int)(sizeof(techCounterOffsets) / sizeof(techCounterOffsets[0])); c++) sum += counted(stats[i], c);
+  }
+  return sum;
+}
+
+//**********************************************************************
+//*                                Check
+//**********************************************************************
+bool expect(bool ok, const char* what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int runCheck() {
+  bool ok = true;
+  static TechTables t;
+  techCompile(t);
+  printf("Checking technique machines, tables are %d bytes\n", (int)sizeof(t));
+
+  for (int i = 0; i < SEQUENCE_COUNT; i++) {
+    const Sequence& s = sequences[i];
+    PlayerStatistics stats;
+    playSequence(t, s, stats, false);
+    bool same = true;
+    for (int c = 1; c < (int)(sizeof(techCounterOffsets) / sizeof(techCounterOffsets[0])); c++) {
+      if (counted(stats, c) != s.expected[c]) same = false;
+    }
+    ok &= expect(same, s.name);
+  }
+
+  //Every state and symbol of the tables has to do what the rows say, including windows and anchors
+  int frames = 20000;
+  std::vector<SynthFrame> synth[PLAYER_COUNT] = { makeFrames(frames, 0x51DE), makeFrames(frames, 0xCAFE) };
+  PlayerStatistics byTable[PLAYER_COUNT], byRows[PLAYER_COUNT];
+  runGame(t, synth, frames, false, byTable);
+  runGame(t, synth, frames, true, byRows);
+  ok &= expect(memcmp(byTable, byRows, sizeof(byTable)) == 0, "compiled tables count what the rows count");
+
+  uint32_t missing = 0;
+  for (int c = 1; c < (int)(sizeof(techCounterOffsets) / sizeof(techCounterOffsets[0])); c++) {
+    if (counted(byTable[0], c) + counted(byTable[1], c) == 0) missing++;
+  }
+  ok &= expect(missing == 0, "the synthetic game reaches every counter");
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+int main(int argc, char** argv) {
+  int frames = DEFAULT_FRAMES;
+  int repetitions = DEFAULT_REPETITIONS;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:r:c")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'r': repetitions = atoi(optarg); break;
+      case 'c': return runCheck();
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-r repetitions] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (frames <= 0 || repetitions <= 0) {
+    fprintf(stderr, "Frames and repetitions must be positive\n");
+    return 1;
+  }
+
+  static TechTables t;
+  techCompile(t);
+  std::vector<SynthFrame> synth[PLAYER_COUNT] = { makeFrames(frames, 0x51DE), makeFrames(frames, 0xCAFE) };
+  printf("%d frames, %d machines, best of %d repetitions, tables are %d bytes\n", frames, TECH_MACHINE_COUNT, repetitions,
+    (int)sizeof(t));
+
+  static const char* names[] = { "tables", "rows" };
+  volatile uint32_t sink = 0;
+  for (int rows = 0; rows < 2; rows++) {
+    PlayerStatistics stats[PLAYER_COUNT];
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < repetitions; r++) {
+      uint64_t start = hostNs();
+      sink += runGame(t, synth, frames, rows != 0, stats);
+      uint64_t elapsed = hostNs() - start;
+      if (elapsed < best) best = elapsed;
+    }
+    printf("%-7s %8.1f ns per frame\n", names[rows], (double)best / frames);
+  }
+
+  return 0;
+}
@@ -0,0 +1,263 @@
+//TelemetryMonitor - subscribes to the per-frame UDP telemetry sent by EnhMelee1294Firmware and prints
+//the latest snapshot along with loss counters. It can also configure a board's telemetry through the
+//binary configuration protocol, and check the receiver against a lossy loopback stream.
+//
+//Build (Linux): g++ -O2 -std=c++11 TelemetryMonitor.cpp -o TelemetryMonitor
+//Usage: TelemetryMonitor [-p port] [-g multicastGroup] [-d deviceIp [-n decimation] [-b byteBudget] [-a telemetryTarget]] [-l]
+//  -d sends the telemetry settings to the board before listening
+//  -l runs the loopback check and exits, the exit code is non-zero on failure
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../Common/telemetryreceiver.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+
+#define CONFIG_PORT 3637
+
+//**********************************************************************
+//*                         Board Configuration
+//**********************************************************************
+bool configureBoard(const char* deviceIp, const char* targetIp, int decimation, int budget) {
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  TlvWriter w;
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_SET_TELEMETRY, 1);
+
+  if (targetIp) {
+    in_addr target;
+    if (inet_pton(AF_INET, targetIp, &target) != 1) {
+      fprintf(stderr, "Invalid telemetry target %s\n", targetIp);
+      return false;
+    }
+    tlvAppend(w, TLV_TELEMETRY_TARGET, (const uint8_t*)&target.s_addr, 4);
+  }
+  if (decimation >= 0) tlvAppendByte(w, TLV_TELEMETRY_DECIMATION, decimation);
+  if (budget >= 0) tlvAppendHalf(w, TLV_TELEMETRY_BUDGET, budget);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(CONFIG_PORT);
+  if (inet_pton(AF_INET, deviceIp, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Invalid device address %s\n", deviceIp);
+    close(fd);
+    return false;
+  }
+
+  sendto(fd, w.buffer, w.size, 0, (sockaddr*)&addr, sizeof(addr));
+
+  //Wait for the status reply
+  pollfd pfd = { fd, POLLIN, 0 };
+  bool ok = false;
+  if (poll(&pfd, 1, 1000) > 0) {
+    uint8_t reply[UDP_BINARY_MAX_PACKET_SIZE];
+    int size = recv(fd, reply, sizeof(reply), 0);
+
+    TlvReader r;
+    uint8_t tag;
+    const uint8_t* value;
+    int length;
+    if (size > 0 && tlvOpen(r, reply, size)) {
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_STATUS && length == 1) ok = value[0] == STATUS_OK;
+      }
+    }
+  }
+
+  close(fd);
+  if (!ok) fprintf(stderr, "Board at %s did not acknowledge the telemetry settings.\n", deviceIp);
+  return ok;
+}
+
+//**********************************************************************
+//*                           Loopback Check
+//**********************************************************************
+void sendFrame(int fd, sockaddr_in& addr, TelemetryFrame& frame, int budget) {
+  uint8_t packet[TELEMETRY_MAX_PACKET_SIZE];
+  int size = telemetryEncode(packet, budget, frame);
+  sendto(fd, packet, size, 0, (sockaddr*)&addr, sizeof(addr));
+}
+
+//Streams frames to ourselves dropping every 7th, sending every 11th twice and delivering every 13th
+//late, then checks the receiver kept the newest snapshot and counted the gaps
+int runLoopbackCheck(int port) {
+  TelemetryReceiver r;
+  if (!telemetryOpen(r, port, NULL)) {
+    fprintf(stderr, "Failed to bind port %d\n", port);
+    return 1;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  const int frameCount = 2000;
+  int failures = 0;
+  uint64_t expectedLost = 0, expectedStale = 0;
+  TelemetryFrame frame = { }, late = { };
+  bool hasLate = false;
+
+  for (int i = 0; i < frameCount; i++) {
+    frame.sequence = (uint16_t)(65000 + i); //Crosses the 16 bit wrap
+    frame.frame = i;
+    frame.stage = 31;
+    frame.playerCount = 2;
+    for (int j = 0; j < 2; j++) {
+      TelemetryPlayer& p = frame.players[j];
+      p.port = j + 1;
+      p.stocks = 4 - i / 600;
+      p.locationX = 80 * sinf(i * 0.01f + j);
+      p.locationY = 20 * cosf(i * 0.02f);
+      p.percent = fmodf(i * 0.37f, 300);
+      p.shieldSize = 60 - (i % 60);
+      p.joystickX = sinf(i * 0.1f);
+      p.joystickY = -cosf(i * 0.1f);
+      p.trigger = (i % 10) / 10.0f;
+    }
+
+    if (i % 7 == 3) {
+      expectedLost++;
+      continue;
+    }
+    if (i % 13 == 5 && i + 1 < frameCount && (i + 1) % 7 != 3) {
+      //Hold this one back until after the next frame. It counts as lost when the next frame arrives and
+      //as stale when it finally shows up
+      late = frame;
+      hasLate = true;
+      expectedLost++;
+      continue;
+    }
+
+    sendFrame(fd, addr, frame, TELEMETRY_MAX_PACKET_SIZE);
+    if (hasLate) {
+      sendFrame(fd, addr, late, TELEMETRY_MAX_PACKET_SIZE);
+      expectedStale++;
+      hasLate = false;
+    }
+    if (i % 11 == 0) {
+      sendFrame(fd, addr, frame, TELEMETRY_MAX_PACKET_SIZE);
+      expectedStale++;
+    }
+
+    //Drain as an overlay would, once per frame
+    telemetryPoll(r);
+    if (!r.hasFrame || r.latest.frame != frame.frame) {
+      fprintf(stderr, "Frame %d: latest snapshot is frame %u\n", i, r.latest.frame);
+      failures++;
+      continue;
+    }
+
+    for (int j = 0; j < 2; j++) {
+      const TelemetryPlayer& a = frame.players[j];
+      const TelemetryPlayer& b = r.latest.players[j];
+      if (fabsf(a.locationX - b.locationX) > 0.51f / TELEMETRY_POSITION_SCALE ||
+        fabsf(a.percent - b.percent) > 0.51f / TELEMETRY_PERCENT_SCALE ||
+        fabsf(a.joystickX - b.joystickX) > 0.51f / TELEMETRY_STICK_SCALE || a.stocks != b.stocks) {
+        fprintf(stderr, "Frame %d: player %d does not round trip\n", i, j + 1);
+        failures++;
+      }
+    }
+  }
+
+  //A budget too small for both players must truncate instead of overflowing
+  uint8_t small[TELEMETRY_HEADER_SIZE + TELEMETRY_PLAYER_SIZE];
+  TelemetryFrame decoded;
+  int size = telemetryEncode(small, sizeof(small), frame);
+  if (size != (int)sizeof(small) || !telemetryDecode(small, size, decoded) || decoded.playerCount != 1 ||
+    !(decoded.flags & TELEMETRY_FLAG_TRUNCATED)) {
+    fprintf(stderr, "Byte budget was not respected\n");
+    failures++;
+  }
+
+  printf("Received: %llu | Lost: %llu (expected %llu) | Stale: %llu (expected %llu) | Malformed: %llu\n",
+    (unsigned long long)r.received, (unsigned long long)r.lost, (unsigned long long)expectedLost,
+    (unsigned long long)r.stale, (unsigned long long)expectedStale, (unsigned long long)r.malformed);
+
+  if (r.lost != expectedLost || r.stale != expectedStale || r.malformed != 0) failures++;
+
+  close(fd);
+  telemetryClose(r);
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+void printSnapshot(const TelemetryReceiver& r) {
+  const TelemetryFrame& f = r.latest;
+  printf("seq %5u frame %6u stage %2u", f.sequence, f.frame, f.stage);
+  for (int i = 0; i < f.playerCount; i++) {
+    const TelemetryPlayer& p = f.players[i];
+    printf(" | P%u %u stocks %5.1f%% (%7.2f, %7.2f) shield %4.1f", p.port, p.stocks, p.percent,
+      p.locationX, p.locationY, p.shieldSize);
+  }
+  printf(" | lost %llu stale %llu\n", (unsigned long long)r.lost, (unsigned long long)r.stale);
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  int port = TELEMETRY_PORT;
+  const char* group = NULL;
+  const char* deviceIp = NULL;
+  const char* targetIp = NULL;
+  int decimation = -1;
+  int budget = -1;
+  bool loopback = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:g:d:n:b:a:l")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 'g': group = optarg; break;
+      case 'd': deviceIp = optarg; break;
+      case 'n': decimation = atoi(optarg); break;
+      case 'b': budget = atoi(optarg); break;
+      case 'a': targetIp = optarg; break;
+      case 'l': loopback = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port] [-g multicastGroup] [-d deviceIp [-n decimation] [-b byteBudget] [-a telemetryTarget]] [-l]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (loopback) return runLoopbackCheck(port);
+
+  if (deviceIp) {
+    if (decimation < 0 && budget < 0 && !targetIp) decimation = 1;
+    if (!configureBoard(deviceIp, targetIp, decimation, budget)) return 1;
+  }
+
+  TelemetryReceiver r;
+  if (!telemetryOpen(r, port, group)) {
+    fprintf(stderr, "Failed to listen for telemetry on port %d\n", port);
+    return 1;
+  }
+
+  fprintf(stderr, "Listening for telemetry on port %d.\n", port);
+
+  //Print at most once a second, the receiver itself keeps up with every frame
+  time_t lastPrint = 0;
+  while (true) {
+    if (telemetryWait(r, 1000) == 0) continue;
+
+    time_t now = time(NULL);
+    if (now != lastPrint) {
+      printSnapshot(r);
+      lastPrint = now;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,323 @@
+//TimeSyncServer - stand-in for the server side of the board's time sync (timesync.h). Answers time sync
+//requests on UDP 3637 with the host's wall clock, and optionally listens for telemetry to report the
+//true delivery latency of every setup from the server time stamped into each datagram.
+//
+//Build (Linux): g++ -O2 -std=c++11 -pthread TimeSyncServer.cpp -o TimeSyncServer
+//Usage: TimeSyncServer [-p port] [-t] [-c]
+//  -t also listens for telemetry on TELEMETRY_PORT and prints delivery latency per setup
+//  -c checks the sync algorithm against a simulated drifting clock and the server over loopback, then exits
+
+#include <map>
+#include <string>
+#include <thread>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/udpprotocol.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/timesync.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/telemetry.h"
+#include "../../TM4C1294 Source/EnhMelee1294Firmware/latency.h"
+
+#define DEFAULT_PORT 3637
+#define REPORT_INTERVAL_S 5
+#define DELIVERY_BUCKET_US 16 //8ms range
+
+//Server time, microseconds since the Unix epoch
+uint64_t serverMicros() {
+  timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  return t.tv_sec * 1000000ull + t.tv_nsec / 1000;
+}
+
+int bindUdp(int port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return -1;
+
+  int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//**********************************************************************
+//*                           Time Sync Replies
+//**********************************************************************
+//Answers one request. T2 is taken as soon as the datagram is read and T3 right before the reply is sent
+void handleTimeSyncRequest(int fd) {
+  uint8_t packet[UDP_BINARY_MAX_PACKET_SIZE];
+  sockaddr_in from;
+  socklen_t fromLength = sizeof(from);
+
+  int size = recvfrom(fd, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLength);
+  uint64_t t2 = serverMicros();
+  if (size <= 0) return;
+
+  TlvReader r;
+  if (!tlvOpen(r, packet, size) || r.type != MSG_TYPE_TIME_SYNC || r.version != UDP_BINARY_VERSION) return;
+
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  const uint8_t* t1 = NULL;
+  while (tlvNext(r, tag, value, length)) {
+    if (tag == TLV_TIME_T1 && length == 8) t1 = value;
+  }
+  if (!t1) return;
+
+  uint8_t reply[UDP_BINARY_HEADER_SIZE + 30];
+  TlvWriter w;
+  tlvBegin(w, reply, sizeof(reply), MSG_TYPE_TIME_SYNC, r.sequence);
+  tlvAppend(w, TLV_TIME_T1, t1, 8);
+  tlvAppendLong(w, TLV_TIME_T2, t2);
+  tlvAppendLong(w, TLV_TIME_T3, serverMicros());
+  sendto(fd, w.buffer, w.size, 0, (sockaddr*)&from, fromLength);
+}
+
+//**********************************************************************
+//*                          Delivery Latency
+//**********************************************************************
+typedef struct {
+  LatencyHistogram delivery;
+  uint64_t unsynchronized;
+} SetupDelivery;
+
+void handleTelemetry(int fd, std::map<std::string, SetupDelivery>& setups) {
+  uint8_t packet[TELEMETRY_MAX_PACKET_SIZE + 1];
+  sockaddr_in from;
+  socklen_t fromLength = sizeof(from);
+
+  int size = recvfrom(fd, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLength);
+  uint64_t arrival = serverMicros();
+
+  TelemetryFrame frame;
+  if (size <= 0 || !telemetryDecode(packet, size, frame)) return;
+
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+
+  std::map<std::string, SetupDelivery>::iterator it = setups.find(ip);
+  if (it == setups.end()) {
+    it = setups.insert(std::make_pair(std::string(ip), SetupDelivery())).first;
+    latencyHistogramReset(it->second.delivery, DELIVERY_BUCKET_US);
+    it->second.unsynchronized = 0;
+  }
+
+  if (!(frame.flags & TELEMETRY_FLAG_SERVER_TIME)) {
+    it->second.unsynchronized++;
+    return;
+  }
+
+  //A stamp slightly in the future is sync error, count it as zero
+  uint64_t delivery = arrival > frame.serverTime ? arrival - frame.serverTime : 0;
+  latencyHistogramAdd(it->second.delivery, (uint32_t)(delivery < 0xFFFFFFFF ? delivery : 0xFFFFFFFF));
+}
+
+void printDelivery(std::map<std::string, SetupDelivery>& setups) {
+  for (std::map<std::string, SetupDelivery>::iterator it = setups.begin(); it != setups.end(); ++it) {
+    LatencyHistogram& h = it->second.delivery;
+    printf("%-15s frames=%lu p50=%luus p99=%luus max=%luus unsynchronized=%llu\n", it->first.c_str(),
+      (unsigned long)h.count, (unsigned long)latencyPercentile(h, 50), (unsigned long)latencyPercentile(h, 99),
+      (unsigned long)h.maxUs, (unsigned long long)it->second.unsynchronized);
+  }
+  fflush(stdout);
+}
+
+//**********************************************************************
+//*                                Check
+//**********************************************************************
+uint32_t nextRandomDelay(uint32_t& state) {
+  //xorshift32, deterministic so runs are repeatable
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+//Runs timesync.h against a board clock that is off by decades and drifts by 40ppm, with queueing delay
+//on both paths, and measures the error of the converted time between exchanges
+int checkSimulated() {
+  const int64_t trueOffset = 1700000000000000ll; //Board boots at the Unix epoch, the server is in 2023
+  const double driftPpm = 40;
+  uint32_t rng = 0xC0FFEE;
+
+  TimeSync ts;
+  timeSyncInit(ts);
+
+  double worstError = 0;
+  uint64_t serverNow = trueOffset;
+
+  //Board local time as a function of server time
+  #define LOCAL_AT(server) ((uint64_t)(((server) - trueOffset) * (1 + driftPpm / 1e6)))
+
+  for (int exchange = 0; exchange < 300; exchange++) {
+    int interval = exchange < TIME_SYNC_SAMPLE_COUNT ? 250000 : 2000000;
+    serverNow += interval;
+
+    //Base path delay plus occasional queueing, in both directions independently
+    uint32_t outbound = 300 + (nextRandomDelay(rng) % 4 == 0 ? nextRandomDelay(rng) % 5000 : nextRandomDelay(rng) % 100);
+    uint32_t inbound = 300 + (nextRandomDelay(rng) % 4 == 0 ? nextRandomDelay(rng) % 5000 : nextRandomDelay(rng) % 100);
+
+    uint64_t t1 = LOCAL_AT(serverNow);
+    uint64_t t2 = serverNow + outbound;
+    uint64_t t3 = t2 + 20;
+    uint64_t t4 = LOCAL_AT(t3 + inbound);
+    timeSyncAddSample(ts, t1, t2, t3, t4);
+
+    //Check the conversion halfway to the next exchange, once the drift estimate has settled
+    if (exchange >= 30) {
+      uint64_t probeServer = t3 + inbound + interval / 2;
+      double error = fabs((double)(timeSyncToServer(ts, LOCAL_AT(probeServer)) - (int64_t)probeServer));
+      if (error > worstError) worstError = error;
+    }
+
+    serverNow = t3 + inbound;
+  }
+
+  #undef LOCAL_AT
+
+  printf("Simulated: worst error %.0fus, drift estimate %.1fppm (true %.1fppm)\n", worstError,
+    -ts.drift * 1e6, driftPpm);
+  return worstError < 500 ? 0 : 1;
+}
+
+//Does a few real exchanges against the server thread over loopback
+int checkLoopback(int port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  TimeSync ts;
+  timeSyncInit(ts);
+
+  //The local clock is the monotonic clock, nowhere near server time
+  for (int i = 0; i < TIME_SYNC_SAMPLE_COUNT; i++) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t t1 = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+
+    uint8_t packet[UDP_BINARY_HEADER_SIZE + 10];
+    TlvWriter w;
+    tlvBegin(w, packet, sizeof(packet), MSG_TYPE_TIME_SYNC, i);
+    tlvAppendLong(w, TLV_TIME_T1, t1);
+    sendto(fd, w.buffer, w.size, 0, (sockaddr*)&addr, sizeof(addr));
+
+    pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 1000) <= 0) continue;
+
+    uint8_t reply[UDP_BINARY_MAX_PACKET_SIZE];
+    int size = recv(fd, reply, sizeof(reply), 0);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t t4 = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+
+    TlvReader r;
+    uint8_t tag;
+    const uint8_t* value;
+    int length;
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    if (size > 0 && tlvOpen(r, reply, size)) {
+      while (tlvNext(r, tag, value, length)) {
+        if (length == 8 && tag >= TLV_TIME_T1 && tag <= TLV_TIME_T3) t[tag - TLV_TIME_T1] = tlvLong(value);
+      }
+    }
+
+    if (t[0] == t1) timeSyncAddSample(ts, t[0], t[1], t[2], t4);
+    usleep(20000);
+  }
+
+  close(fd);
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t local = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+  double error = fabs((double)(timeSyncToServer(ts, local) - (int64_t)serverMicros()));
+
+  printf("Loopback: %u exchanges, round trip %lluus, error %.0fus\n", ts.exchanges,
+    (unsigned long long)ts.delay, error);
+  return ts.valid && ts.exchanges == TIME_SYNC_SAMPLE_COUNT && error < 1000 ? 0 : 1;
+}
+
+//**********************************************************************
+//*                                Main
+//**********************************************************************
+void serveTimeSync(int fd) {
+  while (true) handleTimeSyncRequest(fd);
+}
+
+int main(int argc, char** argv) {
+  int port = DEFAULT_PORT;
+  bool telemetry = false;
+  bool check = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:tc")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 't': telemetry = true; break;
+      case 'c': check = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port] [-t] [-c]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  int syncFd = bindUdp(port);
+  if (syncFd < 0) {
+    fprintf(stderr, "Failed to bind UDP port %d\n", port);
+    return 1;
+  }
+
+  if (check) {
+    std::thread server(serveTimeSync, syncFd);
+    server.detach();
+
+    int failures = checkSimulated() + checkLoopback(port);
+    printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+    return failures == 0 ? 0 : 1;
+  }
+
+  int telemetryFd = -1;
+  if (telemetry && (telemetryFd = bindUdp(TELEMETRY_PORT)) < 0) {
+    fprintf(stderr, "Failed to bind telemetry port %d\n", TELEMETRY_PORT);
+    return 1;
+  }
+
+  fprintf(stderr, "Answering time sync requests on UDP port %d.\n", port);
+
+  std::map<std::string, SetupDelivery> setups;
+  time_t lastReport = time(NULL);
+
+  pollfd fds[2] = { { syncFd, POLLIN, 0 }, { telemetryFd, POLLIN, 0 } };
+  while (true) {
+    if (poll(fds, telemetry ? 2 : 1, 1000) > 0) {
+      if (fds[0].revents & POLLIN) handleTimeSyncRequest(syncFd);
+      if (telemetry && (fds[1].revents & POLLIN)) handleTelemetry(telemetryFd, setups);
+    }
+
+    if (telemetry && time(NULL) - lastReport >= REPORT_INTERVAL_S) {
+      printDelivery(setups);
+      lastReport = time(NULL);
+    }
+  }
+
+  return 0;
+}
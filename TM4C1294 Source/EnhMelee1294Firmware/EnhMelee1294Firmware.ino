@@ -1,35 +1,46 @@
-#include <EEPROM.h>
-
 #include <SPI.h>
 #include <Ethernet.h>
 #include <EthernetUdp.h>
+#include <lwiplib.h>
 #include <ArduinoJson.h>
 
+#include "driverlib/eeprom.h"
+#include "driverlib/timer.h"
+
 #include "SSI3DMASlave.h"
 #include "enhmelee.h"
+#include "eventschema.h"
+#define MSG_CRC_HARDWARE
+#include "msgcheck.h"
 #include "Flash.h"
-
-//**********************************************************************
-//*                         ASM Event Codes
-//**********************************************************************
-#define EVENT_GAME_START 0x37
-#define EVENT_UPDATE 0x38
-#define EVENT_GAME_END 0x39
-
-int asmEvents[256];
-
-void asmEventsInitialize() {
-  asmEvents[EVENT_GAME_START] = 0xA;
-  asmEvents[EVENT_UPDATE] = 0x7A;
-  asmEvents[EVENT_GAME_END] = 0x1;
-}
+#include "udpprotocol.h"
+#include "livestats.h"
+#include "playevents.h"
+#include "statseries.h"
+#include "techniques.h"
+#include "heatmap.h"
+#include "movestats.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "timesync.h"
+#include "scheduler.h"
+#include "idle.h"
+#include "metrics.h"
+#include "netboot.h"
 
 //**********************************************************************
 //*               SPI Slave Communication Functions
 //**********************************************************************
 RfifoMessage Msg; //Keep an RfifoMessage variable as a global variable to prevent memory leak?
+FrameTiming MsgTiming; //Stamps for Msg, filled in as the message goes through the main loop
+LatencyStats Latency;
+IdleStats Idle;
+MsgCheckStats MsgChecks = { };
+bool otherSchemaGame = false; //The game came from a Gecko code of another schema version, its messages are not used
+MetricsRegistry Metrics; //Health of the board, read by UDP queries
 
 void spiSlaveInitialize() {
+  msgCheckInitialize();
   SSI3DMASlave.begin();
 }
 
@@ -40,18 +51,22 @@ void spiReadMessage() {
   if(!SSI3DMASlave.isMessageAvailable()) return;
   
   uint32_t messageSize = SSI3DMASlave.getMessageSize();
+  MsgTiming = { SSI3DMASlave.getMessageTimestamp(), 0, 0, 0 };
   uint8_t* bytes = SSI3DMASlave.popMessage();
+  metricAdd(Metrics, METRIC_SSI_MESSAGES, 1);
   
   Msg.eventCode = bytes[0];
   
-  //Copy all bytes from receive buffer to msg
-  for (int i = 1; i < messageSize; i++) Msg.data[i-1] = bytes[i];
+  //If the size or the crc is wrong, return without flagging success. Corrupt bytes must never reach the stats
+  int payloadSize;
+  int result = msgCheck(bytes, messageSize, asmEvents, payloadSize, MsgChecks);
+  if (result == MSG_CHECK_OTHER_SCHEMA) dropOtherSchemaGame(0);
+  if (result != MSG_CHECK_OK && result != MSG_CHECK_UNCHECKED) return;
   
-  Msg.messageSize = messageSize - 1;
-  
-  //If message size does not match expected size, return without flagging success
-  if (Msg.messageSize != asmEvents[Msg.eventCode]) return;
+  //Copy the payload from receive buffer to msg, writeMsg() forwards it without the trailer
+  for (int i = 0; i < payloadSize; i++) Msg.data[i] = bytes[i + 1];
   
+  Msg.messageSize = payloadSize;
   Msg.success = true; 
 }
 
@@ -59,111 +74,71 @@ void spiReadMessage() {
 //*                         Event Handlers
 //**********************************************************************
 Game CurrentGame = { };
-
-//The read operators will read a value and increment the index so the next read will read in the correct location
-uint8_t readByte(uint8_t* a, int& idx) {
-  return a[idx++];
+LiveStats LiveSnapshots; //Published from loop() every interval frames, read by UDP queries
+PlayEventQueue PlayEvents; //Queued by computeStatistics(), pushed by a background task
+TechTables TechniqueTables; //Compiled from the machines in techniques.h at startup
+TechTracker TechniqueTrackers[PLAYER_COUNT];
+StageHeatmaps Heatmaps; //Positions and spacing of the game in progress, read by UDP queries
+HeatmapPages HeatmapQueryPages; //The grid a query is paging through
+StatSeries Series; //Every counter bucketed over time, read by UDP queries
+MoveStats MoveHistograms[PLAYER_COUNT]; //What each move did, read by UDP queries
+
+//The Gecko code and this firmware have to be upgraded together. A game from another schema version is
+//dropped whole instead of decoding its updates with the wrong layout, and counted in MsgChecks
+void dropOtherSchemaGame(uint8_t version) {
+  otherSchemaGame = true;
+  debugPrintln(String("Game dropped: the Gecko code sends event schema ") + version + String(", this firmware reads ") +
+    EVENT_SCHEMA_VERSION + String(". Upgrade both together"));
 }
 
-uint16_t readHalf(uint8_t* a, int& idx) {
-  uint16_t value = a[idx] << 8 | a[idx + 1];
-  idx += 2;
-  return value;
-}
-
-uint32_t readWord(uint8_t* a, int& idx) {
-  uint32_t value = a[idx] << 24 | a[idx + 1] << 16 | a[idx + 2] << 8 | a[idx + 3];
-  idx += 4;
-  return value;
-}
-
-float readFloat(uint8_t* a, int& idx) {
-  uint32_t bytes = readWord(a, idx);
-  return *(float*)(&bytes);
-}
-
-void handleGameStart() {
+//Event codes, payload sizes and the field by field decode come from the schema in eventschema.h. Returns
+//false if the game is dropped for its schema version
+bool handleGameStart() {
   writeMsg();
   
-  uint8_t* data = Msg.data;
-  int idx = 0;
-  
   //Reset CurrentGame variable
   CurrentGame = { };
   
-  //Load stage ID
-  CurrentGame.stage = readHalf(data, idx);
-
+  schemaDecodeGameStart(CurrentGame, Msg.data);
+  if (!schemaVersionMatches(CurrentGame)) {
+    MsgChecks.otherSchemas++;
+    dropOtherSchemaGame(CurrentGame.schemaVersion);
+    return false;
+  }
+  otherSchemaGame = false;
+  
   for (int i = 0; i < PLAYER_COUNT; i++) {
-    Player& p = CurrentGame.players[i];
-    
-    //Load player data
-    p.controllerPort = readByte(data, idx);
-    p.characterId = readByte(data, idx);
-    p.playerType = readByte(data, idx);
-    p.characterColor = readByte(data, idx);
+    techResetTracker(TechniqueTrackers[i]);
+    moveStatsReset(MoveHistograms[i]);
   }
+  heatmapReset(Heatmaps, CurrentGame.stage);
+  seriesReset(Series);
+  return true;
 }
 
 void handleUpdate() {
   writeMsg();
   
-  uint8_t* data = Msg.data;
-  int idx = 0;
+  uint32_t lastFrame = CurrentGame.frameCounter;
+
+  //The current frame becomes the previous one, see FrameHistory in enhmelee.h
+  for (int i = 0; i < PLAYER_COUNT; i++) frameHistoryAdvance(CurrentGame.players[i]);
+
+  schemaDecodeUpdate(CurrentGame, Msg.data);
   
   //Check frame count and see if any frames were skipped
-  uint32_t frameCount = readWord(data, idx);
-  int framesMissed = frameCount - CurrentGame.frameCounter - 1;
+  int framesMissed = CurrentGame.frameCounter - lastFrame - 1;
   CurrentGame.framesMissed += framesMissed;
-  CurrentGame.frameCounter = frameCount;
-
-  CurrentGame.randomSeed = readWord(data, idx);
-
-  for (int i = 0; i < PLAYER_COUNT; i++) {
-    Player& p = CurrentGame.players[i];
-
-    //Change over previous frame data
-    p.previousFrameData = p.currentFrameData;
-
-    PlayerFrameData& pfd = p.currentFrameData;
-
-    //Load player data
-    pfd = { };
-    pfd.internalCharacterId = readByte(data, idx);
-    pfd.animation = readHalf(data, idx);
-    pfd.locationX = readFloat(data, idx);
-    pfd.locationY = readFloat(data, idx);
-
-    //Controller information
-    pfd.joystickX = readFloat(data, idx);
-    pfd.joystickY = readFloat(data, idx);
-    pfd.cstickX = readFloat(data, idx);
-    pfd.cstickY = readFloat(data, idx);
-    pfd.trigger = readFloat(data, idx);
-    pfd.buttons = readWord(data, idx);
-
-    //More data
-    pfd.percent = readFloat(data, idx);
-    pfd.shieldSize = readFloat(data, idx);
-    pfd.lastMoveHitId = readByte(data, idx);
-    pfd.comboCount = readByte(data, idx);
-    pfd.lastHitBy = readByte(data, idx);
-    pfd.stocks = readByte(data, idx);
-
-    //Raw controller information
-    pfd.physicalButtons = readHalf(data, idx);
-    pfd.lTrigger = readFloat(data, idx);
-    pfd.rTrigger = readFloat(data, idx);
-  }
+  metricAdd(Metrics, METRIC_FRAMES, 1);
+  if (framesMissed > 0) metricAdd(Metrics, METRIC_FRAMES_MISSED, framesMissed);
+  CurrentGame.frameDelta = lastFrame != 0 && framesMissed > 0 ? framesMissed + 1 : 1; //The first update counts as one frame
 }
 
 void handleGameEnd() {
   writeMsg();
   
-  uint8_t* data = Msg.data;
-  int idx = 0;
-  
-  CurrentGame.winCondition = readByte(data, idx);
+  schemaDecodeGameEnd(CurrentGame, Msg.data);
+  metricAdd(Metrics, METRIC_GAMES, 1);
 }
 
 //**********************************************************************
@@ -186,6 +161,7 @@ byte mac[] = { 0x00, 0x1A, 0xB6, 0x02, 0xF5, 0x8C };
 IPAddress serverIp(10, 0, 0, 13);
 int serverPort = 3636;
 long timeOfLastFailedConnection = 0;
+bool clientWasConnected = false; //To count lost connections
 EthernetClient client;
 
 int udpPort = 3637;
@@ -195,9 +171,37 @@ EthernetUDP udp;
 
 bool ethernetInitialized = false;
 
+//The network comes up in the background after ingest is running, see netboot.h
+NetBoot Boot = { };
+StreamBacklog Backlog;
+
 bool sendUdpDebugMessages = true;
 bool sendSerialDebugMessages = true;
 
+//Time sync with the server, requests go to the server's UDP port 3637
+#define TIME_SYNC_FAST_INTERVAL_MS 250 //Until the sample window is full
+#define TIME_SYNC_INTERVAL_MS 2000
+
+TimeSync ServerClock;
+uint64_t timeSyncPendingT1 = 0;
+unsigned long timeOfLastTimeSync = 0;
+
+//Telemetry settings are not persisted, hosts configure them after discovery
+IPAddress telemetryIp(255, 255, 255, 255); //Broadcast by default, a multicast group address also works
+uint8_t telemetryDecimation = 0; //Send every Nth frame, 0 disables telemetry
+int telemetryByteBudget = TELEMETRY_MAX_PACKET_SIZE;
+
+//Live stats are pushed to the host that last asked for it, not persisted either
+bool liveStatsPush = false;
+IPAddress liveStatsPushIp;
+int liveStatsPushPort = 0;
+uint32_t liveStatsPushedSequence = 0;
+uint8_t liveStatsPushPart = LIVE_PART_COUNT; //Next part of the pushed snapshot to send, LIVE_PART_COUNT once all went
+
+//Play events go to the host that last asked for them, see playevents.h
+IPAddress playEventsPushIp;
+int playEventsPushPort = 0;
+
 String ipPortToString(IPAddress ip, int port) {
   char ipAddressString[30];
   sprintf(ipAddressString, "%d.%d.%d.%d:%d", ip[0], ip[1], ip[2], ip[3], port);
@@ -220,30 +224,77 @@ String macToString() {
   return String(macString);
 }
 
-void ethernetInitialize() {
-  debugPrintln("Checking EEPROM Schema");
+//Settings are stored as one 8 byte block: schema, target IP (4), target port (2, big endian), debug flags.
+//Programming the block in one call costs two EEPROM word writes instead of one read-modify-write per byte
+void loadSettings() {
+  ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
+  EEPROMInit();
   
-  int i = 0;
-  byte schemaRead = EEPROM.read(i++);
+  uint32_t words[2];
+  EEPROMRead(words, 0, sizeof(words));
+  uint8_t* settings = (uint8_t*)words;
   
   //Ensure that EEPROM has been written to with the proper schema before reading
-  if (schemaRead == EEPROM_SCHEMA) {
-    debugPrintln("Loading settings from EEPROM");
-    
-    //Load target IP address
-    serverIp[0] = EEPROM.read(i++);
-    serverIp[1] = EEPROM.read(i++);
-    serverIp[2] = EEPROM.read(i++);
-    serverIp[3] = EEPROM.read(i++);
-    
-    //Load port
-    serverPort = EEPROM.read(i++) << 8 | EEPROM.read(i++);
-    
-    //Load debug flags
-//    byte flags = EEPROM.read(i++);
-//    sendUdpDebugMessages = flags & 0x1;
-//    sendSerialDebugMessages = flags & 0x2;
-  }
+  if (settings[0] != EEPROM_SCHEMA) return;
+  
+  debugPrintln("Loading settings from EEPROM");
+  
+  //Load target IP address
+  serverIp[0] = settings[1];
+  serverIp[1] = settings[2];
+  serverIp[2] = settings[3];
+  serverIp[3] = settings[4];
+  
+  //Load port
+  serverPort = settings[5] << 8 | settings[6];
+  
+  //Load debug flags
+//  sendUdpDebugMessages = settings[7] & 0x1;
+//  sendSerialDebugMessages = settings[7] & 0x2;
+}
+
+void saveSettings() {
+  uint32_t words[2];
+  uint8_t* settings = (uint8_t*)words;
+  
+  settings[0] = EEPROM_SCHEMA;
+  settings[1] = serverIp[0];
+  settings[2] = serverIp[1];
+  settings[3] = serverIp[2];
+  settings[4] = serverIp[3];
+  settings[5] = serverPort >> 8 & 0xFF;
+  settings[6] = serverPort & 0xFF;
+  settings[7] = (sendUdpDebugMessages ? 0x1 : 0) | (sendSerialDebugMessages ? 0x2 : 0);
+  
+  EEPROMProgram(words, 0, sizeof(words));
+}
+
+//The last lease DHCP gave, the fallback when DHCP does not answer after a reset. Kept after the settings
+#define EEPROM_LEASE_OFFSET 8
+
+void loadLease() {
+  uint32_t words[NETBOOT_LEASE_WORDS];
+  EEPROMRead(words, EEPROM_LEASE_OFFSET, sizeof(words));
+  Boot.hasCachedLease = netBootUnpackLease(words, Boot.cachedLease);
+}
+
+//Only written when the lease changed, a board that always gets the same address never wears the EEPROM
+void saveLease(const NetLease& lease) {
+  if (Boot.hasCachedLease && memcmp(&lease, &Boot.cachedLease, sizeof(lease)) == 0) return;
+  
+  uint32_t words[NETBOOT_LEASE_WORDS];
+  netBootPackLease(lease, words);
+  EEPROMProgram(words, EEPROM_LEASE_OFFSET, sizeof(words));
+  
+  Boot.cachedLease = lease;
+  Boot.hasCachedLease = true;
+}
+
+//Starts DHCP without waiting for an address, bootNetwork() finishes bringing the network up
+void ethernetInitialize() {
+  debugPrintln("Checking EEPROM Schema");
+  loadSettings();
+  loadLease();
   
   debugPrintln("Getting MAC Address from registers.");
   loadMacAddress(mac);
@@ -251,25 +302,85 @@ void ethernetInitialize() {
   
   debugPrintln("Attempting to obtain IP address from DHCP");
   
-  // start the Ethernet connection:
-  if (Ethernet.begin(mac)) {
-    debugPrintln("Obtained IP address: " + ipToString(Ethernet.localIP()));
-  } else {
-    debugPrintln("Failed to configure Ethernet using DHCP");
+  //A timeout of 0 returns as soon as the interface is up, lwIP keeps asking for a lease in the background
+  Boot.dhcpStartMs = millis();
+  Ethernet.begin(mac, 0);
+}
+
+void ipToBytes(IPAddress ip, uint8_t* bytes) {
+  for (int i = 0; i < 4; i++) bytes[i] = ip[i];
+}
+
+//lwIP's configuration calls take addresses as host order words, 192.168.0.1 is 0xC0A80001
+uint32_t ipToWord(const uint8_t* bytes) {
+  return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+//Called by the boot task until the network is up, then only sends the backlog
+void bootNetwork() {
+  if (Boot.source == NETBOOT_WAITING) {
+    int step = netBootAdvance(Boot, millis(), (uint32_t)Ethernet.localIP() != 0);
+    NetLease lease;
+    
+    if (step == NETBOOT_GOT_LEASE) {
+      ipToBytes(Ethernet.localIP(), lease.ip);
+      ipToBytes(Ethernet.subnetMask(), lease.subnet);
+      ipToBytes(Ethernet.gatewayIP(), lease.gateway);
+      ipToBytes(Ethernet.dnsServerIP(), lease.dns);
+      saveLease(lease);
+    }
+    else if (step == NETBOOT_FALL_BACK) {
+      //DHCP is still running in lwIP, a second Ethernet.begin() would start the interface over underneath
+      //it. This stops DHCP and moves the running interface to the address instead. The server is reached by
+      //address, so the lease's DNS server is not needed
+      lease = netBootFallbackLease(Boot, mac);
+      lwIPNetworkConfigChange(ipToWord(lease.ip), ipToWord(lease.subnet), ipToWord(lease.gateway), IPADDR_USE_STATIC);
+    }
+    else return;
+    
+    if (udp.begin(udpPort)) {
+      debugPrintln("Initialized UDP");
+    } else {
+      debugPrintln("Failed to initialize UDP");
+    }
+    
+    ethernetInitialized = true;
+    
+    //lwIP applies a configuration change from its own timer, the lease is what the interface is getting
+    if (Boot.source == NETBOOT_DHCP) debugPrintln("Obtained IP address: " + ipToString(IPAddress(lease.ip)));
+    else debugPrintln(String("No DHCP answer, using ") + (Boot.source == NETBOOT_CACHED ? "the last lease: " : "link local: ") +
+      ipToString(IPAddress(lease.ip)));
+    debugPrintln(String("Ingest was up ") + Boot.ingestUs + String("us after reset, the network ") + Boot.upMs + String("ms after reset."));
   }
   
-  if (udp.begin(udpPort)) {
-    debugPrintln("Initialized UDP");
-  } else {
-    debugPrintln("Failed to initialize UDP");
+  if (!Backlog.active) return;
+  if (!client.connected()) {
+    //Whatever was left would start the next connection in the middle of a message
+    if (Backlog.tail != 0 || backlogExpired(Boot, millis())) {
+      uint32_t lost = backlogAbandon(Backlog);
+      metricAdd(Metrics, METRIC_STREAM_DROPPED, lost);
+      debugPrintln(String("Gave up the boot backlog, ") + lost + String(" messages dropped."));
+    }
+    return;
   }
   
-  ethernetInitialized = true;
+  const uint8_t* bytes;
+  int count = backlogPeek(Backlog, bytes);
+  if (count > 0) backlogConsume(Backlog, client.write(bytes, count));
+  if (backlogPending(Backlog) == 0) {
+    Backlog.active = false;
+    debugPrintln(String("Sent the boot backlog, ") + Backlog.head + String(" bytes."));
+  }
 }
 
 void maintainClientConnection() {
   //If client is connected, nothing to do
-  if (client.connected()) return;
+  if (!ethernetInitialized || client.connected()) return;
+  
+  if (clientWasConnected) {
+    clientWasConnected = false;
+    metricAdd(Metrics, METRIC_TCP_DISCONNECTS, 1);
+  }
   
   //If connection attempt was recently failed, don't attempt to connect
   if (timeOfLastFailedConnection != 0 && millis() - timeOfLastFailedConnection < RECONNECT_TIME_MS) return;
@@ -278,123 +389,699 @@ void maintainClientConnection() {
   debugPrintln("Attempting to connect to server at " + ipPortToString(serverIp, serverPort) + "...");
   
   if (client.connect(serverIp, serverPort)) {
+    clientWasConnected = true;
+    metricAdd(Metrics, METRIC_TCP_CONNECTS, 1);
     debugPrintln("Connection to server successful.");
   } else {
     timeOfLastFailedConnection = millis();
+    metricAdd(Metrics, METRIC_TCP_CONNECT_FAILURES, 1);
     debugPrintln("Connection to server failed."); 
   }
 }
 
+//Changes the server that frames are forwarded to. Shared by the JSON and binary protocols
+void setTarget(IPAddress ip, int port) {
+  //If IP or port as changed, disconnect client
+  if (ip[0] == serverIp[0] && ip[1] == serverIp[1] && ip[2] == serverIp[2] && ip[3] == serverIp[3] && port == serverPort) return;
+  
+  debugPrintln("Change to IP or port requested.");
+  serverIp = ip;
+  serverPort = port;
+  
+  debugPrintln("Disconnecting from old client.");
+  client.stop();
+  
+  //Reset connection timer to allow instant connection attempt
+  timeOfLastFailedConnection = 0;
+  
+  //Write new settings to EEPROM
+  debugPrintln("Writing new IP settings to EEPROM");
+  saveSettings();
+}
+
+//**********************************************************************
+//*                          Server Time Sync
+//**********************************************************************
+//micros() extended to 64 bits, it wraps every ~71 minutes. A wrap is only counted if this runs at least
+//once per wrap, which the time sync task does every few seconds once Ethernet is up. Wraps missed before
+//that only move the local epoch, and no exchange has been measured against it yet
+uint64_t localMicros() {
+  static uint32_t lastMicros = 0;
+  static uint32_t wraps = 0;
+  
+  uint32_t now = micros();
+  if (now < lastMicros) wraps++;
+  lastMicros = now;
+  
+  return (uint64_t)wraps << 32 | now;
+}
+
+void requestTimeSync() {
+  if (!ethernetInitialized) return;
+  
+  unsigned long interval = ServerClock.exchanges < TIME_SYNC_SAMPLE_COUNT ? TIME_SYNC_FAST_INTERVAL_MS : TIME_SYNC_INTERVAL_MS;
+  if (millis() - timeOfLastTimeSync < interval) return;
+  timeOfLastTimeSync = millis();
+  
+  uint8_t packet[UDP_BINARY_HEADER_SIZE + 10];
+  TlvWriter w;
+  tlvBegin(w, packet, sizeof(packet), MSG_TYPE_TIME_SYNC, 0);
+  
+  //Only the latest request is matched, a reply to an older one is ignored
+  timeSyncPendingT1 = localMicros();
+  tlvAppendLong(w, TLV_TIME_T1, timeSyncPendingT1);
+  
+  udp.beginPacket(serverIp, udpPort);
+  udp.write(w.buffer, w.size);
+  udp.endPacket();
+}
+
+void handleTimeSyncReply(TlvReader& r, uint64_t t4) {
+  uint64_t t1 = 0, t2 = 0, t3 = 0;
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  
+  while (tlvNext(r, tag, value, length)) {
+    if (length != 8) continue;
+    if (tag == TLV_TIME_T1) t1 = tlvLong(value);
+    else if (tag == TLV_TIME_T2) t2 = tlvLong(value);
+    else if (tag == TLV_TIME_T3) t3 = tlvLong(value);
+  }
+  
+  if (t1 == 0 || t1 != timeSyncPendingT1 || t2 == 0 || t3 == 0) return;
+  timeSyncPendingT1 = 0;
+  
+  bool wasValid = ServerClock.valid;
+  timeSyncAddSample(ServerClock, t1, t2, t3, t4);
+  if (!wasValid && ServerClock.valid) debugPrintln("Synchronized with server clock.");
+}
+
+//Current time on the server clock, 0 if not synchronized yet
+uint64_t serverMicros() {
+  if (!ServerClock.valid) return 0;
+  return timeSyncToServer(ServerClock, localMicros());
+}
+
+//Packets are kept in global buffers. Declaring them inside the handlers put kilobytes on the stack of
+//every loop() pass that received a packet, even for packets that never needed them
+uint8_t udpPacketBuffer[UDP_MAX_PACKET_SIZE + 1];
+uint8_t udpResponseBuffer[UDP_BINARY_MAX_PACKET_SIZE];
+uint8_t udpLogBuffer[UDP_BINARY_MAX_PACKET_SIZE];
+
+//Set when the host that last discovered us speaks the binary protocol, debug messages are then sent as binary logs
+bool binaryLogging = false;
+
 void listenForUdpPacket() {
+  if (!ethernetInitialized) return;
+  
   int packetSize = udp.parsePacket();
   if (packetSize) {
+    metricAdd(Metrics, METRIC_UDP_PACKETS, 1);
     if (packetSize > UDP_MAX_PACKET_SIZE) return;
     
-    //Read UDP packet into buffer
-    char udpPacketBuffer[UDP_MAX_PACKET_SIZE];
-    udp.read(udpPacketBuffer, UDP_MAX_PACKET_SIZE);
-    
-    //Create JSON root from buffer
-    StaticJsonBuffer<UDP_MAX_PACKET_SIZE> jsonReadBuffer;
-    JsonObject& root = jsonReadBuffer.parseObject(udpPacketBuffer);
+    //Read UDP packet into buffer, terminate it for the JSON parser
+    int bytesRead = udp.read(udpPacketBuffer, UDP_MAX_PACKET_SIZE);
+    if (bytesRead <= 0) return;
+    udpPacketBuffer[bytesRead] = 0;
     
-    //Parse json for command
-    int command = root["type"];
-    debugPrintln("UDP packet contains command: " + String(command));
+    //Time sync replies need the receive time as early as possible
+    uint64_t receivedAt = localMicros();
     
-    //Prepare to write response
-    StaticJsonBuffer<2048> jsonWriteBuffer;
-    JsonObject& resp = jsonWriteBuffer.createObject();
-    
-    //TODO: Test what happens when a UDP message is sent that doesn't contain a type node
-    byte ip1, ip2, ip3, ip4;
-    int receivedPort;
-    
-    //Handle command received
-    switch(command) {
-      case MSG_TYPE_DISCOVERY:
-        //Get IP and port of the UDP sender
-        lastBroadcastIp = udp.remoteIP();
-        lastBroadcastPort = udp.remotePort();
-        debugPrintln("Received UDP packet from: " + ipPortToString(lastBroadcastIp, lastBroadcastPort));
-    
-        debugPrintln("Responding to discovery request. " + macToString());
-        //Add command and mac elements to JSON
-        resp["type"] = MSG_TYPE_DISCOVERY;
-        resp["mac"] = macToString();
-//        resp["targetIp"] = ipToString(serverIp);
-//        resp["targetPort"] = serverPort;
-//        resp["debugSerial"] = sendSerialDebugMessages;
-//        resp["debugUdp"] = sendUdpDebugMessages;
-
-        debugPrintln("Writing UDP message...");
-        //Send udp packet back
-        udp.beginPacket(lastBroadcastIp, lastBroadcastPort);
-        char buffer[2048];
-        resp.printTo(buffer, sizeof(buffer));
-        udp.write(buffer);
-        udp.endPacket();
+    if (isBinaryPacket(udpPacketBuffer, bytesRead)) handleBinaryPacket(bytesRead, receivedAt);
+    else handleJsonPacket();
+  }
+}
+
+//Latency values are sent as u16 microseconds, anything longer than 65ms is reported as 65535
+void writeClampedHalf(uint8_t* a, int& idx, uint32_t value) {
+  if (value > 0xFFFF) value = 0xFFFF;
+  a[idx++] = value >> 8;
+  a[idx++] = value & 0xFF;
+}
+
+void sendUdpResponse(TlvWriter& w, IPAddress ip, int port) {
+  udp.beginPacket(ip, port);
+  udp.write(w.buffer, w.size);
+  udp.endPacket();
+}
+
+void handleBinaryPacket(int packetSize, uint64_t receivedAt) {
+  TlvReader r;
+  tlvOpen(r, udpPacketBuffer, packetSize);
+  
+  //Replies from the server are not answered
+  if (r.type == MSG_TYPE_TIME_SYNC) {
+    if (r.version == UDP_BINARY_VERSION) handleTimeSyncReply(r, receivedAt);
+    return;
+  }
+  
+  //Capture the sender before any debug message is sent
+  IPAddress remoteIp = udp.remoteIP();
+  int remotePort = udp.remotePort();
+  
+  TlvWriter w;
+  tlvBegin(w, udpResponseBuffer, sizeof(udpResponseBuffer), r.type, r.sequence);
+  
+  if (r.version != UDP_BINARY_VERSION) {
+    tlvAppendByte(w, TLV_STATUS, STATUS_UNSUPPORTED_VERSION);
+    sendUdpResponse(w, remoteIp, remotePort);
+    return;
+  }
+  
+  uint8_t tag;
+  const uint8_t* value;
+  int length;
+  
+  switch (r.type) {
+    case MSG_TYPE_DISCOVERY: {
+      lastBroadcastIp = remoteIp;
+      lastBroadcastPort = remotePort;
+      binaryLogging = true;
+      
+      uint8_t targetIp[4] = { serverIp[0], serverIp[1], serverIp[2], serverIp[3] };
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      tlvAppend(w, TLV_MAC, mac, sizeof(mac));
+      tlvAppend(w, TLV_TARGET_IP, targetIp, sizeof(targetIp));
+      tlvAppendHalf(w, TLV_TARGET_PORT, serverPort);
+      
+      uint8_t telemetryTarget[4] = { telemetryIp[0], telemetryIp[1], telemetryIp[2], telemetryIp[3] };
+      tlvAppend(w, TLV_TELEMETRY_TARGET, telemetryTarget, sizeof(telemetryTarget));
+      tlvAppendByte(w, TLV_TELEMETRY_DECIMATION, telemetryDecimation);
+      tlvAppendHalf(w, TLV_TELEMETRY_BUDGET, telemetryByteBudget);
+      break;
+    }
+    case MSG_TYPE_SET_TARGET: {
+      bool hasIp = false, hasPort = false;
+      uint8_t ip[4];
+      uint16_t port = 0;
+      
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_TARGET_IP && length == 4) {
+          memcpy(ip, value, 4);
+          hasIp = true;
+        } else if (tag == TLV_TARGET_PORT && length == 2) {
+          port = tlvHalf(value);
+          hasPort = true;
+        }
+      }
+      
+      if (!hasIp || !hasPort) {
+        tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
+        break;
+      }
+      
+      setTarget(IPAddress(ip[0], ip[1], ip[2], ip[3]), port);
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      break;
+    }
+    case MSG_TYPE_SET_TELEMETRY:
+      //Every field is optional, only the ones present are changed
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_TELEMETRY_TARGET && length == 4) {
+          telemetryIp = IPAddress(value[0], value[1], value[2], value[3]);
+        } else if (tag == TLV_TELEMETRY_DECIMATION && length == 1) {
+          telemetryDecimation = value[0];
+        } else if (tag == TLV_TELEMETRY_BUDGET && length == 2) {
+          int budget = tlvHalf(value);
+          telemetryByteBudget = budget < TELEMETRY_MAX_PACKET_SIZE ? budget : TELEMETRY_MAX_PACKET_SIZE;
+        }
+      }
+      
+      debugPrintln("Telemetry every " + String(telemetryDecimation) + " frames to " + ipToString(telemetryIp));
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      break;
+    case MSG_TYPE_STATS_QUERY:
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_IDLE_SLEEP && length == 1) Idle.enabled = value[0] != 0;
+      }
+      
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      tlvAppendWord(w, TLV_FRAME, CurrentGame.frameCounter);
+      tlvAppendWord(w, TLV_FRAMES_MISSED, CurrentGame.framesMissed);
+      
+      for (int i = 0; i < PLAYER_COUNT; i++) {
+        Player& p = CurrentGame.players[i];
+        uint8_t player[10];
+        int idx = 0;
+        uint32_t percentBits;
+        memcpy(&percentBits, &currentFrame(p).percent, sizeof(percentBits));
         
-        debugPrintln("Discovery message written.");
+        player[idx++] = p.controllerPort + 1;
+        player[idx++] = currentFrame(p).stocks;
+        player[idx++] = percentBits >> 24;
+        player[idx++] = percentBits >> 16;
+        player[idx++] = percentBits >> 8;
+        player[idx++] = percentBits;
+        player[idx++] = p.stats.actionCount >> 8;
+        player[idx++] = p.stats.actionCount;
+        player[idx++] = p.stats.numberOfOpenings >> 8;
+        player[idx++] = p.stats.numberOfOpenings;
+        tlvAppend(w, TLV_PLAYER, player, idx);
+      }
+      
+      for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencyHistogram& h = Latency.stages[i];
+        uint8_t latency[9];
+        int idx = 0;
         
-        break;
-      case MSG_TYPE_SET_TARGET:
-        debugPrintln("Received request to change IP/Port of target server.");
+        latency[idx++] = i;
+        writeClampedHalf(latency, idx, latencyPercentile(h, 50));
+        writeClampedHalf(latency, idx, latencyPercentile(h, 90));
+        writeClampedHalf(latency, idx, latencyPercentile(h, 99));
+        writeClampedHalf(latency, idx, h.maxUs);
+        tlvAppend(w, TLV_LATENCY, latency, idx);
+      }
+      
+      {
+        uint8_t arrival[12];
+        int idx = 0;
         
-//        String targetIpString = root["targetIp"];
-//        int targetPort = root["targetPort"];
-//        sendSerialDebugMessages = root["debugSerial"];
-//        sendUdpDebugMessages = root["debugUdp"];
-        ip1 = root["ip1"];
-        ip2 = root["ip2"];
-        ip3 = root["ip3"];
-        ip4 = root["ip4"];
-        receivedPort = root["port"];
+        writeClampedHalf(arrival, idx, Latency.intervalMean);
+        writeClampedHalf(arrival, idx, latencyJitter(Latency));
+        writeClampedHalf(arrival, idx, latencyPercentile(Latency.arrival, 99));
+        writeClampedHalf(arrival, idx, Latency.arrival.maxUs);
+        arrival[idx++] = Latency.slowFrames >> 24;
+        arrival[idx++] = Latency.slowFrames >> 16;
+        arrival[idx++] = Latency.slowFrames >> 8;
+        arrival[idx++] = Latency.slowFrames;
+        tlvAppend(w, TLV_ARRIVAL, arrival, idx);
+      }
+      
+      {
+        uint8_t idle[13];
+        int idx = 0;
         
-        //If IP or port as changed, disconnect client
-        if (ip1 != serverIp[0] || ip2 != serverIp[1] || ip3 != serverIp[2] || ip4 != serverIp[3] || receivedPort != serverPort) {
-          debugPrintln("Change to IP or port requested.");
-          serverIp[0] = ip1;
-          serverIp[1] = ip2;
-          serverIp[2] = ip3;
-          serverIp[3] = ip4;
-          serverPort = receivedPort;
-          
-          debugPrintln("Disconnecting from old client.");
-          client.stop();
-          
-          //Reset connection timer to allow instant connection attempt
-          timeOfLastFailedConnection = 0;
-          
-          //Write new settings to EEPROM
-          debugPrintln("Writing new IP settings to EEPROM");
-          int i = 0;
-          EEPROM.write(i++, EEPROM_SCHEMA);
-          EEPROM.write(i++, ip1);
-          EEPROM.write(i++, ip2);
-          EEPROM.write(i++, ip3);
-          EEPROM.write(i++, ip4);
-          EEPROM.write(i++, receivedPort >> 8 & 0xFF);
-          EEPROM.write(i++, receivedPort & 0xFF);
+        idleAdvance(Idle, SSI3DMASlave.getTimestamp());
+        idle[idx++] = Idle.enabled;
+        writeClampedHalf(idle, idx, idleDutyCycle(Idle));
+        writeClampedHalf(idle, idx, latencyPercentile(Idle.wake, 50));
+        writeClampedHalf(idle, idx, latencyPercentile(Idle.wake, 99));
+        writeClampedHalf(idle, idx, Idle.wake.maxUs);
+        idle[idx++] = Idle.sleeps >> 24;
+        idle[idx++] = Idle.sleeps >> 16;
+        idle[idx++] = Idle.sleeps >> 8;
+        idle[idx++] = Idle.sleeps;
+        tlvAppend(w, TLV_IDLE, idle, idx);
+      }
+      break;
+    case MSG_TYPE_LIVE_STATS: {
+      uint8_t part = LIVE_PART_PLAYERS;
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_LIVE_INTERVAL && length == 2) {
+          LiveSnapshots.interval = tlvHalf(value);
+        } else if (tag == TLV_LIVE_PUSH && length == 1) {
+          liveStatsPush = value[0] != 0;
+          liveStatsPushIp = remoteIp;
+          liveStatsPushPort = remotePort;
+          liveStatsPushedSequence = LiveSnapshots.sequence;
+          liveStatsPushPart = LIVE_PART_COUNT;
+        } else if (tag == TLV_LIVE_PART && length == 1 && value[0] < LIVE_PART_COUNT) {
+          part = value[0];
         }
-        
+      }
+      
+      //No snapshot yet is still a valid answer, the host sees the interval and waits
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      tlvAppendHalf(w, TLV_LIVE_INTERVAL, LiveSnapshots.interval);
+      liveStatsAppend(w, LiveSnapshots, part);
+      break;
+    }
+    case MSG_TYPE_PLAY_EVENTS:
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_EVENT_PUSH && length == 1) {
+          //Hosts repeat the request, the stream only starts over when it is turned on or goes to a new host
+          bool enable = value[0] != 0;
+          if (enable != PlayEvents.enabled || remoteIp != playEventsPushIp || remotePort != playEventsPushPort) {
+            playEventsReset(PlayEvents, enable);
+          }
+          playEventsPushIp = remoteIp;
+          playEventsPushPort = remotePort;
+        }
+      }
+      
+      //The events themselves only ever go out as pushes
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      break;
+    case MSG_TYPE_STAT_SERIES: {
+      uint8_t port = 0, channel = 0;
+      uint32_t from = 0;
+      bool valid = true;
+      
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_SERIES_BUCKET_FRAMES && length == 2) {
+          valid &= seriesSetBucketFrames(Series, tlvHalf(value));
+        } else if (tag == TLV_SERIES_SELECT && length == 6) {
+          port = value[0];
+          channel = value[1];
+          from = (uint32_t)value[2] << 24 | (uint32_t)value[3] << 16 | (uint32_t)value[4] << 8 | value[5];
+        }
+      }
+      
+      int player = -1;
+      for (int i = 0; i < PLAYER_COUNT; i++) if (CurrentGame.players[i].controllerPort + 1 == port) player = i;
+      if (!valid || (port != 0 && (player < 0 || channel >= SERIES_CHANNELS))) {
+        tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
         break;
-      case MSG_TYPE_FLASH_ERASE:
-        debugPrintln("Erasing flash.");
-        delay(200);
-        eraseFlash();
-        debugPrintln("Flash should be erased and program should be restarted. This message should not show up.");
-    }     
+      }
+      
+      //Without a selection only the bucket length is changed
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      tlvAppendHalf(w, TLV_SERIES_BUCKET_FRAMES, Series.nextBucketFrames);
+      if (player >= 0) seriesAppend(w, Series, player, port, channel, from);
+      break;
+    }
+    case MSG_TYPE_METRICS: {
+      int first = 0;
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_METRICS_FROM && length == 1) first = value[0];
+      }
+      
+      //The MAC names the board whatever address it has today. Hosts ask again from where a reply stopped
+      metricsSample();
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      tlvAppend(w, TLV_MAC, mac, sizeof(mac));
+      if (first < METRIC_COUNT) metricsAppend(w, Metrics, first);
+      break;
+    }
+    case MSG_TYPE_HEATMAP: {
+      uint8_t grid = HEATMAP_GRID_SPACING;
+      uint16_t offset = 0;
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_HEATMAP_SELECT && length == 3) {
+          grid = value[0];
+          offset = tlvHalf(value + 1);
+        }
+      }
+      
+      if (grid > PLAYER_COUNT) {
+        tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
+        break;
+      }
+      
+      //Without a selection the spacing histogram comes back from its start
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      heatmapAppend(w, Heatmaps, HeatmapQueryPages, grid, offset, CurrentGame.frameCounter);
+      break;
+    }
+    case MSG_TYPE_MOVES: {
+      uint8_t player = 0, from = 0;
+      while (tlvNext(r, tag, value, length)) {
+        if (tag == TLV_MOVES_SELECT && length == 2) {
+          player = value[0];
+          from = value[1];
+        }
+      }
+      
+      if (player >= PLAYER_COUNT) {
+        tlvAppendByte(w, TLV_STATUS, STATUS_MALFORMED);
+        break;
+      }
+      
+      //Without a selection the first player's moves come back from the first ID
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      moveStatsAppend(w, MoveHistograms[player], player, CurrentGame.players[player].controllerPort + 1, from);
+      break;
+    }
+    case MSG_TYPE_FLASH_ERASE:
+      //Acknowledge before erasing since we will not get another chance
+      tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+      sendUdpResponse(w, remoteIp, remotePort);
+      
+      debugPrintln("Erasing flash.");
+      delay(200);
+      eraseFlash();
+      return;
+    default:
+      tlvAppendByte(w, TLV_STATUS, STATUS_UNKNOWN_TYPE);
+      break;
   }
+  
+  sendUdpResponse(w, remoteIp, remotePort);
 }
 
-//This is the function that should be called every loop of the application
-int ethernetExecute() {
-  listenForUdpPacket();
-  maintainClientConnection();
+void handleJsonPacket() {
+  //Create JSON root from buffer
+  StaticJsonBuffer<UDP_MAX_PACKET_SIZE> jsonReadBuffer;
+  JsonObject& root = jsonReadBuffer.parseObject((char*)udpPacketBuffer);
+  
+  //Parse json for command
+  int command = root["type"];
+  debugPrintln("UDP packet contains command: " + String(command));
+  
+  //Prepare to write response
+  StaticJsonBuffer<2048> jsonWriteBuffer;
+  JsonObject& resp = jsonWriteBuffer.createObject();
+  
+  //TODO: Test what happens when a UDP message is sent that doesn't contain a type node
+  byte ip1, ip2, ip3, ip4;
+  int receivedPort;
+  
+  //Handle command received
+  switch(command) {
+    case MSG_TYPE_DISCOVERY:
+      //Get IP and port of the UDP sender
+      lastBroadcastIp = udp.remoteIP();
+      lastBroadcastPort = udp.remotePort();
+      binaryLogging = false;
+      debugPrintln("Received UDP packet from: " + ipPortToString(lastBroadcastIp, lastBroadcastPort));
   
-  Ethernet.maintain();
-  return 1;
+      debugPrintln("Responding to discovery request. " + macToString());
+      //Add command and mac elements to JSON
+      resp["type"] = MSG_TYPE_DISCOVERY;
+      resp["mac"] = macToString();
+//      resp["targetIp"] = ipToString(serverIp);
+//      resp["targetPort"] = serverPort;
+//      resp["debugSerial"] = sendSerialDebugMessages;
+//      resp["debugUdp"] = sendUdpDebugMessages;
+
+      debugPrintln("Writing UDP message...");
+      //Send udp packet back
+      udp.beginPacket(lastBroadcastIp, lastBroadcastPort);
+      char buffer[2048];
+      resp.printTo(buffer, sizeof(buffer));
+      udp.write(buffer);
+      udp.endPacket();
+      
+      debugPrintln("Discovery message written.");
+      
+      break;
+    case MSG_TYPE_SET_TARGET:
+      debugPrintln("Received request to change IP/Port of target server.");
+      
+//      String targetIpString = root["targetIp"];
+//      int targetPort = root["targetPort"];
+//      sendSerialDebugMessages = root["debugSerial"];
+//      sendUdpDebugMessages = root["debugUdp"];
+      ip1 = root["ip1"];
+      ip2 = root["ip2"];
+      ip3 = root["ip3"];
+      ip4 = root["ip4"];
+      receivedPort = root["port"];
+      
+      setTarget(IPAddress(ip1, ip2, ip3, ip4), receivedPort);
+      
+      break;
+    case MSG_TYPE_FLASH_ERASE:
+      debugPrintln("Erasing flash.");
+      delay(200);
+      eraseFlash();
+      debugPrintln("Flash should be erased and program should be restarted. This message should not show up.");
+  }
+}
+
+//**********************************************************************
+//*                            Telemetry
+//**********************************************************************
+//Telemetry is sent from the same socket as everything else on UDP, it only ever writes so it does not
+//interfere with listenForUdpPacket()
+uint16_t telemetrySequence = 0;
+uint8_t telemetryBuffer[TELEMETRY_MAX_PACKET_SIZE];
+
+//Returns true if a datagram was sent
+bool sendTelemetry() {
+  if (telemetryDecimation == 0 || !ethernetInitialized) return false;
+  if (CurrentGame.frameCounter % telemetryDecimation != 0) return false;
+  
+  TelemetryFrame frame;
+  frame.flags = 0;
+  frame.sequence = telemetrySequence++;
+  frame.frame = CurrentGame.frameCounter;
+  frame.stage = CurrentGame.stage;
+  frame.playerCount = PLAYER_COUNT;
+  
+  if (ServerClock.valid) {
+    frame.flags |= TELEMETRY_FLAG_SERVER_TIME;
+    frame.serverTime = serverMicros();
+  }
+  
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& p = CurrentGame.players[i];
+    PlayerFrameData& pfd = currentFrame(p);
+    TelemetryPlayer& tp = frame.players[i];
+    
+    tp.port = p.controllerPort + 1;
+    tp.character = pfd.internalCharacterId;
+    tp.stocks = pfd.stocks;
+    tp.animation = pfd.animation;
+    tp.locationX = pfd.locationX;
+    tp.locationY = pfd.locationY;
+    tp.percent = pfd.percent;
+    tp.shieldSize = pfd.shieldSize;
+    tp.physicalButtons = pfd.physicalButtons;
+    tp.joystickX = pfd.joystickX;
+    tp.joystickY = pfd.joystickY;
+    tp.cstickX = pfd.cstickX;
+    tp.cstickY = pfd.cstickY;
+    tp.trigger = pfd.trigger;
+  }
+  
+  int size = telemetryEncode(telemetryBuffer, telemetryByteBudget, frame);
+  if (size == 0) return false;
+  
+  udp.beginPacket(telemetryIp, TELEMETRY_PORT);
+  udp.write(telemetryBuffer, size);
+  udp.endPacket();
+  return true;
+}
+
+//Sends every part of the latest snapshot once to the push target, one datagram per run. Runs as a
+//background task so the frame path only ever publishes into the buffers
+void pushLiveStats() {
+  if (!liveStatsPush || !ethernetInitialized) return;
+  
+  //A newer snapshot starts over from its first part
+  uint32_t sequence = LiveSnapshots.sequence;
+  if (sequence != liveStatsPushedSequence) {
+    liveStatsPushedSequence = sequence;
+    liveStatsPushPart = 0;
+  }
+  if (liveStatsPushPart >= LIVE_PART_COUNT) return;
+  
+  TlvWriter w;
+  tlvBegin(w, udpResponseBuffer, sizeof(udpResponseBuffer), MSG_TYPE_LIVE_STATS, 0);
+  tlvAppendByte(w, TLV_STATUS, STATUS_OK);
+  tlvAppendHalf(w, TLV_LIVE_INTERVAL, LiveSnapshots.interval);
+  if (liveStatsAppend(w, LiveSnapshots, liveStatsPushPart)) sendUdpResponse(w, liveStatsPushIp, liveStatsPushPort);
+  liveStatsPushPart++;
+}
+
+//Sends one datagram of the oldest queued play events, the rest go on the next runs
+void pushPlayEvents() {
+  if (!PlayEvents.enabled || !ethernetInitialized) return;
+  
+  TlvWriter w;
+  tlvBegin(w, udpResponseBuffer, sizeof(udpResponseBuffer), MSG_TYPE_PLAY_EVENTS, 0);
+  if (playEventsAppend(w, PlayEvents) > 0) sendUdpResponse(w, playEventsPushIp, playEventsPushPort);
+}
+
+void maintainDhcpLease() {
+  //A fallback address is kept until reset
+  if (Boot.source != NETBOOT_DHCP) return;
+  
+  //1 and 3 are a failed renewal and a failed rebind
+  int result = Ethernet.maintain();
+  if (result == 1 || result == 3) metricAdd(Metrics, METRIC_DHCP_FAILURES, 1);
+}
+
+//Network work runs as background tasks of the scheduler, see scheduler.h. Budgets are what each task
+//normally takes, client.connect() and a DHCP renewal can block far longer and show up as overruns
+Scheduler Tasks;
+
+uint32_t schedulerClock() {
+  return SSI3DMASlave.getTimestamp();
+}
+
+void ethernetTasksInitialize() {
+  schedulerInit(Tasks, schedulerClock, F_CPU / 1000000);
+  
+  //Name, function, period, budget and deadline in microseconds
+  schedulerAddTask(Tasks, "udp", listenForUdpPacket, 1000, 500, 5000);
+  schedulerAddTask(Tasks, "livestats", pushLiveStats, 1000, 300, 16683);
+  schedulerAddTask(Tasks, "events", pushPlayEvents, 1000, 300, 16683);
+  schedulerAddTask(Tasks, "timesync", requestTimeSync, 50000, 300, 50000);
+  schedulerAddTask(Tasks, "client", maintainClientConnection, 100000, 2000, 500000);
+  schedulerAddTask(Tasks, "dhcp", maintainDhcpLease, 1000000, 2000, 5000000);
+  schedulerAddTask(Tasks, "boot", bootNetwork, 1000, 500, 16683);
+}
+
+//**********************************************************************
+//*                          Device Metrics
+//**********************************************************************
+//Copies in the counters other modules keep and the gauges, see metrics.h. Called right before a dump
+void metricsSample() {
+  metricSet(Metrics, METRIC_UPTIME, millis() / 1000);
+  metricSet(Metrics, METRIC_SSI_OVERRUNS, SSI3DMASlave.getOverrunCount());
+  metricSet(Metrics, METRIC_SSI_DMA_ERRORS, SSI3DMASlave.getDmaErrorCount());
+  metricSet(Metrics, METRIC_SSI_PENDING, SSI3DMASlave.getPendingCount());
+  metricSet(Metrics, METRIC_MSG_UNCHECKED, MsgChecks.unchecked);
+  metricSet(Metrics, METRIC_MSG_BAD_SIZES, MsgChecks.badSizes);
+  metricSet(Metrics, METRIC_MSG_BAD_CRCS, MsgChecks.badCrcs);
+  metricSet(Metrics, METRIC_MSG_SEQUENCE_GAPS, MsgChecks.sequenceGaps);
+  metricSet(Metrics, METRIC_MSG_OTHER_SCHEMAS, MsgChecks.otherSchemas);
+  metricSet(Metrics, METRIC_TCP_CONNECTED, client.connected() ? 1 : 0);
+  metricSet(Metrics, METRIC_PLAY_EVENTS_DROPPED, PlayEvents.dropped);
+  metricSet(Metrics, METRIC_TIME_SYNCED, ServerClock.valid ? 1 : 0);
+  metricSet(Metrics, METRIC_BOOT_INGEST_US, Boot.ingestUs);
+  metricSet(Metrics, METRIC_BOOT_NETWORK_MS, Boot.upMs);
+  metricSet(Metrics, METRIC_NET_SOURCE, Boot.source);
+  metricSet(Metrics, METRIC_BOOT_BACKLOG_BYTES, Backlog.highWater);
+  
+  uint32_t overruns = 0;
+  for (int i = 0; i < Tasks.taskCount; i++) overruns += Tasks.tasks[i].overruns;
+  metricSet(Metrics, METRIC_TASK_OVERRUNS, overruns);
+}
+
+//**********************************************************************
+//*                          Idle Sleep
+//**********************************************************************
+//See idle.h. TIMER4 is a one shot that wakes the core when the next background task is due
+
+void idleTimerIntHandler() {
+  ROM_TimerIntClear(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
+}
+
+void idleInitialize() {
+  //SSI3DMASlave turns on clock gating in sleep, everything that has to wake the core or keep working
+  //while it sleeps is sleep enabled. SSI3, uDMA, GPIO Q and the timestamp timer are done there
+  ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_EMAC0);
+  ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_EPHY0);
+  
+  ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER4);
+  ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_TIMER4);
+  ROM_TimerConfigure(TIMER4_BASE, TIMER_CFG_ONE_SHOT);
+  TimerIntRegister(TIMER4_BASE, TIMER_A, idleTimerIntHandler);
+  ROM_TimerIntEnable(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
+  
+  Idle.enabled = true;
+  idleReset(Idle, F_CPU / 1000000, SSI3DMASlave.getTimestamp());
+}
+
+//Sleeps until the next interrupt if nothing is due soon. Called when the scheduler had nothing to run
+void idleSleep() {
+  if (!Idle.enabled) return;
+  
+  uint32_t sleepUs = schedulerSleepUs(Tasks, SSI3DMASlave.getTimestamp());
+  if (sleepUs < IDLE_MIN_SLEEP_US) return;
+  if (sleepUs > IDLE_MAX_SLEEP_US) sleepUs = IDLE_MAX_SLEEP_US;
+  
+  ROM_TimerLoadSet(TIMER4_BASE, TIMER_A, sleepUs * Idle.cyclesPerMicrosecond);
+  ROM_TimerEnable(TIMER4_BASE, TIMER_A);
+  
+  //With interrupts masked a CS edge between the check and WFI still ends the sleep. It stays pending
+  //and its handler runs as soon as they are unmasked, so the message is never slept through
+  ROM_IntMasterDisable();
+  uint32_t start = SSI3DMASlave.getTimestamp();
+  bool slept = !SSI3DMASlave.isMessageAvailable();
+  if (slept) ROM_SysCtlSleep();
+  ROM_IntMasterEnable();
+  uint32_t end = SSI3DMASlave.getTimestamp();
+  ROM_TimerDisable(TIMER4_BASE, TIMER_A);
+  
+  if (slept) {
+    uint32_t arrival = SSI3DMASlave.isMessageAvailable() ? SSI3DMASlave.getMessageTimestamp() : 0;
+    idleRecordSleep(Idle, start, end, arrival);
+  }
 }
 
 //**********************************************************************
@@ -445,6 +1132,7 @@ void postGameEndMessage() {
     StaticJsonBuffer<10000> jsonBuffer;
     
     JsonObject& root = jsonBuffer.createObject();
+    
     root["frames"] = CurrentGame.frameCounter;
     root["framesMissed"] = CurrentGame.framesMissed;
     root["winCondition"] = CurrentGame.winCondition;
@@ -457,7 +1145,7 @@ void postGameEndMessage() {
       PlayerStatistics& ps = CurrentGame.players[i].stats;
       JsonObject& item = jsonBuffer.createObject();
 
-      item["stocksRemaining"] = CurrentGame.players[i].currentFrameData.stocks;
+      item["stocksRemaining"] = currentFrame(CurrentGame.players[i]).stocks;
       
       item["apm"] = 3600 * (ps.actionCount / totalActiveGameFrames);
       
@@ -466,6 +1154,7 @@ void postGameEndMessage() {
       item["percentTimeAboveOthers"] = 100 * (ps.framesAboveOthers / totalActiveGameFrames);
       item["percentTimeInShield"] = 100 * (ps.framesInShield / totalActiveGameFrames);
       item["secondsWithoutDamage"] = float(ps.mostFramesWithoutDamage) / 60;
+      item["damageDealt"] = float(ps.damageDealt) / 10;
 
       item["rollCount"] = ps.rollCount;
       item["spotDodgeCount"] = ps.spotDodgeCount;
@@ -517,22 +1206,46 @@ void postGameEndMessage() {
   }
 }
 
-void writeMsg() {
-  if (client.connected()) {
-    int realMsgSize = Msg.messageSize + 1;
+void writeStreamMessage(uint8_t eventCode, const uint8_t* data, int size) {
+  //Until the boot backlog is sent everything queues behind it
+  if (Backlog.active) {
+    if (!backlogAppend(Backlog, eventCode, data, size)) metricAdd(Metrics, METRIC_STREAM_DROPPED, 1);
+  }
+  else if (client.connected()) {
+    int realMsgSize = size + 1;
     
     //Write message length
-    client.write(realMsgSize >> 24 & 0xFF);
-    client.write(realMsgSize >> 16 & 0xFF);
-    client.write(realMsgSize >> 8 & 0xFF);
-    client.write(realMsgSize & 0xFF);
+    size_t written = client.write(realMsgSize >> 24 & 0xFF);
+    written += client.write(realMsgSize >> 16 & 0xFF);
+    written += client.write(realMsgSize >> 8 & 0xFF);
+    written += client.write(realMsgSize & 0xFF);
     
     //Write message code
-    client.write(Msg.eventCode);
+    written += client.write(eventCode);
     
     //Write message
-    client.write(Msg.data, Msg.messageSize);
-  }  
+    written += client.write(data, size);
+    if (written != (size_t)realMsgSize + 4) metricAdd(Metrics, METRIC_STREAM_SHORT_WRITES, 1);
+  }
+  else metricAdd(Metrics, METRIC_STREAM_DROPPED, 1);
+}
+
+void writeMsg() {
+  writeStreamMessage(Msg.eventCode, Msg.data, Msg.messageSize);
+}
+
+//Follows the event just forwarded with the server time, see STREAM_TIME_MARK in timesync.h. Nothing is
+//sent until the clock is synchronized
+uint32_t lastTimeMarkFrame = 0;
+
+void writeTimeMark() {
+  uint64_t now = serverMicros();
+  if (now == 0) return;
+  
+  uint8_t mark[STREAM_TIME_MARK_SIZE];
+  timeMarkEncode(mark, CurrentGame.frameCounter, now);
+  writeStreamMessage(STREAM_TIME_MARK, mark, sizeof(mark));
+  lastTimeMarkFrame = CurrentGame.frameCounter;
 }
 
 //**********************************************************************
@@ -546,65 +1259,91 @@ int numberOfSetBits(uint16_t x) {
   return count;
 }
 
+//Durations are weighted by the real frame delta so missed updates do not shrink them, see computeGameStatistics() in statsengine.h
 void computeStatistics() {
   //this function will only get called when frameCount >= 1
-  uint32_t framesSinceStart = CurrentGame.frameCounter - 1;
+  uint32_t frameDelta = CurrentGame.frameDelta > 0 ? CurrentGame.frameDelta : 1;
+  uint32_t framesBefore = CurrentGame.frameCounter - frameDelta;
   
   Player* p = CurrentGame.players;
   
-  float p1CenterDistance = sqrt(pow(p[0].currentFrameData.locationX, 2) + pow(p[0].currentFrameData.locationY, 2));
-  float p2CenterDistance = sqrt(pow(p[1].currentFrameData.locationX, 2) + pow(p[1].currentFrameData.locationY, 2));
+  float p1CenterDistance = sqrt(pow(currentFrame(p[0]).locationX, 2) + pow(currentFrame(p[0]).locationY, 2));
+  float p2CenterDistance = sqrt(pow(currentFrame(p[1]).locationX, 2) + pow(currentFrame(p[1]).locationY, 2));
   
-  p[0].stats.averageDistanceFromCenter = (framesSinceStart*p[0].stats.averageDistanceFromCenter + p1CenterDistance) / (framesSinceStart + 1);
-  p[1].stats.averageDistanceFromCenter = (framesSinceStart*p[1].stats.averageDistanceFromCenter + p2CenterDistance) / (framesSinceStart + 1);
+  p[0].stats.averageDistanceFromCenter = (framesBefore*p[0].stats.averageDistanceFromCenter + frameDelta*p1CenterDistance) / (framesBefore + frameDelta);
+  p[1].stats.averageDistanceFromCenter = (framesBefore*p[1].stats.averageDistanceFromCenter + frameDelta*p2CenterDistance) / (framesBefore + frameDelta);
   
   //Increment frame counter of person who is closest to center. If the players are even distances from the center, do not increment
-  if (p1CenterDistance < p2CenterDistance) p[0].stats.framesClosestCenter++;
-  else if (p2CenterDistance < p1CenterDistance) p[1].stats.framesClosestCenter++;
+  if (p1CenterDistance < p2CenterDistance) p[0].stats.framesClosestCenter += frameDelta;
+  else if (p2CenterDistance < p1CenterDistance) p[1].stats.framesClosestCenter += frameDelta;
 
   //Increment frame counter of person who is highest;
-  if (p[0].currentFrameData.locationY > p[1].currentFrameData.locationY) p[0].stats.framesAboveOthers++;
-  else if (p[1].currentFrameData.locationY > p[0].currentFrameData.locationY) p[1].stats.framesAboveOthers++;
+  if (currentFrame(p[0]).locationY > currentFrame(p[1]).locationY) p[0].stats.framesAboveOthers += frameDelta;
+  else if (currentFrame(p[1]).locationY > currentFrame(p[0]).locationY) p[1].stats.framesAboveOthers += frameDelta;
+  
+  heatmapAdd(Heatmaps, p, frameDelta);
   
   for (int i = 0; i < PLAYER_COUNT; i++) {
     Player& cp = p[i]; //Current player
     Player& op = p[!i]; //Other player
+    uint8_t port = cp.controllerPort + 1; //Play events are tagged with the port, see playevents.h
     
-    bool lostStock = cp.previousFrameData.stocks - cp.currentFrameData.stocks > 0;
-    bool opntLostStock = op.previousFrameData.stocks - op.currentFrameData.stocks > 0;
+    bool lostStock = previousFrame(cp).stocks - currentFrame(cp).stocks > 0;
+    bool opntLostStock = previousFrame(op).stocks - currentFrame(op).stocks > 0;
     
     //Check current action states, although many of these conditions check previous frame data, it shouldn't matter for frame = 1 that there is no previous
-    if (cp.currentFrameData.animation >= GUARD_START && cp.currentFrameData.animation <= GUARD_END) cp.stats.framesInShield++;
-    else if ((cp.currentFrameData.animation == ROLL_FORWARD && cp.previousFrameData.animation != ROLL_FORWARD) ||
-             (cp.currentFrameData.animation == ROLL_BACKWARD && cp.previousFrameData.animation != ROLL_BACKWARD)) cp.stats.rollCount++;
-    else if (cp.currentFrameData.animation == SPOT_DODGE && cp.previousFrameData.animation != SPOT_DODGE) cp.stats.spotDodgeCount++;
-    else if (cp.currentFrameData.animation == AIR_DODGE && cp.previousFrameData.animation != AIR_DODGE) cp.stats.airDodgeCount++;
+    bool wasInShield = previousFrame(cp).animation >= GUARD_START && previousFrame(cp).animation <= GUARD_END;
+    if (currentFrame(cp).animation >= GUARD_START && currentFrame(cp).animation <= GUARD_END) cp.stats.framesInShield += wasInShield ? frameDelta : 1;
+    else if ((currentFrame(cp).animation == ROLL_FORWARD && previousFrame(cp).animation != ROLL_FORWARD) ||
+             (currentFrame(cp).animation == ROLL_BACKWARD && previousFrame(cp).animation != ROLL_BACKWARD)) {
+      cp.stats.rollCount++;
+      playEventQueue(PlayEvents, PLAY_EVENT_ROLL, port, CurrentGame.frameCounter);
+    }
+    else if (currentFrame(cp).animation == SPOT_DODGE && previousFrame(cp).animation != SPOT_DODGE) {
+      cp.stats.spotDodgeCount++;
+      playEventQueue(PlayEvents, PLAY_EVENT_SPOT_DODGE, port, CurrentGame.frameCounter);
+    }
+    else if (currentFrame(cp).animation == AIR_DODGE && previousFrame(cp).animation != AIR_DODGE) {
+      cp.stats.airDodgeCount++;
+      playEventQueue(PlayEvents, PLAY_EVENT_AIR_DODGE, port, CurrentGame.frameCounter);
+    }
     
     //Check if we are getting damaged
-    bool tookPercent = cp.currentFrameData.percent - cp.previousFrameData.percent > 0;
+    bool tookPercent = currentFrame(cp).percent - previousFrame(cp).percent > 0;
     if (tookPercent) {
       cp.flags.framesWithoutDamage = 0;
     } else {
-      cp.flags.framesWithoutDamage++; //Increment count of frames without taking damage
+      cp.flags.framesWithoutDamage += frameDelta; //Increment count of frames without taking damage
 
       //If frames without being hit is greater than previous, set new record
       if (cp.flags.framesWithoutDamage > cp.stats.mostFramesWithoutDamage) cp.stats.mostFramesWithoutDamage = cp.flags.framesWithoutDamage; 
     }
     
+    //Techs, wavedashes, L-cancels, ledgedashes and shield drops, see techniques.h
+    techAdvance(TechniqueTables, TechniqueTrackers[i], cp, cp.stats, frameDelta);
+    
+    //Hits, damage, openings and kills of each move, see movestats.h
+    moveStatsAdd(MoveHistograms[i], cp, op, frameDelta);
+    
     //------------------------------- Monitor Combo Strings -----------------------------------------
-    bool opntTookDamage = op.currentFrameData.percent - op.previousFrameData.percent > 0;
-    bool opntDamagedState = op.currentFrameData.animation >= DAMAGE_START && op.currentFrameData.animation <= DAMAGE_END;
-    bool opntGrabbedState = op.currentFrameData.animation >= CAPTURE_START && op.currentFrameData.animation <= CAPTURE_END;
-    bool opntTechState = (op.currentFrameData.animation >= TECH_START && op.currentFrameData.animation <= TECH_END) ||
-      op.currentFrameData.animation == TECH_MISS_UP || op.currentFrameData.animation == TECH_MISS_DOWN;
+    //Counted in tenths of a percent so it can be bucketed like the other counters. The drop when a stock is lost is not damage
+    int32_t dealt = lroundf(currentFrame(op).percent * 10) - lroundf(previousFrame(op).percent * 10);
+    if (dealt > 0) cp.stats.damageDealt += dealt;
+    
+    bool opntTookDamage = currentFrame(op).percent - previousFrame(op).percent > 0;
+    bool opntDamagedState = currentFrame(op).animation >= DAMAGE_START && currentFrame(op).animation <= DAMAGE_END;
+    bool opntGrabbedState = currentFrame(op).animation >= CAPTURE_START && currentFrame(op).animation <= CAPTURE_END;
+    bool opntTechState = (currentFrame(op).animation >= TECH_START && currentFrame(op).animation <= TECH_END) ||
+      currentFrame(op).animation == TECH_MISS_UP || currentFrame(op).animation == TECH_MISS_DOWN;
 
     //By looking for percent changes we can increment counter even when a player gets true combo'd
     //The damage state requirement makes it so things like fox's lasers, grab pummels, pichu damaging self, etc don't increment count
     if (opntTookDamage && (opntDamagedState || opntGrabbedState)) {
       if (cp.flags.stringCount == 0) {
-        cp.flags.stringStartPercent = op.previousFrameData.percent;
+        cp.flags.stringStartPercent = previousFrame(op).percent;
         cp.flags.stringStartFrame = CurrentGame.frameCounter;
         cp.stats.numberOfOpenings++;
+        playEventOpening(PlayEvents, port, CurrentGame.frameCounter, cp.flags.stringStartPercent);
         //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(" got an opening!");
       }
       
@@ -613,12 +1352,12 @@ void computeStatistics() {
 
     //Reset combo string counter when somebody dies or doesn't get hit for too long
     if (opntDamagedState || opntGrabbedState || opntTechState) cp.flags.stringResetCounter = 0;
-    else if (cp.flags.stringCount > 0) cp.flags.stringResetCounter++;
+    else if (cp.flags.stringCount > 0) addFrames(cp.flags.stringResetCounter, frameDelta);
 
     //Mark combo completed if opponent lost his stock or if the counter is greater than threshold frames
     if (cp.flags.stringCount > 0 && (opntLostStock || lostStock || cp.flags.stringResetCounter > COMBO_STRING_TIMEOUT)) {
       //Store records
-      float percent = op.previousFrameData.percent - cp.flags.stringStartPercent;
+      float percent = previousFrame(op).percent - cp.flags.stringStartPercent;
       uint32_t frames = CurrentGame.frameCounter - cp.flags.stringStartFrame;
       uint16_t hits = cp.flags.stringCount;
       
@@ -629,6 +1368,7 @@ void computeStatistics() {
       if (percent > cp.stats.mostDamageString) cp.stats.mostDamageString = percent;
       if (frames > cp.stats.mostTimeString) cp.stats.mostTimeString = frames;
       if (hits > cp.stats.mostHitsString) cp.stats.mostHitsString = hits;
+      playEventComboEnd(PlayEvents, port, CurrentGame.frameCounter, hits, percent, frames);
 
       //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" combo ended. (") + percent + String("%, ") + hits + String(" hits, ") + frames + String(" frames)"));
       
@@ -638,39 +1378,40 @@ void computeStatistics() {
     
     //------------------- Increment Action Count for APM Calculation --------------------------------
     //First count the number of buttons that go from 0 to 1
-    uint16_t buttonChanges = (~cp.previousFrameData.physicalButtons & cp.currentFrameData.physicalButtons) & 0xFFF;
+    uint16_t buttonChanges = (~previousFrame(cp).physicalButtons & currentFrame(cp).physicalButtons) & 0xFFF;
     cp.stats.actionCount += numberOfSetBits(buttonChanges); //Increment action count by amount of button presses
     
     //Increment action count when sticks change from one region to another. Don't increment when stick returns to deadzone
-    uint8_t prevAnalogRegion = getJoystickRegion(cp.previousFrameData.joystickX, cp.previousFrameData.joystickY);
-    uint8_t currentAnalogRegion = getJoystickRegion(cp.currentFrameData.joystickX, cp.currentFrameData.joystickY);
+    uint8_t prevAnalogRegion = getJoystickRegion(previousFrame(cp).joystickX, previousFrame(cp).joystickY);
+    uint8_t currentAnalogRegion = getJoystickRegion(currentFrame(cp).joystickX, currentFrame(cp).joystickY);
     if ((prevAnalogRegion != currentAnalogRegion) && (currentAnalogRegion != 0)) cp.stats.actionCount++;
     
     //Do the same for c-stick
-    uint8_t prevCstickRegion = getJoystickRegion(cp.previousFrameData.cstickX, cp.previousFrameData.cstickY);
-    uint8_t currentCstickRegion = getJoystickRegion(cp.currentFrameData.cstickX, cp.currentFrameData.cstickY);
+    uint8_t prevCstickRegion = getJoystickRegion(previousFrame(cp).cstickX, previousFrame(cp).cstickY);
+    uint8_t currentCstickRegion = getJoystickRegion(currentFrame(cp).cstickX, currentFrame(cp).cstickY);
     if ((prevCstickRegion != currentCstickRegion) && (currentCstickRegion != 0)) cp.stats.actionCount++;
     
     //Increment action on analog trigger... I'm not sure when. This needs revision
-    if (cp.previousFrameData.lTrigger < 0.3 && cp.currentFrameData.lTrigger >= 0.3) cp.stats.actionCount++;
-    if (cp.previousFrameData.rTrigger < 0.3 && cp.currentFrameData.rTrigger >= 0.3) cp.stats.actionCount++;
+    if (previousFrame(cp).lTrigger < 0.3 && currentFrame(cp).lTrigger >= 0.3) cp.stats.actionCount++;
+    if (previousFrame(cp).rTrigger < 0.3 && currentFrame(cp).rTrigger >= 0.3) cp.stats.actionCount++;
     
     //--------------------------- Recovery detection --------------------------------------------------
-    bool isOffStage = checkIfOffStage(CurrentGame.stage, cp.currentFrameData.locationX, cp.currentFrameData.locationY);
-    bool isInControl = cp.currentFrameData.animation >= GROUNDED_CONTROL_START && cp.currentFrameData.animation <= GROUNDED_CONTROL_END;
-    bool beingDamaged = cp.currentFrameData.animation >= DAMAGE_START && cp.currentFrameData.animation <= DAMAGE_END;
-    bool beingGrabbed = cp.currentFrameData.animation >= CAPTURE_START && cp.currentFrameData.animation <= CAPTURE_END;
-    bool isDying = cp.currentFrameData.animation >= DYING_START && cp.currentFrameData.animation <= DYING_END;
+    bool isOffStage = checkIfOffStage(CurrentGame.stage, currentFrame(cp).locationX, currentFrame(cp).locationY);
+    bool isInControl = currentFrame(cp).animation >= GROUNDED_CONTROL_START && currentFrame(cp).animation <= GROUNDED_CONTROL_END;
+    bool beingDamaged = currentFrame(cp).animation >= DAMAGE_START && currentFrame(cp).animation <= DAMAGE_END;
+    bool beingGrabbed = currentFrame(cp).animation >= CAPTURE_START && currentFrame(cp).animation <= CAPTURE_END;
+    bool isDying = currentFrame(cp).animation >= DYING_START && currentFrame(cp).animation <= DYING_END;
     
     if (!cp.flags.isRecovering && !cp.flags.isHitOffStage && beingDamaged && isOffStage) {
       //If player took a hit off stage
       cp.flags.isHitOffStage = true;
-      //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" off stage! (") + cp.currentFrameData.locationX + String(",") + cp.currentFrameData.locationY + String(")"));
+      //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" off stage! (") + currentFrame(cp).locationX + String(",") + currentFrame(cp).locationY + String(")"));
     }
     else if (!cp.flags.isRecovering && cp.flags.isHitOffStage && !beingDamaged && !isDying && isOffStage) {
       //If player exited damage state off stage
       cp.flags.isRecovering = true;
-      //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" recovering! (") + String(cp.currentFrameData.animation, HEX) + String(")"));
+      playEventQueue(PlayEvents, PLAY_EVENT_RECOVERY_START, port, CurrentGame.frameCounter);
+      //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" recovering! (") + String(currentFrame(cp).animation, HEX) + String(")"));
     }
     else if (!cp.flags.isLandedOnStage && (cp.flags.isRecovering || cp.flags.isHitOffStage) && isInControl && !isOffStage) {
       //If a player is in control of his character after recovering flag as landed
@@ -684,7 +1425,7 @@ void computeStatistics() {
     }
     else if (cp.flags.isLandedOnStage && !isOffStage && !beingDamaged && !beingGrabbed) {
       //If player landed, is still on stage, is not being hit, and is not grabbed, increment frame counter
-      cp.flags.framesSinceLanding++;
+      addFrames(cp.flags.framesSinceLanding, frameDelta);
       
       //If frame counter while on stage passes threshold, consider it a successful recovery
       if (cp.flags.framesSinceLanding > FRAMES_LANDED_RECOVERY) {
@@ -692,6 +1433,7 @@ void computeStatistics() {
           cp.stats.recoveryAttempts++;
           cp.stats.successfulRecoveries++;
           op.stats.edgeguardChances++;
+          playEventRecoveryEnd(PlayEvents, port, CurrentGame.frameCounter, true, op.controllerPort + 1);
           //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(" recovered!");
         }
         
@@ -705,6 +1447,8 @@ void computeStatistics() {
         cp.stats.recoveryAttempts++;
         op.stats.edgeguardChances++;
         op.stats.edgeguardConversions++;
+        playEventRecoveryEnd(PlayEvents, port, CurrentGame.frameCounter, false, op.controllerPort + 1);
+        playEventQueue(PlayEvents, PLAY_EVENT_EDGEGUARD, op.controllerPort + 1, CurrentGame.frameCounter);
         //debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(" died recovering!");
       }
       else if (cp.flags.isHitOffStage) {
@@ -715,14 +1459,14 @@ void computeStatistics() {
     }
     
     //-------------------------- Stock specific stuff -------------------------------------------------
-    int prevStockIndex = STOCK_COUNT - cp.previousFrameData.stocks;
+    int prevStockIndex = STOCK_COUNT - previousFrame(cp).stocks;
     if (prevStockIndex >= 0 && prevStockIndex < STOCK_COUNT) {
       StockStatistics& s = cp.stats.stocks[prevStockIndex];
       s.isStockUsed = true;
       s.frame = CurrentGame.frameCounter;
-      s.percent = cp.currentFrameData.percent;
-      s.lastHitBy = op.currentFrameData.lastMoveHitId; //This will indicate what this player was killed by
-      s.lastAnimation = cp.currentFrameData.animation; //What was character doing before death
+      s.percent = currentFrame(cp).percent;
+      s.lastHitBy = currentFrame(op).lastMoveHitId; //This will indicate what this player was killed by
+      s.lastAnimation = currentFrame(cp).animation; //What was character doing before death
     }
     
     //Mark last stock as lost if lostStock is true
@@ -732,10 +1476,14 @@ void computeStatistics() {
       
       cp.stats.stocks[prevStockIndex].killedInOpenings = op.stats.numberOfOpenings - prevOpenings;
       cp.stats.stocks[prevStockIndex].isStockLost = true;
+      playEventStockLost(PlayEvents, port, CurrentGame.frameCounter, prevStockIndex, cp.stats.stocks[prevStockIndex]);
       
-      debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" lost a stock. (") + cp.currentFrameData.animation + String(", ") + cp.previousFrameData.animation + String(")"));
+      debugPrint(String("Player ") + (char)(65 + i)); debugPrintln(String(" lost a stock. (") + currentFrame(cp).animation + String(", ") + previousFrame(cp).animation + String(")"));
     }
   }
+  
+  //After every counter of both players has moved, see statseries.h
+  seriesAdd(Series, p, CurrentGame.frameCounter);
 }
 
 //**********************************************************************
@@ -756,9 +1504,20 @@ void setup() {
   
   debugPrintln("Starting initialization.");
   
-  ethernetInitialize();
+  //Ingest and the stats engine come first, DHCP used to hold them up for seconds. See netboot.h
   asmEventsInitialize();
   spiSlaveInitialize();
+  latencyReset(Latency, F_CPU / 1000000);
+  liveStatsInitialize(LiveSnapshots);
+  techCompile(TechniqueTables);
+  seriesInitialize(Series);
+  Boot.ingestUs = micros();
+  
+  backlogReset(Backlog, true);
+  ethernetInitialize();
+  ethernetTasksInitialize();
+  idleInitialize();
+  timeSyncInit(ServerClock);
   
   debugPrintln("Initialization complete.");
 }
@@ -777,6 +1536,32 @@ void debugPrintMatchParams() {
   }
 }
 
+void debugPrintIntegrity() {
+  //Like latency these are totals for the whole session
+  debugPrintln(String("Frames missed: ") + CurrentGame.framesMissed + String(". Messages: ") + MsgChecks.messages +
+    String(" checked, ") + MsgChecks.unchecked + String(" unchecked, ") + MsgChecks.badCrcs + String(" bad crc, ") +
+    MsgChecks.badSizes + String(" bad size, ") + MsgChecks.sequenceGaps + String(" lost, ") + MsgChecks.duplicates + String(" duplicate, ") + MsgChecks.otherSchemas +
+    String(" games from another schema"));
+}
+
+void debugPrintLatency() {
+  //Latency is accumulated over the whole session, not per game
+  char report[512];
+  latencyFormatReport(report, sizeof(report), Latency);
+  debugPrint(report);
+}
+
+void debugPrintScheduler() {
+  //Like latency these are totals for the whole session
+  char report[512];
+  schedulerFormatReport(report, sizeof(report), Tasks);
+  debugPrint(report);
+  
+  idleAdvance(Idle, SSI3DMASlave.getTimestamp());
+  idleFormatReport(report, sizeof(report), Idle);
+  debugPrint(report);
+}
+
 void debugPrintGameInfo() {
   if (CurrentGame.frameCounter % 600 == 0) {
     debugPrintln(String("Frame: ") + CurrentGame.frameCounter);
@@ -784,7 +1569,7 @@ void debugPrintGameInfo() {
     debugPrint("Random seed: "); debugPrintln(String(CurrentGame.randomSeed, HEX));
     for (int i = 0; i < PLAYER_COUNT; i++) {
       Player* p = &CurrentGame.players[i];
-      PlayerFrameData* pfd = &p->currentFrameData;
+      PlayerFrameData* pfd = &currentFrame(*p);
       debugPrintln(String("Player ") + (char)(65 + i));
       debugPrint("Location X: "); debugPrintln(String(pfd->locationX));
       debugPrint("Location Y: "); debugPrintln(String(pfd->locationY));
@@ -811,7 +1596,20 @@ void debugPrint(String s) {
     Serial.print(s);
   }
   
-  if (sendUdpDebugMessages && ethernetInitialized) {
+  if (sendUdpDebugMessages && ethernetInitialized && binaryLogging) {
+    //Binary log messages are built in their own buffer since they can be sent while a response is being built
+    TlvWriter w;
+    tlvBegin(w, udpLogBuffer, sizeof(udpLogBuffer), MSG_TYPE_LOG_MESSAGE, 0);
+    
+    int length = s.length();
+    int maxLength = sizeof(udpLogBuffer) - UDP_BINARY_HEADER_SIZE - 2;
+    tlvAppend(w, TLV_LOG_TEXT, (const uint8_t*)s.c_str(), length < maxLength ? length : maxLength);
+    
+    udp.beginPacket(lastBroadcastIp, lastBroadcastPort);
+    udp.write(w.buffer, w.size);
+    udp.endPacket();
+  }
+  else if (sendUdpDebugMessages && ethernetInitialized) {
     //Prepare to write response
     int jsonBufSize = s.length() + 50;
     StaticJsonBuffer<512> jsonWriteBuffer;
@@ -833,33 +1631,52 @@ void debugPrint(String s) {
 //**********************************************************************
 //*                           Main Loop
 //**********************************************************************
-void loop() {
-  //If ethernet client not working, attempt to re-establish
-  ethernetExecute();
-  
-  //read a message from the read fifo - this function doesn't return until data has been read
-  spiReadMessage();
-  
-  if (Msg.success) {
-    switch (Msg.eventCode) {
-      case EVENT_GAME_START:
-        handleGameStart();
-        debugPrintMatchParams();
-        //postMatchParameters();
-        break;
-      case EVENT_UPDATE:
-        handleUpdate();
-        //debugPrintGameInfo();
-        computeStatistics();
-        break;
-      case EVENT_GAME_END:
-        handleGameEnd();
-        //postGameEndMessage();
-        break;
-    }
+void handleMessage() {
+  switch (Msg.eventCode) {
+    case EVENT_GAME_START:
+      if (!handleGameStart()) break;
+      writeTimeMark();
+      playEventGameStart(PlayEvents, 0, CurrentGame.stage, serverMicros());
+      latencyGameStart(Latency);
+      debugPrintMatchParams();
+      //postMatchParameters();
+      break;
+    case EVENT_UPDATE:
+      if (otherSchemaGame) break;
+      handleUpdate();
+      if (CurrentGame.frameCounter - lastTimeMarkFrame >= TIME_MARK_INTERVAL_FRAMES) writeTimeMark();
+      MsgTiming.decoded = SSI3DMASlave.getTimestamp();
+      //debugPrintGameInfo();
+      computeStatistics();
+      liveStatsPublish(LiveSnapshots, CurrentGame, false);
+      MsgTiming.computed = SSI3DMASlave.getTimestamp();
+      if (sendTelemetry()) MsgTiming.emitted = SSI3DMASlave.getTimestamp();
+      latencyRecord(Latency, MsgTiming);
+      schedulerFrame(Tasks, MsgTiming.arrival);
+      break;
+    case EVENT_GAME_END:
+      if (otherSchemaGame) break;
+      handleGameEnd();
+      writeTimeMark();
+      playEventGameEnd(PlayEvents, CurrentGame.frameCounter, CurrentGame.winCondition, serverMicros());
+      schedulerGameEnd(Tasks);
+      liveStatsPublish(LiveSnapshots, CurrentGame, true); //Final numbers, whatever the interval
+      debugPrintLatency();
+      debugPrintScheduler();
+      debugPrintIntegrity();
+      //postGameEndMessage();
+      break;
   }
 }
 
-
-
-
+void loop() {
+  //Frames come first. Every message the CS interrupt has queued is handled before any background task
+  while (SSI3DMASlave.isMessageAvailable()) {
+    spiReadMessage();
+    if (Msg.success) handleMessage();
+  }
+  
+  //At most one background task per pass, only if it fits before the next frame is expected. With nothing
+  //to run the core sleeps until the next message, Ethernet interrupt or task that comes due
+  if (schedulerRunNext(Tasks) < 0) idleSleep();
+}
@@ -13,12 +13,14 @@
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_ssi.h"
+#include "inc/hw_timer.h"
 #include "driverlib/gpio.h"
 #include "driverlib/interrupt.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/pin_map.h"
 #include "driverlib/udma.h"
 #include "driverlib/ssi.h"
+#include "driverlib/timer.h"
 #include "SSI3DMASlave.h"
 #include "part.h"
 
@@ -47,16 +49,29 @@ uint8_t g_ui8SSIRxBuf[SSI_RX_BUFFER_COUNT][SSI_BUFFER_SIZE];
 //
 //*****************************************************************************
 uint32_t g_ui32MessageSizes[SSI_RX_BUFFER_COUNT];
+uint32_t g_ui32MessageTimestamps[SSI_RX_BUFFER_COUNT];
 uint8_t g_ui8RxWriteIndex = 0;
 uint8_t g_ui8RxReadIndex = 0;
 
+//*****************************************************************************
+//
+// Free running timer counting up at F_CPU, used to timestamp the end of each
+// transfer. It wraps every ~35s at 120MHz, only differences are used. Unlike
+// the DWT cycle counter it keeps counting while the core sleeps between
+// messages.
+//
+//*****************************************************************************
+#define TIMESTAMP_TIMER_BASE  TIMER5_BASE
+#define TIMESTAMP_TIMER_PERIPH SYSCTL_PERIPH_TIMER5
+#define TIMESTAMP             HWREG(TIMESTAMP_TIMER_BASE + TIMER_O_TAV)
+
 //*****************************************************************************
 //
 // The count of uDMA errors.  This value is incremented by the uDMA error
 // handler.
 //
 //*****************************************************************************
-uint32_t g_ui32uDMAErrCount = 0;
+volatile uint32_t g_ui32uDMAErrCount = 0;
 
 //*****************************************************************************
 //
@@ -65,6 +80,7 @@ uint32_t g_ui32uDMAErrCount = 0;
 //*****************************************************************************
 volatile uint32_t g_ui32SSIRxWriteCount = 0;
 volatile uint32_t g_ui32SSIRxReadCount = 0;
+volatile uint32_t g_ui32SSIRxOverrunCount = 0; //Unread buffers the DMA wrote over
 uint32_t g_ui32SSITxCount = 0;
 
 //*****************************************************************************
@@ -109,6 +125,8 @@ void uDMAErrorHandler(void)
 //
 //*****************************************************************************
 void gpioQ1IntHandler(void) {
+    //Stamp first so the time does not include the rest of the handler
+    uint32_t ui32Timestamp = TIMESTAMP;
     uint32_t ui32Status;
 
     ui32Status = ROM_GPIOIntStatus(GPIO_PORTQ_BASE, 1);
@@ -123,6 +141,7 @@ void gpioQ1IntHandler(void) {
 	//Get the size of the completed transfer
 	uint32_t msgSize = SSI_BUFFER_SIZE - xferSize;
 	g_ui32MessageSizes[g_ui8RxWriteIndex] = msgSize;
+	g_ui32MessageTimestamps[g_ui8RxWriteIndex] = ui32Timestamp;
 
 	//Store index value of this transaction for print debug message
 	uint8_t previousIndex = g_ui8RxWriteIndex;
@@ -140,6 +159,9 @@ void gpioQ1IntHandler(void) {
 
 	ROM_uDMAChannelEnable(UDMA_CH14_SSI3RX);
 
+	//With every buffer already holding an unread message the one just completed overwrote the oldest
+	if(g_ui32SSIRxWriteCount - g_ui32SSIRxReadCount >= SSI_RX_BUFFER_COUNT) g_ui32SSIRxOverrunCount++;
+
 	//Increment receive count
 	g_ui32SSIRxWriteCount++;
 
@@ -157,6 +179,7 @@ void SSI3DMASlaveClass::configureSSI3() {
   ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI3);
   ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_SSI3);
   ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOQ);
+  ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_GPIOQ); //CS edges have to wake the core
 
   // Configure GPIO Pins for SSI3 mode.
   //
@@ -261,9 +284,18 @@ void SSI3DMASlaveClass::configureCSInterrupt() {
 	ROM_IntEnable(INT_GPIOQ1);
 }
 
+void SSI3DMASlaveClass::configureTimestamp() {
+  ROM_SysCtlPeripheralEnable(TIMESTAMP_TIMER_PERIPH);
+  ROM_SysCtlPeripheralSleepEnable(TIMESTAMP_TIMER_PERIPH);
+  ROM_TimerConfigure(TIMESTAMP_TIMER_BASE, TIMER_CFG_PERIODIC_UP);
+  ROM_TimerLoadSet(TIMESTAMP_TIMER_BASE, TIMER_A, 0xFFFFFFFF);
+  ROM_TimerEnable(TIMESTAMP_TIMER_BASE, TIMER_A);
+}
+
 void SSI3DMASlaveClass::begin() {
   ROM_SysCtlPeripheralClockGating(true);
   
+  configureTimestamp();
   configureSSI3();
   configureDMA();
   configureCSInterrupt();
@@ -281,6 +313,26 @@ uint32_t SSI3DMASlaveClass::getMessageSize() {
 	return g_ui32MessageSizes[g_ui8RxReadIndex];
 }
 
+uint32_t SSI3DMASlaveClass::getMessageTimestamp() {
+	return g_ui32MessageTimestamps[g_ui8RxReadIndex];
+}
+
+uint32_t SSI3DMASlaveClass::getTimestamp() {
+	return TIMESTAMP;
+}
+
+uint32_t SSI3DMASlaveClass::getPendingCount() {
+	return g_ui32SSIRxWriteCount - g_ui32SSIRxReadCount;
+}
+
+uint32_t SSI3DMASlaveClass::getOverrunCount() {
+	return g_ui32SSIRxOverrunCount;
+}
+
+uint32_t SSI3DMASlaveClass::getDmaErrorCount() {
+	return g_ui32uDMAErrCount;
+}
+
 uint8_t* SSI3DMASlaveClass::popMessage() {
 	uint8_t readIndex = g_ui8RxReadIndex;
 
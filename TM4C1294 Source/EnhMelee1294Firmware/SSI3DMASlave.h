@@ -21,6 +21,7 @@ private:
   void configureSSI3(void);
   void configureDMA(void);
   void configureCSInterrupt(void);
+  void configureTimestamp(void);
 
 public:
 
@@ -29,6 +30,11 @@ public:
   void end();
   bool isMessageAvailable(void);
   uint32_t getMessageSize(void);
+  uint32_t getMessageTimestamp(void); // Cycle count when CS rose at the end of the message
+  uint32_t getTimestamp(void); // Current cycle count, same clock as getMessageTimestamp
+  uint32_t getPendingCount(void); // Messages received and not popped yet
+  uint32_t getOverrunCount(void); // Messages lost to a full ring since begin()
+  uint32_t getDmaErrorCount(void);
   uint8_t* popMessage(void);
   void queueResponse(uint8_t* data, int length);
   
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "meleeids.h"
 
 #define PLAYER_COUNT 2
@@ -48,6 +49,25 @@ typedef struct {
   float rTrigger;
 } PlayerFrameData;
 
+//Every player keeps the last FRAME_HISTORY_DEPTH updates in a ring so statistics can look further back than
+//the previous frame. A new update advances the index of the newest entry and clears the oldest entry, which
+//becomes the current one, so nothing is copied. An entry is one update: when updates were missed the entry
+//before it is frameDelta frames older, not one.
+//
+//The depth is set at compile time and must be a power of two. 2 is only the current and previous frames,
+//Host Source/FrameHistoryBenchmark measures the cost per frame of other depths.
+#ifndef FRAME_HISTORY_DEPTH
+#define FRAME_HISTORY_DEPTH 8 //An L-cancel or a wavedash fits in the last 8 frames
+#endif
+#define FRAME_HISTORY_MASK (FRAME_HISTORY_DEPTH - 1)
+
+typedef char FrameHistoryDepthIsPowerOfTwo[(FRAME_HISTORY_DEPTH & FRAME_HISTORY_MASK) == 0 && FRAME_HISTORY_DEPTH >= 2 ? 1 : -1];
+
+typedef struct {
+  PlayerFrameData frames[FRAME_HISTORY_DEPTH];
+  uint8_t newest; //Index of the current frame
+} FrameHistory;
+
 typedef struct {
   //Recovery
   bool isRecovering = false;
@@ -64,6 +84,12 @@ typedef struct {
   uint32_t framesWithoutDamage;
 } PlayerFlags;
 
+//Adds frames to one of the uint8_t frame counters in PlayerFlags. After a long gap the counter stops at
+//the top instead of wrapping, the thresholds it is compared against are far below that
+void addFrames(uint8_t& counter, uint32_t frames) {
+  counter = counter + frames > 0xFF ? 0xFF : counter + frames;
+}
+
 void resetRecoveryFlags(PlayerFlags& flags) {
   flags.isRecovering = false;
   flags.isHitOffStage = false;
@@ -92,17 +118,23 @@ typedef struct {
   
   uint32_t framesInShield; //Amount of frames spent shielding
   uint32_t mostFramesWithoutDamage; //Amount of frames without being hit
+  uint32_t damageDealt; //Percent the opponent took, in tenths
   
   //Defensive option selection
   uint16_t rollCount;
   uint16_t spotDodgeCount;
   uint16_t airDodgeCount;
 
-  //Tech stats - to be implemented
+  //Tech and techniques, counted by the machines in techniques.h
   uint16_t techMissCount;
   uint16_t techLeftCount;
   uint16_t techRightCount;
   uint16_t techPlaceCount;
+  uint16_t wavedashCount;
+  uint16_t lCancelCount;
+  uint16_t lCancelMissCount; //Aerials that landed without an L-cancel
+  uint16_t ledgedashCount;
+  uint16_t shieldDropCount;
   
   //Recovery
   uint16_t recoveryAttempts;
@@ -132,28 +164,71 @@ typedef struct {
   uint8_t playerType;
   uint8_t controllerPort;
 
-  //Update data
-  PlayerFrameData currentFrameData;
+  //Update data, the latest FRAME_HISTORY_DEPTH updates. Read through currentFrame(), previousFrame() and frameAgo()
+  FrameHistory history;
 
   //Used for statistic calculation
-  PlayerFrameData previousFrameData;
   PlayerFlags flags;
   PlayerStatistics stats;
 } Player;
 
 typedef struct {
   Player players[PLAYER_COUNT]; //Contains all information relevant to individual players
+  uint8_t schemaVersion; //EVENT_SCHEMA_VERSION of the Gecko code that sent the game
   uint16_t stage; //Stage ID
 
   //Fromt Update event
   uint32_t frameCounter; //Frame count
   uint32_t framesMissed;
+  uint32_t frameDelta; //Frames since the previous update, more than 1 when updates were missed
   uint32_t randomSeed;
   
   //From OnGameEnd event
   uint8_t winCondition;
 } Game;
 
+//The update from k updates ago, 0 is the current one. k must be below FRAME_HISTORY_DEPTH, older entries
+//have been reused
+PlayerFrameData& frameAgo(Player& p, int k) {
+  return p.history.frames[(p.history.newest - k) & FRAME_HISTORY_MASK];
+}
+
+const PlayerFrameData& frameAgo(const Player& p, int k) {
+  return p.history.frames[(p.history.newest - k) & FRAME_HISTORY_MASK];
+}
+
+PlayerFrameData& currentFrame(Player& p) {
+  return frameAgo(p, 0);
+}
+
+const PlayerFrameData& currentFrame(const Player& p) {
+  return frameAgo(p, 0);
+}
+
+PlayerFrameData& previousFrame(Player& p) {
+  return frameAgo(p, 1);
+}
+
+const PlayerFrameData& previousFrame(const Player& p) {
+  return frameAgo(p, 1);
+}
+
+//Where eventschema.h decodes an update to and encodes one from
+PlayerFrameData& schemaUpdateTarget(Player& p) {
+  return currentFrame(p);
+}
+
+const PlayerFrameData& schemaUpdateTarget(const Player& p) {
+  return currentFrame(p);
+}
+
+//Called before an update is decoded. The oldest entry becomes the current frame, cleared so fields the
+//update does not carry read as 0 like they always have
+void frameHistoryAdvance(Player& p) {
+  p.history.newest = (p.history.newest + 1) & FRAME_HISTORY_MASK;
+  memset(&p.history.frames[p.history.newest], 0, sizeof(PlayerFrameData));
+}
+
 typedef struct {
   bool success;
   uint8_t eventCode;
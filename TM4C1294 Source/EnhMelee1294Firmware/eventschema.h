@@ -0,0 +1,228 @@
+#ifndef _EVENTSCHEMA_H_INCLUDED
+#define _EVENTSCHEMA_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h, the schema refers to the members of Game, Player and PlayerFrameData. The
+//sketches keep frame data differently, each enhmelee.h gives the one an update goes into through
+//schemaUpdateTarget() so this file stays the same in every sketch
+
+//**********************************************************************
+//*                           Event Schema
+//**********************************************************************
+//Every payload the Gecko code (MatchDataExtraction.asm) sends is described once here, field by field in
+//the order they go out. An event sends its GAME fields once followed by a block of PLAYER fields for
+//each player. Everything else comes from these lists: the payload sizes in asmEvents, the decoders the
+//boards run and the encoders host tools use to produce test streams.
+//
+//Adding a field to a payload is one line in the list, the matching send in the Gecko code and a bump of
+//EVENT_SCHEMA_VERSION, which the Gecko code sends at the start of every game.
+//
+//The Gecko code and the firmware have to be upgraded together. A board never decodes a game with
+//another version's layout: a game start whose version does not match, or that has the size from before
+//the version byte, drops the game. Those are counted apart from corrupt messages, as otherSchemas in
+//MsgCheckStats, so a board left on an older Gecko code shows why it has no games.
+//
+//FIELD(type, member) - type is what goes over the wire, member is where it is stored
+#define EVENT_SCHEMA_VERSION 1
+
+#define EVENT_GAME_START 0x37
+#define EVENT_UPDATE 0x38
+#define EVENT_GAME_END 0x39
+
+#define EVENT_GAME_START_SIZE_V0 0xA //Gecko codes from before the version byte
+
+//Game start, player fields are members of Player
+#define GAME_START_GAME_FIELDS(FIELD) \
+  FIELD(uint8_t, schemaVersion) \
+  FIELD(uint16_t, stage)
+
+#define GAME_START_PLAYER_FIELDS(FIELD) \
+  FIELD(uint8_t, controllerPort) \
+  FIELD(uint8_t, characterId) \
+  FIELD(uint8_t, playerType) \
+  FIELD(uint8_t, characterColor)
+
+//Update, player fields are members of PlayerFrameData
+#define UPDATE_GAME_FIELDS(FIELD) \
+  FIELD(uint32_t, frameCounter) \
+  FIELD(uint32_t, randomSeed)
+
+#define UPDATE_PLAYER_FIELDS(FIELD) \
+  FIELD(uint8_t, internalCharacterId) \
+  FIELD(uint16_t, animation) \
+  FIELD(float, locationX) \
+  FIELD(float, locationY) \
+  FIELD(float, joystickX) \
+  FIELD(float, joystickY) \
+  FIELD(float, cstickX) \
+  FIELD(float, cstickY) \
+  FIELD(float, trigger) \
+  FIELD(uint32_t, buttons) \
+  FIELD(float, percent) \
+  FIELD(float, shieldSize) \
+  FIELD(uint8_t, lastMoveHitId) \
+  FIELD(uint8_t, comboCount) \
+  FIELD(uint8_t, lastHitBy) \
+  FIELD(uint8_t, stocks) \
+  FIELD(uint16_t, physicalButtons) \
+  FIELD(float, lTrigger) \
+  FIELD(float, rTrigger)
+
+//Game end
+#define GAME_END_GAME_FIELDS(FIELD) \
+  FIELD(uint8_t, winCondition)
+
+#define GAME_END_PLAYER_FIELDS(FIELD)
+
+//**********************************************************************
+//*                           Payload Sizes
+//**********************************************************************
+#define SCHEMA_FIELD_SIZE(type, member) + (int)sizeof(type)
+#define SCHEMA_EVENT_SIZE(GAME_FIELDS, PLAYER_FIELDS) \
+  (0 GAME_FIELDS(SCHEMA_FIELD_SIZE) + PLAYER_COUNT * (0 PLAYER_FIELDS(SCHEMA_FIELD_SIZE)))
+
+#define EVENT_GAME_START_SIZE SCHEMA_EVENT_SIZE(GAME_START_GAME_FIELDS, GAME_START_PLAYER_FIELDS)
+#define EVENT_UPDATE_SIZE SCHEMA_EVENT_SIZE(UPDATE_GAME_FIELDS, UPDATE_PLAYER_FIELDS)
+#define EVENT_GAME_END_SIZE SCHEMA_EVENT_SIZE(GAME_END_GAME_FIELDS, GAME_END_PLAYER_FIELDS)
+
+//Catches a type typo in the lists, these are the sizes the Gecko code sends
+static_assert(EVENT_GAME_START_SIZE == 0xB, "Game start payload does not match the Gecko code");
+static_assert(EVENT_UPDATE_SIZE == 0x7A, "Update payload does not match the Gecko code");
+static_assert(EVENT_GAME_END_SIZE == 0x1, "Game end payload does not match the Gecko code");
+
+//Payload size for every event code, 0 for codes that are not events
+int asmEvents[256];
+
+void asmEventsInitialize() {
+  asmEvents[EVENT_GAME_START] = EVENT_GAME_START_SIZE;
+  asmEvents[EVENT_UPDATE] = EVENT_UPDATE_SIZE;
+  asmEvents[EVENT_GAME_END] = EVENT_GAME_END_SIZE;
+}
+
+//Call after schemaDecodeGameStart(). False for a game from a Gecko code of another schema version
+bool schemaVersionMatches(const Game& game) {
+  return game.schemaVersion == EVENT_SCHEMA_VERSION;
+}
+
+//**********************************************************************
+//*                        Field Read and Write
+//**********************************************************************
+//The console is big endian, the boards and host tools are little endian. Values are copied out with
+//memcpy, which compiles to a single unaligned load on the Cortex-M, and swapped with the byte swap
+//builtins, a single REV instruction. Floats go through the same path as words without a pointer cast.
+template <typename T> T schemaRead(const uint8_t* p);
+template <typename T> void schemaWrite(uint8_t* p, T value);
+
+template <> inline uint8_t schemaRead<uint8_t>(const uint8_t* p) {
+  return p[0];
+}
+
+template <> inline uint16_t schemaRead<uint16_t>(const uint8_t* p) {
+  uint16_t value;
+  memcpy(&value, p, sizeof(value));
+  return __builtin_bswap16(value);
+}
+
+template <> inline uint32_t schemaRead<uint32_t>(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return __builtin_bswap32(value);
+}
+
+template <> inline float schemaRead<float>(const uint8_t* p) {
+  uint32_t bytes = schemaRead<uint32_t>(p);
+  float value;
+  memcpy(&value, &bytes, sizeof(value));
+  return value;
+}
+
+template <> inline void schemaWrite<uint8_t>(uint8_t* p, uint8_t value) {
+  p[0] = value;
+}
+
+template <> inline void schemaWrite<uint16_t>(uint8_t* p, uint16_t value) {
+  value = __builtin_bswap16(value);
+  memcpy(p, &value, sizeof(value));
+}
+
+template <> inline void schemaWrite<uint32_t>(uint8_t* p, uint32_t value) {
+  value = __builtin_bswap32(value);
+  memcpy(p, &value, sizeof(value));
+}
+
+template <> inline void schemaWrite<float>(uint8_t* p, float value) {
+  uint32_t bytes;
+  memcpy(&bytes, &value, sizeof(bytes));
+  schemaWrite<uint32_t>(p, bytes);
+}
+
+//**********************************************************************
+//*                        Decoders and Encoders
+//**********************************************************************
+//Within a block every field sits at a constant offset, so the field lists expand to straight line loads
+//and stores. target is the struct the block is read into or written from
+#define SCHEMA_DECODE_FIELD(type, member) target.member = schemaRead<type>(block + idx); idx += sizeof(type);
+#define SCHEMA_ENCODE_FIELD(type, member) schemaWrite<type>(block + idx, target.member); idx += sizeof(type);
+
+#define SCHEMA_GAME_SIZE(GAME_FIELDS) (0 GAME_FIELDS(SCHEMA_FIELD_SIZE))
+#define SCHEMA_PLAYER_SIZE(PLAYER_FIELDS) (0 PLAYER_FIELDS(SCHEMA_FIELD_SIZE))
+
+//Only fills in the fields in the payload, the caller decides what else to reset
+void schemaDecodeGameStart(Game& game, const uint8_t* data) {
+  { Game& target = game; const uint8_t* block = data; int idx = 0; GAME_START_GAME_FIELDS(SCHEMA_DECODE_FIELD) }
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& target = game.players[i];
+    const uint8_t* block = data + SCHEMA_GAME_SIZE(GAME_START_GAME_FIELDS) + i * SCHEMA_PLAYER_SIZE(GAME_START_PLAYER_FIELDS);
+    int idx = 0;
+    GAME_START_PLAYER_FIELDS(SCHEMA_DECODE_FIELD)
+  }
+}
+
+void schemaDecodeUpdate(Game& game, const uint8_t* data) {
+  { Game& target = game; const uint8_t* block = data; int idx = 0; UPDATE_GAME_FIELDS(SCHEMA_DECODE_FIELD) }
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    PlayerFrameData& target = schemaUpdateTarget(game.players[i]);
+    const uint8_t* block = data + SCHEMA_GAME_SIZE(UPDATE_GAME_FIELDS) + i * SCHEMA_PLAYER_SIZE(UPDATE_PLAYER_FIELDS);
+    int idx = 0;
+    UPDATE_PLAYER_FIELDS(SCHEMA_DECODE_FIELD)
+  }
+}
+
+void schemaDecodeGameEnd(Game& game, const uint8_t* data) {
+  { Game& target = game; const uint8_t* block = data; int idx = 0; GAME_END_GAME_FIELDS(SCHEMA_DECODE_FIELD) }
+}
+
+//The encoders produce payloads byte for byte identical to what the Gecko code sends. Each returns the
+//payload size. The game start always carries this build's EVENT_SCHEMA_VERSION
+int encodeGameStart(uint8_t* data, const Game& game) {
+  Game versioned = game;
+  versioned.schemaVersion = EVENT_SCHEMA_VERSION;
+  { const Game& target = versioned; uint8_t* block = data; int idx = 0; GAME_START_GAME_FIELDS(SCHEMA_ENCODE_FIELD) }
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const Player& target = game.players[i];
+    uint8_t* block = data + SCHEMA_GAME_SIZE(GAME_START_GAME_FIELDS) + i * SCHEMA_PLAYER_SIZE(GAME_START_PLAYER_FIELDS);
+    int idx = 0;
+    GAME_START_PLAYER_FIELDS(SCHEMA_ENCODE_FIELD)
+  }
+  return EVENT_GAME_START_SIZE;
+}
+
+int encodeUpdate(uint8_t* data, const Game& game) {
+  { const Game& target = game; uint8_t* block = data; int idx = 0; UPDATE_GAME_FIELDS(SCHEMA_ENCODE_FIELD) }
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerFrameData& target = schemaUpdateTarget(game.players[i]);
+    uint8_t* block = data + SCHEMA_GAME_SIZE(UPDATE_GAME_FIELDS) + i * SCHEMA_PLAYER_SIZE(UPDATE_PLAYER_FIELDS);
+    int idx = 0;
+    UPDATE_PLAYER_FIELDS(SCHEMA_ENCODE_FIELD)
+  }
+  return EVENT_UPDATE_SIZE;
+}
+
+int encodeGameEnd(uint8_t* data, const Game& game) {
+  { const Game& target = game; uint8_t* block = data; int idx = 0; GAME_END_GAME_FIELDS(SCHEMA_ENCODE_FIELD) }
+  return EVENT_GAME_END_SIZE;
+}
+
+#endif
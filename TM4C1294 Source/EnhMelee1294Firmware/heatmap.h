@@ -0,0 +1,224 @@
+#ifndef _HEATMAP_H_INCLUDED
+#define _HEATMAP_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h and udpprotocol.h
+
+//**********************************************************************
+//*                        Stage Occupancy Maps
+//**********************************************************************
+//Every frame computeStatistics() bins each player's position into a grid over the stage's blast zones
+//and the horizontal distance between the two players into a spacing histogram. Both are a couple of
+//multiplies and one increment per frame, weighted by the frame delta like the other durations. Cells
+//saturate at 0xFFFF, more than 18 minutes in one cell.
+//
+//Row 0 of the grid is the bottom blast zone, column 0 the left one. A position past a blast zone lands
+//in the edge cell, which only happens on the frames a stock is lost.
+//
+//MSG_TYPE_HEATMAP reads the grids of the game in progress, or of the last one until the next starts, one
+//grid at a time compressed with heatmapEncode() and paged over as many responses as it takes. Host
+//Source/HeatmapDecoder turns them back into counts. Most cells are never visited, so the encoding is runs
+//of empty cells and runs of literal counts:
+//
+//  0nnnnnnn              n + 1 empty cells
+//  1nnnnnnn  v1 .. vn+1  n + 1 counts, each a little endian base 128 varint (1 to 3 bytes)
+#define HEATMAP_COLUMNS 64
+#define HEATMAP_ROWS 32
+#define HEATMAP_CELLS (HEATMAP_COLUMNS * HEATMAP_ROWS)
+#define SPACING_BINS 64
+#define SPACING_BIN_WIDTH 4 //Game units, the last bin also holds everything further apart
+
+#define HEATMAP_RUN_MAX 128
+#define HEATMAP_ENCODED_MAX(cells) ((cells) * 3 + ((cells) + HEATMAP_RUN_MAX - 1) / HEATMAP_RUN_MAX)
+
+#define HEATMAP_GRID_SPACING 0 //Grids of a query, each player's stage grid follows in port order
+
+typedef struct {
+  float left;
+  float right;
+  float bottom;
+  float top;
+} StageBounds;
+
+typedef struct {
+  uint16_t cells[PLAYER_COUNT][HEATMAP_CELLS];
+  uint16_t spacing[SPACING_BINS];
+  StageBounds bounds;
+  float columnsPerUnit;
+  float rowsPerUnit;
+} StageHeatmaps;
+
+//The encoding queries page through
+typedef struct {
+  uint8_t bytes[HEATMAP_ENCODED_MAX(HEATMAP_CELLS)];
+  int size;
+  uint8_t grid;
+  uint32_t frame; //Frame counter when it was encoded
+} HeatmapPages;
+
+//Blast zones of the tournament stages. Anything else gets a box that holds all of them
+StageBounds heatmapStageBounds(uint16_t stage) {
+  switch(stage) {
+    case STAGE_FOD:
+      return { -198.75f, 198.75f, -146.25f, 202.5f };
+    case STAGE_POKEMON:
+      return { -230, 230, -111, 180 };
+    case STAGE_YOSHIS:
+      return { -175.7f, 173.6f, -91, 168 };
+    case STAGE_DREAM_LAND:
+      return { -255, 255, -123, 250 };
+    case STAGE_BATTLEFIELD:
+      return { -224, 224, -108.8f, 200 };
+    case STAGE_FD:
+      return { -246, 246, -140, 188 };
+    default:
+      return { -255, 255, -146.25f, 250 };
+  }
+}
+
+void heatmapReset(StageHeatmaps& h, uint16_t stage) {
+  memset(h.cells, 0, sizeof(h.cells));
+  memset(h.spacing, 0, sizeof(h.spacing));
+  h.bounds = heatmapStageBounds(stage);
+  h.columnsPerUnit = HEATMAP_COLUMNS / (h.bounds.right - h.bounds.left);
+  h.rowsPerUnit = HEATMAP_ROWS / (h.bounds.top - h.bounds.bottom);
+}
+
+//Clamps to the edge bins, NaN goes to bin 0
+int heatmapBin(float offset, float binsPerUnit, int bins) {
+  float bin = offset * binsPerUnit;
+  if (!(bin > 0)) return 0;
+  if (bin >= bins) return bins - 1;
+  return (int)bin;
+}
+
+void heatmapCount(uint16_t& cell, uint32_t frameDelta) {
+  uint32_t count = cell + frameDelta;
+  cell = count > 0xFFFF ? 0xFFFF : count;
+}
+
+void heatmapAdd(StageHeatmaps& h, const Player* players, uint32_t frameDelta) {
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerFrameData& pfd = currentFrame(players[i]);
+    int column = heatmapBin(pfd.locationX - h.bounds.left, h.columnsPerUnit, HEATMAP_COLUMNS);
+    int row = heatmapBin(pfd.locationY - h.bounds.bottom, h.rowsPerUnit, HEATMAP_ROWS);
+    heatmapCount(h.cells[i][row * HEATMAP_COLUMNS + column], frameDelta);
+  }
+
+  float distance = currentFrame(players[0]).locationX - currentFrame(players[1]).locationX;
+  if (distance < 0) distance = -distance;
+  heatmapCount(h.spacing[heatmapBin(distance, 1.0f / SPACING_BIN_WIDTH, SPACING_BINS)], frameDelta);
+}
+
+//**********************************************************************
+//*                             Encoding
+//**********************************************************************
+//Returns the encoded size, or -1 if it does not fit. HEATMAP_ENCODED_MAX(count) always fits
+int heatmapEncode(const uint16_t* cells, int count, uint8_t* out, int capacity) {
+  int size = 0;
+  int i = 0;
+  while (i < count) {
+    int run = 0;
+    if (cells[i] == 0) {
+      while (i + run < count && run < HEATMAP_RUN_MAX && cells[i + run] == 0) run++;
+      if (size + 1 > capacity) return -1;
+      out[size++] = run - 1;
+    }
+    else {
+      while (i + run < count && run < HEATMAP_RUN_MAX && cells[i + run] != 0) run++;
+      if (size + 1 > capacity) return -1;
+      out[size++] = 0x80 | (run - 1);
+      for (int k = 0; k < run; k++) {
+        uint16_t value = cells[i + k];
+        do {
+          if (size + 1 > capacity) return -1;
+          out[size++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+          value >>= 7;
+        } while (value != 0);
+      }
+    }
+    i += run;
+  }
+  return size;
+}
+
+//Returns false if the input is malformed or does not decode to exactly count cells
+bool heatmapDecode(const uint8_t* in, int size, uint16_t* cells, int count) {
+  int idx = 0;
+  int i = 0;
+  while (idx < size) {
+    uint8_t token = in[idx++];
+    int run = (token & 0x7F) + 1;
+    if (i + run > count) return false;
+
+    if (!(token & 0x80)) {
+      memset(cells + i, 0, run * sizeof(uint16_t));
+      i += run;
+      continue;
+    }
+
+    for (int k = 0; k < run; k++) {
+      uint32_t value = 0;
+      for (int shift = 0; ; shift += 7) {
+        if (idx >= size || shift > 14) return false;
+        uint8_t b = in[idx++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+      }
+      if (value > 0xFFFF) return false;
+      cells[i++] = value;
+    }
+  }
+  return i == count;
+}
+
+//**********************************************************************
+//*                              Queries
+//**********************************************************************
+//Appends TLV_HEATMAP_INFO and one TLV_HEATMAP_DATA with as much of the encoded grid from offset on as fits,
+//see udpprotocol.h. Offset 0 encodes the grid as it is now into pages, later offsets page through that same
+//encoding so a grid read during a game still decodes. Returns false if the data did not fit
+bool heatmapAppend(TlvWriter& w, const StageHeatmaps& h, HeatmapPages& pages, uint8_t grid, uint16_t offset,
+  uint32_t frame) {
+  uint8_t value[255];
+  int idx = 0;
+  value[idx++] = HEATMAP_COLUMNS;
+  value[idx++] = HEATMAP_ROWS;
+  const float edges[4] = { h.bounds.left, h.bounds.right, h.bounds.bottom, h.bounds.top };
+  for (int i = 0; i < 4; i++) {
+    uint32_t bits;
+    memcpy(&bits, &edges[i], sizeof(bits));
+    for (int b = 3; b >= 0; b--) value[idx++] = bits >> (8 * b);
+  }
+  value[idx++] = SPACING_BINS;
+  value[idx++] = SPACING_BIN_WIDTH;
+  if (!tlvAppend(w, TLV_HEATMAP_INFO, value, idx)) return false;
+
+  if (offset == 0 || grid != pages.grid) {
+    bool spacing = grid == HEATMAP_GRID_SPACING;
+    pages.size = heatmapEncode(spacing ? h.spacing : h.cells[grid - 1], spacing ? SPACING_BINS : HEATMAP_CELLS,
+      pages.bytes, sizeof(pages.bytes));
+    pages.grid = grid;
+    pages.frame = frame;
+  }
+
+  idx = 0;
+  value[idx++] = grid;
+  for (int b = 3; b >= 0; b--) value[idx++] = pages.frame >> (8 * b);
+  value[idx++] = pages.size >> 8;
+  value[idx++] = pages.size;
+  value[idx++] = offset >> 8;
+  value[idx++] = offset;
+  int room = w.capacity - w.size - 2 - idx;
+  if (room > (int)sizeof(value) - idx) room = sizeof(value) - idx;
+  if (room < 0) return false;
+
+  int count = offset < pages.size ? pages.size - offset : 0;
+  if (count > room) count = room;
+  memcpy(value + idx, pages.bytes + offset, count);
+  return tlvAppend(w, TLV_HEATMAP_DATA, value, idx + count);
+}
+
+#endif
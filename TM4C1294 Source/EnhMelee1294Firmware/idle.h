@@ -0,0 +1,81 @@
+#ifndef _IDLE_H_INCLUDED
+#define _IDLE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//Include after latency.h
+
+//**********************************************************************
+//*                            Idle Sleep
+//**********************************************************************
+//When there is no message and no background task that can run, loop() sleeps the core with WFI instead
+//of spinning. Any enabled interrupt wakes it: the CS edge of the next message, the Ethernet controller or
+//the wake timer set for the next task the scheduler has due (schedulerSleepUs in scheduler.h).
+//
+//Sleep only stops the core clock. SSI3, uDMA, GPIO Q, the Ethernet controller and the timers are sleep
+//enabled so transfers and stamps carry on, and waking takes the interrupt latency plus the handler.
+//
+//Wake latency is measured for every message that arrives while the core sleeps, from the stamp in
+//gpioQ1IntHandler to loop() running again. The duty cycle is the share of the time the core was awake.
+#define IDLE_MIN_SLEEP_US 20 //Not worth sleeping for less
+#define IDLE_MAX_SLEEP_US 100000 //Wake at least this often whatever is due
+#define IDLE_WAKE_BUCKET_US 1
+
+typedef struct {
+  bool enabled;
+  uint32_t cyclesPerMicrosecond;
+
+  uint32_t sleeps;
+  uint64_t sleepCycles;
+  uint64_t elapsedCycles; //Since the reset, both add up differences so the counter can wrap
+  uint32_t lastStamp;
+
+  LatencyHistogram wake;
+} IdleStats;
+
+void idleReset(IdleStats& is, uint32_t cyclesPerMicrosecond, uint32_t now) {
+  bool enabled = is.enabled;
+  memset(&is, 0, sizeof(is));
+  is.enabled = enabled;
+  is.cyclesPerMicrosecond = cyclesPerMicrosecond;
+  is.lastStamp = now;
+  latencyHistogramReset(is.wake, IDLE_WAKE_BUCKET_US);
+}
+
+//Adds the time since the previous stamp, called before and after every sleep and for reports
+void idleAdvance(IdleStats& is, uint32_t now) {
+  is.elapsedCycles += now - is.lastStamp;
+  is.lastStamp = now;
+}
+
+//start and end bracket the WFI. messageArrival is the stamp of a message that woke the core, 0 if none did
+void idleRecordSleep(IdleStats& is, uint32_t start, uint32_t end, uint32_t messageArrival) {
+  idleAdvance(is, start);
+  idleAdvance(is, end);
+  is.sleeps++;
+  is.sleepCycles += end - start;
+
+  //A message stamped before the sleep started was already waiting and did not wake anything
+  if (messageArrival != 0 && (int32_t)(messageArrival - start) >= 0) {
+    latencyHistogramAdd(is.wake, (end - messageArrival) / is.cyclesPerMicrosecond);
+  }
+}
+
+//Share of the time the core was awake, in hundredths of a percent
+uint32_t idleDutyCycle(const IdleStats& is) {
+  if (is.elapsedCycles == 0) return 10000;
+  return (uint32_t)(10000 - is.sleepCycles * 10000 / is.elapsedCycles);
+}
+
+int idleFormatReport(char* out, int size, const IdleStats& is) {
+  uint32_t duty = idleDutyCycle(is);
+  int length = snprintf(out, size, "idle    %s awake=%lu.%02lu%% sleeps=%lu wake n=%lu p50=%luus p99=%luus max=%luus\n",
+    is.enabled ? "sleep" : "spin", (unsigned long)(duty / 100), (unsigned long)(duty % 100), (unsigned long)is.sleeps,
+    (unsigned long)is.wake.count, (unsigned long)latencyPercentile(is.wake, 50), (unsigned long)latencyPercentile(is.wake, 99),
+    (unsigned long)is.wake.maxUs);
+  return length < size ? length : size - 1;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef _LATENCY_H_INCLUDED
+#define _LATENCY_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//**********************************************************************
+//*                          Frame Latency
+//**********************************************************************
+//Every message is stamped with the timestamp timer in gpioQ1IntHandler when CS rises at the end of the
+//SPI transaction. The main loop adds a stamp after each stage and the differences go into fixed
+//histograms, so recording a frame is a handful of adds and percentiles can be read at any time.
+//Nothing here touches hardware so the host tools run the exact same code on recorded or simulated stamps.
+#define LATENCY_STAGE_DECODE 0 //CS edge -> message decoded into CurrentGame
+#define LATENCY_STAGE_STATS 1 //Decoded -> statistics computed
+#define LATENCY_STAGE_EMIT 2 //Statistics computed -> telemetry datagram handed to the network stack
+#define LATENCY_STAGE_TOTAL 3 //CS edge -> last stage the frame went through
+#define LATENCY_STAGE_COUNT 4
+
+#define LATENCY_BUCKET_COUNT 512 //The last bucket also holds everything above the range
+#define LATENCY_STAGE_BUCKET_US 4 //2ms range for the processing stages
+#define LATENCY_ARRIVAL_BUCKET_US 64 //32ms range for frame to frame arrival
+
+#define LATENCY_NOMINAL_FRAME_US 16683 //60.0988 fps
+#define LATENCY_SLOW_FRAME_US (LATENCY_NOMINAL_FRAME_US * 3 / 2)
+
+typedef struct {
+  uint32_t arrival;
+  uint32_t decoded;
+  uint32_t computed;
+  uint32_t emitted; //0 if the frame was not sent anywhere
+} FrameTiming;
+
+typedef struct {
+  uint32_t bucketUs;
+  uint32_t count;
+  uint32_t maxUs;
+  uint32_t buckets[LATENCY_BUCKET_COUNT];
+} LatencyHistogram;
+
+typedef struct {
+  uint32_t cyclesPerMicrosecond;
+
+  LatencyHistogram stages[LATENCY_STAGE_COUNT];
+
+  //Frame to frame arrival, exposes jitter on the console side and game slowdowns
+  LatencyHistogram arrival;
+  bool hasLastArrival;
+  uint32_t lastArrival;
+  float intervalMean;
+  float intervalM2;
+  uint32_t slowFrames;
+} LatencyStats;
+
+void latencyHistogramReset(LatencyHistogram& h, uint32_t bucketUs) {
+  memset(&h, 0, sizeof(h));
+  h.bucketUs = bucketUs;
+}
+
+void latencyHistogramAdd(LatencyHistogram& h, uint32_t us) {
+  uint32_t bucket = us / h.bucketUs;
+  if (bucket >= LATENCY_BUCKET_COUNT) bucket = LATENCY_BUCKET_COUNT - 1;
+
+  h.buckets[bucket]++;
+  h.count++;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+//Returns the upper edge of the bucket holding the given percentile (0 - 100), never more than the max seen
+uint32_t latencyPercentile(const LatencyHistogram& h, float percentile) {
+  if (h.count == 0) return 0;
+
+  uint32_t target = (uint32_t)(h.count * percentile / 100);
+  if (target >= h.count) target = h.count - 1;
+
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    seen += h.buckets[i];
+    if (seen > target) {
+      uint32_t edge = (i + 1) * h.bucketUs;
+      return edge < h.maxUs ? edge : h.maxUs;
+    }
+  }
+
+  return h.maxUs;
+}
+
+void latencyReset(LatencyStats& ls, uint32_t cyclesPerMicrosecond) {
+  ls.cyclesPerMicrosecond = cyclesPerMicrosecond;
+  for (int i = 0; i < LATENCY_STAGE_COUNT; i++) latencyHistogramReset(ls.stages[i], LATENCY_STAGE_BUCKET_US);
+  latencyHistogramReset(ls.arrival, LATENCY_ARRIVAL_BUCKET_US);
+
+  ls.hasLastArrival = false;
+  ls.lastArrival = 0;
+  ls.intervalMean = 0;
+  ls.intervalM2 = 0;
+  ls.slowFrames = 0;
+}
+
+//The gap between games is not a frame interval, call this on game start
+void latencyGameStart(LatencyStats& ls) {
+  ls.hasLastArrival = false;
+}
+
+uint32_t latencyMicroseconds(const LatencyStats& ls, uint32_t startCycles, uint32_t endCycles) {
+  //Unsigned subtraction handles the cycle counter wrapping
+  return (endCycles - startCycles) / ls.cyclesPerMicrosecond;
+}
+
+void latencyRecord(LatencyStats& ls, const FrameTiming& t) {
+  latencyHistogramAdd(ls.stages[LATENCY_STAGE_DECODE], latencyMicroseconds(ls, t.arrival, t.decoded));
+  latencyHistogramAdd(ls.stages[LATENCY_STAGE_STATS], latencyMicroseconds(ls, t.decoded, t.computed));
+
+  uint32_t last = t.computed;
+  if (t.emitted != 0) {
+    latencyHistogramAdd(ls.stages[LATENCY_STAGE_EMIT], latencyMicroseconds(ls, t.computed, t.emitted));
+    last = t.emitted;
+  }
+  latencyHistogramAdd(ls.stages[LATENCY_STAGE_TOTAL], latencyMicroseconds(ls, t.arrival, last));
+
+  if (ls.hasLastArrival) {
+    uint32_t interval = latencyMicroseconds(ls, ls.lastArrival, t.arrival);
+    latencyHistogramAdd(ls.arrival, interval);
+    if (interval > LATENCY_SLOW_FRAME_US) ls.slowFrames++;
+
+    //Welford's running variance, stays accurate in single precision over long sessions
+    float delta = interval - ls.intervalMean;
+    ls.intervalMean += delta / ls.arrival.count;
+    ls.intervalM2 += delta * (interval - ls.intervalMean);
+  }
+
+  ls.lastArrival = t.arrival;
+  ls.hasLastArrival = true;
+}
+
+//Standard deviation of the frame to frame arrival interval in microseconds
+float latencyJitter(const LatencyStats& ls) {
+  if (ls.arrival.count < 2) return 0;
+  float variance = ls.intervalM2 / (ls.arrival.count - 1);
+
+  //Newton's method, avoids pulling in the math library for one square root
+  float root = variance > 1 ? variance : 1;
+  for (int i = 0; i < 20; i++) root = (root + variance / root) / 2;
+  return variance > 0 ? root : 0;
+}
+
+//One report line per stage plus one for arrival. The board prints this and the host simulator prints
+//the same text so the two can be diffed
+int latencyFormatReport(char* out, int size, const LatencyStats& ls) {
+  static const char* stageNames[LATENCY_STAGE_COUNT] = { "decode", "stats", "emit", "total" };
+
+  int length = 0;
+  for (int i = 0; i < LATENCY_STAGE_COUNT && length < size; i++) {
+    const LatencyHistogram& h = ls.stages[i];
+    length += snprintf(out + length, size - length, "%-7s n=%lu p50=%luus p90=%luus p99=%luus max=%luus\n",
+      stageNames[i], (unsigned long)h.count, (unsigned long)latencyPercentile(h, 50),
+      (unsigned long)latencyPercentile(h, 90), (unsigned long)latencyPercentile(h, 99), (unsigned long)h.maxUs);
+  }
+
+  if (length < size) {
+    const LatencyHistogram& h = ls.arrival;
+    length += snprintf(out + length, size - length, "arrival n=%lu mean=%luus jitter=%luus p99=%luus max=%luus slow=%lu\n",
+      (unsigned long)h.count, (unsigned long)(ls.intervalMean + 0.5f), (unsigned long)(latencyJitter(ls) + 0.5f),
+      (unsigned long)latencyPercentile(h, 99), (unsigned long)h.maxUs, (unsigned long)ls.slowFrames);
+  }
+
+  return length < size ? length : size - 1;
+}
+
+#endif
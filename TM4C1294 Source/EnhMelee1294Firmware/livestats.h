@@ -0,0 +1,176 @@
+#ifndef _LIVESTATS_H_INCLUDED
+#define _LIVESTATS_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h and udpprotocol.h
+
+//**********************************************************************
+//*                        Live Stats Snapshots
+//**********************************************************************
+//The statistics of the game in progress, published every interval frames so they can be read during the
+//game instead of only after EVENT_GAME_END. Snapshots go into one of two buffers, the one the latest
+//snapshot is not in, and sequence is incremented once the copy is complete:
+//
+//  buffers[sequence & 1]        the latest complete snapshot, never written to
+//  buffers[(sequence + 1) & 1]  where the next snapshot goes
+//
+//A reader takes sequence, encodes from the latest buffer and then checks sequence is unchanged. The writer
+//never waits for readers, and a reader only has to retry if it was still reading when the next snapshot
+//started, which takes a whole interval. On the board both run from loop() so the retry never happens,
+//the check keeps it correct if the publish ever moves into an interrupt.
+//
+//A whole snapshot does not fit in one datagram, so it goes out in parts. Each part starts with the same
+//TLV_LIVE_SNAPSHOT, a host joins them by its sequence. A query asks for one part with TLV_LIVE_PART, the
+//players part if it has none, and a push sends every part.
+#define LIVE_STATS_DEFAULT_INTERVAL 60 //Frames between snapshots, about once a second
+#define LIVE_STATS_READ_ATTEMPTS 3
+
+#define LIVE_PART_PLAYERS 0 //TLV_LIVE_PLAYER and TLV_LIVE_STOCK
+#define LIVE_PART_TECHNIQUES 1 //TLV_LIVE_TECHS
+#define LIVE_PART_COUNT 2
+
+typedef struct {
+  uint32_t frame;
+  uint32_t framesMissed;
+  uint8_t port[PLAYER_COUNT];
+  uint8_t stocksRemaining[PLAYER_COUNT];
+  float percent[PLAYER_COUNT];
+  PlayerStatistics stats[PLAYER_COUNT]; //Includes the StockStatistics of every stock
+} LiveStatsSnapshot;
+
+typedef struct {
+  LiveStatsSnapshot buffers[2];
+  volatile uint32_t sequence; //Snapshots published so far, 0 before the first one
+  uint16_t interval; //Frames between snapshots, 0 stops publishing
+} LiveStats;
+
+//Keeps the compiler from moving the copy past the sequence update or the reads past the check
+#define LIVE_STATS_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+void liveStatsInitialize(LiveStats& ls) {
+  ls.sequence = 0;
+  ls.interval = LIVE_STATS_DEFAULT_INTERVAL;
+}
+
+//Called after the statistics of a frame are computed. force publishes regardless of the interval, used
+//at the end of a game so the final numbers are always available. Returns true if a snapshot was published
+bool liveStatsPublish(LiveStats& ls, const Game& game, bool force) {
+  if (!force && (ls.interval == 0 || game.frameCounter % ls.interval != 0)) return false;
+
+  uint32_t sequence = ls.sequence;
+  LiveStatsSnapshot& s = ls.buffers[(sequence + 1) & 1];
+  s.frame = game.frameCounter;
+  s.framesMissed = game.framesMissed;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const Player& p = game.players[i];
+    s.port[i] = p.controllerPort + 1;
+    s.stocksRemaining[i] = currentFrame(p).stocks;
+    s.percent[i] = currentFrame(p).percent;
+    s.stats[i] = p.stats;
+  }
+
+  LIVE_STATS_BARRIER();
+  ls.sequence = sequence + 1;
+  return true;
+}
+
+void liveStatsPut(uint8_t* a, int& idx, uint32_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) a[idx++] = value >> (8 * i);
+}
+
+void liveStatsPutFloat(uint8_t* a, int& idx, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  liveStatsPut(a, idx, bits, 4);
+}
+
+//Appends the TLVs of one part of a snapshot, see TLV_LIVE_* in udpprotocol.h
+void liveStatsAppendSnapshot(TlvWriter& w, const LiveStatsSnapshot& s, uint32_t sequence, uint8_t part) {
+  uint8_t value[32];
+  int idx = 0;
+  liveStatsPut(value, idx, sequence, 4);
+  liveStatsPut(value, idx, s.frame, 4);
+  liveStatsPut(value, idx, s.framesMissed, 4);
+  tlvAppend(w, TLV_LIVE_SNAPSHOT, value, idx);
+  tlvAppendByte(w, TLV_LIVE_PART, part);
+
+  if (part == LIVE_PART_TECHNIQUES) {
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      const PlayerStatistics& ps = s.stats[i];
+      idx = 0;
+      value[idx++] = s.port[i];
+      liveStatsPut(value, idx, ps.techMissCount, 2);
+      liveStatsPut(value, idx, ps.techLeftCount, 2);
+      liveStatsPut(value, idx, ps.techRightCount, 2);
+      liveStatsPut(value, idx, ps.techPlaceCount, 2);
+      liveStatsPut(value, idx, ps.wavedashCount, 2);
+      liveStatsPut(value, idx, ps.lCancelCount, 2);
+      liveStatsPut(value, idx, ps.lCancelMissCount, 2);
+      liveStatsPut(value, idx, ps.ledgedashCount, 2);
+      liveStatsPut(value, idx, ps.shieldDropCount, 2);
+      tlvAppend(w, TLV_LIVE_TECHS, value, idx);
+    }
+    return;
+  }
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerStatistics& ps = s.stats[i];
+    idx = 0;
+    value[idx++] = s.port[i];
+    value[idx++] = s.stocksRemaining[i];
+    liveStatsPutFloat(value, idx, s.percent[i]);
+    liveStatsPut(value, idx, ps.actionCount, 2);
+    liveStatsPut(value, idx, ps.numberOfOpenings, 2);
+    liveStatsPut(value, idx, ps.recoveryAttempts, 2);
+    liveStatsPut(value, idx, ps.successfulRecoveries, 2);
+    liveStatsPut(value, idx, ps.framesInShield, 4);
+    liveStatsPut(value, idx, ps.rollCount, 2);
+    liveStatsPut(value, idx, ps.spotDodgeCount, 2);
+    liveStatsPut(value, idx, ps.airDodgeCount, 2);
+    liveStatsPutFloat(value, idx, ps.averageDamagePerString);
+    liveStatsPutFloat(value, idx, ps.mostDamageString);
+    tlvAppend(w, TLV_LIVE_PLAYER, value, idx);
+  }
+
+  //Only stocks that have been played, a 2 player game with every stock played still fits in a datagram
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    for (int j = 0; j < STOCK_COUNT; j++) {
+      const StockStatistics& ss = s.stats[i].stocks[j];
+      if (!ss.isStockUsed && j > 0) continue;
+
+      idx = 0;
+      value[idx++] = s.port[i];
+      value[idx++] = j;
+      value[idx++] = (ss.isStockUsed ? 1 : 0) | (ss.isStockLost ? 2 : 0);
+      liveStatsPut(value, idx, ss.frame, 4);
+      liveStatsPutFloat(value, idx, ss.percent);
+      value[idx++] = ss.lastHitBy;
+      liveStatsPut(value, idx, ss.killedInOpenings, 2);
+      tlvAppend(w, TLV_LIVE_STOCK, value, idx);
+    }
+  }
+}
+
+//Appends one part of the latest snapshot to a response. Returns false if there is none yet or it kept
+//changing while it was read, the writer then has its size from before the call
+bool liveStatsAppend(TlvWriter& w, const LiveStats& ls, uint8_t part) {
+  int start = w.size;
+  for (int attempt = 0; attempt < LIVE_STATS_READ_ATTEMPTS; attempt++) {
+    uint32_t sequence = ls.sequence;
+    if (sequence == 0) return false;
+    LIVE_STATS_BARRIER();
+
+    w.size = start;
+    liveStatsAppendSnapshot(w, ls.buffers[sequence & 1], sequence, part);
+
+    LIVE_STATS_BARRIER();
+    if (ls.sequence == sequence) return true;
+  }
+
+  w.size = start;
+  return false;
+}
+
+#endif
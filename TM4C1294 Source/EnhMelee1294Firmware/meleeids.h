@@ -23,6 +23,25 @@
 #define GUARD_ON 0xB2
 #define TECH_MISS_UP 0xB7
 #define TECH_MISS_DOWN 0xBF
+#define TECH_IN_PLACE 0xC7
+#define TECH_ROLL_FORWARD 0xC8
+#define TECH_ROLL_BACKWARD 0xC9
+
+//Used by the technique machines in techniques.h
+#define ACTION_JUMP_START 0x19 //JumpF, JumpB, JumpAerialF, JumpAerialB
+#define ACTION_JUMP_END 0x1C
+#define ACTION_FALL_START 0x1D //Fall, FallF, FallB, FallAerial, FallAerialF, FallAerialB, FallSpecial, FallSpecialF, FallSpecialB
+#define ACTION_FALL_END 0x25
+#define ACTION_LANDING_FALL_SPECIAL 0x2B //Landing out of an air dodge, the end of a wavedash or ledgedash
+#define AERIAL_START 0x41 //AttackAirN to AttackAirLw
+#define AERIAL_END 0x45
+#define AERIAL_LANDING_START 0x46 //LandingAirN to LandingAirLw, the lag an L-cancel halves
+#define AERIAL_LANDING_END 0x4A
+#define ACTION_PLATFORM_DROP 0xF4
+#define LEDGE_START 0xFC //CliffCatch, CliffWait
+#define LEDGE_END 0xFD
+#define LEDGE_JUMP_START 0x104 //CliffJumpSlow1 to CliffJumpQuick2
+#define LEDGE_JUMP_END 0x107
 
 //Stage IDs
 #define STAGE_FOD 2
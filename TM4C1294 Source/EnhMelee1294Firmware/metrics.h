@@ -0,0 +1,135 @@
+#ifndef _METRICS_H_INCLUDED
+#define _METRICS_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//Include after udpprotocol.h
+
+//**********************************************************************
+//*                          Device Metrics
+//**********************************************************************
+//One registry of named counters and gauges for the health of the board itself, as opposed to the
+//statistics of the game. Everything is a u32 slot indexed by a METRIC_* ID:
+//
+//  counter  only goes up for as long as the board runs, hosts look at the rate
+//  gauge    a current value
+//
+//metricAdd() is an LDREX/STREX add on the M4, so interrupt handlers and loop() can count into the same
+//slot without masking interrupts. Counters another module already keeps (the SSI driver's, MsgChecks,
+//the scheduler's) are not counted twice, metricsSample() in the sketch copies them in right before a dump.
+//
+//MSG_TYPE_METRICS returns the slots as a packed array of big endian u32 in ID order, see udpprotocol.h.
+//Names do not go over the wire, hosts keep a copy of metricDefs. IDs are never reused or reordered,
+//new metrics go at the end and a host exports the IDs it does not know under their number.
+//Host Source/MetricsExporter scrapes every board on the subnet into a Prometheus endpoint.
+#define METRIC_COUNTER 0
+#define METRIC_GAUGE 1
+
+#define METRIC_UPTIME 0
+#define METRIC_SSI_MESSAGES 1
+#define METRIC_SSI_OVERRUNS 2
+#define METRIC_SSI_DMA_ERRORS 3
+#define METRIC_SSI_PENDING 4
+#define METRIC_MSG_UNCHECKED 5
+#define METRIC_MSG_BAD_SIZES 6
+#define METRIC_MSG_BAD_CRCS 7
+#define METRIC_MSG_SEQUENCE_GAPS 8
+#define METRIC_FRAMES 9
+#define METRIC_FRAMES_MISSED 10
+#define METRIC_GAMES 11
+#define METRIC_TCP_CONNECTED 12
+#define METRIC_TCP_CONNECTS 13
+#define METRIC_TCP_CONNECT_FAILURES 14
+#define METRIC_TCP_DISCONNECTS 15
+#define METRIC_STREAM_DROPPED 16
+#define METRIC_STREAM_SHORT_WRITES 17
+#define METRIC_UDP_PACKETS 18
+#define METRIC_DHCP_FAILURES 19
+#define METRIC_PLAY_EVENTS_DROPPED 20
+#define METRIC_TASK_OVERRUNS 21
+#define METRIC_TIME_SYNCED 22
+#define METRIC_BOOT_INGEST_US 23
+#define METRIC_BOOT_NETWORK_MS 24
+#define METRIC_NET_SOURCE 25
+#define METRIC_BOOT_BACKLOG_BYTES 26
+#define METRIC_MSG_OTHER_SCHEMAS 27
+#define METRIC_COUNT 28
+
+typedef struct {
+  const char* name;
+  uint8_t kind;
+  const char* help;
+} MetricDef;
+
+//In METRIC_* order
+static const MetricDef metricDefs[] = {
+  { "uptime_seconds", METRIC_GAUGE, "Seconds since the board started" },
+  { "ssi_messages_total", METRIC_COUNTER, "Messages taken off the SSI receive ring" },
+  { "ssi_overruns_total", METRIC_COUNTER, "Messages written over before they were read" },
+  { "ssi_dma_errors_total", METRIC_COUNTER, "uDMA errors" },
+  { "ssi_pending", METRIC_GAUGE, "Messages waiting in the SSI receive ring" },
+  { "msg_unchecked_total", METRIC_COUNTER, "Messages accepted without a trailer" },
+  { "msg_bad_sizes_total", METRIC_COUNTER, "Messages rejected for their size or event code" },
+  { "msg_bad_crcs_total", METRIC_COUNTER, "Messages rejected for their crc" },
+  { "msg_sequence_gaps_total", METRIC_COUNTER, "Messages lost between two good ones" },
+  { "frames_total", METRIC_COUNTER, "Updates handled" },
+  { "frames_missed_total", METRIC_COUNTER, "Gaps in the frame counter of the updates" },
+  { "games_total", METRIC_COUNTER, "Games that ended" },
+  { "tcp_connected", METRIC_GAUGE, "1 while the stream to the server is connected" },
+  { "tcp_connects_total", METRIC_COUNTER, "Connections made to the server" },
+  { "tcp_connect_failures_total", METRIC_COUNTER, "Connection attempts that failed" },
+  { "tcp_disconnects_total", METRIC_COUNTER, "Connections that were lost or closed" },
+  { "stream_dropped_total", METRIC_COUNTER, "Messages not forwarded because there was no connection" },
+  { "stream_short_writes_total", METRIC_COUNTER, "Messages the connection took only part of" },
+  { "udp_packets_total", METRIC_COUNTER, "UDP packets received" },
+  { "dhcp_failures_total", METRIC_COUNTER, "Lease renewals and rebinds that failed" },
+  { "play_events_dropped_total", METRIC_COUNTER, "Play events that found the queue full" },
+  { "task_overruns_total", METRIC_COUNTER, "Background task runs longer than their budget" },
+  { "time_synced", METRIC_GAUGE, "1 once the clock is synchronized with the server" },
+  { "boot_ingest_microseconds", METRIC_GAUGE, "Time from reset until SSI ingest and the stats engine ran" },
+  { "boot_network_milliseconds", METRIC_GAUGE, "Time from reset until the network was up, 0 while waiting" },
+  { "net_source", METRIC_GAUGE, "Where the address came from: 0 none yet, 1 DHCP, 2 cached lease, 3 link local" },
+  { "boot_backlog_bytes", METRIC_GAUGE, "Most bytes the stream held back while the board booted" },
+  { "msg_other_schemas_total", METRIC_COUNTER, "Games dropped because the Gecko code sends another schema version" },
+};
+
+typedef char MetricDefsMatchCount[sizeof(metricDefs) / sizeof(metricDefs[0]) == METRIC_COUNT ? 1 : -1];
+
+typedef struct {
+  volatile uint32_t values[METRIC_COUNT];
+} MetricsRegistry;
+
+void metricsReset(MetricsRegistry& m) {
+  for (int i = 0; i < METRIC_COUNT; i++) m.values[i] = 0;
+}
+
+void metricAdd(MetricsRegistry& m, int id, uint32_t count) {
+  __sync_fetch_and_add(&m.values[id], count);
+}
+
+//A single aligned store, also safe from an interrupt handler
+void metricSet(MetricsRegistry& m, int id, uint32_t value) {
+  m.values[id] = value;
+}
+
+//Appends one TLV_METRICS with the slots from first on, as many as fit. Returns the ID after the last
+//one appended, METRIC_COUNT once everything was sent, or first if not even one fit
+int metricsAppend(TlvWriter& w, const MetricsRegistry& m, int first) {
+  uint8_t value[255];
+  int idx = 0;
+  value[idx++] = first;
+  value[idx++] = METRIC_COUNT;
+
+  int room = w.capacity - w.size - 2;
+  if (room > (int)sizeof(value)) room = sizeof(value);
+  int id = first;
+  for (; id < METRIC_COUNT && idx + 4 <= room; id++) {
+    uint32_t v = m.values[id];
+    for (int i = 3; i >= 0; i--) value[idx++] = v >> (8 * i);
+  }
+  if (id == first || !tlvAppend(w, TLV_METRICS, value, idx)) return first;
+  return id;
+}
+
+#endif
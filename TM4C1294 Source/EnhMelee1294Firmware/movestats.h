@@ -0,0 +1,128 @@
+#ifndef _MOVESTATS_H_INCLUDED
+#define _MOVESTATS_H_INCLUDED
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h and udpprotocol.h
+
+//**********************************************************************
+//*                        Per Move Histograms
+//**********************************************************************
+//What each move of a player did over the game, indexed by the lastMoveHitId the console reports for
+//the player who landed it:
+//
+//  hits           hits that put the opponent in a damage or grab state, the hits combo strings count
+//  damage         every percent the opponent took while it was the player's last move, in tenths
+//  openings       strings started by the move, these add up to numberOfOpenings
+//  kills          stocks the opponent lost while it was the player's last move, like StockStatistics.lastHitBy
+//  comboStarters  first move of a string of 2 hits or more
+//  comboEnders    last move of a string of 2 hits or more
+//
+//Strings follow the rules of the combo strings in computeStatistics(), so both see the same openings.
+//moveStatsAdd() runs once per player per frame and only ever touches the bins of the current move.
+//
+//MSG_TYPE_MOVES reads the moves of one player that did anything, for the game in progress or the last one
+//until the next starts. A response holds the moves from the ID asked for on that fit in a datagram, the
+//host asks again from where it stopped. Host Source/MoveReport prints them and checks the histograms
+//against a whole game reference.
+#define MOVE_ID_COUNT 64 //IDs from MOVE_ID_COUNT - 1 up share the last bin
+
+typedef struct {
+  uint16_t hits[MOVE_ID_COUNT];
+  uint32_t damage[MOVE_ID_COUNT];
+  uint16_t openings[MOVE_ID_COUNT];
+  uint16_t kills[MOVE_ID_COUNT];
+  uint16_t comboStarters[MOVE_ID_COUNT];
+  uint16_t comboEnders[MOVE_ID_COUNT];
+
+  //The string in progress
+  uint16_t stringHits;
+  uint8_t stringFirstMove;
+  uint8_t stringLastMove;
+  uint8_t stringResetCounter;
+} MoveStats;
+
+void moveStatsReset(MoveStats& ms) {
+  memset(&ms, 0, sizeof(ms));
+}
+
+uint8_t moveBin(uint8_t moveId) {
+  return moveId < MOVE_ID_COUNT ? moveId : MOVE_ID_COUNT - 1;
+}
+
+//Called for every player every frame, cp is the player the moves belong to and op the opponent
+void moveStatsAdd(MoveStats& ms, const Player& cp, const Player& op, uint32_t frameDelta) {
+  const PlayerFrameData& opNow = currentFrame(op);
+  const PlayerFrameData& opBefore = previousFrame(op);
+  uint8_t move = moveBin(currentFrame(cp).lastMoveHitId);
+
+  //Rounded the way damageDealt is, so the bins add up to it
+  int32_t dealt = lroundf(opNow.percent * 10) - lroundf(opBefore.percent * 10);
+  if (dealt > 0) ms.damage[move] += dealt;
+
+  bool opDamaged = opNow.animation >= DAMAGE_START && opNow.animation <= DAMAGE_END;
+  bool opGrabbed = opNow.animation >= CAPTURE_START && opNow.animation <= CAPTURE_END;
+  bool opTeching = (opNow.animation >= TECH_START && opNow.animation <= TECH_END) ||
+    opNow.animation == TECH_MISS_UP || opNow.animation == TECH_MISS_DOWN;
+
+  if (opNow.percent - opBefore.percent > 0 && (opDamaged || opGrabbed)) {
+    ms.hits[move]++;
+    if (ms.stringHits == 0) {
+      ms.openings[move]++;
+      ms.stringFirstMove = move;
+    }
+    ms.stringHits++;
+    ms.stringLastMove = move;
+  }
+
+  if (opDamaged || opGrabbed || opTeching) ms.stringResetCounter = 0;
+  else if (ms.stringHits > 0) addFrames(ms.stringResetCounter, frameDelta);
+
+  bool opLostStock = opBefore.stocks - opNow.stocks > 0;
+  bool lostStock = previousFrame(cp).stocks - currentFrame(cp).stocks > 0;
+  if (ms.stringHits > 0 && (opLostStock || lostStock || ms.stringResetCounter > COMBO_STRING_TIMEOUT)) {
+    if (ms.stringHits >= 2) {
+      ms.comboStarters[ms.stringFirstMove]++;
+      ms.comboEnders[ms.stringLastMove]++;
+    }
+    ms.stringHits = 0;
+  }
+
+  if (opLostStock) ms.kills[move]++;
+}
+
+void moveStatsPut(uint8_t* a, int& idx, uint32_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) a[idx++] = value >> (8 * i);
+}
+
+//Appends TLV_MOVES_PAGE and a TLV_MOVE for every move from move ID from on that landed, dealt damage or
+//killed, as many as fit, see udpprotocol.h. The page says where to ask from next. Returns false if not
+//even the page fit
+bool moveStatsAppend(TlvWriter& w, const MoveStats& ms, uint8_t player, uint8_t port, uint8_t from) {
+  int pageAt = w.size;
+  uint8_t page[4] = { player, port, from, MOVE_ID_COUNT };
+  if (!tlvAppend(w, TLV_MOVES_PAGE, page, sizeof(page))) return false;
+
+  for (int m = from; m < MOVE_ID_COUNT; m++) {
+    if (ms.hits[m] == 0 && ms.damage[m] == 0 && ms.kills[m] == 0) continue;
+
+    uint8_t value[15];
+    int idx = 0;
+    value[idx++] = m;
+    moveStatsPut(value, idx, ms.hits[m], 2);
+    moveStatsPut(value, idx, ms.damage[m], 4);
+    moveStatsPut(value, idx, ms.openings[m], 2);
+    moveStatsPut(value, idx, ms.kills[m], 2);
+    moveStatsPut(value, idx, ms.comboStarters[m], 2);
+    moveStatsPut(value, idx, ms.comboEnders[m], 2);
+    if (!tlvAppend(w, TLV_MOVE, value, idx)) {
+      w.buffer[pageAt + 2 + 3] = m;
+      break;
+    }
+  }
+  return true;
+}
+
+#endif
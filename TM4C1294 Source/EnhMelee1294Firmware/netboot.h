@@ -0,0 +1,203 @@
+#ifndef _NETBOOT_H_INCLUDED
+#define _NETBOOT_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//**********************************************************************
+//*                             Fast Boot
+//**********************************************************************
+//setup() brings up SSI ingest and the stats engine first, within milliseconds of reset, and only then
+//starts the network. Ethernet.begin() is called without waiting for DHCP, lwIP's DHCP client keeps
+//running from the Ethernet interrupt and the boot background task polls for the address through
+//netBootAdvance(). If none comes within NETBOOT_DHCP_WAIT_MS the board takes the last lease DHCP gave it,
+//kept in EEPROM, or without one a link local address made from its MAC, and stays on it until reset. The
+//fallback stops DHCP and moves the running interface to that address, the interface is never started twice.
+//
+//Until the first connection to the server after boot, every message writeMsg() sends waits in a backlog
+//instead of being dropped, so a game started while the board boots still reaches the server from its
+//first frame. The boot task sends the backlog in chunks, new messages queue behind it until it is empty.
+//A message that finds the backlog full is dropped whole so the stream stays framed. The backlog is given
+//up if the server has not taken a connection NETBOOT_CONNECT_WAIT_MS after the network came up, or if the
+//connection is lost while it drains. What it still held is counted as dropped and writeMsg() goes back to
+//sending directly.
+//
+//How long each step took after reset is kept here, reported with the device metrics and printed once
+//the network is up. Host Source/BootSim plays a reset in the middle of a game against the old boot.
+#define NETBOOT_DHCP_WAIT_MS 10000
+#define NETBOOT_CONNECT_WAIT_MS 5000
+
+//Where the address came from
+#define NETBOOT_WAITING 0
+#define NETBOOT_DHCP 1
+#define NETBOOT_CACHED 2
+#define NETBOOT_LINK_LOCAL 3
+
+//Returned by netBootAdvance()
+#define NETBOOT_KEEP_WAITING 0
+#define NETBOOT_GOT_LEASE 1 //DHCP gave an address, store the lease and start the services
+#define NETBOOT_FALL_BACK 2 //Configure the cached lease or the link local address, then start the services
+#define NETBOOT_UP 3
+
+#define NETBOOT_LEASE_SCHEMA 0x1
+#define NETBOOT_LEASE_WORDS 5 //EEPROM words of a stored lease
+
+#define STREAM_BACKLOG_SIZE 65536 //Power of two, about 8 seconds of updates
+#define STREAM_BACKLOG_CHUNK 1024 //Most bytes one run of the boot task sends
+
+typedef struct {
+  uint8_t ip[4];
+  uint8_t subnet[4];
+  uint8_t gateway[4];
+  uint8_t dns[4];
+} NetLease;
+
+typedef struct {
+  uint8_t source; //NETBOOT_WAITING until the network is up
+  bool hasCachedLease;
+  NetLease cachedLease;
+  uint32_t ingestUs; //micros() once ingest and the stats engine were running, i.e. time since reset
+  uint32_t dhcpStartMs; //millis() when DHCP was started
+  uint32_t upMs; //millis() when the network came up, 0 before
+} NetBoot;
+
+//Called by the boot task until it returns NETBOOT_UP
+int netBootAdvance(NetBoot& nb, uint32_t nowMs, bool hasAddress) {
+  if (nb.source != NETBOOT_WAITING) return NETBOOT_UP;
+
+  if (hasAddress) {
+    nb.source = NETBOOT_DHCP;
+    nb.upMs = nowMs;
+    return NETBOOT_GOT_LEASE;
+  }
+  if (nowMs - nb.dhcpStartMs < NETBOOT_DHCP_WAIT_MS) return NETBOOT_KEEP_WAITING;
+
+  nb.source = nb.hasCachedLease ? NETBOOT_CACHED : NETBOOT_LINK_LOCAL;
+  nb.upMs = nowMs;
+  return NETBOOT_FALL_BACK;
+}
+
+//169.254.x.y from the end of the MAC, clear of the reserved 169.254.0.x and 169.254.255.x
+void netBootLinkLocal(NetLease& lease, const uint8_t* mac) {
+  memset(&lease, 0, sizeof(lease));
+  lease.ip[0] = 169;
+  lease.ip[1] = 254;
+  lease.ip[2] = 1 + mac[4] % 254;
+  lease.ip[3] = mac[5];
+  lease.subnet[0] = 255;
+  lease.subnet[1] = 255;
+}
+
+//The address the fallback configures
+NetLease netBootFallbackLease(const NetBoot& nb, const uint8_t* mac) {
+  NetLease lease;
+  if (nb.source == NETBOOT_CACHED) lease = nb.cachedLease;
+  else netBootLinkLocal(lease, mac);
+  return lease;
+}
+
+//EEPROM block: schema, 3 unused bytes, then ip, subnet, gateway and dns
+void netBootPackLease(const NetLease& lease, uint32_t* words) {
+  uint8_t* bytes = (uint8_t*)words;
+  memset(bytes, 0, NETBOOT_LEASE_WORDS * 4);
+  bytes[0] = NETBOOT_LEASE_SCHEMA;
+  memcpy(bytes + 4, &lease, sizeof(lease));
+}
+
+bool netBootUnpackLease(const uint32_t* words, NetLease& lease) {
+  const uint8_t* bytes = (const uint8_t*)words;
+  if (bytes[0] != NETBOOT_LEASE_SCHEMA) return false;
+  memcpy(&lease, bytes + 4, sizeof(lease));
+  return lease.ip[0] != 0;
+}
+
+//**********************************************************************
+//*                          Stream Backlog
+//**********************************************************************
+typedef struct {
+  uint8_t bytes[STREAM_BACKLOG_SIZE];
+  uint32_t head; //Bytes queued since the reset
+  uint32_t tail; //Bytes sent
+  uint32_t messageStart; //First byte of the oldest message not completely sent
+  uint32_t messages; //Messages not completely sent
+  uint32_t highWater;
+  uint32_t dropped; //Messages that found it full
+  bool active;
+} StreamBacklog;
+
+void backlogReset(StreamBacklog& b, bool active) {
+  b.head = 0;
+  b.tail = 0;
+  b.messageStart = 0;
+  b.messages = 0;
+  b.highWater = 0;
+  b.dropped = 0;
+  b.active = active;
+}
+
+uint32_t backlogPending(const StreamBacklog& b) {
+  return b.head - b.tail;
+}
+
+void backlogPut(StreamBacklog& b, uint8_t value) {
+  b.bytes[b.head++ & (STREAM_BACKLOG_SIZE - 1)] = value;
+}
+
+//Queues a message framed like writeMsg() sends it. Returns false if it was dropped. The header of a message
+//being sent is kept until all of it went, backlogConsume() reads its size from there
+bool backlogAppend(StreamBacklog& b, uint8_t eventCode, const uint8_t* data, int size) {
+  uint32_t realMsgSize = size + 1;
+  if (STREAM_BACKLOG_SIZE - (b.head - b.messageStart) < 4 + realMsgSize) {
+    b.dropped++;
+    return false;
+  }
+
+  backlogPut(b, realMsgSize >> 24 & 0xFF);
+  backlogPut(b, realMsgSize >> 16 & 0xFF);
+  backlogPut(b, realMsgSize >> 8 & 0xFF);
+  backlogPut(b, realMsgSize & 0xFF);
+  backlogPut(b, eventCode);
+  for (int i = 0; i < size; i++) backlogPut(b, data[i]);
+  b.messages++;
+
+  if (backlogPending(b) > b.highWater) b.highWater = backlogPending(b);
+  return true;
+}
+
+//The oldest unsent bytes that are contiguous in the ring, at most STREAM_BACKLOG_CHUNK. Returns the count
+int backlogPeek(const StreamBacklog& b, const uint8_t*& bytes) {
+  uint32_t offset = b.tail & (STREAM_BACKLOG_SIZE - 1);
+  uint32_t count = backlogPending(b);
+  if (count > STREAM_BACKLOG_SIZE - offset) count = STREAM_BACKLOG_SIZE - offset;
+  if (count > STREAM_BACKLOG_CHUNK) count = STREAM_BACKLOG_CHUNK;
+  bytes = b.bytes + offset;
+  return count;
+}
+
+//Marks count bytes as sent and moves past the messages they completed
+void backlogConsume(StreamBacklog& b, uint32_t count) {
+  b.tail += count;
+  while (b.messages > 0) {
+    uint32_t size = 0;
+    for (int i = 0; i < 4; i++) size = size << 8 | b.bytes[(b.messageStart + i) & (STREAM_BACKLOG_SIZE - 1)];
+    if (b.tail - b.messageStart < 4 + size) break;
+    b.messageStart += 4 + size;
+    b.messages--;
+  }
+}
+
+//A server that never takes the first connection would otherwise hold the stream back for good
+bool backlogExpired(const NetBoot& nb, uint32_t nowMs) {
+  return nb.source != NETBOOT_WAITING && nowMs - nb.upMs >= NETBOOT_CONNECT_WAIT_MS;
+}
+
+//Stops queueing, writeMsg() sends directly from here on. Returns the messages that will never be sent,
+//one a lost connection cut short included
+uint32_t backlogAbandon(StreamBacklog& b) {
+  uint32_t lost = b.messages;
+  b.messages = 0;
+  b.active = false;
+  return lost;
+}
+
+#endif
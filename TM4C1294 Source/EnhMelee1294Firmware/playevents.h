@@ -0,0 +1,205 @@
+#ifndef _PLAYEVENTS_H_INCLUDED
+#define _PLAYEVENTS_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h and udpprotocol.h
+
+//**********************************************************************
+//*                          Play Event Stream
+//**********************************************************************
+//computeStatistics() queues a small typed event the moment it detects something: an opening, the end of
+//a combo string, a recovery starting and how it ended, an edgeguard conversion, a lost stock, a roll or
+//a dodge. The end of game summary can be rebuilt from the events alone, so a host following the stream
+//does not have to wait for EVENT_GAME_END (Host Source/PlayEventMonitor does this).
+//
+//Events are encoded when they are queued, a few bytes each:
+//
+//  [0]     kind     one of the PLAY_EVENT_* values below
+//  [1]     port     1 to 4, 0 for the game wide events
+//  [2..5]  frame    big endian, frame counter the event was detected on
+//  [6..]   payload  depends on the kind, multi byte values big endian, floats as their IEEE 754 bits
+//
+//The game start and end events carry the server time they were queued at, microseconds since the Unix
+//epoch from timesync.h, or 0 while the board has not synced with the time server.
+//
+//The queue is a ring of fixed slots. Every queued event takes the next sequence number, and the sender
+//drains the oldest first into MSG_TYPE_PLAY_EVENTS datagrams, one TLV_PLAY_EVENT per event after a
+//TLV_EVENT_STREAM giving the sequence of the first one. A host sees lost datagrams as a gap in the
+//sequence. When the ring is full the new event is dropped and counted instead, that count goes out in
+//every datagram. Nothing is queued while no host is listening.
+//
+//Both ends run from loop(), computeStatistics() after a frame and the sender as a background task, so
+//the queue needs no locking.
+#define PLAY_EVENT_QUEUE_SIZE 128 //Power of two. A busy game queues a few events a second
+#define PLAY_EVENT_MAX_SIZE 16
+#define PLAY_EVENT_HEADER_SIZE 6
+
+#define PLAY_EVENT_GAME_START 1 //u16 stage, u64 server time
+#define PLAY_EVENT_GAME_END 2 //u8 win condition, u64 server time
+#define PLAY_EVENT_OPENING 3 //f32 opponent percent when the string started
+#define PLAY_EVENT_COMBO_END 4 //u16 hits, f32 damage, u32 frames
+#define PLAY_EVENT_RECOVERY_START 5 //No payload
+#define PLAY_EVENT_RECOVERY_END 6 //u8 1 recovered, 0 lost the stock, u8 port of the player who had the edgeguard chance
+#define PLAY_EVENT_EDGEGUARD 7 //No payload, port is the player who converted the edgeguard
+#define PLAY_EVENT_STOCK_LOST 8 //u8 stock, f32 percent, u8 last hit by, u16 last animation, u16 openings
+#define PLAY_EVENT_ROLL 9 //No payload
+#define PLAY_EVENT_SPOT_DODGE 10
+#define PLAY_EVENT_AIR_DODGE 11
+
+typedef struct {
+  uint8_t size;
+  uint8_t bytes[PLAY_EVENT_MAX_SIZE];
+} PlayEventSlot;
+
+typedef struct {
+  PlayEventSlot slots[PLAY_EVENT_QUEUE_SIZE];
+  uint32_t head; //Sequence of the next event queued
+  uint32_t tail; //Sequence of the oldest event not sent yet
+  uint32_t dropped; //Events that found the ring full
+  bool enabled;
+} PlayEventQueue;
+
+void playEventsReset(PlayEventQueue& q, bool enabled) {
+  q.head = 0;
+  q.tail = 0;
+  q.dropped = 0;
+  q.enabled = enabled;
+}
+
+uint32_t playEventsPending(const PlayEventQueue& q) {
+  return q.head - q.tail;
+}
+
+void playEventPut(uint8_t* a, int& idx, uint32_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) a[idx++] = value >> (8 * i);
+}
+
+void playEventPutLong(uint8_t* a, int& idx, uint64_t value) {
+  playEventPut(a, idx, value >> 32, 4);
+  playEventPut(a, idx, value, 4);
+}
+
+void playEventPutFloat(uint8_t* a, int& idx, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  playEventPut(a, idx, bits, 4);
+}
+
+//Starts an event in the next free slot and writes its header. Returns NULL if nothing is queued, the
+//event is then dropped and counted if the ring is full. idx is where the payload goes
+uint8_t* playEventBegin(PlayEventQueue& q, uint8_t kind, uint8_t port, uint32_t frame, int& idx) {
+  if (!q.enabled) return NULL;
+  if (q.head - q.tail == PLAY_EVENT_QUEUE_SIZE) {
+    q.dropped++;
+    return NULL;
+  }
+
+  uint8_t* e = q.slots[q.head & (PLAY_EVENT_QUEUE_SIZE - 1)].bytes;
+  idx = 0;
+  e[idx++] = kind;
+  e[idx++] = port;
+  playEventPut(e, idx, frame, 4);
+  return e;
+}
+
+void playEventCommit(PlayEventQueue& q, int size) {
+  q.slots[q.head & (PLAY_EVENT_QUEUE_SIZE - 1)].size = size;
+  q.head++;
+}
+
+//An event with no payload
+void playEventQueue(PlayEventQueue& q, uint8_t kind, uint8_t port, uint32_t frame) {
+  int idx;
+  if (playEventBegin(q, kind, port, frame, idx) != NULL) playEventCommit(q, idx);
+}
+
+void playEventGameStart(PlayEventQueue& q, uint32_t frame, uint16_t stage, uint64_t serverTime) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_GAME_START, 0, frame, idx);
+  if (e == NULL) return;
+
+  playEventPut(e, idx, stage, 2);
+  playEventPutLong(e, idx, serverTime);
+  playEventCommit(q, idx);
+}
+
+void playEventGameEnd(PlayEventQueue& q, uint32_t frame, uint8_t winCondition, uint64_t serverTime) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_GAME_END, 0, frame, idx);
+  if (e == NULL) return;
+
+  e[idx++] = winCondition;
+  playEventPutLong(e, idx, serverTime);
+  playEventCommit(q, idx);
+}
+
+void playEventOpening(PlayEventQueue& q, uint8_t port, uint32_t frame, float opponentPercent) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_OPENING, port, frame, idx);
+  if (e == NULL) return;
+
+  playEventPutFloat(e, idx, opponentPercent);
+  playEventCommit(q, idx);
+}
+
+void playEventComboEnd(PlayEventQueue& q, uint8_t port, uint32_t frame, uint16_t hits, float damage, uint32_t frames) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_COMBO_END, port, frame, idx);
+  if (e == NULL) return;
+
+  playEventPut(e, idx, hits, 2);
+  playEventPutFloat(e, idx, damage);
+  playEventPut(e, idx, frames, 4);
+  playEventCommit(q, idx);
+}
+
+void playEventRecoveryEnd(PlayEventQueue& q, uint8_t port, uint32_t frame, bool recovered, uint8_t opponentPort) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_RECOVERY_END, port, frame, idx);
+  if (e == NULL) return;
+
+  e[idx++] = recovered ? 1 : 0;
+  e[idx++] = opponentPort;
+  playEventCommit(q, idx);
+}
+
+void playEventStockLost(PlayEventQueue& q, uint8_t port, uint32_t frame, uint8_t stock, const StockStatistics& ss) {
+  int idx;
+  uint8_t* e = playEventBegin(q, PLAY_EVENT_STOCK_LOST, port, frame, idx);
+  if (e == NULL) return;
+
+  e[idx++] = stock;
+  playEventPutFloat(e, idx, ss.percent);
+  e[idx++] = ss.lastHitBy;
+  playEventPut(e, idx, ss.lastAnimation, 2);
+  playEventPut(e, idx, ss.killedInOpenings, 2);
+  playEventCommit(q, idx);
+}
+
+//Appends the stream header and as many of the oldest events as fit, then forgets them. Returns the
+//number of events appended, 0 leaves the writer as it was
+int playEventsAppend(TlvWriter& w, PlayEventQueue& q) {
+  if (q.head == q.tail) return 0;
+
+  int start = w.size;
+  uint8_t stream[8];
+  int idx = 0;
+  playEventPut(stream, idx, q.tail, 4);
+  playEventPut(stream, idx, q.dropped, 4);
+  if (!tlvAppend(w, TLV_EVENT_STREAM, stream, idx)) return 0;
+
+  int count = 0;
+  while (q.head != q.tail) {
+    const PlayEventSlot& slot = q.slots[q.tail & (PLAY_EVENT_QUEUE_SIZE - 1)];
+    if (!tlvAppend(w, TLV_PLAY_EVENT, slot.bytes, slot.size)) break;
+    q.tail++;
+    count++;
+  }
+
+  if (count == 0) w.size = start;
+  return count;
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _SCHEDULER_H_INCLUDED
+#define _SCHEDULER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//**********************************************************************
+//*                        Cooperative Scheduler
+//**********************************************************************
+//Frames always come first: loop() handles every message the CS interrupt has queued before it asks the
+//scheduler for anything else, and then the scheduler runs at most one background task.
+//
+//Background tasks are the network upkeep, UDP configuration, time sync and pushes. Each has a period, a
+//time budget and a deadline relative to when it became due. Of the tasks that are due the one with the
+//earliest deadline runs, but only if its budget fits in the slack before the next frame is expected,
+//so a task started mid-game finishes before the console sends again. Between games, or when frames
+//stop during a pause, there is no frame to protect and every due task may run.
+//
+//The tasks are cooperative and cannot be stopped, so the budget only decides when a task may start.
+//Overruns and missed deadlines are counted per task for the report. Time comes from the clock function
+//in cycles, the board passes the cycle counter and the host simulation (Host Source/SchedulerSim) a
+//simulated one, so both run this exact code.
+#define SCHED_MAX_TASKS 8
+#define SCHED_FRAME_US 16683 //60.0988 fps
+#define SCHED_FRAME_GUARD_US 1000 //Slack left free ahead of the next expected frame
+#define SCHED_FRAMES_STOPPED 3 //Frames without a message before the game counts as paused
+
+typedef uint32_t (*SchedClock)();
+typedef void (*SchedTaskFunction)();
+
+typedef struct {
+  const char* name;
+  SchedTaskFunction run;
+  uint32_t periodUs; //0 runs on every pass that has the time
+  uint32_t budgetUs; //Longest the task is expected to run
+  uint32_t deadlineUs; //Latest the task should start after it became due
+  uint32_t due; //Cycle count the task is next due at
+  bool deferred; //Held back since it became due, counted once
+
+  //Accounting
+  uint32_t runs;
+  uint32_t overruns; //Runs longer than budgetUs
+  uint32_t deadlineMisses; //Runs started more than deadlineUs late
+  uint32_t deferrals; //Times it became due and had to wait for a frame to be handled first
+  uint32_t maxRunUs;
+  uint32_t maxLatenessUs;
+} SchedTask;
+
+typedef struct {
+  SchedClock clock;
+  uint32_t cyclesPerMicrosecond;
+  SchedTask tasks[SCHED_MAX_TASKS];
+  int taskCount;
+
+  bool framesExpected; //Frames are arriving, cleared at game end or once they stop
+  uint32_t lastFrame; //Cycle count the last frame arrived at
+} Scheduler;
+
+void schedulerInit(Scheduler& s, SchedClock clock, uint32_t cyclesPerMicrosecond) {
+  memset(&s, 0, sizeof(s));
+  s.clock = clock;
+  s.cyclesPerMicrosecond = cyclesPerMicrosecond;
+}
+
+//Returns the index of the task, or -1 if there is no room. The task is due right away
+int schedulerAddTask(Scheduler& s, const char* name, SchedTaskFunction run, uint32_t periodUs, uint32_t budgetUs,
+  uint32_t deadlineUs) {
+  if (s.taskCount == SCHED_MAX_TASKS) return -1;
+
+  SchedTask& t = s.tasks[s.taskCount];
+  memset(&t, 0, sizeof(t));
+  t.name = name;
+  t.run = run;
+  t.periodUs = periodUs;
+  t.budgetUs = budgetUs;
+  t.deadlineUs = deadlineUs;
+  t.due = s.clock();
+  return s.taskCount++;
+}
+
+//Called for every frame with the cycle count it arrived at
+void schedulerFrame(Scheduler& s, uint32_t arrival) {
+  s.framesExpected = true;
+  s.lastFrame = arrival;
+}
+
+void schedulerGameEnd(Scheduler& s) {
+  s.framesExpected = false;
+}
+
+//Microseconds a task may run before the next frame is expected, 0xFFFFFFFF when no frame is expected.
+//Frames that have stopped clear framesExpected until the next one arrives. A game that ends without a
+//game end would otherwise keep it set, and once the cycle counter wraps past lastFrame the elapsed time
+//looks short again and tasks are deferred for a frame that never comes
+uint32_t schedulerSlackUs(Scheduler& s, uint32_t now) {
+  if (!s.framesExpected) return 0xFFFFFFFF;
+
+  uint32_t elapsed = (now - s.lastFrame) / s.cyclesPerMicrosecond;
+  if (elapsed > SCHED_FRAMES_STOPPED * SCHED_FRAME_US) {
+    s.framesExpected = false;
+    return 0xFFFFFFFF;
+  }
+
+  uint32_t window = SCHED_FRAME_US - SCHED_FRAME_GUARD_US;
+  return elapsed < window ? window - elapsed : 0;
+}
+
+//Runs the due task with the earliest deadline that fits before the next frame. Returns the index of
+//the task that ran, or -1 if none did
+int schedulerRunNext(Scheduler& s) {
+  uint32_t now = s.clock();
+  uint32_t slack = schedulerSlackUs(s, now);
+
+  int next = -1;
+  int32_t nextDeadline = 0;
+  for (int i = 0; i < s.taskCount; i++) {
+    SchedTask& t = s.tasks[i];
+    if ((int32_t)(now - t.due) < 0) continue;
+
+    if (t.budgetUs > slack) {
+      if (!t.deferred) t.deferrals++;
+      t.deferred = true;
+      continue;
+    }
+
+    //Relative to now so the comparison survives the cycle counter wrapping
+    int32_t deadline = (int32_t)(t.due + t.deadlineUs * s.cyclesPerMicrosecond - now);
+    if (next < 0 || deadline < nextDeadline) {
+      next = i;
+      nextDeadline = deadline;
+    }
+  }
+  if (next < 0) return -1;
+
+  SchedTask& t = s.tasks[next];
+  t.deferred = false;
+  uint32_t lateness = (now - t.due) / s.cyclesPerMicrosecond;
+
+  t.run();
+
+  uint32_t end = s.clock();
+  uint32_t runUs = (end - now) / s.cyclesPerMicrosecond;
+  t.runs++;
+  if (runUs > t.budgetUs) t.overruns++;
+  if (lateness > t.deadlineUs) t.deadlineMisses++;
+  if (runUs > t.maxRunUs) t.maxRunUs = runUs;
+  if (lateness > t.maxLatenessUs) t.maxLatenessUs = lateness;
+
+  //A task that fell more than a period behind starts over from now instead of running back to back
+  uint32_t period = t.periodUs * s.cyclesPerMicrosecond;
+  t.due += period;
+  if ((int32_t)(end - t.due) >= 0) t.due = end + period;
+
+  return next;
+}
+
+//Microseconds until schedulerRunNext() could run a task, if no frame arrives first. A task that is due
+//but does not fit has to wait for a frame, or for frames to stop long enough to count as a pause. Used
+//to set the wake timer before the core sleeps, see idle.h
+uint32_t schedulerSleepUs(Scheduler& s, uint32_t now) {
+  uint32_t slack = schedulerSlackUs(s, now);
+  uint32_t sleep = 0xFFFFFFFF;
+
+  for (int i = 0; i < s.taskCount; i++) {
+    const SchedTask& t = s.tasks[i];
+    uint32_t wait;
+    if ((int32_t)(now - t.due) < 0) {
+      wait = (t.due - now) / s.cyclesPerMicrosecond;
+    } else if (t.budgetUs <= slack) {
+      return 0;
+    } else {
+      uint32_t elapsed = (now - s.lastFrame) / s.cyclesPerMicrosecond;
+      uint32_t paused = SCHED_FRAMES_STOPPED * SCHED_FRAME_US + 1;
+      wait = elapsed < paused ? paused - elapsed : 0;
+    }
+    if (wait < sleep) sleep = wait;
+  }
+
+  return sleep;
+}
+
+//One line per task, printed with the latency report
+int schedulerFormatReport(char* out, int size, const Scheduler& s) {
+  int length = 0;
+  for (int i = 0; i < s.taskCount && length < size; i++) {
+    const SchedTask& t = s.tasks[i];
+    length += snprintf(out + length, size - length, "%-9s runs=%lu max=%luus/%luus overruns=%lu late=%luus misses=%lu deferred=%lu\n",
+      t.name, (unsigned long)t.runs, (unsigned long)t.maxRunUs, (unsigned long)t.budgetUs, (unsigned long)t.overruns,
+      (unsigned long)t.maxLatenessUs, (unsigned long)t.deadlineMisses, (unsigned long)t.deferrals);
+  }
+
+  return length < size ? length : size - 1;
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _STATSERIES_H_INCLUDED
+#define _STATSERIES_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//Include after enhmelee.h and udpprotocol.h
+
+//**********************************************************************
+//*                         Stat Time Series
+//**********************************************************************
+//The counters in PlayerStatistics are whole game totals. For momentum graphs (APM over time, damage per
+//10 seconds, openings per minute) every counter is also split into buckets of bucketFrames frames.
+//
+//The counting sites are left alone. After computeStatistics() has updated the totals, seriesAdd() adds
+//how much each counter moved since the last frame to the bucket of the current frame. That is the same
+//subtract and add for every counter every frame, with no branch on which counters moved. The first
+//frame of a bucket clears it through a mask instead of a branch as well.
+//
+//Buckets are kept in a ring of SERIES_BUCKETS. At the default 10 seconds that covers more than 10
+//minutes, so a whole game stays available until the next one starts. Longer games keep the latest
+//SERIES_BUCKETS. A gap of missed frames longer than a bucket clears the buckets it skipped, so they read
+//as empty rather than as what the ring held a lap earlier.
+//
+//MSG_TYPE_STAT_SERIES returns one channel of one player as a packed array of big endian u16 counts,
+//oldest bucket first. Host Source/SeriesMonitor reads them.
+#define SERIES_BUCKETS 64 //Power of two
+#define SERIES_DEFAULT_BUCKET_FRAMES 600
+#define SERIES_MIN_BUCKET_FRAMES 60
+#define SERIES_MAX_BUCKET_FRAMES 3600 //Keeps every bucket of every counter within a u16
+
+//Channels, the 32 bit counters first
+#define SERIES_FRAMES_ABOVE_OTHERS 0
+#define SERIES_FRAMES_CLOSEST_CENTER 1
+#define SERIES_FRAMES_IN_SHIELD 2
+#define SERIES_DAMAGE_DEALT 3 //Tenths of a percent
+#define SERIES_ACTIONS 4
+#define SERIES_OPENINGS 5
+#define SERIES_ROLLS 6
+#define SERIES_SPOT_DODGES 7
+#define SERIES_AIR_DODGES 8
+#define SERIES_TECH_MISSES 9
+#define SERIES_TECH_LEFT 10
+#define SERIES_TECH_RIGHT 11
+#define SERIES_TECH_PLACE 12
+#define SERIES_WAVEDASHES 13
+#define SERIES_L_CANCELS 14
+#define SERIES_L_CANCEL_MISSES 15
+#define SERIES_LEDGEDASHES 16
+#define SERIES_SHIELD_DROPS 17
+#define SERIES_RECOVERY_ATTEMPTS 18
+#define SERIES_SUCCESSFUL_RECOVERIES 19
+#define SERIES_EDGEGUARD_CHANCES 20
+#define SERIES_EDGEGUARD_CONVERSIONS 21
+#define SERIES_CHANNELS 22
+
+static const uint16_t seriesWordOffsets[] = {
+  offsetof(PlayerStatistics, framesAboveOthers),
+  offsetof(PlayerStatistics, framesClosestCenter),
+  offsetof(PlayerStatistics, framesInShield),
+  offsetof(PlayerStatistics, damageDealt),
+};
+#define SERIES_WORD_CHANNELS (int)(sizeof(seriesWordOffsets) / sizeof(seriesWordOffsets[0]))
+
+static const uint16_t seriesHalfOffsets[] = {
+  offsetof(PlayerStatistics, actionCount),
+  offsetof(PlayerStatistics, numberOfOpenings),
+  offsetof(PlayerStatistics, rollCount),
+  offsetof(PlayerStatistics, spotDodgeCount),
+  offsetof(PlayerStatistics, airDodgeCount),
+  offsetof(PlayerStatistics, techMissCount),
+  offsetof(PlayerStatistics, techLeftCount),
+  offsetof(PlayerStatistics, techRightCount),
+  offsetof(PlayerStatistics, techPlaceCount),
+  offsetof(PlayerStatistics, wavedashCount),
+  offsetof(PlayerStatistics, lCancelCount),
+  offsetof(PlayerStatistics, lCancelMissCount),
+  offsetof(PlayerStatistics, ledgedashCount),
+  offsetof(PlayerStatistics, shieldDropCount),
+  offsetof(PlayerStatistics, recoveryAttempts),
+  offsetof(PlayerStatistics, successfulRecoveries),
+  offsetof(PlayerStatistics, edgeguardChances),
+  offsetof(PlayerStatistics, edgeguardConversions),
+};
+
+typedef char SeriesChannelsMatchOffsets[SERIES_WORD_CHANNELS + sizeof(seriesHalfOffsets) / sizeof(seriesHalfOffsets[0]) ==
+  SERIES_CHANNELS ? 1 : -1];
+
+typedef struct {
+  uint16_t buckets[PLAYER_COUNT][SERIES_BUCKETS][SERIES_CHANNELS];
+  uint32_t last[PLAYER_COUNT][SERIES_CHANNELS]; //Totals as of the previous frame
+  uint32_t bucket; //Bucket of the latest frame, counted from the start of the game
+  uint16_t bucketFrames;
+  uint16_t nextBucketFrames; //Set between games, takes effect at the next reset
+} StatSeries;
+
+//Called at game start, the statistics are all zero then
+void seriesReset(StatSeries& s) {
+  memset(s.buckets, 0, sizeof(s.buckets));
+  memset(s.last, 0, sizeof(s.last));
+  s.bucket = 0;
+  s.bucketFrames = s.nextBucketFrames;
+}
+
+void seriesInitialize(StatSeries& s) {
+  s.nextBucketFrames = SERIES_DEFAULT_BUCKET_FRAMES;
+  seriesReset(s);
+}
+
+//Returns false if the length is out of range
+bool seriesSetBucketFrames(StatSeries& s, uint16_t frames) {
+  if (frames < SERIES_MIN_BUCKET_FRAMES || frames > SERIES_MAX_BUCKET_FRAMES) return false;
+  s.nextBucketFrames = frames;
+  return true;
+}
+
+//Called after the statistics of a frame are computed. The frame counter starts at 1
+void seriesAdd(StatSeries& s, const Player* players, uint32_t frame) {
+  uint32_t bucket = (frame - 1) / s.bucketFrames;
+  uint16_t keep = -(uint16_t)(bucket == s.bucket); //0 on the first frame of a bucket
+
+  //Only a bucket change can skip buckets, every other frame stays without a branch
+  if (bucket - s.bucket > 1) {
+    uint32_t skipped = bucket - s.bucket - 1;
+    if (skipped > SERIES_BUCKETS) skipped = SERIES_BUCKETS;
+    for (int i = 0; i < PLAYER_COUNT; i++) {
+      for (uint32_t b = 1; b <= skipped; b++) {
+        memset(s.buckets[i][(s.bucket + b) & (SERIES_BUCKETS - 1)], 0, sizeof(s.buckets[i][0]));
+      }
+    }
+  }
+  s.bucket = bucket;
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const uint8_t* stats = (const uint8_t*)&players[i].stats;
+    uint16_t* cells = s.buckets[i][bucket & (SERIES_BUCKETS - 1)];
+    uint32_t* last = s.last[i];
+
+    for (int c = 0; c < SERIES_WORD_CHANNELS; c++) {
+      uint32_t total = *(const uint32_t*)(stats + seriesWordOffsets[c]);
+      cells[c] = (cells[c] & keep) + (total - last[c]);
+      last[c] = total;
+    }
+    for (int c = SERIES_WORD_CHANNELS; c < SERIES_CHANNELS; c++) {
+      uint32_t total = *(const uint16_t*)(stats + seriesHalfOffsets[c - SERIES_WORD_CHANNELS]);
+      cells[c] = (cells[c] & keep) + (total - last[c]);
+      last[c] = total;
+    }
+  }
+}
+
+//Oldest bucket still in the ring
+uint32_t seriesFirstBucket(const StatSeries& s) {
+  return s.bucket >= SERIES_BUCKETS ? s.bucket - SERIES_BUCKETS + 1 : 0;
+}
+
+//Packs the buckets of one channel from bucket from on, as many as fit in capacity. Returns the count
+int seriesPack(const StatSeries& s, int player, int channel, uint32_t from, uint8_t* out, int capacity) {
+  uint32_t first = seriesFirstBucket(s);
+  if (from < first) from = first;
+
+  int count = 0;
+  for (uint32_t b = from; b <= s.bucket && 2 * (count + 1) <= capacity; b++, count++) {
+    uint16_t value = s.buckets[player][b & (SERIES_BUCKETS - 1)][channel];
+    out[2 * count] = value >> 8;
+    out[2 * count + 1] = value & 0xFF;
+  }
+  return count;
+}
+
+//Appends TLV_SERIES_INFO and one TLV_SERIES_DATA with as many buckets as fit, see udpprotocol.h.
+//Returns false if not even one bucket fit
+bool seriesAppend(TlvWriter& w, const StatSeries& s, int player, uint8_t port, uint8_t channel, uint32_t from) {
+  uint8_t value[255];
+  int idx = 0;
+  value[idx++] = s.bucketFrames >> 8;
+  value[idx++] = s.bucketFrames;
+  for (int i = 3; i >= 0; i--) value[idx++] = s.bucket >> (8 * i);
+  uint32_t first = seriesFirstBucket(s);
+  for (int i = 3; i >= 0; i--) value[idx++] = first >> (8 * i);
+  if (!tlvAppend(w, TLV_SERIES_INFO, value, idx)) return false;
+
+  if (from < first) from = first;
+  idx = 0;
+  value[idx++] = port;
+  value[idx++] = channel;
+  for (int i = 3; i >= 0; i--) value[idx++] = from >> (8 * i);
+  int room = w.capacity - w.size - 2 - idx;
+  if (room > (int)sizeof(value) - idx) room = sizeof(value) - idx;
+  if (room < 2) return false;
+  idx += 2 * seriesPack(s, player, channel, from, value + idx, room);
+  return tlvAppend(w, TLV_SERIES_DATA, value, idx);
+}
+
+#endif
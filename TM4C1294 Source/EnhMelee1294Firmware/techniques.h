@@ -0,0 +1,294 @@
+#ifndef _TECHNIQUES_H_INCLUDED
+#define _TECHNIQUES_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//Include after enhmelee.h
+
+//**********************************************************************
+//*                        Technique Detection
+//**********************************************************************
+//Techs, wavedashes, L-cancels, ledgedashes and shield drops are each a small state machine. Every frame
+//of a player is reduced to a symbol: the category of its animation (TECH_CAT_* below) and whether a
+//shield button was pressed on that frame. A machine is a list of rows, each of which moves it from one
+//state to the next on a set of categories, optionally counting something. State 0 is idle.
+//
+//  - The first row that matches the state and symbol is taken. A row to the same state keeps the frames
+//    already spent in it unless it has TECH_ROW_RESTART
+//  - When no row matches the machine goes back to state 0 and that frame is tried again from there
+//  - Each state has a window. Staying longer than that many frames moves the machine to the timeout state
+//    of the state instead. Frames count with frameDelta, so missed updates do not stretch a window
+//
+//techCompile() turns the rows into a dense table indexed by machine, state and symbol, and the category
+//of every animation into a lookup, once at startup. techAdvance() then only does a lookup per machine
+//for every frame, whatever the rows say. Adding a technique is adding rows and a machine here.
+//Host Source/TechniqueBenchmark checks the machines on recorded frame sequences and times them.
+#define TECH_ANIMATION_COUNT 0x180 //Common animations, character specific ones above this are TECH_CAT_OTHER
+#define TECH_MAX_STATES 4
+#define TECH_MACHINE_COUNT 5
+
+#define TECH_CAT_OTHER 0
+#define TECH_CAT_GROUNDED 1 //Standing, walking, dashing, running and crouching
+#define TECH_CAT_JUMPSQUAT 2
+#define TECH_CAT_AIRBORNE 3 //Jumping, falling, jumping from the ledge
+#define TECH_CAT_AIR_DODGE 4
+#define TECH_CAT_SPECIAL_LANDING 5 //Landing out of an air dodge
+#define TECH_CAT_AERIAL 6
+#define TECH_CAT_AERIAL_LANDING 7
+#define TECH_CAT_SHIELD 8
+#define TECH_CAT_PLATFORM_DROP 9
+#define TECH_CAT_LEDGE 10
+#define TECH_CAT_TECH_IN_PLACE 11
+#define TECH_CAT_TECH_ROLL 12
+#define TECH_CAT_TECH_MISS 13
+#define TECH_CATEGORY_COUNT 14
+#define TECH_SYMBOL_COUNT (TECH_CATEGORY_COUNT * 2) //Category times 2, plus 1 if a shield button was pressed
+
+#define TECH_ANY 0xFFFFFFFF //Every category
+#define TECH_IN(category) (1UL << (category))
+
+#define TECH_PRESS_ANY 0
+#define TECH_PRESS_YES 1
+#define TECH_PRESS_NO 2
+
+#define TECH_ROW_RESTART 0x01 //Start the window over even if the state does not change
+#define TECH_ROW_ANCHOR 0x02 //Remember where the player is
+#define TECH_ROW_DIRECTIONAL 0x04 //Count counter + 1 instead if the player is right of the anchor
+
+//What a row counts, in the order of techCounterOffsets. A directional row counts the left counter or
+//the right one that follows it
+#define TECH_COUNT_NONE 0
+#define TECH_COUNT_MISS 1
+#define TECH_COUNT_LEFT 2
+#define TECH_COUNT_RIGHT 3
+#define TECH_COUNT_PLACE 4
+#define TECH_COUNT_WAVEDASH 5
+#define TECH_COUNT_LCANCEL 6
+#define TECH_COUNT_LCANCEL_MISS 7
+#define TECH_COUNT_LEDGEDASH 8
+#define TECH_COUNT_SHIELD_DROP 9
+
+static const uint16_t techCounterOffsets[] = {
+  0,
+  offsetof(PlayerStatistics, techMissCount),
+  offsetof(PlayerStatistics, techLeftCount),
+  offsetof(PlayerStatistics, techRightCount),
+  offsetof(PlayerStatistics, techPlaceCount),
+  offsetof(PlayerStatistics, wavedashCount),
+  offsetof(PlayerStatistics, lCancelCount),
+  offsetof(PlayerStatistics, lCancelMissCount),
+  offsetof(PlayerStatistics, ledgedashCount),
+  offsetof(PlayerStatistics, shieldDropCount),
+};
+
+//**********************************************************************
+//*                             Definitions
+//**********************************************************************
+typedef struct {
+  uint16_t start;
+  uint16_t end;
+  uint8_t category;
+} TechCategoryRange;
+
+static const TechCategoryRange techCategoryRanges[] = {
+  { GROUNDED_CONTROL_START, ACTION_KNEE_BEND - 1, TECH_CAT_GROUNDED },
+  { ACTION_KNEE_BEND, ACTION_KNEE_BEND, TECH_CAT_JUMPSQUAT },
+  { ACTION_JUMP_START, ACTION_FALL_END, TECH_CAT_AIRBORNE },
+  { AIR_DODGE, AIR_DODGE, TECH_CAT_AIR_DODGE },
+  { ACTION_LANDING_FALL_SPECIAL, ACTION_LANDING_FALL_SPECIAL, TECH_CAT_SPECIAL_LANDING },
+  { AERIAL_START, AERIAL_END, TECH_CAT_AERIAL },
+  { AERIAL_LANDING_START, AERIAL_LANDING_END, TECH_CAT_AERIAL_LANDING },
+  { GUARD_START, GUARD_END, TECH_CAT_SHIELD },
+  { TECH_MISS_UP, TECH_MISS_UP, TECH_CAT_TECH_MISS },
+  { TECH_MISS_DOWN, TECH_MISS_DOWN, TECH_CAT_TECH_MISS },
+  { TECH_IN_PLACE, TECH_IN_PLACE, TECH_CAT_TECH_IN_PLACE },
+  { TECH_ROLL_FORWARD, TECH_ROLL_BACKWARD, TECH_CAT_TECH_ROLL },
+  { ACTION_PLATFORM_DROP, ACTION_PLATFORM_DROP, TECH_CAT_PLATFORM_DROP },
+  { LEDGE_START, LEDGE_END, TECH_CAT_LEDGE },
+  { LEDGE_JUMP_START, LEDGE_JUMP_END, TECH_CAT_AIRBORNE },
+};
+
+typedef struct {
+  uint8_t state;
+  uint32_t categories; //TECH_IN() of every category the row matches
+  uint8_t press; //TECH_PRESS_*
+  uint8_t next;
+  uint8_t flags; //TECH_ROW_*
+  uint8_t counter; //TECH_COUNT_*
+} TechRow;
+
+typedef struct {
+  const char* name;
+  const TechRow* rows;
+  int rowCount;
+  uint8_t windows[TECH_MAX_STATES]; //Frames each state may last, 0 for as long as its rows allow
+  uint8_t timeouts[TECH_MAX_STATES]; //State a machine goes to when the window runs out
+} TechMachine;
+
+//A jump, an air dodge within a few frames of leaving the ground and the landing out of it. An air dodge
+//into the ground without a jump is a waveland and is not counted
+static const TechRow wavedashRows[] = {
+  { 0, TECH_IN(TECH_CAT_JUMPSQUAT), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_JUMPSQUAT), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AIRBORNE), TECH_PRESS_ANY, 2, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AIR_DODGE), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AIRBORNE), TECH_PRESS_ANY, 2, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AIR_DODGE), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+  { 3, TECH_IN(TECH_CAT_AIR_DODGE), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+  { 3, TECH_IN(TECH_CAT_SPECIAL_LANDING), TECH_PRESS_ANY, 0, 0, TECH_COUNT_WAVEDASH },
+};
+
+//L, R or Z pressed at most 6 frames before an aerial lands. Every aerial that lands in landing lag is
+//either an L-cancel or a miss, an aerial that ends before landing is neither
+static const TechRow lCancelRows[] = {
+  { 0, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_YES, 2, 0, TECH_COUNT_NONE },
+  { 0, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_NO, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_YES, 2, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_NO, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AERIAL_LANDING), TECH_PRESS_ANY, 0, 0, TECH_COUNT_LCANCEL_MISS },
+  { 2, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_YES, 2, TECH_ROW_RESTART, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AERIAL), TECH_PRESS_NO, 2, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AERIAL_LANDING), TECH_PRESS_ANY, 0, 0, TECH_COUNT_LCANCEL },
+};
+
+//Letting go of the ledge, a jump or fall, then an air dodge back onto the stage
+static const TechRow ledgedashRows[] = {
+  { 0, TECH_IN(TECH_CAT_LEDGE), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_LEDGE), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_AIRBORNE), TECH_PRESS_ANY, 2, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AIRBORNE), TECH_PRESS_ANY, 2, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_AIR_DODGE), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+  { 3, TECH_IN(TECH_CAT_AIR_DODGE), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+  { 3, TECH_IN(TECH_CAT_SPECIAL_LANDING), TECH_PRESS_ANY, 0, 0, TECH_COUNT_LEDGEDASH },
+};
+
+//Dropping through a platform straight out of shield
+static const TechRow shieldDropRows[] = {
+  { 0, TECH_IN(TECH_CAT_SHIELD), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_SHIELD), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 1, TECH_IN(TECH_CAT_PLATFORM_DROP), TECH_PRESS_ANY, 0, 0, TECH_COUNT_SHIELD_DROP },
+};
+
+//Each tech counted once when it starts. Which way a roll went is only known once it is over, from where
+//the player ended up
+static const TechRow techRows[] = {
+  { 0, TECH_IN(TECH_CAT_TECH_IN_PLACE), TECH_PRESS_ANY, 1, 0, TECH_COUNT_PLACE },
+  { 0, TECH_IN(TECH_CAT_TECH_ROLL), TECH_PRESS_ANY, 2, TECH_ROW_ANCHOR, TECH_COUNT_NONE },
+  { 0, TECH_IN(TECH_CAT_TECH_MISS), TECH_PRESS_ANY, 3, 0, TECH_COUNT_MISS },
+  { 1, TECH_IN(TECH_CAT_TECH_IN_PLACE), TECH_PRESS_ANY, 1, 0, TECH_COUNT_NONE },
+  { 2, TECH_IN(TECH_CAT_TECH_ROLL), TECH_PRESS_ANY, 2, 0, TECH_COUNT_NONE },
+  { 2, TECH_ANY & ~TECH_IN(TECH_CAT_TECH_ROLL), TECH_PRESS_ANY, 0, TECH_ROW_DIRECTIONAL, TECH_COUNT_LEFT },
+  { 3, TECH_IN(TECH_CAT_TECH_MISS), TECH_PRESS_ANY, 3, 0, TECH_COUNT_NONE },
+};
+
+#define TECH_ROWS(rows) rows, (int)(sizeof(rows) / sizeof(rows[0]))
+
+static const TechMachine techMachines[TECH_MACHINE_COUNT] = {
+  //                         Windows          Timeouts
+  { "wavedash", TECH_ROWS(wavedashRows), { 0, 10, 4, 10 }, { 0, 0, 0, 0 } },
+  { "lcancel", TECH_ROWS(lCancelRows), { 0, 0, 6, 0 }, { 0, 0, 1, 0 } },
+  { "ledgedash", TECH_ROWS(ledgedashRows), { 0, 0, 30, 10 }, { 0, 0, 0, 0 } },
+  { "shielddrop", TECH_ROWS(shieldDropRows), { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+  { "tech", TECH_ROWS(techRows), { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+};
+
+//**********************************************************************
+//*                              Engine
+//**********************************************************************
+typedef struct {
+  uint8_t next;
+  uint8_t flags;
+  uint8_t counter;
+} TechStep;
+
+typedef struct {
+  uint8_t categories[TECH_ANIMATION_COUNT];
+  TechStep steps[TECH_MACHINE_COUNT][TECH_MAX_STATES][TECH_SYMBOL_COUNT];
+} TechTables;
+
+//Where every machine is for one player, cleared at game start
+typedef struct {
+  uint8_t state[TECH_MACHINE_COUNT];
+  uint16_t frames[TECH_MACHINE_COUNT]; //Spent in the current state
+  float anchorX[TECH_MACHINE_COUNT];
+} TechTracker;
+
+//First row of the machine that matches, NULL if none does
+const TechRow* techMatch(const TechMachine& m, int state, int category, bool pressed) {
+  for (int r = 0; r < m.rowCount; r++) {
+    const TechRow& row = m.rows[r];
+    if (row.state != state || (row.categories & TECH_IN(category)) == 0) continue;
+    if ((row.press == TECH_PRESS_YES && !pressed) || (row.press == TECH_PRESS_NO && pressed)) continue;
+    return &row;
+  }
+  return NULL;
+}
+
+void techCompile(TechTables& t) {
+  memset(t.categories, TECH_CAT_OTHER, sizeof(t.categories));
+  for (unsigned int i = 0; i < sizeof(techCategoryRanges) / sizeof(techCategoryRanges[0]); i++) {
+    const TechCategoryRange& range = techCategoryRanges[i];
+    for (int a = range.start; a <= range.end && a < TECH_ANIMATION_COUNT; a++) t.categories[a] = range.category;
+  }
+
+  for (int m = 0; m < TECH_MACHINE_COUNT; m++) {
+    for (int s = 0; s < TECH_MAX_STATES; s++) {
+      for (int symbol = 0; symbol < TECH_SYMBOL_COUNT; symbol++) {
+        int category = symbol >> 1;
+        bool pressed = symbol & 1;
+        const TechRow* row = techMatch(techMachines[m], s, category, pressed);
+        if (row == NULL && s != 0) row = techMatch(techMachines[m], 0, category, pressed);
+
+        TechStep& step = t.steps[m][s][symbol];
+        step.next = row != NULL ? row->next : 0;
+        step.flags = row != NULL ? row->flags : 0;
+        step.counter = row != NULL ? row->counter : TECH_COUNT_NONE;
+      }
+    }
+  }
+}
+
+void techResetTracker(TechTracker& tr) {
+  memset(&tr, 0, sizeof(tr));
+}
+
+//L, R or Z went down on this frame, or an analog trigger crossed the same threshold the APM count uses
+bool techShieldPressed(const PlayerFrameData& current, const PlayerFrameData& previous) {
+  uint16_t pressed = ~previous.physicalButtons & current.physicalButtons;
+  return (pressed & 0x70) != 0 || (previous.lTrigger < 0.3 && current.lTrigger >= 0.3) ||
+    (previous.rTrigger < 0.3 && current.rTrigger >= 0.3);
+}
+
+//Called once per player per update, after the update is decoded
+void techAdvance(const TechTables& t, TechTracker& tr, const Player& p, PlayerStatistics& stats, uint32_t frameDelta) {
+  const PlayerFrameData& current = currentFrame(p);
+  uint8_t category = current.animation < TECH_ANIMATION_COUNT ? t.categories[current.animation] : TECH_CAT_OTHER;
+  int symbol = category * 2 + techShieldPressed(current, previousFrame(p));
+
+  for (int m = 0; m < TECH_MACHINE_COUNT; m++) {
+    uint8_t state = tr.state[m];
+    uint32_t frames = tr.frames[m] + frameDelta;
+    uint8_t window = techMachines[m].windows[state];
+    if (window != 0 && frames > window) {
+      state = techMachines[m].timeouts[state];
+      frames = 0;
+    }
+
+    const TechStep& step = t.steps[m][state][symbol];
+    if (step.next != state || (step.flags & TECH_ROW_RESTART)) frames = 0;
+    if (step.flags & TECH_ROW_ANCHOR) tr.anchorX[m] = current.locationX;
+    if (step.counter != TECH_COUNT_NONE) {
+      int counter = step.counter;
+      if ((step.flags & TECH_ROW_DIRECTIONAL) && current.locationX > tr.anchorX[m]) counter++;
+      uint16_t& count = *(uint16_t*)((uint8_t*)&stats + techCounterOffsets[counter]);
+      count++;
+    }
+
+    tr.state[m] = step.next;
+    tr.frames[m] = frames > 0xFFFF ? 0xFFFF : frames;
+  }
+}
+
+#endif
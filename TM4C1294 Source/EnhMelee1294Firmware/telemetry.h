@@ -0,0 +1,196 @@
+#ifndef _TELEMETRY_H_INCLUDED
+#define _TELEMETRY_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//**********************************************************************
+//*                         Per-Frame Telemetry
+//**********************************************************************
+//Compact snapshot of the game in progress, sent over UDP every Nth frame so overlays do not have to
+//wait for the end of game JSON. Every datagram is self contained, receivers just keep the newest
+//sequence number they have seen and a lost packet is replaced by the next one. Layout:
+//
+//  [0]     'S'        magic
+//  [1]     'T'
+//  [2]     version    TELEMETRY_VERSION
+//  [3]     flags      TELEMETRY_FLAG_*
+//  [4..5]  sequence   big endian, incremented for every datagram sent
+//  [6..9]  frame      big endian frame counter
+//  [10..11] stage
+//  [12]    players    number of player blocks that follow
+//  [13..]  player blocks, TELEMETRY_PLAYER_SIZE bytes each
+//  [..+8]  server time, u64 microseconds since the Unix epoch, only if TELEMETRY_FLAG_SERVER_TIME is set
+//
+//Floats are sent as fixed point to keep a 2 player snapshot under 60 bytes.
+#define TELEMETRY_MAGIC_0 'S'
+#define TELEMETRY_MAGIC_1 'T'
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 13
+#define TELEMETRY_PLAYER_SIZE 20
+#define TELEMETRY_MAX_PLAYERS 4
+#define TELEMETRY_SERVER_TIME_SIZE 8
+#define TELEMETRY_MAX_PACKET_SIZE (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PLAYERS * TELEMETRY_PLAYER_SIZE + TELEMETRY_SERVER_TIME_SIZE)
+
+#define TELEMETRY_PORT 3638
+
+#define TELEMETRY_FLAG_TRUNCATED 0x01 //Not every player fit in the byte budget
+#define TELEMETRY_FLAG_SERVER_TIME 0x02 //The board is synchronized with the server and stamped the datagram
+
+//Fixed point scales
+#define TELEMETRY_POSITION_SCALE 16.0f //int16, 1/16 unit, +/-2048 covers every blast zone
+#define TELEMETRY_PERCENT_SCALE 10.0f //uint16, 0.1%
+#define TELEMETRY_SHIELD_SCALE 4.0f //uint8, full shield is 60
+#define TELEMETRY_STICK_SCALE 127.0f //int8
+#define TELEMETRY_TRIGGER_SCALE 255.0f //uint8
+
+typedef struct {
+  uint8_t port; //1 based like the JSON output
+  uint8_t character; //Internal character id
+  uint8_t stocks;
+  uint16_t animation;
+  float locationX;
+  float locationY;
+  float percent;
+  float shieldSize;
+  uint16_t physicalButtons;
+  float joystickX;
+  float joystickY;
+  float cstickX;
+  float cstickY;
+  float trigger;
+} TelemetryPlayer;
+
+typedef struct {
+  uint8_t flags;
+  uint16_t sequence;
+  uint32_t frame;
+  uint16_t stage;
+  uint8_t playerCount;
+  TelemetryPlayer players[TELEMETRY_MAX_PLAYERS];
+  uint64_t serverTime; //Send time in server time, only valid with TELEMETRY_FLAG_SERVER_TIME
+} TelemetryFrame;
+
+int32_t telemetryQuantize(float value, float scale, int32_t min, int32_t max) {
+  float scaled = value * scale;
+  int32_t q = (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+  if (q < min) return min;
+  if (q > max) return max;
+  return q;
+}
+
+void telemetryWriteHalf(uint8_t* a, int& idx, uint16_t value) {
+  a[idx++] = value >> 8;
+  a[idx++] = value & 0xFF;
+}
+
+uint16_t telemetryReadHalf(const uint8_t* a, int& idx) {
+  uint16_t value = a[idx] << 8 | a[idx + 1];
+  idx += 2;
+  return value;
+}
+
+//Writes as many players as fit in byteBudget. Returns the datagram size, or 0 if not even the header fits
+int telemetryEncode(uint8_t* out, int byteBudget, const TelemetryFrame& frame) {
+  if (byteBudget < TELEMETRY_HEADER_SIZE) return 0;
+
+  int playerCount = frame.playerCount;
+  if (playerCount > TELEMETRY_MAX_PLAYERS) playerCount = TELEMETRY_MAX_PLAYERS;
+
+  //The server time is dropped before any player is
+  uint8_t flags = frame.flags;
+  int available = byteBudget - TELEMETRY_HEADER_SIZE;
+  if ((flags & TELEMETRY_FLAG_SERVER_TIME) && available >= playerCount * TELEMETRY_PLAYER_SIZE + TELEMETRY_SERVER_TIME_SIZE) {
+    available -= TELEMETRY_SERVER_TIME_SIZE;
+  } else {
+    flags &= ~TELEMETRY_FLAG_SERVER_TIME;
+  }
+
+  int fitting = available / TELEMETRY_PLAYER_SIZE;
+  if (fitting < playerCount) {
+    playerCount = fitting;
+    flags |= TELEMETRY_FLAG_TRUNCATED;
+  }
+
+  int idx = 0;
+  out[idx++] = TELEMETRY_MAGIC_0;
+  out[idx++] = TELEMETRY_MAGIC_1;
+  out[idx++] = TELEMETRY_VERSION;
+  out[idx++] = flags;
+  telemetryWriteHalf(out, idx, frame.sequence);
+  telemetryWriteHalf(out, idx, frame.frame >> 16);
+  telemetryWriteHalf(out, idx, frame.frame & 0xFFFF);
+  telemetryWriteHalf(out, idx, frame.stage);
+  out[idx++] = playerCount;
+
+  for (int i = 0; i < playerCount; i++) {
+    const TelemetryPlayer& p = frame.players[i];
+    out[idx++] = p.port;
+    out[idx++] = p.character;
+    out[idx++] = p.stocks;
+    telemetryWriteHalf(out, idx, p.animation);
+    telemetryWriteHalf(out, idx, (uint16_t)telemetryQuantize(p.locationX, TELEMETRY_POSITION_SCALE, -32768, 32767));
+    telemetryWriteHalf(out, idx, (uint16_t)telemetryQuantize(p.locationY, TELEMETRY_POSITION_SCALE, -32768, 32767));
+    telemetryWriteHalf(out, idx, telemetryQuantize(p.percent, TELEMETRY_PERCENT_SCALE, 0, 65535));
+    out[idx++] = telemetryQuantize(p.shieldSize, TELEMETRY_SHIELD_SCALE, 0, 255);
+    telemetryWriteHalf(out, idx, p.physicalButtons);
+    out[idx++] = (uint8_t)telemetryQuantize(p.joystickX, TELEMETRY_STICK_SCALE, -127, 127);
+    out[idx++] = (uint8_t)telemetryQuantize(p.joystickY, TELEMETRY_STICK_SCALE, -127, 127);
+    out[idx++] = (uint8_t)telemetryQuantize(p.cstickX, TELEMETRY_STICK_SCALE, -127, 127);
+    out[idx++] = (uint8_t)telemetryQuantize(p.cstickY, TELEMETRY_STICK_SCALE, -127, 127);
+    out[idx++] = telemetryQuantize(p.trigger, TELEMETRY_TRIGGER_SCALE, 0, 255);
+    out[idx++] = 0; //Reserved
+  }
+
+  if (flags & TELEMETRY_FLAG_SERVER_TIME) {
+    for (int i = 0; i < TELEMETRY_SERVER_TIME_SIZE; i++) out[idx++] = frame.serverTime >> (56 - 8 * i);
+  }
+
+  return idx;
+}
+
+//Returns false if the datagram is not a telemetry packet this version understands
+bool telemetryDecode(const uint8_t* packet, int size, TelemetryFrame& frame) {
+  if (size < TELEMETRY_HEADER_SIZE) return false;
+  if (packet[0] != TELEMETRY_MAGIC_0 || packet[1] != TELEMETRY_MAGIC_1 || packet[2] != TELEMETRY_VERSION) return false;
+
+  int idx = 3;
+  frame.flags = packet[idx++];
+  frame.sequence = telemetryReadHalf(packet, idx);
+  frame.frame = (uint32_t)telemetryReadHalf(packet, idx) << 16;
+  frame.frame |= telemetryReadHalf(packet, idx);
+  frame.stage = telemetryReadHalf(packet, idx);
+  frame.playerCount = packet[idx++];
+
+  if (frame.playerCount > TELEMETRY_MAX_PLAYERS) return false;
+  if (size < TELEMETRY_HEADER_SIZE + frame.playerCount * TELEMETRY_PLAYER_SIZE) return false;
+
+  for (int i = 0; i < frame.playerCount; i++) {
+    TelemetryPlayer& p = frame.players[i];
+    p.port = packet[idx++];
+    p.character = packet[idx++];
+    p.stocks = packet[idx++];
+    p.animation = telemetryReadHalf(packet, idx);
+    p.locationX = (int16_t)telemetryReadHalf(packet, idx) / TELEMETRY_POSITION_SCALE;
+    p.locationY = (int16_t)telemetryReadHalf(packet, idx) / TELEMETRY_POSITION_SCALE;
+    p.percent = telemetryReadHalf(packet, idx) / TELEMETRY_PERCENT_SCALE;
+    p.shieldSize = packet[idx++] / TELEMETRY_SHIELD_SCALE;
+    p.physicalButtons = telemetryReadHalf(packet, idx);
+    p.joystickX = (int8_t)packet[idx++] / TELEMETRY_STICK_SCALE;
+    p.joystickY = (int8_t)packet[idx++] / TELEMETRY_STICK_SCALE;
+    p.cstickX = (int8_t)packet[idx++] / TELEMETRY_STICK_SCALE;
+    p.cstickY = (int8_t)packet[idx++] / TELEMETRY_STICK_SCALE;
+    p.trigger = packet[idx++] / TELEMETRY_TRIGGER_SCALE;
+    idx++; //Reserved
+  }
+
+  frame.serverTime = 0;
+  if (frame.flags & TELEMETRY_FLAG_SERVER_TIME) {
+    if (size < idx + TELEMETRY_SERVER_TIME_SIZE) return false;
+    for (int i = 0; i < TELEMETRY_SERVER_TIME_SIZE; i++) frame.serverTime = frame.serverTime << 8 | packet[idx++];
+  }
+
+  return true;
+}
+
+#endif
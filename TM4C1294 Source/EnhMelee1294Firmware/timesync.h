@@ -0,0 +1,120 @@
+#ifndef _TIMESYNC_H_INCLUDED
+#define _TIMESYNC_H_INCLUDED
+
+#include <stdint.h>
+
+//**********************************************************************
+//*                         Server Time Sync
+//**********************************************************************
+//NTP style exchange over the binary UDP protocol. The board sends its local time T1, the server answers
+//with the time it received the request (T2) and sent the reply (T3), and the board notes the time the
+//reply arrived (T4). All times are microseconds, server time is microseconds since the Unix epoch.
+//
+//  offset = ((T2 - T1) + (T3 - T4)) / 2    delay = (T4 - T1) - (T3 - T2)
+//
+//Queueing only ever adds delay, so out of the last few exchanges the one with the smallest delay gives
+//the most trustworthy offset. Drift between the two clocks is estimated from how that offset moves
+//over time so stamps stay accurate between exchanges.
+#define TIME_SYNC_SAMPLE_COUNT 8
+#define TIME_SYNC_MIN_DRIFT_SPAN_US 10000000 //Offsets closer than 10s apart are too noisy for a drift estimate
+#define TIME_SYNC_DRIFT_GAIN 0.25f
+
+typedef struct {
+  int64_t offset;
+  uint64_t delay;
+  uint64_t local; //Local time the sample was taken
+} TimeSyncSample;
+
+typedef struct {
+  TimeSyncSample samples[TIME_SYNC_SAMPLE_COUNT];
+  int sampleCount;
+  int nextSample;
+  uint32_t exchanges;
+
+  bool valid;
+  int64_t offset; //Server time - local time at offsetLocal
+  uint64_t offsetLocal;
+  uint64_t delay; //Round trip of the sample the offset came from
+  float drift; //Server microseconds gained per local microsecond
+
+  bool hasDriftAnchor;
+  int64_t driftAnchorOffset;
+  uint64_t driftAnchorLocal;
+} TimeSync;
+
+void timeSyncInit(TimeSync& ts) {
+  ts.sampleCount = 0;
+  ts.nextSample = 0;
+  ts.exchanges = 0;
+  ts.valid = false;
+  ts.offset = 0;
+  ts.offsetLocal = 0;
+  ts.delay = 0;
+  ts.drift = 0;
+  ts.hasDriftAnchor = false;
+}
+
+//Converts a local time to server time. Only meaningful once ts.valid is set
+int64_t timeSyncToServer(const TimeSync& ts, uint64_t local) {
+  int64_t elapsed = (int64_t)(local - ts.offsetLocal);
+  return (int64_t)local + ts.offset + (int64_t)(ts.drift * elapsed);
+}
+
+//Adds one completed exchange. Returns false if the timestamps are inconsistent
+bool timeSyncAddSample(TimeSync& ts, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+  if (t4 < t1 || t3 < t2) return false;
+
+  uint64_t roundTrip = t4 - t1;
+  uint64_t serverTime = t3 - t2;
+  TimeSyncSample& s = ts.samples[ts.nextSample];
+  s.delay = roundTrip > serverTime ? roundTrip - serverTime : 0;
+  s.offset = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+  s.local = t4;
+
+  ts.nextSample = (ts.nextSample + 1) % TIME_SYNC_SAMPLE_COUNT;
+  if (ts.sampleCount < TIME_SYNC_SAMPLE_COUNT) ts.sampleCount++;
+  ts.exchanges++;
+
+  //Clock filter, trust the sample that spent the least time in queues
+  const TimeSyncSample* best = &ts.samples[0];
+  for (int i = 1; i < ts.sampleCount; i++) {
+    if (ts.samples[i].delay < best->delay) best = &ts.samples[i];
+  }
+
+  if (ts.valid && best->local == ts.offsetLocal) return true;
+
+  if (!ts.hasDriftAnchor) {
+    ts.driftAnchorOffset = best->offset;
+    ts.driftAnchorLocal = best->local;
+    ts.hasDriftAnchor = true;
+  } else if (best->local - ts.driftAnchorLocal >= TIME_SYNC_MIN_DRIFT_SPAN_US) {
+    float measured = (float)(best->offset - ts.driftAnchorOffset) / (float)(best->local - ts.driftAnchorLocal);
+    ts.drift += TIME_SYNC_DRIFT_GAIN * (measured - ts.drift);
+    ts.driftAnchorOffset = best->offset;
+    ts.driftAnchorLocal = best->local;
+  }
+
+  ts.offset = best->offset;
+  ts.offsetLocal = best->local;
+  ts.delay = best->delay;
+  ts.valid = true;
+  return true;
+}
+
+//**********************************************************************
+//*                            Time Marks
+//**********************************************************************
+//The main TCP stream forwards the Gecko events unchanged, so the board adds its own message to line
+//them up with the server clock. It is framed like the forwarded events (4-byte big-endian length of
+//code and payload, then the code) and pairs the frame counter of the last event with the server time
+//it was forwarded at, both big-endian. Servers that do not know the code skip it by its length.
+#define STREAM_TIME_MARK 0x3F
+#define STREAM_TIME_MARK_SIZE 12 //u32 frame counter, u64 server microseconds
+#define TIME_MARK_INTERVAL_FRAMES 60 //About once a second during a game
+
+void timeMarkEncode(uint8_t* out, uint32_t frame, uint64_t serverTime) {
+  for (int i = 0; i < 4; i++) out[i] = frame >> (24 - 8 * i);
+  for (int i = 0; i < 8; i++) out[4 + i] = serverTime >> (56 - 8 * i);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef _UDPPROTOCOL_H_INCLUDED
+#define _UDPPROTOCOL_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+//**********************************************************************
+//*                     Binary UDP Configuration Protocol
+//**********************************************************************
+//Compact alternative to the JSON messages handled by listenForUdpPacket(). Every packet is:
+//
+//  [0]    'S'        magic, a JSON packet always starts with '{' so the two can share port 3637
+//  [1]    'L'
+//  [2]    version    UDP_BINARY_VERSION of the sender
+//  [3]    type       same numbering as the MSG_TYPE_* JSON command types
+//  [4..5] sequence   big endian, echoed back in the response so hosts can match requests
+//  [6..]  TLVs       tag (1 byte), length (1 byte), value (length bytes), multi byte values big endian
+//
+//Receivers skip tags they do not know so new fields can be added without bumping the version. The
+//version only changes when the meaning of an existing tag or type changes.
+#define UDP_BINARY_MAGIC_0 'S'
+#define UDP_BINARY_MAGIC_1 'L'
+#define UDP_BINARY_VERSION 1
+#define UDP_BINARY_HEADER_SIZE 6
+#define UDP_BINARY_MAX_PACKET_SIZE 256
+
+//Message types that only exist in the binary protocol. 1 to 4 are shared with the JSON MSG_TYPE_* values
+#define MSG_TYPE_STATS_QUERY 5
+#define MSG_TYPE_SET_TELEMETRY 6
+#define MSG_TYPE_TIME_SYNC 7 //Sent by the board to the server, see timesync.h
+#define MSG_TYPE_LIVE_STATS 8 //Latest live stats snapshot, see livestats.h. Also pushed by the board when enabled
+#define MSG_TYPE_PLAY_EVENTS 9 //Events detected during the game, see playevents.h. Pushed by the board when enabled
+#define MSG_TYPE_STAT_SERIES 10 //One counter of one player bucketed over time, see statseries.h
+#define MSG_TYPE_METRICS 11 //Health counters and gauges of the board, see metrics.h
+#define MSG_TYPE_HEATMAP 12 //Stage heatmaps and spacing of the game in progress or the last one, see heatmap.h
+#define MSG_TYPE_MOVES 13 //Per move histograms of the game in progress or the last one, see movestats.h
+
+//TLV tags
+#define TLV_STATUS 0x01 //u8, one of the STATUS_* values below
+#define TLV_MAC 0x02 //6 bytes
+#define TLV_TARGET_IP 0x03 //4 bytes
+#define TLV_TARGET_PORT 0x04 //u16
+#define TLV_LOG_TEXT 0x05 //UTF-8 text, not null terminated
+#define TLV_TELEMETRY_TARGET 0x06 //4 bytes, broadcast or multicast address telemetry is sent to
+#define TLV_TELEMETRY_DECIMATION 0x07 //u8, send every Nth frame, 0 disables telemetry
+#define TLV_TELEMETRY_BUDGET 0x08 //u16, maximum telemetry datagram size
+#define TLV_FRAME 0x10 //u32, frame counter of the game in progress
+#define TLV_FRAMES_MISSED 0x11 //u32
+#define TLV_PLAYER 0x12 //u8 port, u8 stocks, f32 percent, u16 action count, u16 openings
+#define TLV_LATENCY 0x13 //u8 stage, u16 p50, u16 p90, u16 p99, u16 max, all in microseconds
+#define TLV_ARRIVAL 0x14 //u16 mean interval, u16 jitter, u16 p99 interval, u16 max interval (us), u32 slow frames
+#define TLV_TIME_T1 0x15 //u64, board local time the time sync request was sent (us)
+#define TLV_TIME_T2 0x16 //u64, server time the request was received (us since the Unix epoch)
+#define TLV_TIME_T3 0x17 //u64, server time the reply was sent
+#define TLV_LIVE_INTERVAL 0x18 //u16, frames between live stats snapshots, 0 stops them
+#define TLV_LIVE_PUSH 0x19 //u8, 1 pushes every snapshot to the host that sent it, 0 stops pushing
+#define TLV_LIVE_SNAPSHOT 0x1A //u32 snapshot sequence, u32 frame, u32 frames missed
+#define TLV_LIVE_PLAYER 0x1B //u8 port, u8 stocks, f32 percent, u16 actions, u16 openings, u16 recovery attempts,
+                             //u16 successful recoveries, u32 frames in shield, u16 rolls, u16 spot dodges,
+                             //u16 air dodges, f32 average damage per string, f32 most damage string
+#define TLV_LIVE_STOCK 0x1C //u8 port, u8 stock, u8 flags (1 used, 2 lost), u32 last frame, f32 percent, u8 last hit by,
+                           //u16 openings allowed
+#define TLV_IDLE_SLEEP 0x1D //u8, in a stats query: 1 sleeps between frames, 0 busy polls
+#define TLV_IDLE 0x1E //u8 sleeping, u16 awake share (0.01%), u16 wake p50, u16 wake p99, u16 wake max (us), u32 sleeps
+#define TLV_EVENT_PUSH 0x1F //u8, 1 pushes play events to the host that sent it, 0 stops pushing
+#define TLV_EVENT_STREAM 0x20 //u32 sequence of the first event in the datagram, u32 events dropped so far
+#define TLV_PLAY_EVENT 0x21 //One event, encoded as described in playevents.h
+#define TLV_SERIES_BUCKET_FRAMES 0x22 //u16, bucket length from the next game on, 60 to 3600 frames
+#define TLV_SERIES_SELECT 0x23 //u8 port, u8 channel, u32 first bucket wanted
+#define TLV_SERIES_INFO 0x24 //u16 bucket length in frames, u32 latest bucket, u32 oldest bucket kept
+#define TLV_SERIES_DATA 0x25 //u8 port, u8 channel, u32 first bucket, u16 count per bucket up to the latest
+#define TLV_METRICS_FROM 0x26 //u8, first metric ID wanted, 0 if absent
+#define TLV_METRICS 0x27 //u8 first ID, u8 metric count of the board, u32 per metric from the first ID on
+#define TLV_LIVE_PART 0x28 //u8, which part of a live stats snapshot a response carries, LIVE_PART_* in livestats.h
+#define TLV_LIVE_TECHS 0x29 //u8 port, u16 missed techs, u16 techs left, u16 techs right, u16 techs in place,
+                            //u16 wavedashes, u16 L-cancels, u16 missed L-cancels, u16 ledgedashes, u16 shield drops
+#define TLV_HEATMAP_SELECT 0x2A //u8 grid, HEATMAP_GRID_* in heatmap.h, u16 first encoded byte wanted
+#define TLV_HEATMAP_INFO 0x2B //u8 columns, u8 rows, f32 left, f32 right, f32 bottom, f32 top, u8 spacing bins,
+                              //u8 spacing bin width
+#define TLV_HEATMAP_DATA 0x2C //u8 grid, u32 frame it was encoded at, u16 encoded size, u16 offset, encoded bytes
+                              //from the offset on
+#define TLV_MOVES_SELECT 0x2D //u8 player, 0 for the lower port, u8 first move ID wanted
+#define TLV_MOVES_PAGE 0x2E //u8 player, u8 port, u8 first move ID, u8 move ID to ask from next, MOVE_ID_COUNT at the end
+#define TLV_MOVE 0x2F //u8 move ID, u16 hits, u32 damage (0.1%), u16 openings, u16 kills, u16 combo starters,
+                      //u16 combo enders
+
+#define STATUS_OK 0
+#define STATUS_UNSUPPORTED_VERSION 1
+#define STATUS_MALFORMED 2
+#define STATUS_UNKNOWN_TYPE 3
+
+typedef struct {
+  uint8_t* buffer;
+  int capacity;
+  int size;
+} TlvWriter;
+
+typedef struct {
+  const uint8_t* buffer;
+  int size;
+  int offset;
+
+  uint8_t version;
+  uint8_t type;
+  uint16_t sequence;
+} TlvReader;
+
+//Returns true if the packet starts with the binary magic. Anything else is handled as JSON
+bool isBinaryPacket(const uint8_t* packet, int size) {
+  return size >= UDP_BINARY_HEADER_SIZE && packet[0] == UDP_BINARY_MAGIC_0 && packet[1] == UDP_BINARY_MAGIC_1;
+}
+
+void tlvBegin(TlvWriter& w, uint8_t* buffer, int capacity, uint8_t type, uint16_t sequence) {
+  w.buffer = buffer;
+  w.capacity = capacity;
+
+  buffer[0] = UDP_BINARY_MAGIC_0;
+  buffer[1] = UDP_BINARY_MAGIC_1;
+  buffer[2] = UDP_BINARY_VERSION;
+  buffer[3] = type;
+  buffer[4] = sequence >> 8;
+  buffer[5] = sequence & 0xFF;
+  w.size = UDP_BINARY_HEADER_SIZE;
+}
+
+//Appends a TLV. Returns false without writing anything if it does not fit
+bool tlvAppend(TlvWriter& w, uint8_t tag, const uint8_t* value, int length) {
+  if (length > 0xFF || w.size + 2 + length > w.capacity) return false;
+
+  w.buffer[w.size++] = tag;
+  w.buffer[w.size++] = length;
+  memcpy(w.buffer + w.size, value, length);
+  w.size += length;
+  return true;
+}
+
+bool tlvAppendByte(TlvWriter& w, uint8_t tag, uint8_t value) {
+  return tlvAppend(w, tag, &value, 1);
+}
+
+bool tlvAppendHalf(TlvWriter& w, uint8_t tag, uint16_t value) {
+  uint8_t bytes[2] = { (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) };
+  return tlvAppend(w, tag, bytes, 2);
+}
+
+bool tlvAppendWord(TlvWriter& w, uint8_t tag, uint32_t value) {
+  uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+  return tlvAppend(w, tag, bytes, 4);
+}
+
+bool tlvAppendLong(TlvWriter& w, uint8_t tag, uint64_t value) {
+  uint8_t bytes[8];
+  for (int i = 0; i < 8; i++) bytes[i] = value >> (56 - 8 * i);
+  return tlvAppend(w, tag, bytes, 8);
+}
+
+//Validates the header. A packet from a newer major version is still opened so the caller can reply
+//with STATUS_UNSUPPORTED_VERSION
+bool tlvOpen(TlvReader& r, const uint8_t* packet, int size) {
+  if (!isBinaryPacket(packet, size)) return false;
+
+  r.buffer = packet;
+  r.size = size;
+  r.offset = UDP_BINARY_HEADER_SIZE;
+  r.version = packet[2];
+  r.type = packet[3];
+  r.sequence = packet[4] << 8 | packet[5];
+  return true;
+}
+
+//Returns the next TLV. Returns false at the end of the packet or if a TLV runs past the end
+bool tlvNext(TlvReader& r, uint8_t& tag, const uint8_t*& value, int& length) {
+  if (r.offset + 2 > r.size) return false;
+
+  tag = r.buffer[r.offset];
+  length = r.buffer[r.offset + 1];
+  if (r.offset + 2 + length > r.size) return false;
+
+  value = r.buffer + r.offset + 2;
+  r.offset += 2 + length;
+  return true;
+}
+
+uint16_t tlvHalf(const uint8_t* value) {
+  return value[0] << 8 | value[1];
+}
+
+uint64_t tlvLong(const uint8_t* value) {
+  uint64_t result = 0;
+  for (int i = 0; i < 8; i++) result = result << 8 | value[i];
+  return result;
+}
+
+#endif
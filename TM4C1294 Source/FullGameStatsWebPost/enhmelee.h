@@ -1,14 +1,16 @@
+#ifndef _ENHMELEE_H_INCLUDED
+#define _ENHMELEE_H_INCLUDED
+
 #include <stdint.h>
 #include <stdio.h>
 #include "meleeids.h"
+#include "gamearena.h"
 
 #define PLAYER_COUNT 2
 #define STOCK_COUNT 4
-#define COMBO_STRING_BUFFER_SIZE 200
-#define RECOVERY_BUFFER_SIZE 100
-#define PUNISH_BUFFER_SIZE 150
 #define MAX_FRAMES 28800
 #define MSG_BUFFER_SIZE 1024
+#define INTERNAL_CHARACTER_COUNT 33
 
 #define JOYSTICK_NE 1
 #define JOYSTICK_SE 2
@@ -116,7 +118,7 @@ typedef struct {
 
 typedef struct {
   //Internal Character Usage - currenly only used for sheik/zelda detection
-  uint32_t internalCharUsage[33];
+  uint32_t internalCharUsage[INTERNAL_CHARACTER_COUNT];
   
   //Positional
   uint32_t framesAboveOthers; //Assuming if you are higher, you are in a worse position
@@ -142,14 +144,12 @@ typedef struct {
 
   uint16_t numberOfOpenings; //this is the number of times a player started a combo string
   
-  uint8_t comboStringIndex = 0;
-  uint8_t recoveryIndex = 0;
-  uint8_t punishIndex = 0;
-  
   StockStatistics stocks[STOCK_COUNT];
-  ComboString comboStrings[COMBO_STRING_BUFFER_SIZE];
-  Recovery recoveries[RECOVERY_BUFFER_SIZE];
-  Punish punishes[PUNISH_BUFFER_SIZE];
+  
+  //Grow from the arena of the game, see gamearena.h
+  EventList comboStrings; //ComboString
+  EventList recoveries; //Recovery
+  EventList punishes; //Punish
 } PlayerStatistics;
 
 typedef struct {
@@ -168,13 +168,26 @@ typedef struct {
   PlayerStatistics stats;
 } Player;
 
+//Where eventschema.h decodes an update to and encodes one from
+PlayerFrameData& schemaUpdateTarget(Player& p) {
+  return p.currentFrameData;
+}
+
+const PlayerFrameData& schemaUpdateTarget(const Player& p) {
+  return p.currentFrameData;
+}
+
 typedef struct {
+  GameArena* arena; //Where the event lists of the players grow from, stays with the game when it is reset
+  uint32_t arenaStart; //Head of the arena when the game started, releasing up to here frees older games
   Player players[PLAYER_COUNT]; //Contains all information relevant to individual players
+  uint8_t schemaVersion; //EVENT_SCHEMA_VERSION of the Gecko code that sent the game
   uint16_t stage; //Stage ID
 
   //Fromt Update event
   uint32_t frameCounter; //Frame count
   uint32_t framesMissed;
+  uint32_t frameDelta; //Frames since the previous update, more than 1 when updates were missed
   uint32_t randomSeed;
   
   //From OnGameEnd event
@@ -221,17 +234,39 @@ uint8_t getJoystickRegion(float x, float y) {
   else return JOYSTICK_DZ;
 }
 
-void appendRecovery(bool successfulRecovery, Player& cp, uint32_t frameCounter) {
-  Recovery& r =  cp.stats.recoveries[cp.stats.recoveryIndex];
-  r.frameStart = cp.flags.recoveryStartFrame;
-  r.frameEnd = frameCounter;
-  r.percentStart = cp.flags.recoveryStartPercent;
-  r.percentEnd = cp.previousFrameData.percent;
-  r.isSuccessful = successfulRecovery;
-  
-  if (cp.stats.recoveryIndex < RECOVERY_BUFFER_SIZE - 1) {
-     cp.stats.recoveryIndex++;
+//Starts the lists of the game over at the head of arena. Whatever they held before stays in the arena
+//it came from until that is released
+void gameAttachArena(Game& game, GameArena* arena) {
+  game.arena = arena;
+  game.arenaStart = arena != NULL ? arena->head : 0;
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    PlayerStatistics& ps = game.players[i].stats;
+    ps.comboStrings = { };
+    ps.recoveries = { };
+    ps.punishes = { };
+  }
+}
+
+//Records dropped by the lists of a game because its arena was full
+uint32_t gameDroppedRecords(const Game& game) {
+  uint32_t dropped = 0;
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    const PlayerStatistics& ps = game.players[i].stats;
+    dropped += ps.comboStrings.dropped + ps.recoveries.dropped + ps.punishes.dropped;
   }
+  return dropped;
+}
+
+void appendRecovery(GameArena* arena, bool successfulRecovery, Player& cp, uint32_t frameCounter) {
+  Recovery* r = (Recovery*)eventListAppend(arena, cp.stats.recoveries, sizeof(Recovery));
+  if (r == NULL) return;
+
+  r->frameStart = cp.flags.recoveryStartFrame;
+  r->frameEnd = frameCounter;
+  r->percentStart = cp.flags.recoveryStartPercent;
+  r->percentEnd = cp.previousFrameData.percent;
+  r->isSuccessful = successfulRecovery;
 }
 
 void resetRecoveryFlags(PlayerFlags& flags) {
@@ -241,18 +276,22 @@ void resetRecoveryFlags(PlayerFlags& flags) {
   flags.framesSinceLanding = 0;
 }
 
-void appendPunish(bool isKill, Player& cp, Player& op, uint32_t frameCounter) {
-  Punish& p =  cp.stats.punishes[cp.stats.punishIndex];
-  p.frameStart = cp.flags.punishStartFrame;
-  p.frameEnd = frameCounter;
-  p.percentStart = cp.flags.punishStartPercent;
-  p.percentEnd = op.previousFrameData.percent;
-  p.hitCount = cp.flags.punishHitCount;
-  p.isKill = isKill;
-  
-  if (cp.stats.punishIndex < PUNISH_BUFFER_SIZE - 1) {
-     cp.stats.punishIndex++;
-  }
+void appendPunish(GameArena* arena, bool isKill, Player& cp, Player& op, uint32_t frameCounter) {
+  Punish* p = (Punish*)eventListAppend(arena, cp.stats.punishes, sizeof(Punish));
+  if (p == NULL) return;
+
+  p->frameStart = cp.flags.punishStartFrame;
+  p->frameEnd = frameCounter;
+  p->percentStart = cp.flags.punishStartPercent;
+  p->percentEnd = op.previousFrameData.percent;
+  p->hitCount = cp.flags.punishHitCount;
+  p->isKill = isKill;
+}
+
+//Adds frames to one of the uint8_t frame counters in PlayerFlags. After a long gap the counter stops at
+//the top instead of wrapping, the thresholds it is compared against are far below that
+void addFrames(uint8_t& counter, uint32_t frames) {
+  counter = counter + frames > 0xFF ? 0xFF : counter + frames;
 }
 
 void resetPunishFlags(PlayerFlags& flags) {
@@ -261,3 +300,4 @@ void resetPunishFlags(PlayerFlags& flags) {
   flags.punishHitCount = 0;
 }
 
+#endif
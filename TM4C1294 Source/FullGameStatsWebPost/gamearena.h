@@ -0,0 +1,148 @@
+#ifndef _GAMEARENA_H_INCLUDED
+#define _GAMEARENA_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+//**********************************************************************
+//*                            Game Arena
+//**********************************************************************
+//The combo strings, recoveries and punishes of a game are lists that grow from a bump arena. A list takes
+//EVENT_CHUNK_RECORDS records at a time, so the lists of both players share the same memory and a game
+//heavy on one kind of event has all of it. Nothing is freed on its own.
+//
+//The arena is a ring so games can share one: each game allocates from where the one before it stopped,
+//and games are released oldest first by moving the tail up to the start of the oldest game still held.
+//A tool that follows one game at a time just resets the arena at every game start. Both are O(1).
+//
+//When the arena is full the record is dropped and counted, on the list and on the arena. highWater is
+//the most the arena has held at once.
+#define GAME_ARENA_SIZE 20480 //One game at a time, enough for the longest synthetic game
+#define EVENT_CHUNK_RECORDS 8
+#define ARENA_ALIGNMENT sizeof(void*) //Chunks start with a pointer
+
+typedef struct {
+  uint8_t* memory;
+  uint32_t size;
+  uint32_t head; //Next free byte
+  uint32_t tail; //First byte still held. The arena is empty when it equals head, it is never quite full
+
+  //Since arenaInit
+  uint32_t highWater; //Most bytes held at once
+  uint32_t overflows; //Allocations that did not fit
+} GameArena;
+
+void arenaInit(GameArena& a, uint8_t* memory, uint32_t size) {
+  uint32_t skip = (ARENA_ALIGNMENT - (uintptr_t)memory % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+  a.memory = memory + skip;
+  a.size = size > skip ? (size - skip) / ARENA_ALIGNMENT * ARENA_ALIGNMENT : 0;
+  a.head = 0;
+  a.tail = 0;
+  a.highWater = 0;
+  a.overflows = 0;
+}
+
+//Bytes from tail to head, including any skipped at the end of the ring
+uint32_t arenaHeld(const GameArena& a) {
+  return a.head >= a.tail ? a.head - a.tail : a.size - a.tail + a.head;
+}
+
+//Everything allocated from the arena is gone
+void arenaReset(GameArena& a) {
+  a.head = 0;
+  a.tail = 0;
+}
+
+//Frees everything allocated before mark, the value head had when the oldest game still held started
+void arenaRelease(GameArena& a, uint32_t mark) {
+  a.tail = mark;
+}
+
+//Returns NULL when the arena is full. A block never wraps: if it does not fit before the end of the ring
+//it goes at the start, and the bytes it skipped stay held until the tail passes them
+void* arenaAlloc(GameArena& a, uint32_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+  //The free space is head up to tail, around the end of the ring if the held bytes do not wrap
+  uint32_t at = a.size;
+  if (a.tail > a.head) {
+    if (a.head + size < a.tail) at = a.head;
+  } else if (a.head + size < a.size || (a.head + size == a.size && a.tail > 0)) {
+    at = a.head;
+  } else if (size < a.tail) {
+    at = 0;
+  }
+
+  if (at == a.size) {
+    a.overflows++;
+    return NULL;
+  }
+
+  a.head = at + size == a.size ? 0 : at + size;
+  uint32_t held = arenaHeld(a);
+  if (held > a.highWater) a.highWater = held;
+  return a.memory + at;
+}
+
+//**********************************************************************
+//*                           Event Lists
+//**********************************************************************
+//A list holds records of one type, the record size is passed on every call
+typedef struct EventChunk {
+  struct EventChunk* next;
+  uint16_t count;
+  //EVENT_CHUNK_RECORDS records follow
+} EventChunk;
+
+typedef struct {
+  EventChunk* first;
+  EventChunk* last;
+  uint16_t count;
+  uint16_t dropped; //Records lost to a full arena
+} EventList;
+
+typedef struct {
+  const EventChunk* chunk;
+  uint16_t index; //Next record in chunk
+} EventCursor;
+
+//Room for one more record at the end of the list, NULL if the arena is full. A game without an arena
+//keeps no records and counts them all as dropped
+void* eventListAppend(GameArena* arena, EventList& list, uint32_t recordSize) {
+  if (list.last == NULL || list.last->count == EVENT_CHUNK_RECORDS) {
+    EventChunk* chunk = NULL;
+    if (arena != NULL) chunk = (EventChunk*)arenaAlloc(*arena, sizeof(EventChunk) + EVENT_CHUNK_RECORDS * recordSize);
+    if (chunk == NULL) {
+      list.dropped++;
+      return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->count = 0;
+    if (list.last != NULL) list.last->next = chunk;
+    else list.first = chunk;
+    list.last = chunk;
+  }
+
+  list.count++;
+  return (uint8_t*)(list.last + 1) + list.last->count++ * recordSize;
+}
+
+void eventCursorBegin(EventCursor& c, const EventList& list) {
+  c.chunk = list.first;
+  c.index = 0;
+}
+
+//Next record of the list, NULL after the last one
+const void* eventCursorNext(EventCursor& c, uint32_t recordSize) {
+  if (c.chunk == NULL) return NULL;
+  if (c.index == c.chunk->count) {
+    if (c.chunk->next == NULL) return NULL;
+    c.chunk = c.chunk->next;
+    c.index = 0;
+  }
+
+  return (const uint8_t*)(c.chunk + 1) + c.index++ * recordSize;
+}
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef _GAMEJSON_H_INCLUDED
+#define _GAMEJSON_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "enhmelee.h"
+
+//**********************************************************************
+//*                      Resumable Game Serializer
+//**********************************************************************
+//Writes the "games" array of the upload one piece at a time: a game header, a player header, a single
+//stock, combo string, recovery or punish, or the brackets between them. A piece is at most
+//GAME_JSON_PIECE_SIZE bytes and the cursor remembers where it is, so the caller can take as many bytes as
+//it has time for and come back later. Nothing is built in memory ahead of time, which also removes the
+//old limit on how many combo strings fit in the JSON buffer.
+//
+//Games are read from a ring of ringSize completed games by sequence number, slot game % ringSize. The
+//caller must not overwrite a game in [first, end) while the cursor is still writing.
+#define GAME_JSON_PIECE_SIZE 512
+
+#define GAME_JSON_OPEN 0
+#define GAME_JSON_GAME 1
+#define GAME_JSON_PLAYER 2
+#define GAME_JSON_STOCKS 3
+#define GAME_JSON_COMBO_STRINGS 4
+#define GAME_JSON_RECOVERIES 5
+#define GAME_JSON_PUNISHES 6
+#define GAME_JSON_DONE 7
+
+typedef struct {
+  const Game* games;
+  int ringSize;
+  uint32_t first; //Sequence number of the first game written
+  uint32_t game; //Sequence number of the game being written
+  uint32_t end; //One past the last game written
+
+  uint8_t state;
+  uint8_t player;
+  uint16_t item; //Next stock
+  EventCursor records; //Next combo string, recovery or punish
+  uint16_t written; //Elements of the current list written so far, decides the commas
+
+  char piece[GAME_JSON_PIECE_SIZE];
+  int pieceSize;
+  int pieceOffset;
+} GameJsonCursor;
+
+void gameJsonBegin(GameJsonCursor& c, const Game* games, int ringSize, uint32_t first, uint32_t end) {
+  c.games = games;
+  c.ringSize = ringSize;
+  c.first = first;
+  c.game = first;
+  c.end = end;
+  c.state = GAME_JSON_OPEN;
+  c.player = 0;
+  c.item = 0;
+  c.records = { };
+  c.written = 0;
+  c.pieceSize = 0;
+  c.pieceOffset = 0;
+}
+
+//**********************************************************************
+//*                           Piece Writers
+//**********************************************************************
+void gameJsonText(GameJsonCursor& c, const char* text) {
+  int length = strlen(text);
+  if (c.pieceSize + length > GAME_JSON_PIECE_SIZE) length = GAME_JSON_PIECE_SIZE - c.pieceSize;
+  memcpy(c.piece + c.pieceSize, text, length);
+  c.pieceSize += length;
+}
+
+//Writes "key": with the comma in front unless it is the first member of the object
+void gameJsonKey(GameJsonCursor& c, const char* key) {
+  char last = c.pieceSize > 0 ? c.piece[c.pieceSize - 1] : '{';
+  if (last != '{' && last != '[') gameJsonText(c, ",");
+  gameJsonText(c, "\"");
+  gameJsonText(c, key);
+  gameJsonText(c, "\":");
+}
+
+void gameJsonUint(GameJsonCursor& c, const char* key, uint32_t value) {
+  char number[12];
+  sprintf(number, "%lu", (unsigned long)value);
+  gameJsonKey(c, key);
+  gameJsonText(c, number);
+}
+
+//Two decimals like the JSON library this replaced. printf float support is not linked in on the board
+void gameJsonFloat(GameJsonCursor& c, const char* key, float value) {
+  char number[16];
+  if (value != value) value = 0; //NaN is not valid JSON
+  bool negative = value < 0;
+  if (negative) value = -value;
+  if (value > 42949672.0f) value = 42949672.0f;
+  uint32_t hundredths = (uint32_t)(value * 100 + 0.5f);
+  sprintf(number, "%s%lu.%02lu", negative ? "-" : "", (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100));
+  gameJsonKey(c, key);
+  gameJsonText(c, number);
+}
+
+void gameJsonBool(GameJsonCursor& c, const char* key, bool value) {
+  gameJsonKey(c, key);
+  gameJsonText(c, value ? "true" : "false");
+}
+
+//Opens an element of a list, with a comma if it is not the first
+void gameJsonElement(GameJsonCursor& c) {
+  gameJsonText(c, c.written > 0 ? ",{" : "{");
+  c.written++;
+}
+
+//Closes the current list and opens the next one
+void gameJsonNextList(GameJsonCursor& c, const char* key, uint8_t state, const EventList& list) {
+  gameJsonText(c, "],\"");
+  gameJsonText(c, key);
+  gameJsonText(c, "\":[");
+  c.state = state;
+  eventCursorBegin(c.records, list);
+  c.written = 0;
+}
+
+void gameJsonGame(GameJsonCursor& c, const Game& g) {
+  if (c.game != c.first) gameJsonText(c, ",");
+  gameJsonText(c, "{");
+  gameJsonUint(c, "frames", g.frameCounter);
+  gameJsonUint(c, "framesMissed", g.framesMissed);
+  gameJsonUint(c, "winCondition", g.winCondition);
+  gameJsonUint(c, "stage", g.stage);
+  gameJsonText(c, ",\"players\":[");
+}
+
+void gameJsonPlayer(GameJsonCursor& c, const Game& g, const Player& p) {
+  const PlayerStatistics& ps = p.stats;
+  float totalActiveGameFrames = float(g.frameCounter);
+
+  //Zelda and Sheik are reported as whichever was played longer
+  uint8_t playedCharacterId = p.characterId;
+  if (playedCharacterId == EXTERNAL_ZELDA || playedCharacterId == EXTERNAL_SHEIK) {
+    uint32_t zeldaFrames = ps.internalCharUsage[INTERNAL_ZELDA];
+    uint32_t sheikFrames = ps.internalCharUsage[INTERNAL_SHEIK];
+    playedCharacterId = zeldaFrames > sheikFrames ? EXTERNAL_ZELDA : EXTERNAL_SHEIK;
+  }
+
+  gameJsonText(c, c.player > 0 ? ",{" : "{");
+  gameJsonUint(c, "port", p.controllerPort + 1);
+  gameJsonUint(c, "character", playedCharacterId);
+  gameJsonUint(c, "color", p.characterColor);
+  gameJsonUint(c, "playerType", p.playerType);
+  gameJsonUint(c, "stocksRemaining", p.currentFrameData.stocks);
+  gameJsonFloat(c, "apm", 3600 * (ps.actionCount / totalActiveGameFrames));
+  gameJsonFloat(c, "averageDistanceFromCenter", ps.averageDistanceFromCenter);
+  gameJsonFloat(c, "percentTimeClosestCenter", 100 * (ps.framesClosestCenter / totalActiveGameFrames));
+  gameJsonFloat(c, "percentTimeAboveOthers", 100 * (ps.framesAboveOthers / totalActiveGameFrames));
+  gameJsonFloat(c, "percentTimeInShield", 100 * (ps.framesInShield / totalActiveGameFrames));
+  gameJsonUint(c, "framesWithoutDamage", ps.mostFramesWithoutDamage);
+  gameJsonUint(c, "rollCount", ps.rollCount);
+  gameJsonUint(c, "spotDodgeCount", ps.spotDodgeCount);
+  gameJsonUint(c, "airDodgeCount", ps.airDodgeCount);
+  gameJsonText(c, ",\"stocks\":[");
+}
+
+//Fills piece with the next piece. Some steps only move the cursor, such as skipping a stock that was
+//never played, so this loops until there is something to send. Returns false once the array is closed
+bool gameJsonNextPiece(GameJsonCursor& c) {
+  c.pieceSize = 0;
+  c.pieceOffset = 0;
+
+  while (c.pieceSize == 0) {
+    const Game& g = c.games[c.game % c.ringSize];
+    const PlayerStatistics& ps = g.players[c.player].stats;
+    const void* record;
+
+    switch (c.state) {
+      case GAME_JSON_OPEN:
+        gameJsonText(c, "[");
+        c.state = GAME_JSON_GAME;
+        break;
+      case GAME_JSON_GAME:
+        if (c.game == c.end) {
+          gameJsonText(c, "]");
+          c.state = GAME_JSON_DONE;
+          break;
+        }
+        gameJsonGame(c, g);
+        c.player = 0;
+        c.state = GAME_JSON_PLAYER;
+        break;
+      case GAME_JSON_PLAYER:
+        gameJsonPlayer(c, g, g.players[c.player]);
+        c.state = GAME_JSON_STOCKS;
+        c.item = 0;
+        c.written = 0;
+        break;
+      case GAME_JSON_STOCKS:
+        if (c.item == STOCK_COUNT) {
+          gameJsonNextList(c, "comboStrings", GAME_JSON_COMBO_STRINGS, ps.comboStrings);
+          break;
+        }
+        {
+          const StockStatistics& ss = ps.stocks[c.item];
+
+          //Only log the stock if the player actually played that stock
+          if (ss.frameStart > 0 || c.item == 0) {
+            gameJsonElement(c);
+            gameJsonUint(c, "frameStart", ss.frameStart);
+            gameJsonUint(c, "frameEnd", ss.frameEnd);
+            gameJsonFloat(c, "percent", ss.percent);
+            gameJsonUint(c, "moveLastHitBy", ss.lastHitBy);
+            gameJsonUint(c, "lastAnimation", ss.lastAnimation);
+            gameJsonUint(c, "openingsAllowed", ss.killedInOpenings);
+            gameJsonText(c, "}");
+          }
+          c.item++;
+        }
+        break;
+      case GAME_JSON_COMBO_STRINGS:
+        record = eventCursorNext(c.records, sizeof(ComboString));
+        if (record == NULL) {
+          gameJsonNextList(c, "recoveries", GAME_JSON_RECOVERIES, ps.recoveries);
+          break;
+        }
+        {
+          const ComboString& cs = *(const ComboString*)record;
+          gameJsonElement(c);
+          gameJsonUint(c, "frameStart", cs.frameStart);
+          gameJsonUint(c, "frameEnd", cs.frameEnd);
+          gameJsonFloat(c, "percentStart", cs.percentStart);
+          gameJsonFloat(c, "percentEnd", cs.percentEnd);
+          gameJsonUint(c, "hitCount", cs.hitCount);
+          gameJsonText(c, "}");
+        }
+        break;
+      case GAME_JSON_RECOVERIES:
+        record = eventCursorNext(c.records, sizeof(Recovery));
+        if (record == NULL) {
+          gameJsonNextList(c, "punishes", GAME_JSON_PUNISHES, ps.punishes);
+          break;
+        }
+        {
+          const Recovery& r = *(const Recovery*)record;
+          gameJsonElement(c);
+          gameJsonUint(c, "frameStart", r.frameStart);
+          gameJsonUint(c, "frameEnd", r.frameEnd);
+          gameJsonFloat(c, "percentStart", r.percentStart);
+          gameJsonFloat(c, "percentEnd", r.percentEnd);
+          gameJsonBool(c, "isSuccessful", r.isSuccessful);
+          gameJsonText(c, "}");
+        }
+        break;
+      case GAME_JSON_PUNISHES:
+        record = eventCursorNext(c.records, sizeof(Punish));
+        if (record == NULL) {
+          //Close the punishes and the player, and the game after its last player
+          gameJsonText(c, "]}");
+          if (++c.player < PLAYER_COUNT) {
+            c.state = GAME_JSON_PLAYER;
+          } else {
+            gameJsonText(c, "]}");
+            c.player = 0;
+            c.game++;
+            c.state = GAME_JSON_GAME;
+          }
+          break;
+        }
+        {
+          const Punish& p = *(const Punish*)record;
+          gameJsonElement(c);
+          gameJsonUint(c, "frameStart", p.frameStart);
+          gameJsonUint(c, "frameEnd", p.frameEnd);
+          gameJsonFloat(c, "percentStart", p.percentStart);
+          gameJsonFloat(c, "percentEnd", p.percentEnd);
+          gameJsonUint(c, "hitCount", p.hitCount);
+          gameJsonBool(c, "isKill", p.isKill);
+          gameJsonText(c, "}");
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool gameJsonDone(const GameJsonCursor& c) {
+  return c.state == GAME_JSON_DONE && c.pieceOffset == c.pieceSize;
+}
+
+//Copies up to max bytes of the array into out. Returns the number of bytes copied, 0 once everything has
+//been written
+int gameJsonRead(GameJsonCursor& c, char* out, int max) {
+  int size = 0;
+  while (size < max) {
+    if (c.pieceOffset == c.pieceSize && !gameJsonNextPiece(c)) break;
+
+    int count = c.pieceSize - c.pieceOffset;
+    if (count > max - size) count = max - size;
+    memcpy(out + size, c.piece + c.pieceOffset, count);
+    c.pieceOffset += count;
+    size += count;
+  }
+
+  return size;
+}
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef _STATSENGINE_H_INCLUDED
+#define _STATSENGINE_H_INCLUDED
+
+#include <math.h>
+#include "enhmelee.h"
+#include "eventschema.h"
+
+//The stats engine only depends on enhmelee.h and the C standard library so that host side tools
+//(see Host Source) can run the exact same decode and statistics code that runs on the board
+
+//**********************************************************************
+//*                         Event Decoders
+//**********************************************************************
+//Event codes, payload sizes and the field by field decode come from the schema in eventschema.h
+void decodeGameStart(Game& game, const uint8_t* data) {
+  //Reset game variable, the arena stays with the game and the new lists start at its head
+  GameArena* arena = game.arena;
+  game = { };
+  gameAttachArena(game, arena);
+
+  schemaDecodeGameStart(game, data);
+}
+
+void decodeUpdate(Game& game, const uint8_t* data) {
+  uint32_t lastFrame = game.frameCounter;
+
+  //Change over previous frame data
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& p = game.players[i];
+    p.previousFrameData = p.currentFrameData;
+    p.currentFrameData = { };
+  }
+
+  schemaDecodeUpdate(game, data);
+
+  //Check frame count and see if any frames were skipped
+  int framesMissed = game.frameCounter - lastFrame - 1;
+  game.framesMissed += framesMissed;
+  game.frameDelta = lastFrame != 0 && framesMissed > 0 ? framesMissed + 1 : 1; //The first update counts as one frame
+}
+
+void decodeGameEnd(Game& game, const uint8_t* data) {
+  schemaDecodeGameEnd(game, data);
+}
+
+//**********************************************************************
+//*                            Statistics
+//**********************************************************************
+int numberOfSetBits(uint16_t x) {
+  //This function solves the Hamming Weight problem. Effectively it counts the number of bits in the input that are set to 1
+  //This implementation is supposedly very efficient when most bits are zero. Found: https://en.wikipedia.org/wiki/Hamming_weight#Efficient_implementation
+  int count;
+  for (count=0; x; count++) x &= x-1;
+  return count;
+}
+
+//Thresholds the statistics depend on. The board always runs the defaults from enhmelee.h, host tools
+//can run several sets over the same frames to tune them. Counters saturate at 255 so a threshold of
+//255 never triggers
+typedef struct {
+  uint8_t comboStringTimeout; //Frames without a hit before a combo string ends
+  uint8_t framesLandedRecovery; //Frames on stage before a recovery counts as successful
+  uint8_t framesLandedPunish; //Frames the opponent is actionable before a punish ends
+} StatsParams;
+
+const StatsParams DefaultStatsParams = { COMBO_STRING_TIMEOUT, FRAMES_LANDED_RECOVERY, FRAMES_LANDED_PUNISH };
+
+//When updates were missed, the frame that arrives stands in for the ones before it. Durations are weighted
+//by the real frame delta so they keep adding up to the length of the game, while anything that needs to
+//see a state on both sides of the gap (shielding, neutral after a punish) only counts the gap when it did
+void computeGameStatistics(Game& game, const StatsParams& params = DefaultStatsParams) {
+  //this function will only get called when frameCount >= 1
+  uint32_t frameDelta = game.frameDelta > 0 ? game.frameDelta : 1;
+  uint32_t framesBefore = game.frameCounter - frameDelta;
+
+  Player* p = game.players;
+
+  float p1CenterDistance = sqrt(pow(p[0].currentFrameData.locationX, 2) + pow(p[0].currentFrameData.locationY, 2));
+  float p2CenterDistance = sqrt(pow(p[1].currentFrameData.locationX, 2) + pow(p[1].currentFrameData.locationY, 2));
+
+  p[0].stats.averageDistanceFromCenter = (framesBefore*p[0].stats.averageDistanceFromCenter + frameDelta*p1CenterDistance) / (framesBefore + frameDelta);
+  p[1].stats.averageDistanceFromCenter = (framesBefore*p[1].stats.averageDistanceFromCenter + frameDelta*p2CenterDistance) / (framesBefore + frameDelta);
+
+  //Increment frame counter of person who is closest to center. If the players are even distances from the center, do not increment
+  if (p1CenterDistance < p2CenterDistance) p[0].stats.framesClosestCenter += frameDelta;
+  else if (p2CenterDistance < p1CenterDistance) p[1].stats.framesClosestCenter += frameDelta;
+
+  //Increment frame counter of person who is highest;
+  if (p[0].currentFrameData.locationY > p[1].currentFrameData.locationY) p[0].stats.framesAboveOthers += frameDelta;
+  else if (p[1].currentFrameData.locationY > p[0].currentFrameData.locationY) p[1].stats.framesAboveOthers += frameDelta;
+
+  for (int i = 0; i < PLAYER_COUNT; i++) {
+    Player& cp = p[i]; //Current player
+    Player& op = p[!i]; //Other player
+
+    bool lostStock = cp.previousFrameData.stocks - cp.currentFrameData.stocks > 0;
+    bool opntLostStock = op.previousFrameData.stocks - op.currentFrameData.stocks > 0;
+
+    //Check current action states, although many of these conditions check previous frame data, it shouldn't matter for frame = 1 that there is no previous
+    bool wasInShield = cp.previousFrameData.animation >= GUARD_START && cp.previousFrameData.animation <= GUARD_END;
+    if (cp.currentFrameData.animation >= GUARD_START && cp.currentFrameData.animation <= GUARD_END) cp.stats.framesInShield += wasInShield ? frameDelta : 1;
+    else if ((cp.currentFrameData.animation == ROLL_FORWARD && cp.previousFrameData.animation != ROLL_FORWARD) ||
+             (cp.currentFrameData.animation == ROLL_BACKWARD && cp.previousFrameData.animation != ROLL_BACKWARD)) cp.stats.rollCount++;
+    else if (cp.currentFrameData.animation == SPOT_DODGE && cp.previousFrameData.animation != SPOT_DODGE) cp.stats.spotDodgeCount++;
+    else if (cp.currentFrameData.animation == AIR_DODGE && cp.previousFrameData.animation != AIR_DODGE) cp.stats.airDodgeCount++;
+
+    //Check if we are getting damaged
+    bool tookPercent = cp.currentFrameData.percent - cp.previousFrameData.percent > 0;
+    if (tookPercent) {
+      cp.flags.framesWithoutDamage = 0;
+    } else {
+      cp.flags.framesWithoutDamage += frameDelta; //Increment count of frames without taking damage
+
+      //If frames without being hit is greater than previous, set new record
+      if (cp.flags.framesWithoutDamage > cp.stats.mostFramesWithoutDamage) cp.stats.mostFramesWithoutDamage = cp.flags.framesWithoutDamage;
+    }
+
+    //Modify internal character counter (sheik/zelda detection)
+    uint8_t internalCharId = cp.currentFrameData.internalCharacterId;
+    if (internalCharId < INTERNAL_CHARACTER_COUNT) cp.stats.internalCharUsage[internalCharId] += frameDelta;
+
+    //------------------------------- Monitor Combo Strings -----------------------------------------
+    bool opntTookDamage = op.currentFrameData.percent - op.previousFrameData.percent > 0;
+    bool opntDamagedState = op.currentFrameData.animation >= DAMAGE_START && op.currentFrameData.animation <= DAMAGE_END;
+    bool opntGrabbedState = op.currentFrameData.animation >= CAPTURE_START && op.currentFrameData.animation <= CAPTURE_END;
+    bool opntTechState = (op.currentFrameData.animation >= TECH_START && op.currentFrameData.animation <= TECH_END) ||
+      op.currentFrameData.animation == TECH_MISS_UP || op.currentFrameData.animation == TECH_MISS_DOWN;
+
+    //By looking for percent changes we can increment counter even when a player gets true combo'd
+    //The damage state requirement makes it so things like fox's lasers, grab pummels, pichu damaging self, etc don't increment count
+    if (opntTookDamage && (opntDamagedState || opntGrabbedState)) {
+      if (cp.flags.stringCount == 0) {
+        cp.flags.stringStartPercent = op.previousFrameData.percent;
+        cp.flags.stringStartFrame = game.frameCounter;
+      }
+
+      cp.flags.stringCount++; //increment number of hits
+    }
+
+    //Reset combo string counter when somebody dies or doesn't get hit for too long
+    if (opntDamagedState || opntGrabbedState || opntTechState) cp.flags.stringResetCounter = 0;
+    else if (cp.flags.stringCount > 0) addFrames(cp.flags.stringResetCounter, frameDelta);
+
+    //Mark combo completed if opponent lost his stock or if the counter is greater than threshold frames
+    if (cp.flags.stringCount > 0 && (opntLostStock || lostStock || cp.flags.stringResetCounter > params.comboStringTimeout)) {
+      ComboString* cs = (ComboString*)eventListAppend(game.arena, cp.stats.comboStrings, sizeof(ComboString));
+      if (cs != NULL) {
+        cs->frameStart = cp.flags.stringStartFrame;
+        cs->frameEnd = game.frameCounter;
+        cs->percentStart = cp.flags.stringStartPercent;
+        cs->percentEnd = op.previousFrameData.percent;
+        cs->hitCount = cp.flags.stringCount;
+      }
+
+      //Reset string count
+      cp.flags.stringCount = 0;
+    }
+
+    //------------------- Increment Action Count for APM Calculation --------------------------------
+    //First count the number of buttons that go from 0 to 1
+    uint16_t buttonChanges = (~cp.previousFrameData.physicalButtons & cp.currentFrameData.physicalButtons) & 0xFFF;
+    cp.stats.actionCount += numberOfSetBits(buttonChanges); //Increment action count by amount of button presses
+
+    //Increment action count when sticks change from one region to another. Don't increment when stick returns to deadzone
+    uint8_t prevAnalogRegion = getJoystickRegion(cp.previousFrameData.joystickX, cp.previousFrameData.joystickY);
+    uint8_t currentAnalogRegion = getJoystickRegion(cp.currentFrameData.joystickX, cp.currentFrameData.joystickY);
+    if ((prevAnalogRegion != currentAnalogRegion) && (currentAnalogRegion != 0)) cp.stats.actionCount++;
+
+    //Do the same for c-stick
+    uint8_t prevCstickRegion = getJoystickRegion(cp.previousFrameData.cstickX, cp.previousFrameData.cstickY);
+    uint8_t currentCstickRegion = getJoystickRegion(cp.currentFrameData.cstickX, cp.currentFrameData.cstickY);
+    if ((prevCstickRegion != currentCstickRegion) && (currentCstickRegion != 0)) cp.stats.actionCount++;
+
+    //Increment action on analog trigger... I'm not sure when. This needs revision
+    if (cp.previousFrameData.lTrigger < 0.3 && cp.currentFrameData.lTrigger >= 0.3) cp.stats.actionCount++;
+    if (cp.previousFrameData.rTrigger < 0.3 && cp.currentFrameData.rTrigger >= 0.3) cp.stats.actionCount++;
+
+    //--------------------------- Recovery detection --------------------------------------------------
+    bool isOffStage = checkIfOffStage(game.stage, cp.currentFrameData.locationX, cp.currentFrameData.locationY);
+    bool isInControl = cp.currentFrameData.animation >= GROUNDED_CONTROL_START && cp.currentFrameData.animation <= GROUNDED_CONTROL_END;
+    bool beingDamaged = cp.currentFrameData.animation >= DAMAGE_START && cp.currentFrameData.animation <= DAMAGE_END;
+    bool beingGrabbed = cp.currentFrameData.animation >= CAPTURE_START && cp.currentFrameData.animation <= CAPTURE_END;
+    bool isDying = cp.currentFrameData.animation >= DYING_START && cp.currentFrameData.animation <= DYING_END;
+
+    if (!cp.flags.isRecovering && !cp.flags.isHitOffStage && beingDamaged && isOffStage) {
+      //If player took a hit off stage
+      cp.flags.isHitOffStage = true;
+    }
+    else if (!cp.flags.isRecovering && cp.flags.isHitOffStage && !beingDamaged && !isDying && isOffStage) {
+      //If player exited damage state off stage
+      cp.flags.isRecovering = true;
+      cp.flags.recoveryStartPercent = cp.currentFrameData.percent;
+      cp.flags.recoveryStartFrame = game.frameCounter;
+    }
+    else if (!cp.flags.isLandedOnStage && (cp.flags.isRecovering || cp.flags.isHitOffStage) && isInControl && !isOffStage) {
+      //If a player is in control of his character after recovering flag as landed
+      cp.flags.isLandedOnStage = true;
+    }
+    else if (cp.flags.isLandedOnStage && isOffStage) {
+      //If player landed but is sent back off stage, continue recovery process
+      cp.flags.framesSinceLanding = 0;
+      cp.flags.isLandedOnStage = false;
+    }
+    else if (cp.flags.isLandedOnStage && !isOffStage && !beingDamaged && !beingGrabbed) {
+      //If player landed, is still on stage, is not being hit, and is not grabbed, increment frame counter
+      addFrames(cp.flags.framesSinceLanding, frameDelta);
+
+      //If frame counter while on stage passes threshold, consider it a successful recovery
+      if (cp.flags.framesSinceLanding > params.framesLandedRecovery) {
+        appendRecovery(game.arena, true, cp, game.frameCounter);
+        resetRecoveryFlags(cp.flags);
+      }
+    }
+
+    if ((cp.flags.isRecovering || cp.flags.isHitOffStage) && lostStock) {
+      //If player dies while recovering, consider it a failed recovery
+      if (cp.flags.isRecovering) {
+        appendRecovery(game.arena, false, cp, game.frameCounter);
+      }
+
+      resetRecoveryFlags(cp.flags);
+    }
+
+    //----------------------------- Punish detection --------------------------------------------------
+    bool opntInControl = op.currentFrameData.animation >= GROUNDED_CONTROL_START && op.currentFrameData.animation <= GROUNDED_CONTROL_END;
+
+    if (opntTookDamage && (opntDamagedState || opntGrabbedState)) {
+      // Successfully hit opponent, check if we already have a punish going
+      if (!cp.flags.isPunishing) {
+        // If we didn't have a punish going, start a new one
+        cp.flags.punishStartPercent = op.previousFrameData.percent;
+        cp.flags.punishStartFrame = game.frameCounter;
+        cp.stats.numberOfOpenings++;
+        cp.flags.isPunishing = true;
+      }
+
+      cp.flags.punishHitCount++; //increment number of hits
+    }
+
+    if (opntDamagedState || opntGrabbedState) {
+      // If opponent got grabbed or damaged, reset the punish reset counter
+      cp.flags.framesSincePunishReset = 0; //reset the punish reset timer
+    }
+
+    bool startNeutralCount = cp.flags.framesSincePunishReset == 0 && opntInControl;
+    bool continueNeutralCount = cp.flags.framesSincePunishReset > 0;
+    if (startNeutralCount || continueNeutralCount) {
+      // This will increment the reset timer under the following conditions:
+      // 1) if we were punishing opponent but they have now entered an actionable state
+      // 2) if counter has already started counting meaning opponent has entered actionable state
+      // The opponent only became actionable somewhere in a gap, so a gap only counts once the timer runs
+      addFrames(cp.flags.framesSincePunishReset, continueNeutralCount ? frameDelta : 1);
+    }
+
+    // Termination condition 1 - we kill our opponent
+    if (cp.flags.isPunishing && opntLostStock) {
+      appendPunish(game.arena, true, cp, op, game.frameCounter);
+      resetPunishFlags(cp.flags);
+    }
+
+    // Termination condition 2 - we have not re-hit our opponent in buffer amount
+    if (cp.flags.isPunishing && cp.flags.framesSincePunishReset > params.framesLandedPunish) {
+      appendPunish(game.arena, false, cp, op, game.frameCounter);
+      resetPunishFlags(cp.flags);
+    }
+
+    //-------------------------- Stock specific stuff -------------------------------------------------
+    int prevStockIndex = STOCK_COUNT - cp.previousFrameData.stocks;
+    if (prevStockIndex >= 0 && prevStockIndex < STOCK_COUNT) {
+      StockStatistics& s = cp.stats.stocks[prevStockIndex];
+
+      if (s.frameStart == 0) s.frameStart = game.frameCounter;
+      s.percent = cp.currentFrameData.percent;
+      s.lastHitBy = op.currentFrameData.lastMoveHitId; //This will indicate what this player was killed by
+      s.lastAnimation = cp.currentFrameData.animation; //What was character doing before death
+    }
+
+    //Mark last stock as lost if lostStock is true
+    if (lostStock && prevStockIndex >= 0 && prevStockIndex < STOCK_COUNT) {
+      int16_t prevOpenings = 0;
+      for (int i = prevStockIndex - 1; i >= 0; i--) prevOpenings += cp.stats.stocks[i].killedInOpenings;
+
+      cp.stats.stocks[prevStockIndex].killedInOpenings = op.stats.numberOfOpenings - prevOpenings;
+      cp.stats.stocks[prevStockIndex].frameEnd = game.frameCounter;
+
+      //A gap can hide more than one stock loss, the stocks in between start and end on this frame
+      for (int j = prevStockIndex + 1; j < STOCK_COUNT - cp.currentFrameData.stocks && j < STOCK_COUNT; j++) {
+        StockStatistics& s = cp.stats.stocks[j];
+        s.frameStart = game.frameCounter;
+        s.frameEnd = game.frameCounter;
+        s.percent = 0;
+        s.killedInOpenings = 0;
+      }
+    }
+  }
+}
+
+//**********************************************************************
+//*                          Engine Context
+//**********************************************************************
+//Everything the engine needs to follow one stream of messages. Nothing in this file keeps state of its
+//own, so any number of contexts can run side by side, one per thread or one per parameter set. Each
+//context has its own arena for the event lists of its game
+typedef struct {
+  Game game;
+  StatsParams params;
+  bool gameInProgress;
+
+  GameArena arena;
+  uint8_t arenaMemory[GAME_ARENA_SIZE];
+} StatsContext;
+
+//Return values of statsHandleMessage
+#define STATS_REJECTED -1 //Size does not match the event or a game start of another schema version, dropped like loop() does
+#define STATS_IGNORED 0
+#define STATS_GAME_STARTED 1
+#define STATS_FRAME 2
+#define STATS_GAME_ENDED 3 //The game in the context is complete and can be summarized
+
+void statsContextInitialize(StatsContext& ctx, const StatsParams& params = DefaultStatsParams) {
+  ctx.game = { };
+  ctx.params = params;
+  ctx.gameInProgress = false;
+  arenaInit(ctx.arena, ctx.arenaMemory, sizeof(ctx.arenaMemory));
+}
+
+//Handles one message, the event code followed by the payload. Mirrors the event switch in loop()
+int statsHandleMessage(StatsContext& ctx, const uint8_t* message, int messageSize) {
+  uint8_t eventCode = message[0];
+  const uint8_t* data = message + 1;
+  if (messageSize - 1 != asmEvents[eventCode]) return STATS_REJECTED;
+
+  switch (eventCode) {
+    case EVENT_GAME_START:
+      //Set on every game so a copied context never writes into the original
+      arenaReset(ctx.arena);
+      ctx.game.arena = &ctx.arena;
+      decodeGameStart(ctx.game, data);
+      ctx.gameInProgress = schemaVersionMatches(ctx.game);
+      return ctx.gameInProgress ? STATS_GAME_STARTED : STATS_REJECTED;
+    case EVENT_UPDATE:
+      decodeUpdate(ctx.game, data);
+      computeGameStatistics(ctx.game, ctx.params);
+      return STATS_FRAME;
+    case EVENT_GAME_END: {
+      decodeGameEnd(ctx.game, data);
+      bool ended = ctx.gameInProgress;
+      ctx.gameInProgress = false;
+      return ended ? STATS_GAME_ENDED : STATS_IGNORED;
+    }
+  }
+
+  return STATS_IGNORED;
+}
+
+//Runs one message through several contexts that follow the same stream with different parameters.
+//Each message is decoded once, only the statistics are computed per context. Returns the result for
+//the first context, all of them get the same one
+int statsHandleMessageSets(StatsContext* contexts, int count, const uint8_t* message, int messageSize) {
+  int result = statsHandleMessage(contexts[0], message, messageSize);
+  if (result == STATS_REJECTED || result == STATS_IGNORED) return result;
+
+  const Game& decoded = contexts[0].game;
+  for (int k = 1; k < count; k++) {
+    StatsContext& ctx = contexts[k];
+    if (result == STATS_GAME_STARTED) {
+      ctx.game = decoded;
+      arenaReset(ctx.arena);
+      gameAttachArena(ctx.game, &ctx.arena);
+      ctx.gameInProgress = true;
+    } else if (result == STATS_FRAME) {
+      Game& game = ctx.game;
+      game.frameCounter = decoded.frameCounter;
+      game.framesMissed = decoded.framesMissed;
+      game.frameDelta = decoded.frameDelta;
+      game.randomSeed = decoded.randomSeed;
+      for (int i = 0; i < PLAYER_COUNT; i++) {
+        game.players[i].previousFrameData = decoded.players[i].previousFrameData;
+        game.players[i].currentFrameData = decoded.players[i].currentFrameData;
+      }
+      computeGameStatistics(game, ctx.params);
+    } else {
+      ctx.game.winCondition = decoded.winCondition;
+      ctx.gameInProgress = false;
+    }
+  }
+
+  return result;
+}
+
+#endif